@@ -0,0 +1,427 @@
+/*
+ * Copyright (C) 2015 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define BATCH_STATS_AVX2
+#endif
+
+#include "batch_stats.hh"
+
+using namespace gazebo;
+using namespace benchmark;
+
+namespace
+{
+  /// \brief Statistic names BatchStats knows.
+  const char *const statNames[] = {"maxAbs", "mean", "rms", "var",
+                                   "min", "max"};
+
+  /// \brief Partial results of a block, per lane. Sample i of a block
+  /// goes to lane i % 4.
+  struct Lanes
+  {
+    double maxAbs[4];
+    double min[4];
+    double max[4];
+    double sum[4];
+    double sumCompensation[4];
+    double squares[4];
+    double squaresCompensation[4];
+  };
+
+  /// \brief Kahan compensated add of _value to _sum.
+  inline void KahanAdd(double &_sum, double &_compensation, double _value)
+  {
+    const double y = _value - _compensation;
+    const double t = _sum + y;
+    _compensation = (t - _sum) - y;
+    _sum = t;
+  }
+
+  /// \brief Start every lane of a block.
+  void StartLanes(Lanes &_lanes)
+  {
+    for (int l = 0; l < 4; ++l)
+    {
+      _lanes.maxAbs[l] = 0.0;
+      _lanes.min[l] = std::numeric_limits<double>::infinity();
+      _lanes.max[l] = -std::numeric_limits<double>::infinity();
+      _lanes.sum[l] = 0.0;
+      _lanes.sumCompensation[l] = 0.0;
+      _lanes.squares[l] = 0.0;
+      _lanes.squaresCompensation[l] = 0.0;
+    }
+  }
+
+  /// \brief First pass over samples [_begin, _end) of a block, one lane
+  /// at a time. The comparisons are written as those of _mm256_max_pd
+  /// and _mm256_min_pd, so that both passes agree on every sample.
+  void AccumulateScalar(const double *_values, size_t _begin, size_t _end
+    , Lanes &_lanes)
+  {
+    for (size_t i = _begin; i < _end; ++i)
+    {
+      const int l = i % 4;
+      const double x = _values[i];
+      const double a = std::fabs(x);
+      _lanes.maxAbs[l] = _lanes.maxAbs[l] > a ? _lanes.maxAbs[l] : a;
+      _lanes.min[l] = _lanes.min[l] < x ? _lanes.min[l] : x;
+      _lanes.max[l] = _lanes.max[l] > x ? _lanes.max[l] : x;
+      KahanAdd(_lanes.sum[l], _lanes.sumCompensation[l], x);
+      KahanAdd(_lanes.squares[l], _lanes.squaresCompensation[l], x * x);
+    }
+  }
+
+  /// \brief Second pass over samples [_begin, _end) of a block: squared
+  /// deviations from the block mean, one lane at a time.
+  void DeviationsScalar(const double *_values, size_t _begin, size_t _end
+    , double _mean, double *_sum, double *_compensation)
+  {
+    for (size_t i = _begin; i < _end; ++i)
+    {
+      const int l = i % 4;
+      const double d = _values[i] - _mean;
+      KahanAdd(_sum[l], _compensation[l], d * d);
+    }
+  }
+
+#ifdef BATCH_STATS_AVX2
+  /// \brief Kahan compensated add of four lanes.
+  __attribute__((target("avx2")))
+  inline void KahanAdd4(__m256d &_sum, __m256d &_compensation
+    , __m256d _value)
+  {
+    const __m256d y = _mm256_sub_pd(_value, _compensation);
+    const __m256d t = _mm256_add_pd(_sum, y);
+    _compensation = _mm256_sub_pd(_mm256_sub_pd(t, _sum), y);
+    _sum = t;
+  }
+
+  /// \brief AccumulateScalar of a whole block, four samples at a time.
+  __attribute__((target("avx2")))
+  void AccumulateAvx2(const double *_values, size_t _count, Lanes &_lanes)
+  {
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    __m256d maxAbs = _mm256_loadu_pd(_lanes.maxAbs);
+    __m256d min = _mm256_loadu_pd(_lanes.min);
+    __m256d max = _mm256_loadu_pd(_lanes.max);
+    __m256d sum = _mm256_loadu_pd(_lanes.sum);
+    __m256d sumCompensation = _mm256_loadu_pd(_lanes.sumCompensation);
+    __m256d squares = _mm256_loadu_pd(_lanes.squares);
+    __m256d squaresCompensation =
+        _mm256_loadu_pd(_lanes.squaresCompensation);
+    const size_t whole = _count - _count % 4;
+    for (size_t i = 0; i < whole; i += 4)
+    {
+      const __m256d x = _mm256_loadu_pd(_values + i);
+      maxAbs = _mm256_max_pd(maxAbs, _mm256_andnot_pd(sign, x));
+      min = _mm256_min_pd(min, x);
+      max = _mm256_max_pd(max, x);
+      KahanAdd4(sum, sumCompensation, x);
+      KahanAdd4(squares, squaresCompensation, _mm256_mul_pd(x, x));
+    }
+    _mm256_storeu_pd(_lanes.maxAbs, maxAbs);
+    _mm256_storeu_pd(_lanes.min, min);
+    _mm256_storeu_pd(_lanes.max, max);
+    _mm256_storeu_pd(_lanes.sum, sum);
+    _mm256_storeu_pd(_lanes.sumCompensation, sumCompensation);
+    _mm256_storeu_pd(_lanes.squares, squares);
+    _mm256_storeu_pd(_lanes.squaresCompensation, squaresCompensation);
+    AccumulateScalar(_values, whole, _count, _lanes);
+  }
+
+  /// \brief DeviationsScalar of a whole block, four samples at a time.
+  __attribute__((target("avx2")))
+  void DeviationsAvx2(const double *_values, size_t _count, double _mean
+    , double *_sum, double *_compensation)
+  {
+    const __m256d mean = _mm256_set1_pd(_mean);
+    __m256d sum = _mm256_loadu_pd(_sum);
+    __m256d compensation = _mm256_loadu_pd(_compensation);
+    const size_t whole = _count - _count % 4;
+    for (size_t i = 0; i < whole; i += 4)
+    {
+      const __m256d d = _mm256_sub_pd(_mm256_loadu_pd(_values + i), mean);
+      KahanAdd4(sum, compensation, _mm256_mul_pd(d, d));
+    }
+    _mm256_storeu_pd(_sum, sum);
+    _mm256_storeu_pd(_compensation, compensation);
+    DeviationsScalar(_values, whole, _count, _mean, _sum, _compensation);
+  }
+
+  /// \brief Square roots of a block, four at a time.
+  __attribute__((target("avx2")))
+  void MagnitudesAvx2(const double *_x, const double *_y, const double *_z
+    , size_t _count, double *_mag)
+  {
+    const size_t whole = _count - _count % 4;
+    for (size_t i = 0; i < whole; i += 4)
+    {
+      const __m256d x = _mm256_loadu_pd(_x + i);
+      const __m256d y = _mm256_loadu_pd(_y + i);
+      const __m256d z = _mm256_loadu_pd(_z + i);
+      const __m256d squares = _mm256_add_pd(_mm256_add_pd(
+          _mm256_mul_pd(x, x), _mm256_mul_pd(y, y)), _mm256_mul_pd(z, z));
+      _mm256_storeu_pd(_mag + i, _mm256_sqrt_pd(squares));
+    }
+    for (size_t i = whole; i < _count; ++i)
+      _mag[i] = std::sqrt(_x[i] * _x[i] + _y[i] * _y[i] + _z[i] * _z[i]);
+  }
+
+  /// \brief Whether the processor running the benchmark has AVX2.
+  const bool hasAvx2 = __builtin_cpu_supports("avx2");
+
+  /// \brief Whether blocks are reduced with AVX2, see
+  /// BatchStats::UseAvx2.
+  bool useAvx2 = hasAvx2;
+#endif
+
+  /// \brief Sum of the four lanes of a Kahan sum, itself compensated.
+  double SumLanes(const double *_sum, const double *_compensation)
+  {
+    double sum = 0.0;
+    double compensation = 0.0;
+    for (int l = 0; l < 4; ++l)
+    {
+      KahanAdd(sum, compensation, _sum[l]);
+      KahanAdd(sum, compensation, -_compensation[l]);
+    }
+    return sum;
+  }
+}
+
+/////////////////////////////////////////////////
+bool BatchStats::UseAvx2(bool _enabled)
+{
+#ifdef BATCH_STATS_AVX2
+  useAvx2 = _enabled && hasAvx2;
+  return useAvx2;
+#else
+  (void)_enabled;
+  return false;
+#endif
+}
+
+/////////////////////////////////////////////////
+bool BatchStats::InsertStatistics(const std::string &_names)
+{
+  std::istringstream stream(_names);
+  std::string name;
+  while (std::getline(stream, name, ','))
+  {
+    bool known = false;
+    for (const char *statName : statNames)
+      known = known || name == statName;
+    if (!known || this->nameCount == 6)
+      return false;
+    this->names[this->nameCount++] = name;
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////
+void BatchStats::InsertBlock(const double *_values, size_t _count)
+{
+  while (_count > 0 && this->buffered > 0)
+  {
+    this->InsertData(*_values++);
+    --_count;
+  }
+  const size_t whole = _count - _count % BlockSize;
+  for (size_t i = 0; i < whole; i += BlockSize)
+    this->Reduce(_values + i, BlockSize);
+  for (size_t i = whole; i < _count; ++i)
+    this->InsertData(_values[i]);
+}
+
+/////////////////////////////////////////////////
+void BatchStats::Flush()
+{
+  this->Reduce(this->buffer, this->buffered);
+  this->buffered = 0;
+}
+
+/////////////////////////////////////////////////
+size_t BatchStats::Count() const
+{
+  return this->count + this->buffered;
+}
+
+/////////////////////////////////////////////////
+void BatchStats::Reduce(const double *_values, size_t _count)
+{
+  if (_count == 0)
+    return;
+
+  Lanes lanes;
+  StartLanes(lanes);
+#ifdef BATCH_STATS_AVX2
+  if (useAvx2)
+    AccumulateAvx2(_values, _count, lanes);
+  else
+#endif
+    AccumulateScalar(_values, 0, _count, lanes);
+  const double blockMean =
+      SumLanes(lanes.sum, lanes.sumCompensation) / _count;
+
+  // Second pass for the deviations, the block is still in the cache
+  double deviations[4] = {0.0, 0.0, 0.0, 0.0};
+  double deviationsCompensation[4] = {0.0, 0.0, 0.0, 0.0};
+#ifdef BATCH_STATS_AVX2
+  if (useAvx2)
+  {
+    DeviationsAvx2(_values, _count, blockMean, deviations,
+                   deviationsCompensation);
+  }
+  else
+#endif
+  {
+    DeviationsScalar(_values, 0, _count, blockMean, deviations,
+                     deviationsCompensation);
+  }
+  const double blockM2 = SumLanes(deviations, deviationsCompensation);
+
+  // Welford's update, with a block in place of a single sample
+  const double n = static_cast<double>(this->count);
+  const double total = n + _count;
+  const double delta = blockMean - this->mean;
+  this->mean += delta * _count / total;
+  this->m2 += blockM2 + delta * delta * n * _count / total;
+  KahanAdd(this->sumSquares, this->sumSquaresCompensation,
+           SumLanes(lanes.squares, lanes.squaresCompensation));
+
+  for (int l = 0; l < 4; ++l)
+  {
+    this->maxAbs = std::max(this->maxAbs, lanes.maxAbs[l]);
+    this->min = std::min(this->min, lanes.min[l]);
+    this->max = std::max(this->max, lanes.max[l]);
+  }
+  this->count += _count;
+}
+
+/////////////////////////////////////////////////
+std::map<std::string, double> BatchStats::Map() const
+{
+  // The buffered samples are reduced in a copy
+  BatchStats all = *this;
+  all.Flush();
+
+  std::map<std::string, double> values;
+  for (int i = 0; i < this->nameCount; ++i)
+  {
+    const std::string &name = this->names[i];
+    double value = 0.0;
+    if (all.count == 0)
+      value = 0.0;
+    else if (name == "maxAbs")
+      value = all.maxAbs;
+    else if (name == "mean")
+      value = all.mean;
+    else if (name == "rms")
+      value = std::sqrt(all.sumSquares / all.count);
+    else if (name == "var")
+      value = all.count > 1 ? all.m2 / (all.count - 1) : 0.0;
+    else if (name == "min")
+      value = all.min;
+    else if (name == "max")
+      value = all.max;
+    values[name] = value;
+  }
+  return values;
+}
+
+/////////////////////////////////////////////////
+bool Vector3BatchStats::InsertStatistics(const std::string &_names)
+{
+  bool result = true;
+  for (auto &stats : this->stats)
+    result = stats.InsertStatistics(_names) && result;
+  return result;
+}
+
+/////////////////////////////////////////////////
+void Vector3BatchStats::Flush()
+{
+  if (this->buffered == 0)
+    return;
+
+  double mag[BatchStats::BlockSize];
+#ifdef BATCH_STATS_AVX2
+  if (useAvx2)
+    MagnitudesAvx2(this->x, this->y, this->z, this->buffered, mag);
+  else
+#endif
+  {
+    for (size_t i = 0; i < this->buffered; ++i)
+    {
+      mag[i] = std::sqrt(this->x[i] * this->x[i] + this->y[i] * this->y[i] +
+                         this->z[i] * this->z[i]);
+    }
+  }
+  this->stats[0].InsertBlock(this->x, this->buffered);
+  this->stats[1].InsertBlock(this->y, this->buffered);
+  this->stats[2].InsertBlock(this->z, this->buffered);
+  this->stats[3].InsertBlock(mag, this->buffered);
+  this->buffered = 0;
+}
+
+/////////////////////////////////////////////////
+const BatchStats &Vector3BatchStats::X()
+{
+  this->Flush();
+  return this->stats[0];
+}
+
+/////////////////////////////////////////////////
+const BatchStats &Vector3BatchStats::Y()
+{
+  this->Flush();
+  return this->stats[1];
+}
+
+/////////////////////////////////////////////////
+const BatchStats &Vector3BatchStats::Z()
+{
+  this->Flush();
+  return this->stats[2];
+}
+
+/////////////////////////////////////////////////
+const BatchStats &Vector3BatchStats::Mag()
+{
+  this->Flush();
+  return this->stats[3];
+}
+
+/////////////////////////////////////////////////
+std::map<std::string, double> Vector3BatchStats::Map()
+{
+  this->Flush();
+  const char *const keys[] = {"_x_", "_y_", "_z_", "_mag_"};
+  std::map<std::string, double> values;
+  for (int i = 0; i < 4; ++i)
+  {
+    for (const auto &value : this->stats[i].Map())
+      values[keys[i] + value.first] = value.second;
+  }
+  return values;
+}
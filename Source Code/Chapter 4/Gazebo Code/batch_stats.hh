@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2015 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef BENCHMARK_GAZEBO_BATCH_STATS_HH_
+#define BENCHMARK_GAZEBO_BATCH_STATS_HH_
+
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <string>
+
+#include <ignition/math/Vector3.hh>
+
+namespace gazebo
+{
+  namespace benchmark
+  {
+    /// \brief Streaming statistics of a signal, as
+    /// ignition::math::SignalStats with the same statistic names, but
+    /// samples are buffered and folded in a block at a time. A block is
+    /// reduced with AVX2 when the processor has it, four lanes wide with
+    /// Kahan compensated sums, and merged into the running mean and
+    /// variance with Welford's update. The scalar fallback runs the same
+    /// lanes, so both give identical results.
+    class BatchStats
+    {
+      /// \brief Samples buffered before a block is reduced.
+      public: static const size_t BlockSize = 256;
+
+      /// \brief Reduce blocks with AVX2 or with the scalar lanes, so that
+      /// tests can compare them. AVX2 is used by default when the
+      /// processor has it.
+      /// \param[in] _enabled Use AVX2 if the processor has it.
+      /// \return True if blocks are reduced with AVX2 from now on.
+      public: static bool UseAvx2(bool _enabled);
+
+      /// \brief Select the statistics reported by Map.
+      /// \param[in] _names Comma separated names among maxAbs, mean, rms,
+      /// var, min and max.
+      /// \return False if a name is unknown.
+      public: bool InsertStatistics(const std::string &_names);
+
+      /// \brief Add a sample.
+      /// \param[in] _value Sample value.
+      public: void InsertData(double _value)
+      {
+        this->buffer[this->buffered++] = _value;
+        if (this->buffered == BlockSize)
+          this->Flush();
+      }
+
+      /// \brief Add samples, buffered ones first.
+      /// \param[in] _values Sample values.
+      /// \param[in] _count Number of samples.
+      public: void InsertBlock(const double *_values, size_t _count);
+
+      /// \brief Reduce the buffered samples now.
+      public: void Flush();
+
+      /// \brief Number of samples, buffered ones included.
+      public: size_t Count() const;
+
+      /// \brief Selected statistics of every sample so far, buffered ones
+      /// included, keyed by name.
+      /// \return Map from statistic name to value.
+      public: std::map<std::string, double> Map() const;
+
+      /// \brief Fold a block into the running statistics.
+      /// \param[in] _values Samples.
+      /// \param[in] _count Number of samples.
+      private: void Reduce(const double *_values, size_t _count);
+
+      /// \brief Samples not reduced yet.
+      private: double buffer[BlockSize];
+      private: size_t buffered = 0;
+
+      /// \brief Names of the selected statistics.
+      private: std::string names[6];
+      private: int nameCount = 0;
+
+      /// \brief Reduced samples and their running statistics.
+      private: size_t count = 0;
+      private: double mean = 0.0;
+      private: double m2 = 0.0;
+      private: double sumSquares = 0.0;
+      private: double sumSquaresCompensation = 0.0;
+      private: double maxAbs = 0.0;
+      private: double min = std::numeric_limits<double>::infinity();
+      private: double max = -std::numeric_limits<double>::infinity();
+    };
+
+    /// \brief BatchStats of the components and the magnitude of a vector
+    /// signal, as ignition::math::Vector3Stats. Components are buffered
+    /// as separate arrays, and the magnitudes of a block are computed
+    /// together when it is reduced.
+    class Vector3BatchStats
+    {
+      /// \brief Select the statistics of every component and the
+      /// magnitude.
+      /// \param[in] _names Comma separated names, see BatchStats.
+      /// \return False if a name is unknown.
+      public: bool InsertStatistics(const std::string &_names);
+
+      /// \brief Add a sample.
+      /// \param[in] _value Sample vector.
+      public: void InsertData(const ignition::math::Vector3d &_value)
+      {
+        this->x[this->buffered] = _value.X();
+        this->y[this->buffered] = _value.Y();
+        this->z[this->buffered] = _value.Z();
+        if (++this->buffered == BatchStats::BlockSize)
+          this->Flush();
+      }
+
+      /// \brief Reduce the buffered samples now.
+      public: void Flush();
+
+      /// \brief Statistics of the x component.
+      public: const BatchStats &X();
+
+      /// \brief Statistics of the y component.
+      public: const BatchStats &Y();
+
+      /// \brief Statistics of the z component.
+      public: const BatchStats &Z();
+
+      /// \brief Statistics of the magnitude.
+      public: const BatchStats &Mag();
+
+      /// \brief Selected statistics keyed as ServerFixture::Record names
+      /// those of a Vector3Stats: _x_, _y_, _z_ and _mag_ followed by the
+      /// statistic name.
+      /// \return Map from key to value.
+      public: std::map<std::string, double> Map();
+
+      /// \brief Components not reduced yet.
+      private: double x[BatchStats::BlockSize];
+      private: double y[BatchStats::BlockSize];
+      private: double z[BatchStats::BlockSize];
+      private: size_t buffered = 0;
+
+      /// \brief Statistics of the components and the magnitude.
+      private: BatchStats stats[4];
+    };
+  }
+}
+#endif
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2015 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <ignition/math/SignalStats.hh>
+#include <ignition/math/Vector3Stats.hh>
+
+#include "gtest/gtest.h"
+#include "batch_stats.hh"
+
+using namespace gazebo;
+using namespace benchmark;
+
+/// \brief Statistics that ignition::math::SignalStats also has.
+static const char *const statistics = "maxAbs,mean,rms,var";
+
+/// \brief Sample counts below, at and above multiples of 4 and of a block.
+static const size_t sizes[] = {1, 2, 3, 5, 7, 255, 256, 257, 1000, 1027};
+
+/////////////////////////////////////////////////
+/// \brief Normal samples with a non-zero mean, the same for a seed.
+static std::vector<double> Samples(size_t _count, unsigned _seed)
+{
+  std::mt19937 generator(_seed);
+  std::normal_distribution<double> normal(0.3, 2.0);
+  std::vector<double> samples(_count);
+  for (double &sample : samples)
+    sample = normal(generator);
+  return samples;
+}
+
+/////////////////////////////////////////////////
+/// \brief Expect the same keys and values that agree to rounding.
+static void ExpectNear(const std::map<std::string, double> &_expected
+  , const std::map<std::string, double> &_actual)
+{
+  ASSERT_EQ(_expected.size(), _actual.size());
+  for (const auto &expected : _expected)
+  {
+    auto actual = _actual.find(expected.first);
+    ASSERT_NE(actual, _actual.end()) << expected.first;
+    EXPECT_NEAR(expected.second, actual->second,
+                1e-10 * std::max(1.0, std::fabs(expected.second)))
+      << expected.first;
+  }
+}
+
+/////////////////////////////////////////////////
+TEST(BatchStats, MatchesSignalStats)
+{
+  for (size_t size : sizes)
+  {
+    SCOPED_TRACE(size);
+    const std::vector<double> samples = Samples(size, size);
+    ignition::math::SignalStats expected;
+    BatchStats actual;
+    EXPECT_TRUE(expected.InsertStatistics(statistics));
+    EXPECT_TRUE(actual.InsertStatistics(statistics));
+    for (double sample : samples)
+    {
+      expected.InsertData(sample);
+      actual.InsertData(sample);
+    }
+    EXPECT_EQ(size, actual.Count());
+    ExpectNear(expected.Map(), actual.Map());
+  }
+}
+
+/////////////////////////////////////////////////
+TEST(BatchStats, MinMax)
+{
+  const std::vector<double> samples = Samples(1027, 1);
+  BatchStats stats;
+  EXPECT_TRUE(stats.InsertStatistics("min,max"));
+  stats.InsertBlock(samples.data(), samples.size());
+  const auto minMax = std::minmax_element(samples.begin(), samples.end());
+  EXPECT_EQ(*minMax.first, stats.Map()["min"]);
+  EXPECT_EQ(*minMax.second, stats.Map()["max"]);
+}
+
+/////////////////////////////////////////////////
+TEST(BatchStats, UnknownStatistic)
+{
+  BatchStats stats;
+  EXPECT_FALSE(stats.InsertStatistics("mean,median"));
+}
+
+/////////////////////////////////////////////////
+TEST(BatchStats, InsertBlockAfterBuffered)
+{
+  // Buffered samples before blocks that do and do not fill a block
+  for (size_t buffered : {1, 3, 255})
+  {
+    for (size_t size : sizes)
+    {
+      SCOPED_TRACE(std::to_string(buffered) + " + " + std::to_string(size));
+      const std::vector<double> samples = Samples(buffered + size, size);
+      ignition::math::SignalStats expected;
+      BatchStats actual;
+      expected.InsertStatistics(statistics);
+      actual.InsertStatistics(statistics);
+      for (double sample : samples)
+        expected.InsertData(sample);
+      for (size_t i = 0; i < buffered; ++i)
+        actual.InsertData(samples[i]);
+      actual.InsertBlock(samples.data() + buffered, size);
+      EXPECT_EQ(buffered + size, actual.Count());
+      ExpectNear(expected.Map(), actual.Map());
+    }
+  }
+}
+
+/////////////////////////////////////////////////
+TEST(Vector3BatchStats, MatchesVector3Stats)
+{
+  for (size_t size : sizes)
+  {
+    SCOPED_TRACE(size);
+    const std::vector<double> samples = Samples(3 * size, size);
+    ignition::math::Vector3Stats expected;
+    Vector3BatchStats actual;
+    EXPECT_TRUE(expected.InsertStatistics(statistics));
+    EXPECT_TRUE(actual.InsertStatistics(statistics));
+    for (size_t i = 0; i < size; ++i)
+    {
+      const ignition::math::Vector3d sample(samples[3 * i],
+          samples[3 * i + 1], samples[3 * i + 2]);
+      expected.InsertData(sample);
+      actual.InsertData(sample);
+    }
+    ExpectNear(expected.X().Map(), actual.X().Map());
+    ExpectNear(expected.Y().Map(), actual.Y().Map());
+    ExpectNear(expected.Z().Map(), actual.Z().Map());
+    ExpectNear(expected.Mag().Map(), actual.Mag().Map());
+
+    // Keyed as ServerFixture::Record names those of a Vector3Stats
+    std::map<std::string, double> keyed = actual.Map();
+    EXPECT_EQ(16u, keyed.size());
+    EXPECT_EQ(actual.Mag().Map()["rms"], keyed["_mag_rms"]);
+  }
+}
+
+/////////////////////////////////////////////////
+TEST(BatchStats, Avx2MatchesScalar)
+{
+  if (!BatchStats::UseAvx2(true))
+  {
+    std::cerr << "No AVX2 on this processor, nothing to compare"
+              << std::endl;
+    return;
+  }
+
+  for (size_t size : sizes)
+  {
+    SCOPED_TRACE(size);
+    const std::vector<double> samples = Samples(3 * size, size);
+    std::map<std::string, double> maps[2];
+    std::map<std::string, double> vectorMaps[2];
+    for (int avx2 = 0; avx2 < 2; ++avx2)
+    {
+      BatchStats::UseAvx2(avx2 == 1);
+      BatchStats stats;
+      Vector3BatchStats vectorStats;
+      stats.InsertStatistics("maxAbs,mean,rms,var,min,max");
+      vectorStats.InsertStatistics("maxAbs,mean,rms,var,min,max");
+      stats.InsertData(samples[0]);
+      stats.InsertBlock(samples.data() + 1, samples.size() - 1);
+      for (size_t i = 0; i < size; ++i)
+      {
+        vectorStats.InsertData(ignition::math::Vector3d(samples[3 * i],
+            samples[3 * i + 1], samples[3 * i + 2]));
+      }
+      maps[avx2] = stats.Map();
+      vectorMaps[avx2] = vectorStats.Map();
+    }
+    // The lanes are the same, so the results are identical
+    EXPECT_EQ(maps[0], maps[1]);
+    EXPECT_EQ(vectorMaps[0], vectorMaps[1]);
+  }
+  BatchStats::UseAvx2(true);
+}
@@ -14,7 +14,12 @@
  * limitations under the License.
  *
 */
+#include <algorithm>
+#include <chrono>
+#include <map>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <ignition/math/Pose3.hh>
 #include <ignition/math/Quaternion.hh>
@@ -22,7 +27,10 @@
 
 #include "gazebo/msgs/msgs.hh"
 #include "gazebo/physics/physics.hh"
+#include "batch_stats.hh"
 #include "boxes.hh"
+#include "perf_counters.hh"
+#include "rotation_reference.hh"
 
 /* A. Lazar change begin */
 #include <ignition/math/Angle.hh>
@@ -33,6 +41,17 @@
 using namespace gazebo;
 using namespace benchmark;
 
+/////////////////////////////////////////////////
+// Nearest-rank percentile of a sorted vector, _p in [0, 1]
+static double Percentile(const std::vector<double> &_sorted, double _p)
+{
+  if (_sorted.empty())
+    return 0.0;
+  size_t rank = static_cast<size_t>(ceil(_p * _sorted.size()));
+  rank = std::min(std::max(rank, static_cast<size_t>(1)), _sorted.size());
+  return _sorted[rank - 1];
+}
+
 /////////////////////////////////////////////////
 // Boxes:
 // Spawn a single box and record accuracy for momentum and energy
@@ -155,12 +174,18 @@ void BoxesTest::Boxes(const std::string &_physicsEngine
   const double simDuration = 10.0;
   int steps = ceil(simDuration / _dt);
 
-  // variables to compute statistics on
-  ignition::math::Vector3Stats linearPositionError;
-  ignition::math::Vector3Stats linearVelocityError;
-  ignition::math::Vector3Stats angularPositionError;
-  ignition::math::Vector3Stats angularMomentumError;
-  ignition::math::SignalStats energyError;
+  // reference orientation after every step, computed before the timed
+  // loop so that the error costs a lookup per step
+  const RotationReference rotationReference(I0, w0,
+      link->WorldInertialPose().Rot(), _dt, steps);
+
+  // variables to compute statistics on, buffered and reduced a block of
+  // steps at a time
+  Vector3BatchStats linearPositionError;
+  Vector3BatchStats linearVelocityError;
+  Vector3BatchStats angularPositionError;
+  Vector3BatchStats angularMomentumError;
+  BatchStats energyError;
   {
     const std::string statNames = "maxAbs";
     EXPECT_TRUE(linearPositionError.InsertStatistics(statNames));
@@ -200,6 +225,17 @@ void BoxesTest::Boxes(const std::string &_physicsEngine
   outputFile<<"\n";
   /* A. Lazar change end */
 
+  // The physics update runs on the world thread, World::Step only waits
+  // for it, so the hardware counters follow the world thread and only
+  // run inside its updates
+  PerfCounters perfCounters;
+  event::ConnectionPtr perfStartConnection =
+      event::Events::ConnectWorldUpdateBegin(
+      [&](const common::UpdateInfo &) { perfCounters.Start(); });
+  event::ConnectionPtr perfStopConnection =
+      event::Events::ConnectWorldUpdateEnd(
+      [&]() { perfCounters.Stop(); });
+
   // unthrottle update rate
   physics->SetRealTimeUpdateRate(0.0);
   common::Time startTime = common::Time::GetWallTime();
@@ -220,6 +256,9 @@ void BoxesTest::Boxes(const std::string &_physicsEngine
     ignition::math::Vector3d p_aux = p - (p0 + v0 * t + 0.5*g*t*t);
     linearPositionError.InsertData(p - (p0 + v0 * t + 0.5*g*t*t));
 
+    // angular position error
+    angularPositionError.InsertData(
+        rotationReference.Error(i, link->WorldInertialPose().Rot()));
 
     // angular momentum error
     ignition::math::Vector3d H = link->WorldAngularMomentum();
@@ -265,14 +304,25 @@ void BoxesTest::Boxes(const std::string &_physicsEngine
   this->Record("simTime", simTime.Double());
   this->Record("timeRatio", elapsedTime.Double() / simTime.Double());
 
-  // Record statistics on pitch and yaw angles
+  // Record statistics on pitch and yaw angles, under the names Record
+  // gives SignalStats and Vector3Stats
+  auto recordStats = [this](const std::string &_prefix,
+                            const std::map<std::string, double> &_values)
+  {
+    for (const auto &value : _values)
+      this->Record(_prefix + value.first, value.second);
+  };
   this->Record("energy0", E0);
-  this->Record("energyError_", energyError);
+  recordStats("energyError_", energyError.Map());
   this->Record("angMomentum0", H0mag);
-  this->Record("angMomentumErr_", angularMomentumError.Mag());
-  this->Record("angPositionErr", angularPositionError);
-  this->Record("linPositionErr_", linearPositionError.Mag());
-  this->Record("linVelocityErr_", linearVelocityError.Mag());
+  recordStats("angMomentumErr_", angularMomentumError.Mag().Map());
+  recordStats("angPositionErr", angularPositionError.Map());
+  recordStats("linPositionErr_", linearPositionError.Mag().Map());
+  recordStats("linVelocityErr_", linearVelocityError.Mag().Map());
+
+  // Counter totals and rates, zero when perf counters are unavailable
+  for (const auto &value : perfCounters.Values())
+    this->Record(value.first, value.second);
 
   /* A. Lazar change begin */
   outputFile.close();
@@ -306,3 +356,154 @@ TEST_P(BoxesTest, Boxes)
 
 
 }
+
+/////////////////////////////////////////////////
+// BoxesRealTime:
+// Spawn boxes and step the world at a fixed real-time update rate,
+// recording the wall latency of each step and how often a step finishes
+// after its deadline.
+void BoxesRealTimeTest::BoxesRealTime(const std::string &_physicsEngine
+                                    , double _dt
+                                    , int _modelCount
+                                    , bool _collision
+                                    , bool _complex)
+{
+  // Load a blank world (no ground plane)
+  Load("worlds/blank.world", true, _physicsEngine);
+  physics::WorldPtr world = physics::get_world("default");
+  ASSERT_NE(world, nullptr);
+
+  // Verify physics engine type
+  physics::PhysicsEnginePtr physics = world->Physics();
+  ASSERT_NE(physics, nullptr);
+  ASSERT_EQ(physics->GetType(), _physicsEngine);
+
+  if (!_complex)
+  {
+    world->SetGravity(ignition::math::Vector3d::Zero);
+  }
+
+  // Same box and initial conditions as BoxesTest::Boxes
+  const double dx = 0.1;
+  const double dy = 0.4;
+  const double dz = 0.9;
+  const double mass = 10.0;
+  msgs::Model msgModel;
+  msgs::AddBoxLink(msgModel, mass, ignition::math::Vector3d(dx, dy, dz));
+  if (!_collision)
+  {
+    msgModel.mutable_link(0)->clear_collision();
+  }
+
+  ignition::math::Vector3d v0(-0.9, 0.4, 0.1);
+  ignition::math::Vector3d w0(0.5, 0, 0);
+  if (_complex)
+  {
+    v0.Set(-2.0, 2.0, 8.0);
+    w0.Set(0.1, 5.0, 0.1);
+  }
+
+  ASSERT_GT(_modelCount, 0);
+  for (int i = 0; i < _modelCount; ++i)
+  {
+    msgModel.set_name(this->GetUniqueString("model"));
+    msgs::Set(msgModel.mutable_pose()->mutable_position(),
+              ignition::math::Vector3d(0.0, dz*2*i, 0.0));
+
+    physics::ModelPtr model = this->SpawnModel(msgModel);
+    ASSERT_NE(model, nullptr);
+
+    physics::LinkPtr link = model->GetLink();
+    ASSERT_NE(link, nullptr);
+
+    link->SetLinearVel(v0);
+    link->SetAngularVel(w0);
+  }
+
+  common::Time t0 = world->SimTime();
+
+  physics->SetMaxStepSize(_dt);
+  const double simDuration = 5.0;
+  int steps = ceil(simDuration / _dt);
+
+  // The fixture paces the steps itself, like a real-time controller loop
+  // would, so keep the world thread unthrottled and avoid pacing twice.
+  physics->SetRealTimeUpdateRate(0.0);
+
+  typedef std::chrono::steady_clock Clock;
+  const auto period = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(_dt));
+
+  std::vector<double> latencies;
+  latencies.reserve(steps);
+  int deadlineMisses = 0;
+
+  const auto startTime = Clock::now();
+  auto deadline = startTime;
+  for (int i = 0; i < steps; ++i)
+  {
+    deadline += period;
+
+    const auto stepStart = Clock::now();
+    world->Step(1);
+    const auto stepEnd = Clock::now();
+
+    latencies.push_back(
+        std::chrono::duration<double>(stepEnd - stepStart).count());
+
+    // Keep an absolute schedule, so a late step does not shift the
+    // deadlines of the steps after it.
+    if (stepEnd > deadline)
+      ++deadlineMisses;
+    else
+      std::this_thread::sleep_until(deadline);
+  }
+  const double elapsedTime =
+      std::chrono::duration<double>(Clock::now() - startTime).count();
+
+  common::Time simTime = (world->SimTime() - t0).Double();
+  ASSERT_NEAR(simTime.Double(), simDuration, _dt*1.1);
+
+  this->Record("updateRate", 1.0 / _dt);
+  this->Record("wallTime", elapsedTime);
+  this->Record("simTime", simTime.Double());
+  this->Record("timeRatio", elapsedTime / simTime.Double());
+  this->Record("deadlineMissRate",
+      static_cast<double>(deadlineMisses) / steps);
+
+  double latencySum = 0.0;
+  for (const double latency : latencies)
+    latencySum += latency;
+  std::sort(latencies.begin(), latencies.end());
+  this->Record("stepLatency_mean", latencySum / latencies.size());
+  this->Record("stepLatency_p50", Percentile(latencies, 0.5));
+  this->Record("stepLatency_p99", Percentile(latencies, 0.99));
+  this->Record("stepLatency_p999", Percentile(latencies, 0.999));
+  this->Record("stepLatency_max", latencies.back());
+}
+
+/////////////////////////////////////////////////
+TEST_P(BoxesRealTimeTest, BoxesRealTime)
+{
+  std::string physicsEngine = std::tr1::get<0>(GetParam());
+  double dt                 = std::tr1::get<1>(GetParam());
+  int modelCount            = std::tr1::get<2>(GetParam());
+  bool collision            = std::tr1::get<3>(GetParam());
+  bool isComplex            = std::tr1::get<4>(GetParam());
+  gzdbg << physicsEngine
+        << ", dt: " << dt
+        << ", modelCount: " << modelCount
+        << ", collision: " << collision
+        << ", isComplex: " << isComplex
+        << std::endl;
+  RecordProperty("engine", physicsEngine);
+  this->Record("dt", dt);
+  RecordProperty("modelCount", modelCount);
+  RecordProperty("collision", collision);
+  RecordProperty("isComplex", isComplex);
+  BoxesRealTime(physicsEngine
+              , dt
+              , modelCount
+              , collision
+              , isComplex);
+}
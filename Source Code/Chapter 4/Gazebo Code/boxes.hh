@@ -51,6 +51,24 @@ namespace gazebo
                        , bool _collision
                        , bool _complex);
     };
+
+    // Same parameters as BoxesTest, but the world is stepped in real time
+    // with the update rate given by 1 / dt.
+    class BoxesRealTimeTest : public BoxesTest
+    {
+      /// \brief Test per-step wall latency and deadline misses when the
+      /// world is paced at a fixed real-time update rate.
+      /// \param[in] _physicsEngine Physics engine to use.
+      /// \param[in] _dt Max time step size, also the real-time step period.
+      /// \param[in] _modelCount Number of boxes to spawn.
+      /// \param[in] _collision Flag for collision shape on / off.
+      /// \param[in] _complex Flag for complex trajectory on / off.
+      public: void BoxesRealTime(const std::string &_physicsEngine
+                               , double _dt
+                               , int _modelCount
+                               , bool _collision
+                               , bool _complex);
+    };
   }
 }
 #endif
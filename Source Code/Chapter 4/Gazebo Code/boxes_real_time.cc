@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2015 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <string.h>
+
+#include "boxes.hh"
+#include "gazebo/test/helper_physics_generator.hh"
+
+using namespace gazebo;
+using namespace benchmark;
+
+// 1 kHz real-time update rate
+const double g_dt_real_time = 1.0e-3;
+
+INSTANTIATE_TEST_CASE_P(EnginesModelCountRealTime, BoxesRealTimeTest,
+  ::testing::Combine(PHYSICS_ENGINE_VALUES
+  , ::testing::Values(g_dt_real_time)
+  , ::testing::Values(1, 10, 50)
+  , ::testing::Values(true)
+  , ::testing::Values(true)));
+
+/////////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2015 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <string.h>
+
+#include "collide_spheres.hh"
+#include "gazebo/test/helper_physics_generator.hh"
+
+using namespace gazebo;
+using namespace benchmark;
+
+// ode, bullet and simbody build their broadphase in code, so they only
+// run with their default collision detector.
+INSTANTIATE_TEST_CASE_P(EnginesDefaultDetector, CollideBroadphaseTest,
+  ::testing::Combine(PHYSICS_ENGINE_VALUES
+  , ::testing::Values(1.0e-3)
+  , ::testing::Values("default")
+  , ::testing::Values("spheres", "boxes")
+  , ::testing::Values(100, 1000, 10000)));
+
+#ifdef HAVE_DART
+INSTANTIATE_TEST_CASE_P(DartDetectors, CollideBroadphaseTest,
+  ::testing::Combine(::testing::Values("dart")
+  , ::testing::Values(1.0e-3)
+  , ::testing::Values("fcl", "dart", "bullet", "ode")
+  , ::testing::Values("spheres", "boxes")
+  , ::testing::Values(100, 1000, 10000)));
+#endif
+
+/////////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -14,13 +14,24 @@
  * limitations under the License.
  *
 */
+#include <algorithm>
+#include <cmath>
+#include <fstream>
 #include <map>
+#include <memory>
+#include <random>
+#include <sstream>
 #include <string>
 #include <utility>
+#include <vector>
+
+#include <boost/filesystem.hpp>
 
 #include "gazebo/msgs/msgs.hh"
 #include "gazebo/physics/physics.hh"
 #include "collide_spheres.hh"
+#include "contact_capture.hh"
+#include "step_timer.hh"
 
 using namespace gazebo;
 using namespace benchmark;
@@ -128,18 +139,16 @@ void CollideTest::Spheres(const std::string &_physicsEngine
     EXPECT_DOUBLE_EQ(positionDiff.Length(), dmPair.first * 1e-1);
   }
 
-  // You have to subscribe to a contacts topic in order to use
-  // the C++ API, otherwise it skips it to save CPU time
-  auto contactSub = this->node->Subscribe("~/physics/contacts", &OnContacts);
+  // Fill in contacts without subscribing to the contacts topic
+  ContactCapture contactCapture(physics);
+  ASSERT_TRUE(contactCapture.Valid());
 
   world->Step(1);
 
   // Contact data
-  auto contactManager = physics->GetContactManager();
-  ASSERT_NE(contactManager, nullptr);
-  unsigned int contactCount = contactManager->GetContactCount();
+  unsigned int contactCount = contactCapture.Count();
   EXPECT_EQ(contactCount, 16u);
-  auto contacts = contactManager->GetContacts();
+  const auto &contacts = contactCapture.Contacts();
 
   for (unsigned int i = 0; i < contactCount; ++i)
   {
@@ -180,3 +189,539 @@ TEST_P(CollideTest, Spheres)
   Spheres(physicsEngine
         , dt);
 }
+
+/////////////////////////////////////////////////
+// Separation ratios (center distance / radius) of collide_spheres.world.
+// Pairs with a ratio of 2.0 or less are in contact.
+static const double g_separationRatios[] =
+  {3.0, 2.5, 2.2, 2.1, 2.0, 1.9, 1.8, 1.5, 1.0, 0.5, 0.1, 0.0};
+static const int g_separationCount =
+  sizeof(g_separationRatios) / sizeof(g_separationRatios[0]);
+
+/////////////////////////////////////////////////
+// Open a temporary world file and write everything up to the models.
+// The physics type is replaced by the engine passed to Load, but the
+// collision detector is only read from the world file, so it is written
+// here unless _collisionDetector is "default". Only dart uses it.
+static std::string OpenGeneratedWorld(std::ofstream &_out
+                                    , const std::string &_worldName
+                                    , const std::string &_collisionDetector)
+{
+  const std::string path = TemporaryWorldPath(_worldName);
+  _out.open(path.c_str());
+
+  _out << "<?xml version=\"1.0\" ?>\n"
+       << "<sdf version=\"1.6\">\n"
+       << "  <world name=\"" << _worldName << "\">\n"
+       << "    <physics name=\"default_physics\" default=\"true\""
+       << " type=\"ode\">\n";
+  if (_collisionDetector != "default")
+  {
+    _out << "      <dart>\n"
+         << "        <collision_detector>" << _collisionDetector
+         << "</collision_detector>\n"
+         << "      </dart>\n";
+  }
+  _out << "    </physics>\n";
+
+  return path;
+}
+
+/////////////////////////////////////////////////
+// Write a link with a single collision shape and no gravity.
+static void WriteLink(std::ofstream &_out
+                    , const std::string &_name
+                    , const ignition::math::Pose3d &_pose
+                    , double _mass
+                    , const ignition::math::Vector3d &_inertia
+                    , const std::string &_geometry)
+{
+  const auto &pos = _pose.Pos();
+  const auto rpy = _pose.Rot().Euler();
+  _out << "      <link name=\"" << _name << "\">\n"
+       << "        <pose>" << pos.X() << " " << pos.Y() << " " << pos.Z()
+       << " " << rpy.X() << " " << rpy.Y() << " " << rpy.Z() << "</pose>\n"
+       << "        <gravity>false</gravity>\n"
+       << "        <inertial>\n"
+       << "          <mass>" << _mass << "</mass>\n"
+       << "          <inertia>\n"
+       << "            <ixx>" << _inertia.X() << "</ixx>\n"
+       << "            <iyy>" << _inertia.Y() << "</iyy>\n"
+       << "            <izz>" << _inertia.Z() << "</izz>\n"
+       << "            <ixy>0</ixy><ixz>0</ixz><iyz>0</iyz>\n"
+       << "          </inertia>\n"
+       << "        </inertial>\n"
+       << "        <collision name=\"collision\">\n"
+       << "          <geometry>" << _geometry << "</geometry>\n"
+       << "        </collision>\n"
+       << "      </link>\n";
+}
+
+/////////////////////////////////////////////////
+// Write a world with _pairCount sphere pairs to a temporary file.
+// Pair i uses separation ratio i % 12 and alternates between the 1mm and
+// 100mm radius of collide_spheres.world every 12 pairs. Sphere A sits at
+// x = 0 like in the erb world so the separations are exact, and the pairs
+// are laid out on a 1m grid in the y-z plane so they never touch each
+// other. Pairs are grouped into self-colliding models to keep the model
+// count low.
+// Returns the path of the world file and sets _contactPairs to the number
+// of pairs that are expected to be in contact.
+static std::string WriteSpherePairsWorld(int _pairCount
+                                       , int &_contactPairs
+                                       , const std::string &_collisionDetector
+                                           = "default")
+{
+  const double density = 600;
+  const double spacing = 1.0;
+  const int pairsPerModel = 50;
+  const int rowLength = static_cast<int>(ceil(sqrt(_pairCount)));
+
+  std::ofstream out;
+  const std::string path =
+      OpenGeneratedWorld(out, "collide_sphere_pairs", _collisionDetector);
+
+  _contactPairs = 0;
+  for (int i = 0; i < _pairCount; ++i)
+  {
+    if (i % pairsPerModel == 0)
+    {
+      if (i > 0)
+        out << "    </model>\n";
+      out << "    <model name=\"pairs" << i / pairsPerModel << "\">\n"
+          << "      <self_collide>true</self_collide>\n";
+    }
+
+    const double separationRatio = g_separationRatios[i % g_separationCount];
+    const double radius = ((i / g_separationCount) % 2 == 0) ? 1e-3 : 1e-1;
+    if (separationRatio <= 2.0)
+      ++_contactPairs;
+
+    const double y = (i % rowLength) * spacing;
+    const double z = 0.5 + (i / rowLength) * spacing;
+    const double mass = density * 4.0 / 3.0 * M_PI * pow(radius, 3);
+    const double inertia = 2.0 / 5.0 * mass * radius * radius;
+
+    std::ostringstream geometry;
+    geometry << "<sphere><radius>" << radius << "</radius></sphere>";
+
+    const char *suffix[2] = {"A", "B"};
+    const double x[2] = {0.0, separationRatio * radius};
+    for (int s = 0; s < 2; ++s)
+    {
+      WriteLink(out, "p" + std::to_string(i) + suffix[s],
+          ignition::math::Pose3d(x[s], y, z, 0, 0, 0), mass,
+          ignition::math::Vector3d(inertia, inertia, inertia),
+          geometry.str());
+    }
+  }
+  if (_pairCount > 0)
+    out << "    </model>\n";
+  out << "  </world>\n"
+      << "</sdf>\n";
+
+  return path;
+}
+
+/////////////////////////////////////////////////
+// A box of the random box world, in the model named _model.
+struct RandomBox
+{
+  std::string model;
+  bool isStatic;
+  ignition::math::Pose3d pose;
+  ignition::math::Vector3d size;
+};
+
+/////////////////////////////////////////////////
+// Draw _boxCount randomly placed and oriented boxes, like a rock field.
+// Even boxes are static rocks and odd boxes are free probes, so contacts
+// are found between rocks and probes. The volume grows with the box count
+// to keep the density, and so the fraction of overlapping boxes, the
+// same. A fixed seed gives the same scene for every engine. Rocks and
+// probes go into separate models, since static is a model property.
+static std::vector<RandomBox> RandomBoxes(int _boxCount)
+{
+  const int boxesPerModel = 50;
+  const double side = 1.5 * cbrt(_boxCount);
+
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> position(0.0, side);
+  std::uniform_real_distribution<double> size(0.2, 1.0);
+  std::uniform_real_distribution<double> angle(-M_PI, M_PI);
+
+  std::vector<RandomBox> boxes;
+  for (int kind = 0; kind < 2; ++kind)
+  {
+    const bool isStatic = (kind == 0);
+    int linksInModel = 0;
+    int modelIndex = 0;
+    for (int i = kind; i < _boxCount; i += 2)
+    {
+      // Drawn one at a time, the order of arguments is unspecified
+      double draws[9];
+      for (int d = 0; d < 3; ++d)
+        draws[d] = size(rng);
+      for (int d = 3; d < 6; ++d)
+        draws[d] = position(rng);
+      for (int d = 6; d < 9; ++d)
+        draws[d] = angle(rng);
+
+      RandomBox box;
+      box.model = (isStatic ? "rocks" : "probes") +
+          std::to_string(modelIndex);
+      box.isStatic = isStatic;
+      box.size.Set(draws[0], draws[1], draws[2]);
+      box.pose = ignition::math::Pose3d(draws[3], draws[4], draws[5],
+          draws[6], draws[7], draws[8]);
+      boxes.push_back(box);
+
+      if (++linksInModel == boxesPerModel)
+      {
+        linksInModel = 0;
+        ++modelIndex;
+      }
+    }
+  }
+  return boxes;
+}
+
+/////////////////////////////////////////////////
+// Write a world with the boxes of RandomBoxes(_boxCount), named by their
+// index in it.
+static std::string WriteRandomBoxesWorld(int _boxCount
+                                       , const std::string &_collisionDetector)
+{
+  const double density = 2000;
+  const std::vector<RandomBox> boxes = RandomBoxes(_boxCount);
+
+  std::ofstream out;
+  const std::string path =
+      OpenGeneratedWorld(out, "collide_random_boxes", _collisionDetector);
+
+  for (size_t i = 0; i < boxes.size(); ++i)
+  {
+    const RandomBox &box = boxes[i];
+    if (i == 0 || box.model != boxes[i - 1].model)
+    {
+      if (i > 0)
+        out << "    </model>\n";
+      out << "    <model name=\"" << box.model << "\">\n"
+          << "      <static>" << (box.isStatic ? "true" : "false")
+          << "</static>\n";
+    }
+
+    const ignition::math::Vector3d &dim = box.size;
+    const double mass = density * dim.X() * dim.Y() * dim.Z();
+    const ignition::math::Vector3d inertia(
+        mass / 12.0 * (dim.Y() * dim.Y() + dim.Z() * dim.Z()),
+        mass / 12.0 * (dim.Z() * dim.Z() + dim.X() * dim.X()),
+        mass / 12.0 * (dim.X() * dim.X() + dim.Y() * dim.Y()));
+
+    std::ostringstream geometry;
+    geometry << "<box><size>" << dim.X() << " " << dim.Y() << " "
+             << dim.Z() << "</size></box>";
+    WriteLink(out, "box" + std::to_string(i), box.pose, mass, inertia,
+        geometry.str());
+  }
+  if (!boxes.empty())
+    out << "    </model>\n";
+  out << "  </world>\n"
+      << "</sdf>\n";
+
+  return path;
+}
+
+/////////////////////////////////////////////////
+// Separating axis test of two boxes: they overlap unless one of the face
+// normals of either box, or a cross product of an edge of each, separates
+// their projections.
+static bool BoxesOverlap(const RandomBox &_a, const RandomBox &_b)
+{
+  const ignition::math::Vector3d units[3] = {
+      ignition::math::Vector3d::UnitX, ignition::math::Vector3d::UnitY,
+      ignition::math::Vector3d::UnitZ};
+  ignition::math::Vector3d a[3], b[3];
+  for (int i = 0; i < 3; ++i)
+  {
+    a[i] = _a.pose.Rot().RotateVector(units[i]);
+    b[i] = _b.pose.Rot().RotateVector(units[i]);
+  }
+  const ignition::math::Vector3d t = _b.pose.Pos() - _a.pose.Pos();
+
+  auto separates = [&](const ignition::math::Vector3d &_axis)
+  {
+    // Parallel edges give no axis, the face normals cover them
+    if (_axis.SquaredLength() < 1e-12)
+      return false;
+    double radius = 0.0;
+    for (int i = 0; i < 3; ++i)
+    {
+      radius += 0.5 * _a.size[i] * std::fabs(a[i].Dot(_axis)) +
+                0.5 * _b.size[i] * std::fabs(b[i].Dot(_axis));
+    }
+    return std::fabs(t.Dot(_axis)) > radius;
+  };
+
+  for (int i = 0; i < 3; ++i)
+  {
+    if (separates(a[i]) || separates(b[i]))
+      return false;
+  }
+  for (int i = 0; i < 3; ++i)
+  {
+    for (int j = 0; j < 3; ++j)
+    {
+      if (separates(a[i].Cross(b[j])))
+        return false;
+    }
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////
+// Number of colliding pairs of the boxes of RandomBoxes(_boxCount), the
+// reference every collision detector is checked against. Boxes of the
+// same model do not collide, as models do not self collide, and neither
+// do two static boxes.
+static unsigned int RandomBoxesContacts(int _boxCount)
+{
+  const std::vector<RandomBox> boxes = RandomBoxes(_boxCount);
+  unsigned int contacts = 0;
+  for (size_t i = 0; i < boxes.size(); ++i)
+  {
+    for (size_t j = i + 1; j < boxes.size(); ++j)
+    {
+      const RandomBox &a = boxes[i];
+      const RandomBox &b = boxes[j];
+      if (a.model == b.model || (a.isStatic && b.isStatic))
+        continue;
+
+      // Bounding spheres reject most pairs before the axis test
+      const double reach = 0.5 * (a.size.Length() + b.size.Length());
+      if ((b.pose.Pos() - a.pose.Pos()).SquaredLength() > reach * reach)
+        continue;
+      if (BoxesOverlap(a, b))
+        ++contacts;
+    }
+  }
+  return contacts;
+}
+
+/////////////////////////////////////////////////
+// Time collision-only steps of a world with physics disabled, and return
+// the values to record: those of StepTimer, the mean contact count and the
+// contacts, and pairs unless _pairCount is zero, found per second.
+// Only ode detects collisions in PhysicsEngine::UpdateCollision, before
+// the before physics update event, so its rates are per second of
+// collisionTime_. The other engines detect collisions inside their
+// physics update, so their rates are per second of the whole step and
+// named contactsPerStepSecond and pairsPerStepSecond.
+static std::map<std::string, double> TimeCollisionSteps(
+    physics::WorldPtr _world, int _steps, int _pairCount)
+{
+  auto contactManager = _world->Physics()->GetContactManager();
+  StepTimer stepTimer(_world);
+  double totalContacts = 0.0;
+  for (int i = 0; i < _steps; ++i)
+  {
+    stepTimer.Step();
+    totalContacts += contactManager->GetContactCount();
+  }
+
+  std::map<std::string, double> values = stepTimer.Values();
+  values["contactCount"] = totalContacts / _steps;
+  std::string suffix = "PerStepSecond";
+  double seconds = stepTimer.WallTime();
+  if (stepTimer.SplitsCollision())
+  {
+    suffix = "PerSecond";
+    seconds = stepTimer.CollisionTime().Map()["mean"] * _steps;
+  }
+  values["contacts" + suffix] = totalContacts / seconds;
+  if (_pairCount > 0)
+    values["pairs" + suffix] = _pairCount * _steps / seconds;
+  return values;
+}
+
+/////////////////////////////////////////////////
+// Sphere pairs:
+// Load a generated world with many sphere pairs, disable physics and
+// time repeated collision-only steps.
+void CollideScaleTest::SpherePairs(const std::string &_physicsEngine
+                                 , double _dt
+                                 , int _pairCount
+                                 , bool _subscribe)
+{
+  int contactPairs = 0;
+  const std::string worldFile =
+      WriteSpherePairsWorld(_pairCount, contactPairs);
+
+  common::Time loadStart = common::Time::GetWallTime();
+  Load(worldFile, true, _physicsEngine);
+  const double loadTime = (common::Time::GetWallTime() - loadStart).Double();
+  boost::filesystem::remove(worldFile);
+
+  physics::WorldPtr world = physics::get_world("collide_sphere_pairs");
+  ASSERT_NE(world, nullptr);
+
+  // Verify physics engine type
+  physics::PhysicsEnginePtr physics = world->Physics();
+  ASSERT_NE(physics, nullptr);
+  ASSERT_EQ(physics->GetType(), _physicsEngine);
+  physics->SetMaxStepSize(_dt);
+
+  // Disable physics updates, only collision checking runs in Step
+  world->SetPhysicsEnabled(false);
+
+  auto contactManager = physics->GetContactManager();
+  ASSERT_NE(contactManager, nullptr);
+
+  // Contacts are only filled in when someone subscribes to them, which
+  // also publishes them every step, or when they are captured directly.
+  transport::SubscriberPtr contactSub;
+  std::unique_ptr<ContactCapture> contactCapture;
+  if (_subscribe)
+  {
+    contactSub = this->node->Subscribe("~/physics/contacts", &OnContacts);
+  }
+  else
+  {
+    contactCapture.reset(new ContactCapture(physics));
+  }
+
+  // First step checks the contacts before timing
+  world->Step(1);
+  EXPECT_EQ(contactManager->GetContactCount(),
+            static_cast<unsigned int>(contactPairs));
+
+  const int steps = 100;
+  std::map<std::string, double> values =
+      TimeCollisionSteps(world, steps, _pairCount);
+  values["loadTime"] = loadTime;
+  for (const auto &value : values)
+    this->Record(value.first, value.second);
+}
+
+/////////////////////////////////////////////////
+TEST_P(CollideScaleTest, SpherePairs)
+{
+  std::string physicsEngine = std::tr1::get<0>(GetParam());
+  double dt                 = std::tr1::get<1>(GetParam());
+  int pairCount             = std::tr1::get<2>(GetParam());
+  bool subscribe            = std::tr1::get<3>(GetParam());
+  gzdbg << physicsEngine
+        << ", dt: " << dt
+        << ", pairCount: " << pairCount
+        << ", subscribe: " << subscribe
+        << std::endl;
+  RecordProperty("engine", physicsEngine);
+  this->Record("dt", dt);
+  RecordProperty("pairCount", pairCount);
+  RecordProperty("subscribe", subscribe);
+  SpherePairs(physicsEngine
+            , dt
+            , pairCount
+            , subscribe);
+}
+
+/////////////////////////////////////////////////
+// Broadphase:
+// Load a generated sphere pair or random box world with the given
+// collision detector, disable physics and time collision-only steps.
+void CollideBroadphaseTest::Broadphase(const std::string &_physicsEngine
+                                     , double _dt
+                                     , const std::string &_collisionDetector
+                                     , const std::string &_scene
+                                     , int _count)
+{
+  int contactPairs = 0;
+  std::string worldFile, worldName;
+  if (_scene == "spheres")
+  {
+    worldFile = WriteSpherePairsWorld(_count, contactPairs,
+        _collisionDetector);
+    worldName = "collide_sphere_pairs";
+  }
+  else if (_scene == "boxes")
+  {
+    worldFile = WriteRandomBoxesWorld(_count, _collisionDetector);
+    worldName = "collide_random_boxes";
+    contactPairs = RandomBoxesContacts(_count);
+  }
+  else
+  {
+    FAIL() << "Unrecognized scene: " << _scene;
+  }
+
+  common::Time loadStart = common::Time::GetWallTime();
+  Load(worldFile, true, _physicsEngine);
+  const double loadTime = (common::Time::GetWallTime() - loadStart).Double();
+  boost::filesystem::remove(worldFile);
+
+  physics::WorldPtr world = physics::get_world(worldName);
+  ASSERT_NE(world, nullptr);
+
+  // Verify physics engine type
+  physics::PhysicsEnginePtr physics = world->Physics();
+  ASSERT_NE(physics, nullptr);
+  ASSERT_EQ(physics->GetType(), _physicsEngine);
+  physics->SetMaxStepSize(_dt);
+
+  // Disable physics updates, only collision checking runs in Step
+  world->SetPhysicsEnabled(false);
+
+  ContactCapture contactCapture(physics);
+  ASSERT_TRUE(contactCapture.Valid());
+
+  // A contact is a colliding pair. The sphere pairs have a known number
+  // of them, the boxes are checked against the exact overlap test of
+  // RandomBoxesContacts, so every detector is compared to the same
+  // reference whatever ran before it. Detectors may disagree on boxes
+  // that barely touch, hence the 2% tolerance on boxes.
+  world->Step(1);
+  const unsigned int contactCount = contactCapture.Count();
+  if (_scene == "spheres")
+  {
+    EXPECT_EQ(contactCount, static_cast<unsigned int>(contactPairs));
+  }
+  else
+  {
+    const double expected = contactPairs;
+    EXPECT_NEAR(contactCount, expected, std::max(1.0, 0.02 * expected))
+      << _collisionDetector << " on " << _count << " boxes";
+  }
+
+  const int steps = 100;
+  std::map<std::string, double> values = TimeCollisionSteps(world, steps, 0);
+  values["loadTime"] = loadTime;
+  values["firstContactCount"] = contactCount;
+  for (const auto &value : values)
+    this->Record(value.first, value.second);
+}
+
+/////////////////////////////////////////////////
+TEST_P(CollideBroadphaseTest, Broadphase)
+{
+  std::string physicsEngine     = std::tr1::get<0>(GetParam());
+  double dt                     = std::tr1::get<1>(GetParam());
+  std::string collisionDetector = std::tr1::get<2>(GetParam());
+  std::string scene             = std::tr1::get<3>(GetParam());
+  int count                     = std::tr1::get<4>(GetParam());
+  gzdbg << physicsEngine
+        << ", dt: " << dt
+        << ", collisionDetector: " << collisionDetector
+        << ", scene: " << scene
+        << ", count: " << count
+        << std::endl;
+  RecordProperty("engine", physicsEngine);
+  this->Record("dt", dt);
+  RecordProperty("collisionDetector", collisionDetector);
+  RecordProperty("scene", scene);
+  RecordProperty("count", count);
+  Broadphase(physicsEngine
+           , dt
+           , collisionDetector
+           , scene
+           , count);
+}
@@ -39,6 +39,61 @@ namespace gazebo
       public: void Spheres(const std::string &_physicsEngine
                          , double _dt);
     };
+
+    // physics engine
+    // dt
+    // number of sphere pairs to generate
+    // subscribe to contacts topic / capture contacts directly
+    typedef std::tr1::tuple < const char *
+                            , double
+                            , int
+                            , bool
+                            > char1double1int1bool1;
+    class CollideScaleTest
+      : public ServerFixture,
+        public testing::WithParamInterface<char1double1int1bool1>
+    {
+      /// \brief Test collision checking throughput on a generated world
+      /// with many sphere pairs at the separations of collide_spheres.world.
+      /// \param[in] _physicsEngine Physics engine to use.
+      /// \param[in] _dt Max time step size.
+      /// \param[in] _pairCount Number of sphere pairs to generate.
+      /// \param[in] _subscribe Flag for getting contacts by subscribing to
+      /// ~/physics/contacts instead of capturing them directly.
+      public: void SpherePairs(const std::string &_physicsEngine
+                             , double _dt
+                             , int _pairCount
+                             , bool _subscribe);
+    };
+
+    // physics engine
+    // dt
+    // collision detector, "default" or one of dart's fcl, dart, bullet, ode
+    // scene, "spheres" or "boxes"
+    // number of sphere pairs or boxes to generate
+    typedef std::tr1::tuple < const char *
+                            , double
+                            , const char *
+                            , const char *
+                            , int
+                            > char1double1char2int1;
+    class CollideBroadphaseTest
+      : public ServerFixture,
+        public testing::WithParamInterface<char1double1char2int1>
+    {
+      /// \brief Test collision checking time for each collision detector
+      /// an engine offers, on generated sphere pair and random box worlds.
+      /// \param[in] _physicsEngine Physics engine to use.
+      /// \param[in] _dt Max time step size.
+      /// \param[in] _collisionDetector Collision detector to use.
+      /// \param[in] _scene Scene to generate, "spheres" or "boxes".
+      /// \param[in] _count Number of sphere pairs or boxes to generate.
+      public: void Broadphase(const std::string &_physicsEngine
+                            , double _dt
+                            , const std::string &_collisionDetector
+                            , const std::string &_scene
+                            , int _count);
+    };
   }
 }
 #endif
@@ -0,0 +1,50 @@
+import os
+import struct
+import numpy as np
+
+# column caches written next to the csv files by csv_cache in
+# Source Code/Data Analysis, see csv_table.hh for the layout
+cacheHeader = struct.Struct('<4sIQqQII')
+columnHeader = struct.Struct('<IIQQ')
+
+# path of the column cache of a csv file
+def columnCachePath(filename):
+    return filename + '.col'
+
+# load the column cache of a csv file as a dictionary of arrays
+# numeric columns are numpy arrays and string columns are lists
+# returns None if there is no cache or the csv changed since it was written
+def loadColumnCache(filename):
+    try:
+        with open(columnCachePath(filename), 'rb') as cachefile:
+            data = cachefile.read()
+        source = os.stat(filename)
+    except OSError:
+        return None
+    if len(data) < cacheHeader.size:
+        return None
+    magic, version, size, modified, rows, columns, _ = \
+        cacheHeader.unpack_from(data, 0)
+    if magic != b'RVCC' or version != 1:
+        return None
+    if size != source.st_size or modified != int(source.st_mtime):
+        return None
+    csvDict = {}
+    offset = cacheHeader.size
+    for c in range(columns):
+        kind, nameLength, start, length = \
+            columnHeader.unpack_from(data, offset)
+        offset += columnHeader.size
+        name = data[offset:offset + nameLength].decode('utf-8')
+        offset += nameLength
+        if start + length > len(data):
+            return None
+        if kind == 0:
+            csvDict[name] = np.frombuffer(data, '<f8', rows, start).copy()
+        else:
+            starts = struct.unpack_from('<%dQ' % (rows + 1), data, start)
+            text = data[start + 8 * (rows + 1):start + length]
+            csvDict[name] = [text[starts[i]:starts[i + 1]].decode('utf-8')
+                             for i in range(rows)]
+    csvDict[None] = []
+    return csvDict
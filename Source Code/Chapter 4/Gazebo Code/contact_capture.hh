@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2015 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef BENCHMARK_GAZEBO_CONTACT_CAPTURE_HH_
+#define BENCHMARK_GAZEBO_CONTACT_CAPTURE_HH_
+
+#include <vector>
+#include "gazebo/physics/physics.hh"
+
+namespace gazebo
+{
+  namespace benchmark
+  {
+    /// \brief Keep the contact manager filled in every step without a
+    /// subscriber on ~/physics/contacts.
+    /// Without a subscriber the contact manager drops all contacts, and a
+    /// subscriber makes it serialize and publish them every step. This
+    /// sets the never drop flag instead, so contacts can be read in process
+    /// and nothing is published. The previous flag is restored on
+    /// destruction.
+    class ContactCapture
+    {
+      /// \brief Constructor.
+      /// \param[in] _physics Physics engine whose contacts are captured.
+      public: explicit ContactCapture(physics::PhysicsEnginePtr _physics)
+        : manager(_physics ? _physics->GetContactManager() : nullptr),
+          previous(false)
+      {
+        if (this->manager)
+        {
+          this->previous = this->manager->NeverDropContacts();
+          this->manager->SetNeverDropContacts(true);
+        }
+      }
+
+      /// \brief Destructor, restores the never drop flag.
+      public: ~ContactCapture()
+      {
+        if (this->manager)
+          this->manager->SetNeverDropContacts(this->previous);
+      }
+
+      /// \brief True if the physics engine has a contact manager.
+      public: bool Valid() const
+      {
+        return this->manager != nullptr;
+      }
+
+      /// \brief Number of contacts found in the last step.
+      public: unsigned int Count() const
+      {
+        return this->manager ? this->manager->GetContactCount() : 0u;
+      }
+
+      /// \brief Contacts found in the last step. Only the first Count()
+      /// entries are valid, the contact manager reuses the rest.
+      public: const std::vector<physics::Contact *> &Contacts() const
+      {
+        return this->manager->GetContacts();
+      }
+
+      /// \brief Contact manager of the physics engine.
+      private: physics::ContactManager *manager;
+
+      /// \brief Never drop flag before this object was created.
+      private: bool previous;
+    };
+  }
+}
+#endif
@@ -1,5 +1,6 @@
 import csv
 import numpy as np
+from column_cache import loadColumnCache
 
 # function for exact matching or partial string matching
 # used for selecting specific test cases based on test parameters
@@ -15,19 +16,31 @@ def match(a,b):
     return False
 
 # open data file as csv and construct dictionary of arrays
+# numeric columns are numpy arrays and other columns lists of strings
+# a column cache written by csv_cache is loaded instead if it is fresh
 def makeCsvDictOfArrays(filename):
+    cached = loadColumnCache(filename)
+    if cached is not None:
+        return cached
     with open(filename, 'rt') as csvfile:
-        spamreader = csv.DictReader(csvfile)
+        spamreader = csv.reader(csvfile)
+        fields = [f.strip() for f in next(spamreader)]
+        # the empty column of a trailing comma
+        if fields and fields[-1] == '':
+            fields.pop()
+        columns = [[] for f in fields]
+        for row in spamreader:
+            for i in range(len(fields)):
+                columns[i].append(row[i].strip() if i < len(row) else '')
+        # converted once per column, appending to numpy arrays is quadratic
         csvDict = {}
-        for field in spamreader.fieldnames:
-            csvDict[field] = []
+        for field, values in zip(fields, columns):
+            try:
+                csvDict[field] = np.array([float(v) if v != '' else np.nan
+                                           for v in values])
+            except ValueError:
+                csvDict[field] = values
         csvDict[None] = []
-        for row in spamreader:
-            for k in row.keys():
-                try:
-                    csvDict[k] = np.append(csvDict[k], float(row[k]))
-                except:
-                    csvDict[k].append(row[k])
         return csvDict
 
 # query a dictionary of arrays for indices of matching parameters
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2015 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <ignition/math/Vector3.hh>
+
+#include "gazebo/physics/physics.hh"
+#include "batch_stats.hh"
+#include "dzhanibekov.hh"
+#include "step_timer.hh"
+#include "torque_free.hh"
+
+using namespace gazebo;
+using namespace benchmark;
+
+/////////////////////////////////////////////////
+// Mean time between sign changes of a sampled signal, with the crossing
+// times interpolated linearly between samples. Zero with fewer than two
+// sign changes.
+static double MeanCrossingInterval(const std::vector<double> &_times
+                                 , const std::vector<double> &_values
+                                 , int &_crossings)
+{
+  std::vector<double> crossings;
+  for (size_t i = 1; i < _values.size(); ++i)
+  {
+    const double a = _values[i - 1];
+    const double b = _values[i];
+    if ((a < 0.0 && b >= 0.0) || (a >= 0.0 && b < 0.0))
+    {
+      crossings.push_back(_times[i - 1] +
+          (_times[i] - _times[i - 1]) * a / (a - b));
+    }
+  }
+  _crossings = static_cast<int>(crossings.size());
+  if (crossings.size() < 2)
+    return 0.0;
+  return (crossings.back() - crossings.front()) / (crossings.size() - 1);
+}
+
+/////////////////////////////////////////////////
+// Dzhanibekov:
+// Spin the T-handle of the dzhanibekov model close to its intermediate
+// axis without gravity, and record the time between its flips against
+// the analytic period, the energy and momentum drift and the step rate
+void DzhanibekovTest::Dzhanibekov(const std::string &_physicsEngine
+                                , double _dt)
+{
+  // Load a blank world (no ground plane)
+  Load("worlds/blank.world", true, _physicsEngine);
+  physics::WorldPtr world = physics::get_world("default");
+  ASSERT_NE(world, nullptr);
+
+  // Verify physics engine type
+  physics::PhysicsEnginePtr physics = world->Physics();
+  ASSERT_NE(physics, nullptr);
+  ASSERT_EQ(physics->GetType(), _physicsEngine);
+  world->SetGravity(ignition::math::Vector3d::Zero);
+
+  // The model path is set for every benchmark by gz_build_tests
+  world->InsertModelFile("model://dzhanibekov");
+  this->WaitUntilEntitySpawn("dzhanibekov", 100, 100);
+  physics::ModelPtr model = world->ModelByName("dzhanibekov");
+  ASSERT_NE(model, nullptr);
+  physics::LinkPtr link = model->GetLink();
+  ASSERT_NE(link, nullptr);
+
+  // The inertia of the model is diagonal, with Iyy > Ixx > Izz
+  const ignition::math::Matrix3d I0 = link->GetInertial()->MOI();
+  const analysis::Vector3 inertia = {I0(0, 0), I0(1, 1), I0(2, 2)};
+  int axes[3] = {0, 1, 2};
+  std::sort(axes, axes + 3, [&](int _a, int _b)
+  {
+    return inertia[_a] < inertia[_b];
+  });
+  const int middle = axes[1];
+  ASSERT_LT(inertia[axes[0]], inertia[middle]);
+  ASSERT_LT(inertia[middle], inertia[axes[2]]);
+
+  // Spin about the intermediate axis, perturbed about the smallest one.
+  // The 1e-10 of dzhanibekov.world puts the rotation on the separatrix
+  // in double precision, where the period is infinite; 1% gives a flip
+  // every 1.6s.
+  double w[3] = {0.0, 0.0, 0.0};
+  w[middle] = 10.0;
+  w[axes[0]] = 0.1;
+  const ignition::math::Vector3d w0(w[0], w[1], w[2]);
+  link->SetLinearVel(ignition::math::Vector3d::Zero);
+  link->SetAngularVel(w0);
+  ASSERT_EQ(w0, link->WorldAngularVel());
+
+  const ignition::math::Quaterniond q0 = link->WorldInertialPose().Rot();
+  analysis::Quaternion orientation;
+  orientation.w = q0.W();
+  orientation.x = q0.X();
+  orientation.y = q0.Y();
+  orientation.z = q0.Z();
+  const analysis::TorqueFreeBody reference(inertia,
+      {w0.X(), w0.Y(), w0.Z()}, orientation);
+  const double flipPeriod0 = reference.Period() / 2.0;
+  ASSERT_TRUE(std::isfinite(flipPeriod0));
+
+  // initial energy and angular momentum in global frame
+  const double E0 = link->GetWorldEnergy();
+  const ignition::math::Vector3d H0 = link->WorldAngularMomentum();
+  const double H0mag = H0.Length();
+
+  // change step size after setting initial conditions
+  // since simbody requires a time step
+  physics->SetMaxStepSize(_dt);
+  const double simDuration = 20.0;
+  const int steps = ceil(simDuration / _dt);
+
+  // variables to compute statistics on
+  Vector3BatchStats angularMomentumError;
+  BatchStats energyError;
+  {
+    const std::string statNames = "maxAbs";
+    EXPECT_TRUE(angularMomentumError.InsertStatistics(statNames));
+    EXPECT_TRUE(energyError.InsertStatistics(statNames));
+  }
+
+  // Body angular velocity about the intermediate axis, whose sign
+  // changes at every flip
+  std::vector<double> times(steps);
+  std::vector<double> spin(steps);
+
+  // Hardware counters of the steps, the readings of the link after each
+  // step are left out
+  StepTimer stepTimer(world, true);
+
+  // unthrottle update rate
+  physics->SetRealTimeUpdateRate(0.0);
+  const common::Time t0 = world->SimTime();
+  for (int i = 0; i < steps; ++i)
+  {
+    stepTimer.Step();
+
+    times[i] = (world->SimTime() - t0).Double();
+    spin[i] = link->RelativeAngularVel()[middle];
+    angularMomentumError.InsertData(
+        (link->WorldAngularMomentum() - H0) / H0mag);
+    energyError.InsertData((link->GetWorldEnergy() - E0) / E0);
+  }
+
+  ASSERT_NEAR(stepTimer.SimTime(), simDuration, _dt*1.1);
+  std::map<std::string, double> values = stepTimer.Values();
+  values["stepsPerSecond"] = steps / stepTimer.WallTime();
+
+  // Flip period, and its error relative to the analytic one. A flip
+  // that never happens, as when the integrator damps the tumbling, is
+  // an error of -1.
+  int flipCount = 0;
+  const double flipPeriod = MeanCrossingInterval(times, spin, flipCount);
+  values["flipPeriod0"] = flipPeriod0;
+  values["flipPeriod"] = flipPeriod;
+  values["flipCount"] = flipCount;
+  values["flipPeriodErr"] = (flipPeriod - flipPeriod0) / flipPeriod0;
+
+  values["energy0"] = E0;
+  InsertStatsMap(values, "energyError_", energyError.Map());
+  values["angMomentum0"] = H0mag;
+  InsertStatsMap(values, "angMomentumErr_",
+                 angularMomentumError.Mag().Map());
+  for (const auto &value : values)
+    this->Record(value.first, value.second);
+}
+
+/////////////////////////////////////////////////
+TEST_P(DzhanibekovTest, Dzhanibekov)
+{
+  std::string physicsEngine = std::tr1::get<0>(GetParam());
+  double dt                 = std::tr1::get<1>(GetParam());
+  gzdbg << physicsEngine
+        << ", dt: " << dt
+        << std::endl;
+  RecordProperty("engine", physicsEngine);
+  this->Record("dt", dt);
+  Dzhanibekov(physicsEngine
+            , dt);
+}
@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2015 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <string>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include <boost/any.hpp>
+#include <boost/filesystem.hpp>
+
+#include "gazebo/physics/physics.hh"
+#include "batch_stats.hh"
+#include "contact_capture.hh"
+#include "joint_cost.hh"
+#include "step_timer.hh"
+
+using namespace gazebo;
+using namespace benchmark;
+
+/////////////////////////////////////////////////
+// Heap in use in bytes, zero without glibc. The resident size would not
+// do: the cases of an engine run in one process, and glibc keeps the
+// pages freed by unloading the previous world for the next one.
+static double HeapInUse()
+{
+#if defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  const struct mallinfo2 info = mallinfo2();
+  return static_cast<double>(info.uordblks) + info.hblkhd;
+#elif defined(__GLIBC__)
+  const struct mallinfo info = mallinfo();
+  return static_cast<double>(static_cast<unsigned int>(info.uordblks)) +
+      static_cast<unsigned int>(info.hblkhd);
+#else
+  return 0.0;
+#endif
+}
+
+/////////////////////////////////////////////////
+// Write a world with _modelCount triballs of one variant on a ground
+// plane to a temporary file, on a 3m grid so that they do not touch
+static std::string WriteJointCostWorld(const std::string &_variant
+                                     , int _modelCount)
+{
+  const double spacing = 3.0;
+  const int rowLength = static_cast<int>(ceil(sqrt(_modelCount)));
+
+  const std::string path = TemporaryWorldPath("joint_cost");
+  std::ofstream out(path.c_str());
+
+  out << "<?xml version=\"1.0\" ?>\n"
+      << "<sdf version=\"1.6\">\n"
+      << "  <world name=\"joint_cost\">\n"
+      << "    <physics name=\"default_physics\" default=\"true\""
+      << " type=\"ode\"/>\n"
+      << "    <model name=\"ground_plane\">\n"
+      << "      <static>true</static>\n"
+      << "      <link name=\"link\">\n"
+      << "        <collision name=\"collision\">\n"
+      << "          <geometry><plane><normal>0 0 1</normal>"
+      << "<size>1000 1000</size></plane></geometry>\n"
+      << "        </collision>\n"
+      << "      </link>\n"
+      << "    </model>\n";
+  for (int i = 0; i < _modelCount; ++i)
+  {
+    out << "    <include>\n"
+        << "      <uri>model://triball_" << _variant << "</uri>\n"
+        << "      <name>triball_" << i << "</name>\n"
+        << "      <pose>" << (i % rowLength) * spacing << " "
+        << (i / rowLength) * spacing << " 0 0 0 0</pose>\n"
+        << "    </include>\n";
+  }
+  out << "  </world>\n"
+      << "</sdf>\n";
+
+  return path;
+}
+
+/////////////////////////////////////////////////
+// JointCost:
+// Load a generated world with many triballs of one variant resting on
+// the ground and time their steps
+void JointCostTest::JointCost(const std::string &_physicsEngine
+                            , const std::string &_variant
+                            , int _modelCount)
+{
+  ASSERT_GT(_modelCount, 0);
+  const std::string worldFile = WriteJointCostWorld(_variant, _modelCount);
+
+  const double memoryBefore = HeapInUse();
+  Load(worldFile, true, _physicsEngine);
+  boost::filesystem::remove(worldFile);
+
+  physics::WorldPtr world = physics::get_world("joint_cost");
+  ASSERT_NE(world, nullptr);
+
+  // Verify physics engine type
+  physics::PhysicsEnginePtr physics = world->Physics();
+  ASSERT_NE(physics, nullptr);
+  ASSERT_EQ(physics->GetType(), _physicsEngine);
+  const double dt = 1e-3;
+  physics->SetMaxStepSize(dt);
+
+  // Rows of the joint constraints, six less the degrees of freedom of
+  // every joint
+  int jointCount = 0;
+  int jointRows = 0;
+  for (int i = 0; i < _modelCount; ++i)
+  {
+    physics::ModelPtr model =
+        world->ModelByName("triball_" + std::to_string(i));
+    ASSERT_NE(model, nullptr);
+    for (const auto &joint : model->GetJoints())
+    {
+      ++jointCount;
+      jointRows += 6 - static_cast<int>(joint->DOF());
+    }
+  }
+
+  // Iterations of the iterative solvers, a fixed count per step. DART
+  // and Simbody do not have the parameter.
+  double iterations = 0.0;
+  {
+    boost::any value;
+    if (physics->GetParam("iters", value))
+    {
+      try
+      {
+        iterations = boost::any_cast<int>(value);
+      }
+      catch(boost::bad_any_cast &)
+      {
+      }
+    }
+  }
+
+  // Let the triballs settle on the ground, counting contacts at the end.
+  // Capturing contacts copies them every step, so it is off while timing.
+  const int settleSteps = static_cast<int>(round(0.2 / dt));
+  double contactPoints = 0.0;
+  {
+    ContactCapture contactCapture(physics);
+    ASSERT_TRUE(contactCapture.Valid());
+    for (int i = 0; i < settleSteps; ++i)
+      world->Step(1);
+    const auto &contacts = contactCapture.Contacts();
+    for (unsigned int c = 0; c < contactCapture.Count(); ++c)
+      contactPoints += contacts[c]->count;
+  }
+  const double memory = HeapInUse() - memoryBefore;
+
+  const int steps = 1000;
+  StepTimer stepTimer(world);
+
+  // unthrottle update rate
+  physics->SetRealTimeUpdateRate(0.0);
+  for (int i = 0; i < steps; ++i)
+    stepTimer.Step();
+
+  // Every contact point adds a normal and two friction rows
+  const double constraintRows = jointRows + 3.0 * contactPoints;
+
+  std::map<std::string, double> values = stepTimer.Values();
+  values["stepTimePerModel"] = stepTimer.WallTime() / steps / _modelCount;
+  // The heap of the server started by Load is the same for every model
+  // count, the slope of memory over the count is the cost of a model
+  values["memory"] = memory;
+  values["memoryPerModel"] = memory / _modelCount;
+  values["jointCount"] = jointCount;
+  values["jointRows"] = jointRows;
+  values["contactPoints"] = contactPoints;
+  values["constraintRows"] = constraintRows;
+  values["solverIterations"] = iterations;
+  // The solve time is only apart from collision for ode, the physics
+  // time of the other engines would charge their collision to the rows
+  if (stepTimer.SplitsCollision())
+  {
+    const double meanSolveTime = stepTimer.PhysicsTime().Map()["mean"];
+    values["solveTimePerRow"] =
+        constraintRows > 0.0 ? meanSolveTime / constraintRows : 0.0;
+    values["solveTimePerRowIteration"] =
+        constraintRows > 0.0 && iterations > 0.0 ?
+        meanSolveTime / (constraintRows * iterations) : 0.0;
+  }
+  for (const auto &value : values)
+    this->Record(value.first, value.second);
+}
+
+/////////////////////////////////////////////////
+TEST_P(JointCostTest, JointCost)
+{
+  std::string physicsEngine = std::tr1::get<0>(GetParam());
+  std::string variant       = std::tr1::get<1>(GetParam());
+  int modelCount            = std::tr1::get<2>(GetParam());
+  gzdbg << physicsEngine
+        << ", variant: " << variant
+        << ", modelCount: " << modelCount
+        << std::endl;
+  RecordProperty("engine", physicsEngine);
+  RecordProperty("variant", variant);
+  RecordProperty("modelCount", modelCount);
+  JointCost(physicsEngine
+          , variant
+          , modelCount);
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2015 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef BENCHMARK_GAZEBO_JOINT_COST_HH_
+#define BENCHMARK_GAZEBO_JOINT_COST_HH_
+
+#include <string>
+#include "gazebo/test/ServerFixture.hh"
+
+namespace gazebo
+{
+  namespace benchmark
+  {
+    // physics engine
+    // triball variant: lumped, fixed or revolute
+    // number of triballs to spawn
+    typedef std::tr1::tuple < const char *
+                            , const char *
+                            , int
+                            > char2int1;
+    class JointCostTest : public ServerFixture,
+                          public testing::WithParamInterface<char2int1>
+    {
+      /// \brief Test the cost of the joint formulation of one body: the
+      /// triball as a single lumped link, or as a chassis with its balls
+      /// on fixed or revolute joints. Records the step and solver time,
+      /// the memory and the constraint rows, so that the cost per
+      /// constraint can be plotted against the number of triballs. The
+      /// solver time is only apart from collision, and the cost per row
+      /// only recorded, for ODE.
+      /// \param[in] _physicsEngine Physics engine to use.
+      /// \param[in] _variant Model variant: lumped, fixed or revolute.
+      /// \param[in] _modelCount Number of triballs to spawn.
+      public: void JointCost(const std::string &_physicsEngine
+                           , const std::string &_variant
+                           , int _modelCount);
+    };
+  }
+}
+#endif
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2015 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "perf_counters.hh"
+
+using namespace gazebo;
+using namespace benchmark;
+
+namespace
+{
+  struct PerfEvent
+  {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+    bool hardware;
+  };
+
+#ifdef __linux__
+  const PerfEvent kEvents[] =
+  {
+    {"perf_cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, true},
+    {"perf_instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,
+      true},
+    {"perf_cacheMisses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES,
+      true},
+    {"perf_branchMisses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES,
+      true},
+    {"perf_contextSwitches", PERF_TYPE_SOFTWARE,
+      PERF_COUNT_SW_CONTEXT_SWITCHES, false},
+  };
+#else
+  const PerfEvent kEvents[] =
+  {
+    {"perf_cycles", 0, 0, true},
+    {"perf_instructions", 0, 0, true},
+    {"perf_cacheMisses", 0, 0, true},
+    {"perf_branchMisses", 0, 0, true},
+    {"perf_contextSwitches", 0, 0, false},
+  };
+#endif
+  const int kEventCount = sizeof(kEvents) / sizeof(kEvents[0]);
+  enum {CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, CONTEXT_SWITCHES};
+}
+
+/////////////////////////////////////////////////
+PerfCounters::PerfCounters()
+  : leaderFd(-1), fds(kEventCount, -1), groupIndex(kEventCount, -1),
+    groupSize(0), opened(false)
+{
+}
+
+/////////////////////////////////////////////////
+void PerfCounters::Open()
+{
+  this->opened = true;
+#ifdef __linux__
+  for (int i = 0; i < kEventCount; ++i)
+  {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = kEvents[i].type;
+    attr.config = kEvents[i].config;
+    attr.disabled = (this->leaderFd < 0) ? 1 : 0;
+    // Context switches happen in the kernel, so only they include it.
+    attr.exclude_kernel = kEvents[i].hardware ? 1 : 0;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    int fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1,
+                                      this->leaderFd, 0));
+    if (fd < 0)
+      continue;
+
+    if (this->leaderFd < 0)
+      this->leaderFd = fd;
+    this->fds[i] = fd;
+    this->groupIndex[i] = this->groupSize++;
+  }
+
+  if (this->leaderFd >= 0)
+    ioctl(this->leaderFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+/////////////////////////////////////////////////
+PerfCounters::~PerfCounters()
+{
+#ifdef __linux__
+  for (int fd : this->fds)
+  {
+    if (fd >= 0)
+      close(fd);
+  }
+#endif
+}
+
+/////////////////////////////////////////////////
+bool PerfCounters::Available() const
+{
+  for (int i = 0; i < kEventCount; ++i)
+  {
+    if (kEvents[i].hardware && this->fds[i] >= 0)
+      return true;
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////
+void PerfCounters::Start()
+{
+  if (!this->opened)
+    this->Open();
+#ifdef __linux__
+  if (this->leaderFd >= 0)
+    ioctl(this->leaderFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+/////////////////////////////////////////////////
+void PerfCounters::Stop()
+{
+#ifdef __linux__
+  if (this->leaderFd >= 0)
+    ioctl(this->leaderFd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+/////////////////////////////////////////////////
+std::vector<double> PerfCounters::Read() const
+{
+  std::vector<double> totals(kEventCount, 0.0);
+#ifdef __linux__
+  if (this->leaderFd < 0)
+    return totals;
+
+  // nr, time_enabled, time_running, then one value per event
+  std::vector<uint64_t> buffer(3 + this->groupSize, 0);
+  const ssize_t bytes = buffer.size() * sizeof(uint64_t);
+  if (read(this->leaderFd, buffer.data(), bytes) != bytes)
+    return totals;
+
+  // Scale up if the group was multiplexed with other users of the PMU.
+  const double enabled = static_cast<double>(buffer[1]);
+  const double running = static_cast<double>(buffer[2]);
+  if (running <= 0.0)
+    return totals;
+  const double scale = enabled / running;
+
+  for (int i = 0; i < kEventCount; ++i)
+  {
+    if (this->groupIndex[i] >= 0)
+      totals[i] = buffer[3 + this->groupIndex[i]] * scale;
+  }
+#endif
+  return totals;
+}
+
+/////////////////////////////////////////////////
+std::map<std::string, double> PerfCounters::Values() const
+{
+  const std::vector<double> totals = this->Read();
+
+  std::map<std::string, double> values;
+  for (int i = 0; i < kEventCount; ++i)
+    values[kEvents[i].name] = totals[i];
+
+  const double cycles = totals[CYCLES];
+  const double instructions = totals[INSTRUCTIONS];
+  values["perf_ipc"] = cycles > 0 ? instructions / cycles : 0.0;
+  // misses per thousand instructions
+  values["perf_cacheMPKI"] =
+      instructions > 0 ? 1000.0 * totals[CACHE_MISSES] / instructions : 0.0;
+  values["perf_branchMPKI"] =
+      instructions > 0 ? 1000.0 * totals[BRANCH_MISSES] / instructions : 0.0;
+  values["perfAvailable"] = this->Available() ? 1.0 : 0.0;
+  return values;
+}
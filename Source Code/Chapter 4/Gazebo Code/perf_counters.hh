@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2015 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef BENCHMARK_GAZEBO_PERF_COUNTERS_HH_
+#define BENCHMARK_GAZEBO_PERF_COUNTERS_HH_
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace gazebo
+{
+  namespace benchmark
+  {
+    /// \brief Group of hardware performance counters opened with
+    /// perf_event_open (user space only). The counters follow a single
+    /// thread, the one that first calls Start. The physics update of a
+    /// world runs on the world thread rather than in World::Step, so
+    /// Start and Stop are called from the world update begin and end
+    /// events. If the kernel, the permissions or the hardware do not
+    /// provide a counter it is left out, and Values reports it as zero.
+    class PerfCounters
+    {
+      /// \brief Constructor, the counters are opened by the first Start.
+      public: PerfCounters();
+
+      /// \brief Destructor, closes the counters.
+      public: ~PerfCounters();
+
+      /// \brief True if at least one hardware counter could be opened.
+      public: bool Available() const;
+
+      /// \brief Resume counting, opening the counters for the calling
+      /// thread the first time.
+      public: void Start();
+
+      /// \brief Pause counting.
+      public: void Stop();
+
+      /// \brief Counter totals and derived rates, keyed by the names used
+      /// for Record. The same keys are returned whether or not counters
+      /// are available, so every test case produces the same csv columns.
+      /// \return Map from record name to value.
+      public: std::map<std::string, double> Values() const;
+
+      /// \brief Open and reset the counters for the calling thread.
+      private: void Open();
+
+      /// \brief Read the scaled total of every counter.
+      /// \return Counter totals in the order of the event table.
+      private: std::vector<double> Read() const;
+
+      /// \brief File descriptor of the group leader, -1 if none.
+      private: int leaderFd;
+
+      /// \brief File descriptor of each event, -1 if it failed to open.
+      private: std::vector<int> fds;
+
+      /// \brief Position of each opened event in the group read buffer.
+      private: std::vector<int> groupIndex;
+
+      /// \brief Number of events in the group.
+      private: int groupSize;
+
+      /// \brief True once Open was called.
+      private: bool opened;
+    };
+  }
+}
+#endif
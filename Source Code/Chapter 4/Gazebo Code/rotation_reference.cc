@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2015 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <cmath>
+#include <vector>
+
+#include "rotation_reference.hh"
+#include "torque_free.hh"
+
+using namespace gazebo;
+using namespace benchmark;
+
+/////////////////////////////////////////////////
+RotationReference::RotationReference(
+    const ignition::math::Matrix3d &_inertia
+  , const ignition::math::Vector3d &_w0
+  , const ignition::math::Quaterniond &_q0
+  , double _dt
+  , int _steps)
+{
+  std::vector<double> times(_steps > 0 ? _steps : 0);
+  for (size_t i = 0; i < times.size(); ++i)
+    times[i] = (i + 1) * _dt;
+
+  analysis::Matrix3 inertia;
+  double trace = 0.0;
+  double products = 0.0;
+  for (int i = 0; i < 3; ++i)
+  {
+    for (int j = 0; j < 3; ++j)
+    {
+      inertia[i][j] = _inertia(i, j);
+      if (i == j)
+        trace += std::fabs(inertia[i][j]);
+      else
+        products += std::fabs(inertia[i][j]);
+    }
+  }
+  const analysis::Vector3 w0 = {_w0.X(), _w0.Y(), _w0.Z()};
+  analysis::Quaternion q0;
+  q0.w = _q0.W();
+  q0.x = _q0.X();
+  q0.y = _q0.Y();
+  q0.z = _q0.Z();
+
+  std::vector<analysis::Quaternion> rotations;
+  std::vector<analysis::Vector3> angularVelocities;
+  this->analytic = products <= 1e-12 * trace;
+  if (this->analytic)
+  {
+    const analysis::Vector3 moments = {inertia[0][0], inertia[1][1],
+                                       inertia[2][2]};
+    analysis::TorqueFreeBody(moments, w0, q0).Evaluate(times, rotations,
+        angularVelocities);
+  }
+  else
+  {
+    analysis::IntegrateTorqueFree(inertia, w0, q0, times, rotations,
+        angularVelocities);
+  }
+
+  this->orientations.reserve(rotations.size());
+  for (const auto &q : rotations)
+  {
+    this->orientations.push_back(
+        ignition::math::Quaterniond(q.w, q.x, q.y, q.z));
+  }
+}
+
+/////////////////////////////////////////////////
+bool RotationReference::Analytic() const
+{
+  return this->analytic;
+}
+
+/////////////////////////////////////////////////
+const ignition::math::Quaterniond &RotationReference::Orientation(
+    int _step) const
+{
+  return this->orientations[_step];
+}
+
+/////////////////////////////////////////////////
+ignition::math::Vector3d RotationReference::Error(int _step
+    , const ignition::math::Quaterniond &_rot) const
+{
+  // Rotation from the reference to _rot, the shorter way round
+  ignition::math::Quaterniond d = _rot * this->orientations[_step].Inverse();
+  const double sign = d.W() < 0.0 ? -1.0 : 1.0;
+  const ignition::math::Vector3d v(d.X(), d.Y(), d.Z());
+  const double s = v.Length();
+  if (s <= 0.0)
+    return ignition::math::Vector3d::Zero;
+  // atan2 keeps small angles accurate, unlike acos of w
+  const double angle = 2.0 * std::atan2(s, std::fabs(d.W()));
+  return v * (sign * angle / s);
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2015 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef BENCHMARK_GAZEBO_ROTATION_REFERENCE_HH_
+#define BENCHMARK_GAZEBO_ROTATION_REFERENCE_HH_
+
+#include <vector>
+
+#include <ignition/math/Matrix3.hh>
+#include <ignition/math/Quaternion.hh>
+#include <ignition/math/Vector3.hh>
+
+namespace gazebo
+{
+  namespace benchmark
+  {
+    /// \brief Reference orientation of a rigid body rotating without
+    /// torques, precomputed once at every step of a benchmark so that the
+    /// step loop only looks it up. A body with a diagonal inertia takes
+    /// the Jacobi elliptic solution of Euler's equations, any other one an
+    /// adaptive Dormand-Prince integration, see torque_free.hh in
+    /// Data Analysis.
+    class RotationReference
+    {
+      /// \brief Constructor, computes the reference at times
+      /// _dt, 2 _dt, ... _steps _dt after the initial conditions.
+      /// \param[in] _inertia Moment of inertia in the body frame.
+      /// \param[in] _w0 Initial angular velocity in the world frame.
+      /// \param[in] _q0 Initial orientation of the body.
+      /// \param[in] _dt Time step.
+      /// \param[in] _steps Number of steps.
+      public: RotationReference(const ignition::math::Matrix3d &_inertia
+                              , const ignition::math::Vector3d &_w0
+                              , const ignition::math::Quaterniond &_q0
+                              , double _dt
+                              , int _steps);
+
+      /// \brief True if the reference is the analytic solution.
+      public: bool Analytic() const;
+
+      /// \brief Reference orientation after a step.
+      /// \param[in] _step Step index, 0 for the first step.
+      /// \return Orientation at time (_step + 1) _dt.
+      public: const ignition::math::Quaterniond &Orientation(
+          int _step) const;
+
+      /// \brief Rotation vector from the reference orientation after a
+      /// step to an orientation, in the world frame. Its length is the
+      /// angle between the two.
+      /// \param[in] _step Step index, 0 for the first step.
+      /// \param[in] _rot Orientation of the body after that step.
+      /// \return Angular position error.
+      public: ignition::math::Vector3d Error(int _step
+          , const ignition::math::Quaterniond &_rot) const;
+
+      /// \brief Reference orientation after every step.
+      private: std::vector<ignition::math::Quaterniond> orientations;
+
+      /// \brief True if the reference is the analytic solution.
+      private: bool analytic;
+    };
+  }
+}
+#endif
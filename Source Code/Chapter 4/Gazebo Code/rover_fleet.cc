@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2015 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "gazebo/physics/physics.hh"
+#include "batch_stats.hh"
+#include "contact_capture.hh"
+#include "rover_fleet.hh"
+#include "step_timer.hh"
+
+using namespace gazebo;
+using namespace benchmark;
+
+typedef std::chrono::steady_clock Clock;
+
+// Wheel link and joint names of the basic rover, in the order the command
+// streams use: left wheels first.
+static const char *g_wheels[4] =
+  {"left_front_wheel", "left_back_wheel",
+   "right_front_wheel", "right_back_wheel"};
+
+/////////////////////////////////////////////////
+// Write a world with _roverCount copies of the basic_rover model of the
+// rover simulation, included from model://basic_rover, on a 4m grid to a
+// temporary file. With _grounded the
+// rovers stand on a ground plane, otherwise gravity is off and they float
+// without contacts, so only their wheel joints are solved. Every rover
+// runs the rover_movement plugin of the rover simulation, without its
+// chassis force, so that the wheel commands of the benchmark drive it.
+static std::string WriteRoverFleetWorld(int _roverCount, bool _grounded)
+{
+  const double spacing = 4.0;
+  const int rowLength = static_cast<int>(ceil(sqrt(_roverCount)));
+
+  const std::string path = TemporaryWorldPath("rover_fleet");
+  std::ofstream out(path.c_str());
+
+  out << "<?xml version=\"1.0\" ?>\n"
+      << "<sdf version=\"1.6\">\n"
+      << "  <world name=\"rover_fleet\">\n"
+      << "    <physics name=\"default_physics\" default=\"true\""
+      << " type=\"ode\"/>\n";
+  if (_grounded)
+  {
+    out << "    <model name=\"ground_plane\">\n"
+        << "      <static>true</static>\n"
+        << "      <link name=\"link\">\n"
+        << "        <collision name=\"collision\">\n"
+        << "          <geometry><plane><normal>0 0 1</normal>"
+        << "<size>1000 1000</size></plane></geometry>\n"
+        << "        </collision>\n"
+        << "      </link>\n"
+        << "    </model>\n";
+  }
+  else
+  {
+    out << "    <gravity>0 0 0</gravity>\n";
+  }
+
+  for (int i = 0; i < _roverCount; ++i)
+  {
+    out << "    <include>\n"
+        << "      <uri>model://basic_rover</uri>\n"
+        << "      <name>rover" << i << "</name>\n"
+        << "      <pose>" << (i % rowLength) * spacing << " "
+        << (i / rowLength) * spacing << " 0 0 0 0</pose>\n"
+        << "      <plugin name=\"rover_movement\""
+        << " filename=\"librover_movement.so\">\n"
+        << "        <force>0 0 0</force>\n"
+        << "      </plugin>\n"
+        << "    </include>\n";
+  }
+  out << "  </world>\n"
+      << "</sdf>\n";
+
+  return path;
+}
+
+/////////////////////////////////////////////////
+// Independent command stream of one rover: drive and turn torques that
+// are redrawn every command period from the rover's own random sequence.
+struct CommandStream
+{
+  std::mt19937 rng;
+  double left = 0.0;
+  double right = 0.0;
+
+  void Next(double _maxTorque)
+  {
+    std::uniform_real_distribution<double> unit(-1.0, 1.0);
+    const double drive = _maxTorque * unit(this->rng);
+    const double turn = 0.5 * _maxTorque * unit(this->rng);
+    this->left = drive - turn;
+    this->right = drive + turn;
+  }
+};
+
+/////////////////////////////////////////////////
+// Fleet:
+// Load a generated world with many basic rovers, drive each one with its
+// own wheel torque commands and time the parts of every step.
+void RoverFleetTest::Fleet(const std::string &_physicsEngine
+                         , double _dt
+                         , int _roverCount
+                         , bool _grounded)
+{
+  ASSERT_GT(_roverCount, 0);
+  const std::string worldFile = WriteRoverFleetWorld(_roverCount, _grounded);
+
+  common::Time loadStart = common::Time::GetWallTime();
+  Load(worldFile, true, _physicsEngine);
+  const double loadTime = (common::Time::GetWallTime() - loadStart).Double();
+  boost::filesystem::remove(worldFile);
+
+  physics::WorldPtr world = physics::get_world("rover_fleet");
+  ASSERT_NE(world, nullptr);
+
+  // Verify physics engine type
+  physics::PhysicsEnginePtr physics = world->Physics();
+  ASSERT_NE(physics, nullptr);
+  ASSERT_EQ(physics->GetType(), _physicsEngine);
+  physics->SetMaxStepSize(_dt);
+
+  // Wheel joints of every rover
+  std::vector<std::array<physics::JointPtr, 4>> joints(_roverCount);
+  std::vector<CommandStream> commands(_roverCount);
+  for (int i = 0; i < _roverCount; ++i)
+  {
+    physics::ModelPtr model = world->ModelByName("rover" + std::to_string(i));
+    ASSERT_NE(model, nullptr);
+    for (int w = 0; w < 4; ++w)
+    {
+      joints[i][w] = model->GetJoint(std::string(g_wheels[w]) + "_hinge");
+      ASSERT_NE(joints[i][w], nullptr);
+    }
+    commands[i].rng.seed(i);
+  }
+
+  // Joint torques have to be set again before every step
+  const double maxTorque = 2.0;
+  const int commandPeriod = static_cast<int>(round(0.5 / _dt));
+  int step = 0;
+  auto applyCommands = [&]()
+  {
+    for (int i = 0; i < _roverCount; ++i)
+    {
+      if (step % commandPeriod == 0)
+        commands[i].Next(maxTorque);
+      joints[i][0]->SetForce(0, commands[i].left);
+      joints[i][1]->SetForce(0, commands[i].left);
+      joints[i][2]->SetForce(0, commands[i].right);
+      joints[i][3]->SetForce(0, commands[i].right);
+    }
+    ++step;
+  };
+
+  // Let the rovers settle on the ground, counting contacts at the end.
+  // Capturing contacts copies them every step, so it is off while timing.
+  const int settleSteps = static_cast<int>(round(0.2 / _dt));
+  double contactCount = 0.0;
+  {
+    ContactCapture contactCapture(physics);
+    ASSERT_TRUE(contactCapture.Valid());
+    for (int i = 0; i < settleSteps; ++i)
+    {
+      applyCommands();
+      world->Step(1);
+    }
+    contactCount = contactCapture.Count();
+  }
+  if (!_grounded)
+  {
+    EXPECT_EQ(contactCount, 0.0);
+  }
+
+  const int steps = 1000;
+  StepTimer stepTimer(world);
+  BatchStats commandTime;
+  EXPECT_TRUE(commandTime.InsertStatistics("mean,maxAbs,min"));
+  double totalCommandTime = 0.0;
+  for (int i = 0; i < steps; ++i)
+  {
+    const Clock::time_point commandStart = Clock::now();
+    applyCommands();
+    const double command = std::chrono::duration<double>(
+        Clock::now() - commandStart).count();
+    commandTime.InsertData(command);
+    totalCommandTime += command;
+    stepTimer.Step();
+  }
+
+  // The wall time and time ratio of the fleet include applying the
+  // commands, stepTime_ is the world step alone
+  const double totalTime = stepTimer.WallTime() + totalCommandTime;
+  const double meanStepTime = totalTime / steps;
+
+  std::map<std::string, double> values = stepTimer.Values();
+  values["loadTime"] = loadTime;
+  values["wallTime"] = totalTime;
+  values["timeRatio"] = meanStepTime / _dt;
+  InsertStatsMap(values, "commandTime_", commandTime.Map());
+  values["stepTimePerRover"] = meanStepTime / _roverCount;
+  values["jointCount"] = 4.0 * _roverCount;
+  values["contactCount"] = contactCount;
+  // Rovers per node in real time, assuming the cost stays linear in the
+  // rover count from here.
+  values["realTimeRovers"] = _roverCount * _dt / meanStepTime;
+  for (const auto &value : values)
+    this->Record(value.first, value.second);
+}
+
+/////////////////////////////////////////////////
+TEST_P(RoverFleetTest, Fleet)
+{
+  std::string physicsEngine = std::tr1::get<0>(GetParam());
+  double dt                 = std::tr1::get<1>(GetParam());
+  int roverCount            = std::tr1::get<2>(GetParam());
+  bool grounded             = std::tr1::get<3>(GetParam());
+  gzdbg << physicsEngine
+        << ", dt: " << dt
+        << ", roverCount: " << roverCount
+        << ", grounded: " << grounded
+        << std::endl;
+  RecordProperty("engine", physicsEngine);
+  this->Record("dt", dt);
+  RecordProperty("roverCount", roverCount);
+  RecordProperty("grounded", grounded);
+  Fleet(physicsEngine
+      , dt
+      , roverCount
+      , grounded);
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2015 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef BENCHMARK_GAZEBO_ROVER_FLEET_HH_
+#define BENCHMARK_GAZEBO_ROVER_FLEET_HH_
+
+#include <string>
+#include "gazebo/test/ServerFixture.hh"
+
+namespace gazebo
+{
+  namespace benchmark
+  {
+    // physics engine
+    // dt
+    // number of rovers to spawn
+    // rovers on the ground / floating without gravity
+    typedef std::tr1::tuple < const char *
+                            , double
+                            , int
+                            , bool
+                            > char1double1int1bool1;
+    class RoverFleetTest
+      : public ServerFixture,
+        public testing::WithParamInterface<char1double1int1bool1>
+    {
+      /// \brief Test the per-step cost of a fleet of basic rovers, each
+      /// driven by its own stream of wheel torque commands, split into
+      /// command application and world step, and the world step into
+      /// collision and constraint solve for ODE.
+      /// \param[in] _physicsEngine Physics engine to use.
+      /// \param[in] _dt Max time step size.
+      /// \param[in] _roverCount Number of rovers to spawn.
+      /// \param[in] _grounded Flag for rovers driving on a ground plane,
+      /// otherwise they float without gravity and only the wheel joints
+      /// are solved.
+      public: void Fleet(const std::string &_physicsEngine
+                       , double _dt
+                       , int _roverCount
+                       , bool _grounded);
+    };
+  }
+}
+#endif
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2015 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <map>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+#include "step_timer.hh"
+
+using namespace gazebo;
+using namespace benchmark;
+
+/////////////////////////////////////////////////
+std::string benchmark::TemporaryWorldPath(const std::string &_name)
+{
+  const boost::filesystem::path path =
+      boost::filesystem::temp_directory_path() /
+      boost::filesystem::unique_path(_name + "_%%%%%%.world");
+  return path.string();
+}
+
+/////////////////////////////////////////////////
+void benchmark::InsertStatsMap(std::map<std::string, double> &_values
+  , const std::string &_prefix
+  , const std::map<std::string, double> &_stats)
+{
+  for (const auto &value : _stats)
+    _values[_prefix + value.first] = value.second;
+}
+
+/////////////////////////////////////////////////
+StepTimer::StepTimer(physics::WorldPtr _world, bool _countEvents)
+  : world(_world), simTime0(_world->SimTime())
+  , splitsCollision(_world->Physics()->GetType() == "ode")
+{
+  this->collisionTime.InsertStatistics("mean,maxAbs,min");
+  this->physicsTime.InsertStatistics("mean,maxAbs,min");
+  this->stepTime.InsertStatistics("mean,maxAbs,min");
+
+  // The physics update runs on the world thread, World::Step only waits
+  // for it, so the hardware counters follow the world thread and only
+  // run inside its updates. They are left out of the phase times.
+  if (_countEvents)
+    this->perfCounters.reset(new PerfCounters());
+
+  // World::Update runs PhysicsEngine::UpdateCollision before the before
+  // physics update event and PhysicsEngine::UpdatePhysics after it.
+  this->beginConnection = event::Events::ConnectWorldUpdateBegin(
+      [this](const common::UpdateInfo &)
+      {
+        if (this->perfCounters)
+          this->perfCounters->Start();
+        this->updateBegin = Clock::now();
+      });
+  this->physicsConnection = event::Events::ConnectBeforePhysicsUpdate(
+      [this](const common::UpdateInfo &)
+      {
+        this->beforePhysics = Clock::now();
+      });
+  this->endConnection = event::Events::ConnectWorldUpdateEnd(
+      [this]()
+      {
+        this->updateEnd = Clock::now();
+        if (this->perfCounters)
+          this->perfCounters->Stop();
+      });
+}
+
+/////////////////////////////////////////////////
+void StepTimer::Step()
+{
+  const Clock::time_point stepStart = Clock::now();
+  this->world->Step(1);
+  const Clock::time_point stepEnd = Clock::now();
+
+  this->collisionTime.InsertData(std::chrono::duration<double>(
+      this->beforePhysics - this->updateBegin).count());
+  this->physicsTime.InsertData(std::chrono::duration<double>(
+      this->updateEnd - this->beforePhysics).count());
+  const double total =
+      std::chrono::duration<double>(stepEnd - stepStart).count();
+  this->stepTime.InsertData(total);
+  this->wallTime += total;
+}
+
+/////////////////////////////////////////////////
+double StepTimer::WallTime() const
+{
+  return this->wallTime;
+}
+
+/////////////////////////////////////////////////
+double StepTimer::SimTime() const
+{
+  return (this->world->SimTime() - this->simTime0).Double();
+}
+
+/////////////////////////////////////////////////
+bool StepTimer::SplitsCollision() const
+{
+  return this->splitsCollision;
+}
+
+/////////////////////////////////////////////////
+const BatchStats &StepTimer::CollisionTime() const
+{
+  return this->collisionTime;
+}
+
+/////////////////////////////////////////////////
+const BatchStats &StepTimer::PhysicsTime() const
+{
+  return this->physicsTime;
+}
+
+/////////////////////////////////////////////////
+std::map<std::string, double> StepTimer::Values() const
+{
+  std::map<std::string, double> values;
+  const double simTime = this->SimTime();
+  values["wallTime"] = this->wallTime;
+  values["simTime"] = simTime;
+  values["timeRatio"] = simTime > 0.0 ? this->wallTime / simTime : 0.0;
+  InsertStatsMap(values, "stepTime_", this->stepTime.Map());
+  if (this->splitsCollision)
+  {
+    InsertStatsMap(values, "collisionTime_", this->collisionTime.Map());
+    InsertStatsMap(values, "solveTime_", this->physicsTime.Map());
+  }
+  else
+  {
+    InsertStatsMap(values, "physicsTime_", this->physicsTime.Map());
+  }
+
+  // Counter totals and rates, zero when perf counters are unavailable
+  if (this->perfCounters)
+  {
+    for (const auto &value : this->perfCounters->Values())
+      values[value.first] = value.second;
+  }
+  return values;
+}
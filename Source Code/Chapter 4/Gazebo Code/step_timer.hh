@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2015 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef BENCHMARK_GAZEBO_STEP_TIMER_HH_
+#define BENCHMARK_GAZEBO_STEP_TIMER_HH_
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "gazebo/common/Events.hh"
+#include "gazebo/physics/physics.hh"
+#include "batch_stats.hh"
+#include "perf_counters.hh"
+
+namespace gazebo
+{
+  namespace benchmark
+  {
+    /// \brief Path of a new file in the temporary directory, for a world
+    /// written by a benchmark. The caller removes it once loaded.
+    /// \param[in] _name Start of the file name, the world name.
+    /// \return Path of a file that does not exist yet.
+    std::string TemporaryWorldPath(const std::string &_name);
+
+    /// \brief Add statistics to a map of values to record, under the names
+    /// ServerFixture::Record gives those of a SignalStats.
+    /// \param[in,out] _values Map from record name to value.
+    /// \param[in] _prefix Prefix of every statistic name.
+    /// \param[in] _stats Statistics keyed by name, as BatchStats::Map
+    /// returns them.
+    void InsertStatsMap(std::map<std::string, double> &_values
+      , const std::string &_prefix
+      , const std::map<std::string, double> &_stats);
+
+    /// \brief Steps a world and times every step, with the phases of
+    /// World::Update taken from the world update begin, before physics
+    /// update and world update end events.
+    class StepTimer
+    {
+      /// \brief Constructor, connects to the world update events. Steps
+      /// are only timed by Step, other updates of the world are not.
+      /// \param[in] _world World to step.
+      /// \param[in] _countEvents Also count hardware events inside the
+      /// world updates, see PerfCounters.
+      public: StepTimer(physics::WorldPtr _world, bool _countEvents = false);
+
+      /// \brief Step the world once.
+      public: void Step();
+
+      /// \brief Wall time of the steps so far.
+      public: double WallTime() const;
+
+      /// \brief Simulated time since construction.
+      public: double SimTime() const;
+
+      /// \brief Whether the time before the before physics update event
+      /// is the collision time. Only ODE detects collisions in
+      /// PhysicsEngine::UpdateCollision, the other engines detect them
+      /// inside their physics update.
+      public: bool SplitsCollision() const;
+
+      /// \brief Time from the world update begin to the before physics
+      /// update event: the collision detection if SplitsCollision.
+      public: const BatchStats &CollisionTime() const;
+
+      /// \brief Time from the before physics update event to the end of
+      /// the world update: the constraint solve and integration if
+      /// SplitsCollision, the whole physics update otherwise.
+      public: const BatchStats &PhysicsTime() const;
+
+      /// \brief Values to record: wallTime, simTime and timeRatio, the
+      /// stepTime_ statistics, collisionTime_ and solveTime_ if
+      /// SplitsCollision and physicsTime_ otherwise and, if counted, the
+      /// hardware counter totals and rates.
+      /// \return Map from record name to value.
+      public: std::map<std::string, double> Values() const;
+
+      /// \brief Clock of the step and phase times.
+      private: typedef std::chrono::steady_clock Clock;
+
+      /// \brief World to step.
+      private: physics::WorldPtr world;
+
+      /// \brief Simulated time at construction.
+      private: common::Time simTime0;
+
+      /// \brief True for ODE, see SplitsCollision.
+      private: bool splitsCollision;
+
+      /// \brief Times of the events of the last world update.
+      private: Clock::time_point updateBegin;
+      private: Clock::time_point beforePhysics;
+      private: Clock::time_point updateEnd;
+
+      /// \brief Connections to the world update events.
+      private: event::ConnectionPtr beginConnection;
+      private: event::ConnectionPtr physicsConnection;
+      private: event::ConnectionPtr endConnection;
+
+      /// \brief Hardware counters of the world updates, null unless
+      /// counted.
+      private: std::unique_ptr<PerfCounters> perfCounters;
+
+      /// \brief Statistics of the phases and of the whole step.
+      private: BatchStats collisionTime;
+      private: BatchStats physicsTime;
+      private: BatchStats stepTime;
+
+      /// \brief Wall time of the steps so far.
+      private: double wallTime = 0.0;
+    };
+  }
+}
+#endif
@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2015 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "gazebo/physics/physics.hh"
+#include "gazebo/physics/ode/ODESurfaceParams.hh"
+#include "batch_stats.hh"
+#include "contact_capture.hh"
+#include "step_timer.hh"
+#include "tetraball.hh"
+
+using namespace gazebo;
+using namespace benchmark;
+
+// Spins of tetraball.world.erb: 2 N + 1 from -w0max to w0max
+static const int g_spin_count = 16;
+static const double g_w0_max = 150.0;
+
+/////////////////////////////////////////////////
+// Write a world with _modelCount tetraballs on a ground plane to a
+// temporary file, in rows of 33 at the 0.3m spacing of tetraball.world.erb
+static std::string WriteTetraballWorld(int _modelCount)
+{
+  const int rowLength = 2 * g_spin_count + 1;
+  const double spacing = 0.3;
+
+  const std::string path = TemporaryWorldPath("tetraball");
+  std::ofstream out(path.c_str());
+
+  out << "<?xml version=\"1.0\" ?>\n"
+      << "<sdf version=\"1.6\">\n"
+      << "  <world name=\"tetraball\">\n"
+      << "    <physics name=\"default_physics\" default=\"true\""
+      << " type=\"ode\"/>\n"
+      << "    <model name=\"ground_plane\">\n"
+      << "      <static>true</static>\n"
+      << "      <link name=\"link\">\n"
+      << "        <collision name=\"collision\">\n"
+      << "          <geometry><plane><normal>0 0 1</normal>"
+      << "<size>1000 1000</size></plane></geometry>\n"
+      << "        </collision>\n"
+      << "      </link>\n"
+      << "    </model>\n";
+  for (int i = 0; i < _modelCount; ++i)
+  {
+    out << "    <include>\n"
+        << "      <uri>model://tetraball</uri>\n"
+        << "      <name>tetraball_" << i << "</name>\n"
+        << "      <pose>" << (i % rowLength) * spacing << " "
+        << (i / rowLength) * spacing << " 0 0 0 0</pose>\n"
+        << "    </include>\n";
+  }
+  out << "  </world>\n"
+      << "</sdf>\n";
+
+  return path;
+}
+
+/////////////////////////////////////////////////
+// Tetraball:
+// Load a generated world with many tetraballs, start them at rest or
+// sliding and spinning, and record their contacts and step times
+void TetraballTest::Tetraball(const std::string &_physicsEngine
+                            , double _dt
+                            , int _modelCount
+                            , bool _moving
+                            , double _kp)
+{
+  ASSERT_GT(_modelCount, 0);
+  const std::string worldFile = WriteTetraballWorld(_modelCount);
+  Load(worldFile, true, _physicsEngine);
+  boost::filesystem::remove(worldFile);
+
+  physics::WorldPtr world = physics::get_world("tetraball");
+  ASSERT_NE(world, nullptr);
+
+  // Verify physics engine type
+  physics::PhysicsEnginePtr physics = world->Physics();
+  ASSERT_NE(physics, nullptr);
+  ASSERT_EQ(physics->GetType(), _physicsEngine);
+
+  // Initial velocities of tetraball.world.erb, the spins repeating in
+  // every row
+  std::vector<physics::LinkPtr> links(_modelCount);
+  for (int i = 0; i < _modelCount; ++i)
+  {
+    physics::ModelPtr model =
+        world->ModelByName("tetraball_" + std::to_string(i));
+    ASSERT_NE(model, nullptr);
+    links[i] = model->GetLink();
+    ASSERT_NE(links[i], nullptr);
+    if (_moving)
+    {
+      const int k = i % (2 * g_spin_count + 1) - g_spin_count;
+      links[i]->SetLinearVel(ignition::math::Vector3d(0, 15, 0));
+      links[i]->SetAngularVel(
+          ignition::math::Vector3d(0, 0, g_w0_max * k / g_spin_count));
+    }
+  }
+
+  // Contact stiffness of every ball with a damping ratio of one, for a
+  // third of the mass on each of the three resting contacts
+  if (_kp > 0.0)
+  {
+    const double mass = links[0]->GetInertial()->Mass();
+    const double kd = 2.0 * sqrt(_kp * mass / 3.0);
+    for (const auto &link : links)
+    {
+      for (const auto &collision : link->GetCollisions())
+      {
+        auto surface = dynamic_cast<physics::ODESurfaceParams *>(
+            collision->GetSurface().get());
+        ASSERT_NE(surface, nullptr);
+        surface->kp = _kp;
+        surface->kd = kd;
+      }
+    }
+  }
+
+  // change step size after setting initial conditions
+  // since simbody requires a time step
+  physics->SetMaxStepSize(_dt);
+  const double simDuration = 2.0;
+  const int steps = ceil(simDuration / _dt);
+
+  StepTimer stepTimer(world);
+
+  // Contacts are read every step, so keeping them is part of the
+  // collision time of every case alike
+  ContactCapture contactCapture(physics);
+  ASSERT_TRUE(contactCapture.Valid());
+
+  BatchStats contactPoints, penetration;
+  EXPECT_TRUE(contactPoints.InsertStatistics("mean,min,max,var"));
+  EXPECT_TRUE(penetration.InsertStatistics("mean,rms,max"));
+
+  // unthrottle update rate
+  physics->SetRealTimeUpdateRate(0.0);
+  int changes = 0;
+  int previousPoints = -1;
+  std::vector<double> depths;
+  for (int i = 0; i < steps; ++i)
+  {
+    stepTimer.Step();
+
+    // Contact points between the balls and the ground or each other
+    int points = 0;
+    depths.clear();
+    const auto &contacts = contactCapture.Contacts();
+    for (unsigned int c = 0; c < contactCapture.Count(); ++c)
+    {
+      const physics::Contact *contact = contacts[c];
+      points += contact->count;
+      for (int j = 0; j < contact->count; ++j)
+        depths.push_back(contact->depths[j]);
+    }
+    penetration.InsertBlock(depths.data(), depths.size());
+    contactPoints.InsertData(points);
+    if (previousPoints >= 0 && points != previousPoints)
+      ++changes;
+    previousPoints = points;
+  }
+
+  std::map<std::string, double> values = stepTimer.Values();
+  // At rest three balls of every tetraball touch the ground
+  values["restingContactPoints"] = 3.0 * _modelCount;
+  InsertStatsMap(values, "contactPoints_", contactPoints.Map());
+  values["contactChangeRate"] = changes / static_cast<double>(steps);
+  InsertStatsMap(values, "penetration_", penetration.Map());
+  const double physicsTimePerModel =
+      stepTimer.PhysicsTime().Map()["mean"] / _modelCount;
+  if (stepTimer.SplitsCollision())
+    values["solveTimePerModel"] = physicsTimePerModel;
+  else
+    values["physicsTimePerModel"] = physicsTimePerModel;
+  for (const auto &value : values)
+    this->Record(value.first, value.second);
+}
+
+/////////////////////////////////////////////////
+TEST_P(TetraballTest, Tetraball)
+{
+  std::string physicsEngine = std::tr1::get<0>(GetParam());
+  double dt                 = std::tr1::get<1>(GetParam());
+  int modelCount            = std::tr1::get<2>(GetParam());
+  bool moving               = std::tr1::get<3>(GetParam());
+  double kp                 = std::tr1::get<4>(GetParam());
+  gzdbg << physicsEngine
+        << ", dt: " << dt
+        << ", modelCount: " << modelCount
+        << ", moving: " << moving
+        << ", kp: " << kp
+        << std::endl;
+  RecordProperty("engine", physicsEngine);
+  this->Record("dt", dt);
+  RecordProperty("modelCount", modelCount);
+  RecordProperty("moving", moving);
+  this->Record("kp", kp);
+  Tetraball(physicsEngine
+          , dt
+          , modelCount
+          , moving
+          , kp);
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2015 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef BENCHMARK_GAZEBO_TETRABALL_HH_
+#define BENCHMARK_GAZEBO_TETRABALL_HH_
+
+#include <string>
+#include "gazebo/test/ServerFixture.hh"
+
+namespace gazebo
+{
+  namespace benchmark
+  {
+    // physics engine
+    // dt
+    // number of tetraballs to spawn
+    // sliding and spinning / resting
+    // contact stiffness, 0 for the default of the model
+    typedef std::tr1::tuple < const char *
+                            , double
+                            , int
+                            , bool
+                            , double
+                            > char1double1int1bool1double1;
+    class TetraballTest
+      : public ServerFixture,
+        public testing::WithParamInterface<char1double1int1bool1double1>
+    {
+      /// \brief Test persistent multi-point contacts: tetrahedra of
+      /// spheres resting or sliding and spinning on the ground, with three
+      /// of their four balls in contact. Records the stability of the
+      /// contact count, the penetration depths and the collision and
+      /// solver time per step, or the physics time of engines other than
+      /// ODE that do not separate them.
+      /// \param[in] _physicsEngine Physics engine to use.
+      /// \param[in] _dt Max time step size.
+      /// \param[in] _modelCount Number of tetraballs to spawn.
+      /// \param[in] _moving Flag for the initial velocities of
+      /// tetraball.world.erb, otherwise the tetraballs start at rest.
+      /// \param[in] _kp Contact stiffness of every ball, with a damping
+      /// ratio of one. Only ODE reads it; 0 keeps the model default.
+      public: void Tetraball(const std::string &_physicsEngine
+                           , double _dt
+                           , int _modelCount
+                           , bool _moving
+                           , double _kp);
+    };
+  }
+}
+#endif
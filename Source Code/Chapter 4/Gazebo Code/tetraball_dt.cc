@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2015 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <string.h>
+
+#include "tetraball.hh"
+#include "gazebo/test/helper_physics_generator.hh"
+
+using namespace gazebo;
+using namespace benchmark;
+
+INSTANTIATE_TEST_CASE_P(EnginesDt, TetraballTest,
+  ::testing::Combine(PHYSICS_ENGINE_VALUES
+  , ::testing::Values(1e-4, 2.5e-4, 5e-4, 1e-3, 2.5e-3, 5e-3)
+  , ::testing::Values(1)
+  , ::testing::Bool()
+  , ::testing::Values(0.0)));
+
+// Contact stiffness is a surface parameter of ODE only
+INSTANTIATE_TEST_CASE_P(OdeContactStiffness, TetraballTest,
+  ::testing::Combine(::testing::Values("ode")
+  , ::testing::Values(1e-4, 1e-3)
+  , ::testing::Values(1)
+  , ::testing::Bool()
+  , ::testing::Values(1e4, 1e5, 1e6, 1e7, 1e8)));
+
+/////////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -2,6 +2,13 @@
 # Hack: extra sources to build binaries can be supplied to gz_build_tests in
 # the variable GZ_BUILD_TESTS_EXTRA_EXE_SRCS. This variable will be clean up
 # at the end of the function
+#
+# The test cases of a binary can be split into GZ_BUILD_TESTS_SHARDS tests
+# with gtest sharding, which run in parallel processes with ctest -j. Every
+# shard gets its own gazebo master port, result file and csv file. This
+# variable is cleaned up the same way. The ports are counted up from 11346
+# over all sharded binaries, so that those of different binaries do not
+# collide either.
 macro (gz_build_tests)
   # Build all the tests
   foreach(GTEST_SOURCE_file ${ARGN})
@@ -18,29 +25,67 @@ macro (gz_build_tests)
       ${Boost_LIBRARIES}
     )
 
-    add_test(${BINARY_NAME} ${CMAKE_CURRENT_BINARY_DIR}/${BINARY_NAME}
-	    --gtest_output=xml:${CMAKE_BINARY_DIR}/test_results/${BINARY_NAME}.xml)
-
     set(_env_vars)
-    list(APPEND _env_vars "GAZEBO_MODEL_PATH=${CMAKE_SOURCE_DIR}/models:${GAZEBO_MODEL_PATH}")
+    list(APPEND _env_vars "GAZEBO_MODEL_PATH=${CMAKE_SOURCE_DIR}/models:${CMAKE_BINARY_DIR}/models:${GAZEBO_MODEL_PATH}")
+    list(APPEND _env_vars "GAZEBO_PLUGIN_PATH=${CMAKE_BINARY_DIR}:${GAZEBO_PLUGIN_PATH}")
     #list(APPEND _env_vars "GAZEBO_RESOURCE_PATH=${CMAKE_SOURCE_DIR}:${GAZEBO_RESOURCE_PATH}")
-    set_tests_properties(${BINARY_NAME} PROPERTIES
-      TIMEOUT 240
-      ENVIRONMENT "${_env_vars}"
-    )
 
-    # Check that the test produced a result and create a failure if it didn't.
-    # Guards against crashed and timed out tests.
-    add_test(check_${BINARY_NAME} ${PROJECT_SOURCE_DIR}/tools/check_test_ran.py
-	    ${CMAKE_BINARY_DIR}/test_results/${BINARY_NAME}.xml)
-
-    # Convert junit file to csv and place in test_results in source folder.
-    add_test(NAME csv_${BINARY_NAME}
-      COMMAND
-      ${PROJECT_SOURCE_DIR}/tools/junit_to_csv.rb
-	    ${CMAKE_BINARY_DIR}/test_results/${BINARY_NAME}.xml
-      ${CMAKE_CURRENT_SOURCE_DIR}/test_results/${BINARY_NAME}
-    )
+    set(_test_names ${BINARY_NAME})
+    if (GZ_BUILD_TESTS_SHARDS GREATER 1)
+      set(_test_names)
+      math(EXPR _last_shard "${GZ_BUILD_TESTS_SHARDS} - 1")
+      foreach(_shard RANGE ${_last_shard})
+        list(APPEND _test_names ${BINARY_NAME}_shard${_shard})
+      endforeach()
+    endif()
+
+    if (NOT DEFINED GZ_BUILD_TESTS_NEXT_PORT)
+      set(GZ_BUILD_TESTS_NEXT_PORT 11346)
+    endif()
+    set(_shard 0)
+    foreach(TEST_NAME ${_test_names})
+      set(_test_env_vars ${_env_vars})
+      if (GZ_BUILD_TESTS_SHARDS GREATER 1)
+        math(EXPR _port "${GZ_BUILD_TESTS_NEXT_PORT} + ${_shard}")
+        list(APPEND _test_env_vars
+          "GTEST_TOTAL_SHARDS=${GZ_BUILD_TESTS_SHARDS}"
+          "GTEST_SHARD_INDEX=${_shard}"
+          "GAZEBO_MASTER_URI=http://localhost:${_port}")
+        math(EXPR _shard "${_shard} + 1")
+      endif()
+
+      add_test(${TEST_NAME} ${CMAKE_CURRENT_BINARY_DIR}/${BINARY_NAME}
+	      --gtest_output=xml:${CMAKE_BINARY_DIR}/test_results/${TEST_NAME}.xml)
+
+      set_tests_properties(${TEST_NAME} PROPERTIES
+        TIMEOUT 240
+        ENVIRONMENT "${_test_env_vars}"
+      )
+
+      # Check that the test produced a result and create a failure if it didn't.
+      # Guards against crashed and timed out tests.
+      add_test(check_${TEST_NAME} ${PROJECT_SOURCE_DIR}/tools/check_test_ran.py
+	      ${CMAKE_BINARY_DIR}/test_results/${TEST_NAME}.xml)
+
+      # Convert junit file to csv and place in test_results in source folder.
+      # Fails if the run is significantly slower than the stored baseline.
+      add_test(NAME csv_${TEST_NAME}
+        COMMAND
+        ${PROJECT_SOURCE_DIR}/tools/junit_to_csv.rb
+	      ${CMAKE_BINARY_DIR}/test_results/${TEST_NAME}.xml
+        ${CMAKE_CURRENT_SOURCE_DIR}/test_results/${TEST_NAME}
+        ${BENCHMARK_BASELINE_DIR}
+      )
+
+      # With ctest -j the checks must still wait for the test they read
+      set_tests_properties(check_${TEST_NAME} PROPERTIES DEPENDS ${TEST_NAME})
+      set_tests_properties(csv_${TEST_NAME} PROPERTIES
+        DEPENDS "${TEST_NAME};check_${TEST_NAME}")
+    endforeach()
+    if (GZ_BUILD_TESTS_SHARDS GREATER 1)
+      math(EXPR GZ_BUILD_TESTS_NEXT_PORT
+        "${GZ_BUILD_TESTS_NEXT_PORT} + ${GZ_BUILD_TESTS_SHARDS}")
+    endif()
 
     install(TARGETS ${BINARY_NAME}
       RUNTIME DESTINATION bin
@@ -48,4 +93,5 @@ macro (gz_build_tests)
   endforeach()
 
   set(GZ_BUILD_TESTS_EXTRA_EXE_SRCS "")
+  set(GZ_BUILD_TESTS_SHARDS "")
 endmacro()
@@ -0,0 +1,181 @@
+#!/usr/bin/env ruby
+#
+# Compare a benchmark csv produced by junit_to_csv.rb against the stored
+# baseline runs of the same binary and fail on significant slowdowns.
+#
+# Usage: compare_to_baseline.rb <current.csv> <baseline_dir>
+#
+# The baseline for BENCHMARK_foo_<timestamp>.csv is every
+# <baseline_dir>/BENCHMARK_foo_*.csv; when several baseline runs exist the
+# per-case median is used. Cases are matched on their gtest name and on
+# every parameter column the benchmarks record (PARAMETER_KEYS), and for
+# each engine the log ratios current / baseline of wallTime and timeRatio
+# are tested with a one-sided Wilcoxon signed-rank test. A metric counts as
+# regressed when the test is significant and the median slowdown exceeds
+# MIN_SLOWDOWN. A baseline that no case matches fails the comparison.
+#
+# The smallest p-value the exact test can reach with n pairs is 1 / 2**n, so
+# below MIN_PAIRS pairs it can never be significant. Such groups are reported
+# as too small and only fail when the median slowdown exceeds
+# SMALL_GROUP_SLOWDOWN.
+
+require 'csv'
+
+module BaselineComparison
+  # The test case: its instantiation and its parameter index.
+  NAME_KEYS = %w[classname name]
+  # Parameters of the benchmark cases, recorded by their TEST_P. A case
+  # only matches a baseline case with the same values.
+  PARAMETER_KEYS = %w[engine dt modelCount collision isComplex variant w0
+                      moving kp roverCount grounded pairCount subscribe
+                      collisionDetector scene count]
+  METRICS = %w[wallTime timeRatio]
+  ALPHA = 0.01
+  MIN_SLOWDOWN = 0.10
+  # Fewest pairs for which 1 / 2**n < ALPHA.
+  MIN_PAIRS = Math.log2(1.0 / ALPHA).floor + 1
+  SMALL_GROUP_SLOWDOWN = 0.25
+  # Above this many pairs the normal approximation is used.
+  EXACT_LIMIT = 25
+
+  def self.median(values)
+    s = values.sort
+    n = s.size
+    n.odd? ? s[n / 2] : 0.5 * (s[n / 2 - 1] + s[n / 2])
+  end
+
+  # Read a csv into a hash of case key => { metric => value }. The key
+  # starts with the engine, the group the cases are tested in.
+  def self.load_cases(path)
+    cases = {}
+    CSV.foreach(path, headers: true) do |row|
+      next unless NAME_KEYS.all? { |k| row[k] }
+      key = [row['engine'].to_s] +
+            (NAME_KEYS + PARAMETER_KEYS).map { |k| row[k].to_s }
+      warn "#{path}: duplicate case #{key.join(' ')}" if cases.key?(key)
+      cases[key] = {}
+      METRICS.each do |m|
+        v = row[m]
+        cases[key][m] = v.to_f if v && v.to_f > 0
+      end
+    end
+    cases
+  end
+
+  # P(W+ >= w) under H0 for n pairs, where ranks are given doubled so that
+  # averaged ties stay integral.
+  def self.exact_upper_p(doubled_ranks, w)
+    total = doubled_ranks.sum
+    counts = Array.new(total + 1, 0)
+    counts[0] = 1
+    doubled_ranks.each do |r|
+      total.downto(r) { |s| counts[s] += counts[s - r] }
+    end
+    hits = 0
+    counts.each_with_index { |c, s| hits += c if s >= w }
+    hits.to_f / (2**doubled_ranks.size)
+  end
+
+  def self.normal_upper_p(z)
+    0.5 * Math.erfc(z / Math.sqrt(2.0))
+  end
+
+  # One-sided Wilcoxon signed-rank test of H1: median(diffs) > 0.
+  def self.wilcoxon_greater(diffs)
+    d = diffs.reject(&:zero?)
+    n = d.size
+    return 1.0 if n.zero?
+
+    order = d.each_index.sort_by { |i| d[i].abs }
+    doubled = Array.new(n)
+    i = 0
+    tie_term = 0
+    while i < n
+      j = i
+      j += 1 while j + 1 < n && d[order[j + 1]].abs == d[order[i]].abs
+      # average of ranks i+1..j+1, doubled
+      (i..j).each { |k| doubled[order[k]] = i + j + 2 }
+      t = j - i + 1
+      tie_term += t**3 - t
+      i = j + 1
+    end
+    w2 = 0
+    d.each_index { |k| w2 += doubled[k] if d[k] > 0 }
+
+    return exact_upper_p(doubled, w2) if n <= EXACT_LIMIT
+
+    mean = n * (n + 1) / 4.0
+    var = n * (n + 1) * (2 * n + 1) / 24.0 - tie_term / 48.0
+    # continuity correction on the undoubled statistic
+    normal_upper_p((w2 / 2.0 - mean - 0.5) / Math.sqrt(var))
+  end
+
+  # Returns true when no metric regressed.
+  def self.compare(current_csv, baseline_dir)
+    prefix = File.basename(current_csv).sub(/_\d{4}-\d\d-\d\dT.*\.csv\z/, '')
+    baseline_files =
+      Dir.glob(File.join(baseline_dir, prefix + '_*.csv')).sort
+    if baseline_files.empty?
+      puts "No baseline for #{prefix} in #{baseline_dir}, skipping comparison"
+      return true
+    end
+
+    current = load_cases(current_csv)
+    runs = baseline_files.map { |f| load_cases(f) }
+    baseline = {}
+    runs.flat_map(&:keys).uniq.each do |key|
+      baseline[key] = {}
+      METRICS.each do |m|
+        values = runs.map { |r| r[key] && r[key][m] }.compact
+        baseline[key][m] = median(values) unless values.empty?
+      end
+    end
+
+    matched = current.keys & baseline.keys
+    puts "#{prefix}: #{matched.size} of #{current.size} cases matched " \
+         "against #{baseline_files.size} baseline run(s)"
+    # A baseline that no case matches checks nothing, it has to be updated
+    if matched.empty? && !current.empty?
+      puts "  no case matches the baseline, update it"
+      return false
+    end
+
+    ok = true
+    matched.group_by(&:first).sort.each do |engine, keys|
+      METRICS.each do |m|
+        logs = keys.map do |k|
+          c = current[k][m]
+          b = baseline[k][m]
+          Math.log(c / b) if c && b
+        end.compact
+        next if logs.empty?
+
+        slowdown = Math.exp(median(logs)) - 1.0
+        if logs.size < MIN_PAIRS
+          regressed = slowdown > SMALL_GROUP_SLOWDOWN
+          printf("  %-8s %-10s n=%-3d median change %+7.2f%%  too few " \
+                 "pairs for the test, threshold %d%%%s\n",
+                 engine, m, logs.size, 100.0 * slowdown,
+                 (100 * SMALL_GROUP_SLOWDOWN).round,
+                 regressed ? '  REGRESSION' : '')
+        else
+          p = wilcoxon_greater(logs)
+          regressed = p < ALPHA && slowdown > MIN_SLOWDOWN
+          printf("  %-8s %-10s n=%-3d median change %+7.2f%%  p=%.4g%s\n",
+                 engine, m, logs.size, 100.0 * slowdown, p,
+                 regressed ? '  REGRESSION' : '')
+        end
+        ok = false if regressed
+      end
+    end
+    ok
+  end
+end
+
+if __FILE__ == $PROGRAM_NAME
+  if ARGV.size != 2
+    warn "Usage: #{$PROGRAM_NAME} <current.csv> <baseline_dir>"
+    exit 2
+  end
+  exit(BaselineComparison.compare(ARGV[0], ARGV[1]) ? 0 : 1)
+end
@@ -0,0 +1,121 @@
+#!/usr/bin/env ruby
+#
+# Tests of compare_to_baseline.rb on csv files as junit_to_csv.rb writes
+# them for the tetraball and joint_cost benchmarks.
+
+require 'minitest/autorun'
+require 'tmpdir'
+require_relative 'compare_to_baseline'
+
+class CompareToBaselineTest < Minitest::Test
+  # Rows of a tetraball_count run: every engine, model count and moving
+  # flag, with a wall time scaled by scale and some noise.
+  def tetraball_rows(scale, seed)
+    random = Random.new(seed)
+    rows = []
+    %w[ode bullet].each do |engine|
+      [1, 2, 4, 8, 16].each do |count|
+        [0, 1].each do |moving|
+          index = rows.size
+          wall = count * (1.0 + moving) * scale * (1.0 + 0.01 * random.rand)
+          rows << {
+            'classname' => 'EnginesCount/TetraballTest',
+            'dt' => 0.001, 'engine' => engine, 'kp' => 1e13,
+            'modelCount' => count, 'moving' => moving,
+            'name' => "Tetraball/#{index}",
+            'timeRatio' => wall / 10.0, 'wallTime' => wall
+          }
+        end
+      end
+    end
+    rows
+  end
+
+  # Rows of a joint_cost_count run, whose cases differ in their variant.
+  def joint_cost_rows(scale, seed)
+    random = Random.new(seed)
+    rows = []
+    %w[ode dart].each do |engine|
+      %w[contacts joints].each do |variant|
+        [10, 20, 40, 80].each do |count|
+          index = rows.size
+          wall = count * (variant == 'joints' ? 2.0 : 1.0) * scale *
+                 (1.0 + 0.01 * random.rand)
+          rows << {
+            'classname' => 'EnginesCount/JointCostTest',
+            'engine' => engine, 'modelCount' => count,
+            'name' => "JointCost/#{index}", 'variant' => variant,
+            'timeRatio' => wall / 2.0, 'wallTime' => wall
+          }
+        end
+      end
+    end
+    rows
+  end
+
+  def write_csv(path, rows)
+    keys = rows.map(&:keys).flatten.uniq.sort
+    File.open(path, 'w') do |f|
+      f.puts keys.join(',')
+      rows.each { |row| f.puts keys.map { |k| row[k] }.join(',') }
+    end
+  end
+
+  # Compare a run against a baseline run, both written to a temporary
+  # directory. Returns the result and the printed report.
+  def compare(prefix, baseline_rows, current_rows)
+    Dir.mktmpdir do |dir|
+      baseline_dir = File.join(dir, 'baseline')
+      Dir.mkdir(baseline_dir)
+      write_csv(File.join(baseline_dir,
+                          prefix + '_2021-01-01T00_00_00.csv'), baseline_rows)
+      current = File.join(dir, prefix + '_2021-01-02T00_00_00.csv')
+      write_csv(current, current_rows)
+      result = nil
+      out, = capture_io do
+        result = BaselineComparison.compare(current, baseline_dir)
+      end
+      [result, out]
+    end
+  end
+
+  def test_tetraball_unchanged_passes
+    ok, out = compare('BENCHMARK_tetraball_count', tetraball_rows(1.0, 1),
+                      tetraball_rows(1.0, 2))
+    assert ok, out
+    assert_match(/20 of 20 cases matched/, out)
+  end
+
+  def test_tetraball_slowdown_fails
+    ok, out = compare('BENCHMARK_tetraball_count', tetraball_rows(1.0, 1),
+                      tetraball_rows(1.3, 2))
+    refute ok, out
+    assert_match(/ode\s+wallTime.*REGRESSION/, out)
+    assert_match(/bullet\s+wallTime.*REGRESSION/, out)
+  end
+
+  def test_joint_cost_slowdown_fails
+    ok, out = compare('BENCHMARK_joint_cost_count', joint_cost_rows(1.0, 1),
+                      joint_cost_rows(1.3, 2))
+    refute ok, out
+    assert_match(/16 of 16 cases matched/, out)
+  end
+
+  # Cases that only differ in their variant are kept apart, merged they
+  # would overwrite each other and leave 4 pairs per engine
+  def test_joint_cost_variants_are_separate_cases
+    ok, out = compare('BENCHMARK_joint_cost_count', joint_cost_rows(1.0, 1),
+                      joint_cost_rows(1.0, 2))
+    assert ok, out
+    assert_match(/ode\s+wallTime\s+n=8 /, out)
+    assert_match(/dart\s+wallTime\s+n=8 /, out)
+  end
+
+  def test_unmatched_baseline_fails
+    current = tetraball_rows(1.0, 2).each { |row| row['kp'] = 1e12 }
+    ok, out = compare('BENCHMARK_tetraball_count', tetraball_rows(1.0, 1),
+                      current)
+    refute ok, out
+    assert_match(/0 of 20 cases matched/, out)
+  end
+end
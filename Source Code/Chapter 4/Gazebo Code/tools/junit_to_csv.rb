@@ -1,15 +1,20 @@
 #!/usr/bin/env ruby
 
 require 'rexml/document'
+require_relative 'compare_to_baseline'
 
 xmlInput = File.read(ARGV[0])
 csvOutputPrefix = ARGV[1]
+# Optional directory of baseline csv files to check the new run against.
+baselineDir = ARGV[2]
 
 doc, arrayOfHashes = REXML::Document.new(xmlInput), []
 doc.elements.each('testsuites/testsuite/testcase') do |t|
   arrayOfHashes << t.attributes
 end
-sortedKeys = arrayOfHashes.first.keys.sort
+# Use every key seen in any test case, since not all cases have to record
+# the same properties. Missing values are left empty.
+sortedKeys = arrayOfHashes.map { |h| h.keys }.flatten.uniq.sort
 sortedKeys.delete("value_param")
 
 timestamp = doc.elements.first.attributes["timestamp"]
@@ -24,3 +29,7 @@ File.open(csvOutput, "w") do |f|
     f.puts row.join(',')
   end
 end
+
+if baselineDir && !BaselineComparison.compare(csvOutput, baselineDir)
+  exit 1
+end
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2015 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <map>
+#include <string>
+#include <vector>
+
+#include <ignition/math/Vector3.hh>
+
+#include "gazebo/physics/physics.hh"
+#include "step_timer.hh"
+#include "triball_drift.hh"
+
+using namespace gazebo;
+using namespace benchmark;
+
+/////////////////////////////////////////////////
+// Center of mass of all links of a model in the world frame
+static ignition::math::Vector3d ModelCoG(const physics::ModelPtr &_model
+                                       , double &_mass)
+{
+  ignition::math::Vector3d cog;
+  _mass = 0.0;
+  for (const auto &link : _model->GetLinks())
+  {
+    const double mass = link->GetInertial()->Mass();
+    cog += mass * link->WorldInertialPose().Pos();
+    _mass += mass;
+  }
+  return cog / _mass;
+}
+
+/////////////////////////////////////////////////
+// Drift:
+// Slide a triball variant along y with a spin about the vertical axis,
+// pulled sideways by a lateral gravity component, and record how far it
+// drifts and what every step costs
+void TriballDriftTest::Drift(const std::string &_physicsEngine
+                           , const std::string &_variant
+                           , double _w0)
+{
+  // Load a world with a ground plane
+  Load("worlds/empty.world", true, _physicsEngine);
+  physics::WorldPtr world = physics::get_world("default");
+  ASSERT_NE(world, nullptr);
+
+  // Verify physics engine type
+  physics::PhysicsEnginePtr physics = world->Physics();
+  ASSERT_NE(physics, nullptr);
+  ASSERT_EQ(physics->GetType(), _physicsEngine);
+
+  // Gravity and initial velocity of triball_drift.world.erb
+  world->SetGravity(ignition::math::Vector3d(1, 0, -9.8));
+  const ignition::math::Vector3d v0(0, 15, 0);
+  const ignition::math::Vector3d w0(0, 0, _w0);
+
+  // One variant per world, so that the step cost is its own. The model
+  // path is set for every benchmark by gz_build_tests.
+  const std::string modelName = "triball_" + _variant;
+  world->InsertModelFile("model://" + modelName);
+  this->WaitUntilEntitySpawn(modelName, 100, 100);
+  physics::ModelPtr model = world->ModelByName(modelName);
+  ASSERT_NE(model, nullptr);
+
+  // Rigid motion of the whole triball about its center of mass: every
+  // link gets the spin, and the velocity of its own center of mass.
+  // Model::SetAngularVel would leave the links off the axis behind.
+  double mass = 0.0;
+  const ignition::math::Vector3d p0 = ModelCoG(model, mass);
+  for (const auto &link : model->GetLinks())
+  {
+    link->SetLinearVel(v0 + w0.Cross(link->WorldInertialPose().Pos() - p0));
+    link->SetAngularVel(w0);
+  }
+  const unsigned int jointCount = model->GetJointCount();
+
+  // change step size after setting initial conditions
+  // since simbody requires a time step
+  const double dt = 1e-3;
+  physics->SetMaxStepSize(dt);
+
+  // The slide stops after about 1.7s, the rest is rolling or resting
+  const double simDuration = 4.0;
+  const int steps = ceil(simDuration / dt);
+
+  StepTimer stepTimer(world, true);
+
+  // unthrottle update rate
+  physics->SetRealTimeUpdateRate(0.0);
+  for (int i = 0; i < steps; ++i)
+    stepTimer.Step();
+  ASSERT_NEAR(stepTimer.SimTime(), simDuration, dt*1.1);
+
+  // Drift is the displacement along the lateral gravity, across the
+  // initial velocity
+  const ignition::math::Vector3d displacement = ModelCoG(model, mass) - p0;
+  std::map<std::string, double> values = stepTimer.Values();
+  values["drift"] = displacement.X();
+  values["travel"] = displacement.Y();
+  values["jointCount"] = jointCount;
+  for (const auto &value : values)
+    this->Record(value.first, value.second);
+}
+
+/////////////////////////////////////////////////
+TEST_P(TriballDriftTest, Drift)
+{
+  std::string physicsEngine = std::tr1::get<0>(GetParam());
+  std::string variant       = std::tr1::get<1>(GetParam());
+  double w0                 = std::tr1::get<2>(GetParam());
+  gzdbg << physicsEngine
+        << ", variant: " << variant
+        << ", w0: " << w0
+        << std::endl;
+  RecordProperty("engine", physicsEngine);
+  RecordProperty("variant", variant);
+  this->Record("w0", w0);
+  Drift(physicsEngine
+      , variant
+      , w0);
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2015 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef BENCHMARK_GAZEBO_TRIBALL_DRIFT_HH_
+#define BENCHMARK_GAZEBO_TRIBALL_DRIFT_HH_
+
+#include <string>
+#include "gazebo/test/ServerFixture.hh"
+
+namespace gazebo
+{
+  namespace benchmark
+  {
+    // physics engine
+    // triball variant: lumped, fixed or revolute
+    // initial spin about the vertical axis
+    typedef std::tr1::tuple < const char *
+                            , const char *
+                            , double
+                            > char2double1;
+    class TriballDriftTest
+      : public ServerFixture,
+        public testing::WithParamInterface<char2double1>
+    {
+      /// \brief Test the drift of a triball sliding and spinning on the
+      /// ground under a lateral gravity component, and the per-step cost
+      /// of the joint formulation of its balls.
+      /// \param[in] _physicsEngine Physics engine to use.
+      /// \param[in] _variant Model variant: lumped for a single link,
+      /// fixed or revolute for balls on fixed or revolute joints.
+      /// \param[in] _w0 Initial angular velocity about the vertical axis.
+      public: void Drift(const std::string &_physicsEngine
+                       , const std::string &_variant
+                       , double _w0);
+    };
+  }
+}
+#endif
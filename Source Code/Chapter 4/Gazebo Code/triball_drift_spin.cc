@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2015 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <string.h>
+
+#include "triball_drift.hh"
+#include "gazebo/test/helper_physics_generator.hh"
+
+using namespace gazebo;
+using namespace benchmark;
+
+// 2 N + 1 spins from -w0max to w0max, as in triball_drift.world.erb
+const int g_spin_count = 16;
+const double g_w0_max = 150.0;
+
+INSTANTIATE_TEST_CASE_P(EnginesVariantsSpin, TriballDriftTest,
+  ::testing::Combine(PHYSICS_ENGINE_VALUES
+  , ::testing::Values("lumped", "fixed", "revolute")
+  , ::testing::Range(-g_w0_max, g_w0_max * (1.0 + 0.5 / g_spin_count)
+                   , g_w0_max / g_spin_count)));
+
+/////////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
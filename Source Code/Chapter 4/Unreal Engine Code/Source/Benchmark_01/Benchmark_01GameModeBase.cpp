@@ -2,4 +2,177 @@
 
 
 #include "Benchmark_01GameModeBase.h"
+#include "EngineUtils.h"
+#include "ExperimentalCube.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformTime.h"
+#include "Kismet/KismetSystemLibrary.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "TextFileManager.h"
 
+ABenchmark_01GameModeBase::ABenchmark_01GameModeBase()
+{
+	// Only ticks while a sweep is running
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+}
+
+void ABenchmark_01GameModeBase::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (!FParse::Param(FCommandLine::Get(), TEXT("BenchmarkSweep")))
+	{
+		return;
+	}
+
+	ReadSweepCommandLine();
+
+	for (TActorIterator<AExperimentalCube> It(GetWorld()); It; ++It)
+	{
+		// The cubes tick after a reset in the same frame, like after BeginPlay.
+		It->AddTickPrerequisiteActor(this);
+		Cubes.Add(*It);
+	}
+	if (Cubes.Num() == 0 || Cases.Num() == 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Benchmark sweep has %d cubes and %d cases, nothing to run"), Cubes.Num(), Cases.Num());
+		FGenericPlatformMisc::RequestExit(false);
+		return;
+	}
+
+	Summary.Add(TEXT("Scenario,Dt,Frame Rate,Frames,Wall Time,Time Ratio"));
+	SetActorTickEnabled(true);
+	NextCase();
+}
+
+void ABenchmark_01GameModeBase::ReadSweepCommandLine()
+{
+	const TCHAR* CommandLine = FCommandLine::Get();
+
+	TArray<float> FrameRates;
+	FString List;
+	if (FParse::Value(CommandLine, TEXT("FrameRates="), List, false))
+	{
+		TArray<FString> Parts;
+		List.ParseIntoArray(Parts, TEXT(","));
+		for (const FString& Part : Parts)
+		{
+			FrameRates.Add(FCString::Atof(*Part));
+		}
+	}
+	else
+	{
+		// The dts of Results/Raw Data/Chapter 4, 0.01282 to 0.05282 s
+		for (int32 Index = 0; Index < 9; Index++)
+		{
+			FrameRates.Add(1.0f / (0.01282f + 0.005f * Index));
+		}
+	}
+
+	TArray<FString> Scenarios = { TEXT("Simple"), TEXT("Complex") };
+	if (FParse::Value(CommandLine, TEXT("Scenarios="), List, false))
+	{
+		List.ParseIntoArray(Scenarios, TEXT(","));
+	}
+
+	for (const FString& Scenario : Scenarios)
+	{
+		for (float FrameRate : FrameRates)
+		{
+			if (FrameRate > 0.0f)
+			{
+				Cases.Add({ Scenario, FrameRate });
+			}
+		}
+	}
+
+	if (!FParse::Value(CommandLine, TEXT("BenchmarkResults="), ResultsDirectory))
+	{
+		ResultsDirectory = FPaths::Combine(UKismetSystemLibrary::GetProjectDirectory(), TEXT("Sweep Results"));
+	}
+}
+
+FString ABenchmark_01GameModeBase::CaseDirectory(const FBenchmarkSweepCase& Case) const
+{
+	return FPaths::Combine(ResultsDirectory, Case.Scenario + TEXT(" Scenario"), TEXT("Unreal Results"),
+		FString::Printf(TEXT("%f"), 1.0f / Case.FrameRate));
+}
+
+void ABenchmark_01GameModeBase::NextCase()
+{
+	CaseIndex++;
+	if (CaseIndex >= Cases.Num())
+	{
+		ATextFileManager::SaveArrayText(ResultsDirectory, TEXT("Benchmark_01_Sweep.csv"), Summary, true);
+		UE_LOG(LogTemp, Warning, TEXT("Benchmark sweep of %d cases written to %s"), Cases.Num(), *ResultsDirectory);
+		SetActorTickEnabled(false);
+		FGenericPlatformMisc::RequestExit(false);
+		return;
+	}
+
+	// Steps of exactly 1 / FrameRate without waiting for real time, the same as -benchmark -fps
+	FApp::SetUseFixedTimeStep(true);
+	FApp::SetFixedDeltaTime(1.0 / Cases[CaseIndex].FrameRate);
+	bResetPending = true;
+}
+
+void ABenchmark_01GameModeBase::ResetCubes()
+{
+	const FBenchmarkSweepCase& Case = Cases[CaseIndex];
+	const FString Directory = CaseDirectory(Case);
+	IFileManager::Get().MakeDirectory(*Directory, true);
+
+	const bool bComplex = Case.Scenario.Equals(TEXT("Complex"), ESearchCase::IgnoreCase);
+	for (AExperimentalCube* Cube : Cubes)
+	{
+		Cube->ResetExperiment(bComplex, Directory);
+	}
+
+	UE_LOG(LogTemp, Warning, TEXT("Benchmark sweep case %d of %d: %s, dt %f"), CaseIndex + 1, Cases.Num(), *Case.Scenario, 1.0f / Case.FrameRate);
+	CaseFrames = 0;
+	CaseStart = FPlatformTime::Seconds();
+}
+
+void ABenchmark_01GameModeBase::FinishCase()
+{
+	const FBenchmarkSweepCase& Case = Cases[CaseIndex];
+	const double WallTime = FPlatformTime::Seconds() - CaseStart;
+	const double SimTime = CaseFrames / Case.FrameRate;
+
+	Summary.Add(Case.Scenario + "," + FString::SanitizeFloat(1.0f / Case.FrameRate) + "," + FString::SanitizeFloat(Case.FrameRate) + "," +
+		FString::FromInt(CaseFrames) + "," + FString::SanitizeFloat(WallTime) + "," + FString::SanitizeFloat(SimTime > 0.0 ? WallTime / SimTime : 0.0));
+}
+
+void ABenchmark_01GameModeBase::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (CaseIndex < 0 || CaseIndex >= Cases.Num())
+	{
+		return;
+	}
+
+	if (bResetPending)
+	{
+		bResetPending = false;
+		ResetCubes();
+		return;
+	}
+
+	CaseFrames++;
+	for (AExperimentalCube* Cube : Cubes)
+	{
+		if (!Cube->IsExperimentFinished())
+		{
+			return;
+		}
+	}
+
+	FinishCase();
+	NextCase();
+}
@@ -6,12 +6,67 @@
 #include "GameFramework/GameModeBase.h"
 #include "Benchmark_01GameModeBase.generated.h"
 
+class AExperimentalCube;
+
+/* One run of the dt sweep: a scenario at a fixed frame rate. */
+struct FBenchmarkSweepCase
+{
+	FString Scenario;
+	float FrameRate = 0.0f;
+};
+
 /**
- * 
+ * Runs the dt sweep of the boxes benchmark in a single process when started with -BenchmarkSweep, the same cases as
+ * boxes_dt.cc in the Gazebo code. Every case sets a fixed time step, resets all ExperimentalCubes of the level to their
+ * spawn transform in the scenario of the case and waits for them to write their observations. Without rendering:
+ *
+ *   Benchmark_01 /Game/Maps/Complex_Scenario_Map?game=/Script/Benchmark_01.Benchmark_01GameModeBase -game -nullrhi
+ *     -unattended -BenchmarkSweep -FrameRates=78.003120,56.116723 -Scenarios=Simple,Complex -BenchmarkResults=PATH
+ *
+ * The observations of a case are written to PATH/<Scenario> Scenario/Unreal Results/<dt>/, the layout of
+ * Results/Raw Data/Chapter 4, and the wall time of every case to PATH/Benchmark_01_Sweep.csv.
  */
 UCLASS()
 class BENCHMARK_01_API ABenchmark_01GameModeBase : public AGameModeBase
 {
 	GENERATED_BODY()
-	
+
+private:
+	TArray<FBenchmarkSweepCase> Cases;
+
+	UPROPERTY()
+	TArray<AExperimentalCube*> Cubes;
+
+	int32 CaseIndex = -1;
+
+	/* The cubes are reset a frame after the time step changes, so that the whole case runs at the new step. */
+	bool bResetPending = false;
+
+	int32 CaseFrames = 0;
+	double CaseStart = 0.0;
+
+	FString ResultsDirectory;
+
+	/* One line per finished case. */
+	TArray<FString> Summary;
+
+	/* Reads -FrameRates=F1,F2,... -Scenarios=Simple,Complex -BenchmarkResults=PATH, the dts of the results by default. */
+	void ReadSweepCommandLine();
+
+	FString CaseDirectory(const FBenchmarkSweepCase& Case) const;
+
+	void NextCase();
+
+	void ResetCubes();
+
+	void FinishCase();
+
+protected:
+	virtual void BeginPlay() override;
+
+public:
+	ABenchmark_01GameModeBase();
+
+	// Called every frame, before the cubes tick
+	virtual void Tick(float DeltaSeconds) override;
 };
@@ -47,6 +47,12 @@ void AExperimentalCube::BeginPlay()
 {
 	Super::BeginPlay();
 
+	SpawnTransform = GetActorTransform();
+	StartExperiment();
+}
+
+void AExperimentalCube::StartExperiment()
+{
 	UWorld* CrtWorld = GetWorld();
 	if (CubeMesh->IsGravityEnabled())
 	{
@@ -80,6 +86,20 @@ void AExperimentalCube::BeginPlay()
 	InitialEnergy = ComputeTotalEnergy();
 }
 
+void AExperimentalCube::ResetExperiment(bool bComplex, const FString& Directory)
+{
+	// Teleporting with ResetPhysics also clears the velocities of the body.
+	SetActorTransform(SpawnTransform, false, nullptr, ETeleportType::ResetPhysics);
+	CubeMesh->SetEnableGravity(bComplex);
+
+	CurrentExperimentTime = 0.0f;
+	ObservationsArray.Reset();
+	bAddedLabels = false;
+	SaveDirectory = Directory;
+
+	StartExperiment();
+}
+
 float AExperimentalCube::ComputeTotalEnergy() 
 {
 	// Compute kinetic energy	
@@ -137,7 +157,7 @@ void AExperimentalCube::AddObservationLabels()
 		FString("Roll") + "," + FString("Yaw") + "," + FString("Pitch") + ",";
 
 	ObservationsArray.Insert(ObservationLabels, 0);
-	ATextFileManager::SaveArrayText(UKismetSystemLibrary::GetProjectDirectory(), FileName, ObservationsArray, true);
+	ATextFileManager::SaveArrayText(SaveDirectory.IsEmpty() ? UKismetSystemLibrary::GetProjectDirectory() : SaveDirectory, FileName, ObservationsArray, true);
 
 	// Modify the value of the auxiliary so that labels are added only once.
 	bAddedLabels = true;
@@ -52,6 +52,12 @@ private:
 	FVector AngularMomentumError;
 	float EnergyError;
 
+	/* Transform the cube was spawned with, the start of every experiment. */
+	FTransform SpawnTransform;
+
+	/* Sets the initial velocities of the scenario given by gravity and the initial values the errors are relative to. */
+	void StartExperiment();
+
 protected:
 	virtual void BeginPlay() override;
 
@@ -86,4 +92,14 @@ public:
 
 	/* Auxiliary boolean used to determine if labels were added or not. */
 	bool bAddedLabels = false;
+
+	/* Directory the .csv file is saved to, the project directory if empty. */
+	FString SaveDirectory;
+
+	/* Moves the cube back to its spawn transform and starts the experiment again in the complex or simple scenario,
+	   saving the new observations to Directory. Used by the dt sweep of ABenchmark_01GameModeBase. */
+	void ResetExperiment(bool bComplex, const FString& Directory);
+
+	/* True once the observations of the experiment were saved. */
+	bool IsExperimentFinished() const { return bAddedLabels; }
 };
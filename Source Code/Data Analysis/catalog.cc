@@ -0,0 +1,470 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#include "catalog.hh"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include "parallel.hh"
+#include "trace.hh"
+
+namespace fs = std::filesystem;
+
+namespace analysis
+{
+  // First line of a catalog file.
+  static const char *catalogHeader = "results catalog 1";
+
+  static std::string Lower(std::string _s)
+  {
+    for (char &c : _s)
+      c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return _s;
+  }
+
+  static std::vector<std::string> Split(const std::string &_s
+                                      , char _separator)
+  {
+    std::vector<std::string> parts;
+    std::istringstream stream(_s);
+    std::string part;
+    while (std::getline(stream, part, _separator))
+      parts.push_back(part);
+    if (!_s.empty() && _s.back() == _separator)
+      parts.push_back("");
+    return parts;
+  }
+
+  // The whole string as a number, NaN if it is not one.
+  static double Number(const std::string &_s)
+  {
+    char *end = nullptr;
+    const double value = std::strtod(_s.c_str(), &end);
+    if (_s.empty() || end != _s.c_str() + _s.size())
+      return std::numeric_limits<double>::quiet_NaN();
+    return value;
+  }
+
+  RunParameters DescribeResultsFile(const std::string &_path)
+  {
+    RunParameters parameters;
+    const std::vector<std::string> parts = Split(_path, '/');
+    if (parts.empty())
+      return parameters;
+
+    // The engine directory splits the path in the run description before
+    // and the sub directories of the engine after it.
+    const std::string suffix = " Results";
+    size_t engine = parts.size();
+    for (size_t i = 0; i + 1 < parts.size(); ++i)
+    {
+      const std::string &part = parts[i];
+      if (part.size() > suffix.size() &&
+          part.compare(part.size() - suffix.size(), suffix.size(),
+                       suffix) == 0)
+      {
+        engine = i;
+        parameters.engine = part.substr(0, part.size() - suffix.size());
+        break;
+      }
+    }
+
+    size_t next = 0;
+    if (next < engine && parts[next].compare(0, 8, "Chapter ") == 0)
+      parameters.chapter = parts[next++];
+    if (next < engine && engine < parts.size())
+      parameters.experiment = parts[next++];
+    for (; next < engine && engine < parts.size(); ++next)
+    {
+      if (!parameters.variant.empty())
+        parameters.variant += "/";
+      parameters.variant += parts[next];
+
+      // "1000N" or "10N Force"
+      char *end = nullptr;
+      const double force = std::strtod(parts[next].c_str(), &end);
+      if (end != parts[next].c_str() && *end == 'N' &&
+          (end[1] == '\0' || end[1] == ' '))
+      {
+        parameters.force = force;
+      }
+    }
+
+    // Step size directories, as "0.012820"
+    for (size_t i = engine + 1; i + 1 < parts.size(); ++i)
+    {
+      const double dt = Number(parts[i]);
+      if (std::isfinite(dt))
+        parameters.dt = dt;
+    }
+
+    // File names as "complex_test_bullet_0.012820.csv"
+    std::string stem = parts.back();
+    const size_t dot = stem.rfind('.');
+    if (dot != std::string::npos)
+      stem = stem.substr(0, dot);
+    const std::vector<std::string> tokens = Split(stem, '_');
+    for (const auto &token : tokens)
+    {
+      const std::string lower = Lower(token);
+      if (lower == "ode" || lower == "bullet" || lower == "simbody" ||
+          lower == "dart")
+      {
+        parameters.physics = lower;
+      }
+    }
+    if (std::isnan(parameters.dt) && tokens.size() > 1)
+    {
+      const double dt = Number(tokens.back());
+      if (std::isfinite(dt) && dt > 0.0 && dt < 1.0)
+        parameters.dt = dt;
+    }
+    return parameters;
+  }
+
+  // Read a results file into a catalog entry.
+  static void ReadEntry(const fs::path &_root, CatalogEntry &_entry)
+  {
+    Trace trace;
+    std::string error;
+    _entry.rows = 0;
+    _entry.columns.clear();
+    if (!ReadTrace((_root / _entry.path).string(), trace, error))
+      return;
+
+    _entry.rows = trace.time.size();
+    if (!trace.time.empty())
+    {
+      _entry.start = trace.time.front();
+      _entry.end = trace.time.back();
+    }
+    for (size_t c = 0; c < trace.names.size(); ++c)
+    {
+      ColumnStats stats;
+      stats.name = trace.names[c];
+      double sum = 0.0;
+      for (double value : trace.columns[c])
+      {
+        if (!std::isfinite(value))
+          continue;
+        if (stats.count == 0 || value < stats.min)
+          stats.min = value;
+        if (stats.count == 0 || value > stats.max)
+          stats.max = value;
+        sum += value;
+        ++stats.count;
+      }
+      if (stats.count > 0)
+        stats.mean = sum / stats.count;
+      _entry.columns.push_back(stats);
+    }
+  }
+
+  bool Catalog::Load(const std::string &_path, std::string &_error)
+  {
+    std::ifstream file(_path.c_str());
+    if (!file)
+    {
+      _error = "could not open " + _path;
+      return false;
+    }
+    std::string line;
+    if (!std::getline(file, line) || line != catalogHeader)
+    {
+      _error = _path + " is not a results catalog";
+      return false;
+    }
+
+    std::vector<CatalogEntry> loaded;
+    while (std::getline(file, line))
+    {
+      const std::vector<std::string> fields = Split(line, '\t');
+      if (fields.size() == 14 && fields[0] == "F")
+      {
+        CatalogEntry entry;
+        entry.path = fields[1];
+        entry.size = std::strtoull(fields[2].c_str(), nullptr, 10);
+        entry.modified = std::strtoll(fields[3].c_str(), nullptr, 10);
+        entry.parameters.chapter = fields[4];
+        entry.parameters.experiment = fields[5];
+        entry.parameters.variant = fields[6];
+        entry.parameters.engine = fields[7];
+        entry.parameters.physics = fields[8];
+        entry.parameters.dt = std::strtod(fields[9].c_str(), nullptr);
+        entry.parameters.force = std::strtod(fields[10].c_str(), nullptr);
+        entry.rows = std::strtoull(fields[11].c_str(), nullptr, 10);
+        entry.start = std::strtod(fields[12].c_str(), nullptr);
+        entry.end = std::strtod(fields[13].c_str(), nullptr);
+        loaded.push_back(entry);
+      }
+      else if (fields.size() == 6 && fields[0] == "C" && !loaded.empty())
+      {
+        ColumnStats stats;
+        stats.name = fields[1];
+        stats.count = std::strtoull(fields[2].c_str(), nullptr, 10);
+        stats.min = std::strtod(fields[3].c_str(), nullptr);
+        stats.max = std::strtod(fields[4].c_str(), nullptr);
+        stats.mean = std::strtod(fields[5].c_str(), nullptr);
+        loaded.back().columns.push_back(stats);
+      }
+      else if (!line.empty())
+      {
+        _error = _path + " has a malformed line: " + line;
+        return false;
+      }
+    }
+
+    std::sort(loaded.begin(), loaded.end(),
+              [](const CatalogEntry &_a, const CatalogEntry &_b)
+    {
+      return _a.path < _b.path;
+    });
+    this->entries.swap(loaded);
+    this->Index();
+    return true;
+  }
+
+  bool Catalog::Save(const std::string &_path, std::string &_error) const
+  {
+    // Written next to the catalog and renamed over it, so that an
+    // interrupted save leaves the previous catalog intact.
+    const std::string temporary = _path + ".tmp";
+    {
+      std::ofstream file(temporary.c_str());
+      file.precision(17);
+      file << catalogHeader << "\n";
+      for (const auto &entry : this->entries)
+      {
+        const RunParameters &p = entry.parameters;
+        file << "F\t" << entry.path << '\t' << entry.size << '\t'
+             << entry.modified << '\t' << p.chapter << '\t'
+             << p.experiment << '\t' << p.variant << '\t' << p.engine
+             << '\t' << p.physics << '\t' << p.dt << '\t' << p.force
+             << '\t' << entry.rows << '\t' << entry.start << '\t'
+             << entry.end << '\n';
+        for (const auto &column : entry.columns)
+        {
+          file << "C\t" << column.name << '\t' << column.count << '\t'
+               << column.min << '\t' << column.max << '\t' << column.mean
+               << '\n';
+        }
+      }
+      if (!file)
+      {
+        _error = "could not write " + temporary;
+        return false;
+      }
+    }
+    std::error_code code;
+    fs::rename(temporary, _path, code);
+    if (code)
+    {
+      _error = "could not replace " + _path + ": " + code.message();
+      return false;
+    }
+    return true;
+  }
+
+  size_t Catalog::Update(const std::string &_root, int _jobs)
+  {
+    const fs::path root(_root);
+    std::map<std::string, CatalogEntry> previous;
+    for (auto &entry : this->entries)
+      previous[entry.path] = std::move(entry);
+
+    // Only the sizes and times of the files are looked at here
+    std::vector<CatalogEntry> current;
+    std::vector<size_t> changed;
+    for (const auto &file : fs::recursive_directory_iterator(root))
+    {
+      if (!file.is_regular_file() || file.path().extension() != ".csv")
+        continue;
+      CatalogEntry entry;
+      entry.path = fs::relative(file.path(), root).generic_string();
+      entry.size = file.file_size();
+      entry.modified = static_cast<std::int64_t>(
+          file.last_write_time().time_since_epoch().count());
+
+      const auto known = previous.find(entry.path);
+      if (known != previous.end() && known->second.size == entry.size &&
+          known->second.modified == entry.modified)
+      {
+        current.push_back(std::move(known->second));
+        continue;
+      }
+      entry.parameters = DescribeResultsFile(entry.path);
+      changed.push_back(current.size());
+      current.push_back(entry);
+    }
+
+    // Largest first, so that no thread is left with a big file at the end
+    std::sort(changed.begin(), changed.end(), [&](size_t _a, size_t _b)
+    {
+      return current[_a].size > current[_b].size;
+    });
+    ParallelFor(changed.size(), _jobs, [&](size_t _i)
+    {
+      ReadEntry(root, current[changed[_i]]);
+    });
+
+    std::sort(current.begin(), current.end(),
+              [](const CatalogEntry &_a, const CatalogEntry &_b)
+    {
+      return _a.path < _b.path;
+    });
+    this->entries.swap(current);
+    this->Index();
+    return changed.size();
+  }
+
+  void Catalog::Index()
+  {
+    this->byChapter.clear();
+    this->byExperiment.clear();
+    this->byVariant.clear();
+    this->byEngine.clear();
+    this->byPhysics.clear();
+    this->byQuantity.clear();
+    this->byDt.clear();
+    for (size_t i = 0; i < this->entries.size(); ++i)
+    {
+      const CatalogEntry &entry = this->entries[i];
+      const RunParameters &p = entry.parameters;
+      this->byChapter[Lower(p.chapter)].push_back(i);
+      this->byExperiment[Lower(p.experiment)].push_back(i);
+      this->byVariant[Lower(p.variant)].push_back(i);
+      this->byEngine[Lower(p.engine)].push_back(i);
+      this->byPhysics[Lower(p.physics)].push_back(i);
+      for (const auto &column : entry.columns)
+      {
+        std::vector<size_t> &withColumn = this->byQuantity[Lower(column.name)];
+        if (withColumn.empty() || withColumn.back() != i)
+          withColumn.push_back(i);
+      }
+      if (std::isfinite(p.dt))
+        this->byDt.push_back(std::make_pair(p.dt, i));
+    }
+    std::sort(this->byDt.begin(), this->byDt.end());
+  }
+
+  bool Catalog::Matches(const CatalogEntry &_entry
+                      , const CatalogQuery &_query)
+  {
+    const RunParameters &p = _entry.parameters;
+    auto same = [](const std::string &_wanted, const std::string &_value)
+    {
+      return _wanted.empty() || Lower(_wanted) == Lower(_value);
+    };
+    if (!same(_query.chapter, p.chapter) ||
+        !same(_query.experiment, p.experiment) ||
+        !same(_query.variant, p.variant) ||
+        !same(_query.engine, p.engine) ||
+        !same(_query.physics, p.physics))
+    {
+      return false;
+    }
+    if (!_query.quantity.empty())
+    {
+      bool found = false;
+      for (const auto &column : _entry.columns)
+        found = found || same(_query.quantity, column.name);
+      if (!found)
+        return false;
+    }
+
+    // NaN fails every bound that is set
+    auto within = [](double _value, double _min, double _max)
+    {
+      if (std::isinf(_min) && std::isinf(_max))
+        return true;
+      return _value >= _min && _value <= _max;
+    };
+    return within(p.dt, _query.minDt, _query.maxDt) &&
+        within(p.force, _query.minForce, _query.maxForce);
+  }
+
+  std::vector<const CatalogEntry *> Catalog::Find(
+      const CatalogQuery &_query) const
+  {
+    // Candidates from the most selective lookup the query allows, every
+    // condition is checked on them afterwards.
+    const std::vector<size_t> *smallest = nullptr;
+    const std::vector<size_t> none;
+    auto lookup = [&](const std::map<std::string, std::vector<size_t>> &_map
+                    , const std::string &_key)
+    {
+      if (_key.empty())
+        return;
+      const auto it = _map.find(Lower(_key));
+      const std::vector<size_t> *found =
+          it == _map.end() ? &none : &it->second;
+      if (!smallest || found->size() < smallest->size())
+        smallest = found;
+    };
+    lookup(this->byChapter, _query.chapter);
+    lookup(this->byExperiment, _query.experiment);
+    lookup(this->byVariant, _query.variant);
+    lookup(this->byEngine, _query.engine);
+    lookup(this->byPhysics, _query.physics);
+    lookup(this->byQuantity, _query.quantity);
+
+    std::vector<size_t> candidates;
+    if (!std::isinf(_query.minDt) || !std::isinf(_query.maxDt))
+    {
+      const auto begin = std::lower_bound(this->byDt.begin(),
+          this->byDt.end(), std::make_pair(_query.minDt, size_t(0)));
+      auto end = begin;
+      while (end != this->byDt.end() && end->first <= _query.maxDt)
+        ++end;
+      if (!smallest || static_cast<size_t>(end - begin) < smallest->size())
+      {
+        for (auto it = begin; it != end; ++it)
+          candidates.push_back(it->second);
+        std::sort(candidates.begin(), candidates.end());
+        smallest = &candidates;
+      }
+    }
+
+    std::vector<const CatalogEntry *> found;
+    auto check = [&](size_t _i)
+    {
+      if (Matches(this->entries[_i], _query))
+        found.push_back(&this->entries[_i]);
+    };
+    if (smallest)
+    {
+      for (size_t i : *smallest)
+        check(i);
+    }
+    else
+    {
+      for (size_t i = 0; i < this->entries.size(); ++i)
+        check(i);
+    }
+    return found;
+  }
+
+  const std::vector<CatalogEntry> &Catalog::Entries() const
+  {
+    return this->entries;
+  }
+}
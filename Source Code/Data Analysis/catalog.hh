@@ -0,0 +1,166 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#ifndef ANALYSIS_CATALOG_HH_
+#define ANALYSIS_CATALOG_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace analysis
+{
+  // Summary of one column of a results file.
+  struct ColumnStats
+  {
+    std::string name;
+
+    // Samples that are numbers.
+    std::size_t count = 0;
+
+    double min = 0.0;
+    double max = 0.0;
+    double mean = 0.0;
+  };
+
+  // Run parameters of a results file, read from its path. NaN or empty
+  // when the path does not give them.
+  struct RunParameters
+  {
+    // Chapter of the report, as "Chapter 4".
+    std::string chapter;
+
+    // First directory below the chapter, as "Complex Scenario" or
+    // "Experiment  2 - Impulse Applied to a Cube".
+    std::string experiment;
+
+    // Directories between the experiment and the engine, as
+    // "Including Friction/1000N".
+    std::string variant;
+
+    // Engine of the "<Engine> Results" directory: Gazebo, Unreal or
+    // Theoretical.
+    std::string engine;
+
+    // Gazebo physics engine from the file name: ode, bullet or simbody.
+    std::string physics;
+
+    // Step size from a directory or the end of the file name, seconds.
+    double dt = std::numeric_limits<double>::quiet_NaN();
+
+    // Applied force from a variant such as "1000N" or "10N Force".
+    double force = std::numeric_limits<double>::quiet_NaN();
+  };
+
+  // Run parameters of a file from its path relative to the results
+  // directory, with / separators.
+  RunParameters DescribeResultsFile(const std::string &_path);
+
+  // One results file in the catalog.
+  struct CatalogEntry
+  {
+    // Path relative to the results directory, with / separators.
+    std::string path;
+
+    // File size and modification time when it was read, a file whose
+    // size or time changed is read again by an update.
+    std::uintmax_t size = 0;
+    std::int64_t modified = 0;
+
+    RunParameters parameters;
+
+    // Samples and their time range.
+    std::size_t rows = 0;
+    double start = 0.0;
+    double end = 0.0;
+
+    // Every column besides the time.
+    std::vector<ColumnStats> columns;
+  };
+
+  // Conditions on the entries to find, empty or infinite ones are not
+  // checked. Names are compared ignoring case.
+  struct CatalogQuery
+  {
+    std::string chapter;
+    std::string experiment;
+    std::string variant;
+    std::string engine;
+    std::string physics;
+
+    // Name of a column the file must have, as "Z Velocity".
+    std::string quantity;
+
+    double minDt = -std::numeric_limits<double>::infinity();
+    double maxDt = std::numeric_limits<double>::infinity();
+    double minForce = -std::numeric_limits<double>::infinity();
+    double maxForce = std::numeric_limits<double>::infinity();
+  };
+
+  // Index of the results files by run parameters. Update walks the
+  // results directory and only reads the files that changed since the
+  // last update, Save and Load keep the catalog between runs, and Find
+  // answers queries from the index alone.
+  class Catalog
+  {
+    // Read a catalog written by Save.
+    // Returns false and sets _error if it could not be read.
+    public: bool Load(const std::string &_path, std::string &_error);
+
+    // Write the catalog to a file.
+    // Returns false and sets _error if it could not be written.
+    public: bool Save(const std::string &_path, std::string &_error) const;
+
+    // Bring the catalog up to date with the csv files under a results
+    // directory: read new and changed files on _jobs threads and drop
+    // the ones that are gone.
+    // Returns the number of files read.
+    public: std::size_t Update(const std::string &_root, int _jobs);
+
+    // Entries matching a query, ordered by path.
+    public: std::vector<const CatalogEntry *> Find(
+        const CatalogQuery &_query) const;
+
+    // All entries, ordered by path.
+    public: const std::vector<CatalogEntry> &Entries() const;
+
+    // Rebuild the lookup tables from the entries.
+    private: void Index();
+
+    // Whether an entry satisfies every condition of a query.
+    private: static bool Matches(const CatalogEntry &_entry
+                               , const CatalogQuery &_query);
+
+    // Entries, ordered by path.
+    private: std::vector<CatalogEntry> entries;
+
+    // Entry indices by lower case name of every parameter, and by column.
+    private: std::map<std::string, std::vector<std::size_t>> byChapter;
+    private: std::map<std::string, std::vector<std::size_t>> byExperiment;
+    private: std::map<std::string, std::vector<std::size_t>> byVariant;
+    private: std::map<std::string, std::vector<std::size_t>> byEngine;
+    private: std::map<std::string, std::vector<std::size_t>> byPhysics;
+    private: std::map<std::string, std::vector<std::size_t>> byQuantity;
+
+    // Entries with a step size, ordered by it.
+    private: std::vector<std::pair<double, std::size_t>> byDt;
+  };
+}
+#endif
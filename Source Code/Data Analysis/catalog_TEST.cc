@@ -0,0 +1,140 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "catalog.hh"
+
+using namespace analysis;
+namespace fs = std::filesystem;
+
+// Write a csv file below a directory, creating its parents.
+static void WriteCsv(const fs::path &_root, const std::string &_path
+                   , const std::string &_contents)
+{
+  fs::create_directories((_root / _path).parent_path());
+  std::ofstream file((_root / _path).c_str());
+  file << _contents;
+}
+
+TEST(Catalog, DescribeResultsFile)
+{
+  RunParameters p = DescribeResultsFile("Chapter 3/Experiment  2 - Impulse"
+      " Applied to a Cube/Including Friction/1000N/Gazebo Results/1000N.csv");
+  EXPECT_EQ(p.chapter, "Chapter 3");
+  EXPECT_EQ(p.experiment, "Experiment  2 - Impulse Applied to a Cube");
+  EXPECT_EQ(p.variant, "Including Friction/1000N");
+  EXPECT_EQ(p.engine, "Gazebo");
+  EXPECT_TRUE(p.physics.empty());
+  EXPECT_DOUBLE_EQ(p.force, 1000.0);
+  EXPECT_TRUE(std::isnan(p.dt));
+
+  p = DescribeResultsFile("Chapter 3/Experiment  3 - Constant Force"
+      " applied to a Cube/10N Force/Unreal Results/Force 1.csv");
+  EXPECT_EQ(p.engine, "Unreal");
+  EXPECT_DOUBLE_EQ(p.force, 10.0);
+
+  p = DescribeResultsFile("Chapter 4/Complex Scenario/Gazebo Results/"
+      "0.012820/complex_test_bullet_0.012820.csv");
+  EXPECT_EQ(p.experiment, "Complex Scenario");
+  EXPECT_TRUE(p.variant.empty());
+  EXPECT_EQ(p.physics, "bullet");
+  EXPECT_DOUBLE_EQ(p.dt, 0.01282);
+  EXPECT_TRUE(std::isnan(p.force));
+}
+
+TEST(Catalog, UpdateSaveAndFind)
+{
+  const fs::path root = fs::temp_directory_path() / "catalog_test";
+  fs::remove_all(root);
+  const std::string header = "Time,X Velocity,Energy\n";
+  for (const char *physics : {"ode", "bullet"})
+  {
+    for (const char *dt : {"0.012820", "0.032820"})
+    {
+      WriteCsv(root, std::string("Chapter 4/Complex Scenario/Gazebo Results/")
+          + dt + "/complex_test_" + physics + "_" + dt + ".csv",
+          header + "0.1,1.0,5.0\n0.2,3.0,4.0\n");
+    }
+  }
+  WriteCsv(root, "Chapter 4/Complex Scenario/Unreal Results/0.012820/"
+      "Benchmark_01_ExperimentalCube0.csv", "Time,Z Velocity\n0.1,2.0\n");
+
+  Catalog catalog;
+  EXPECT_EQ(catalog.Update(root.string(), 2), 5u);
+  ASSERT_EQ(catalog.Entries().size(), 5u);
+
+  CatalogQuery query;
+  query.experiment = "complex scenario";
+  query.physics = "ODE";
+  query.maxDt = 0.03;
+  auto found = catalog.Find(query);
+  ASSERT_EQ(found.size(), 1u);
+  EXPECT_EQ(found[0]->path, "Chapter 4/Complex Scenario/Gazebo Results/"
+      "0.012820/complex_test_ode_0.012820.csv");
+  EXPECT_EQ(found[0]->rows, 2u);
+  ASSERT_EQ(found[0]->columns.size(), 2u);
+  EXPECT_EQ(found[0]->columns[0].name, "X Velocity");
+  EXPECT_DOUBLE_EQ(found[0]->columns[0].min, 1.0);
+  EXPECT_DOUBLE_EQ(found[0]->columns[0].max, 3.0);
+  EXPECT_DOUBLE_EQ(found[0]->columns[0].mean, 2.0);
+
+  query = CatalogQuery();
+  query.quantity = "z velocity";
+  found = catalog.Find(query);
+  ASSERT_EQ(found.size(), 1u);
+  EXPECT_EQ(found[0]->parameters.engine, "Unreal");
+
+  query = CatalogQuery();
+  query.minDt = 0.02;
+  EXPECT_EQ(catalog.Find(query).size(), 2u);
+
+  // Saved and loaded, then only the changed and new files are read again
+  const std::string path = (root / "catalog.txt").string();
+  std::string error;
+  ASSERT_TRUE(catalog.Save(path, error)) << error;
+  Catalog loaded;
+  ASSERT_TRUE(loaded.Load(path, error)) << error;
+  ASSERT_EQ(loaded.Entries().size(), 5u);
+  EXPECT_DOUBLE_EQ(loaded.Entries()[0].parameters.dt,
+                   catalog.Entries()[0].parameters.dt);
+  EXPECT_EQ(loaded.Entries()[0].columns.size(),
+            catalog.Entries()[0].columns.size());
+  EXPECT_EQ(loaded.Update(root.string(), 2), 0u);
+
+  WriteCsv(root, "Chapter 4/Complex Scenario/Gazebo Results/0.012820/"
+      "complex_test_ode_0.012820.csv", header + "0.1,1.0,5.0\n");
+  WriteCsv(root, "Chapter 4/Complex Scenario/Gazebo Results/0.012820/"
+      "complex_test_simbody_0.012820.csv", header + "0.1,1.0,5.0\n");
+  fs::remove(root / "Chapter 4/Complex Scenario/Unreal Results/0.012820/"
+      "Benchmark_01_ExperimentalCube0.csv");
+  EXPECT_EQ(loaded.Update(root.string(), 2), 2u);
+  EXPECT_EQ(loaded.Entries().size(), 5u);
+  query = CatalogQuery();
+  query.physics = "ode";
+  query.maxDt = 0.03;
+  found = loaded.Find(query);
+  ASSERT_EQ(found.size(), 1u);
+  EXPECT_EQ(found[0]->rows, 1u);
+  query.quantity = "Z Velocity";
+  EXPECT_TRUE(loaded.Find(query).empty());
+
+  fs::remove_all(root);
+}
@@ -0,0 +1,155 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+// Writes a column cache next to every csv file given, or found below the
+// directories given, whose cache is missing or older than the csv:
+//   csv_cache "Results/Raw Data" "Source Code/Chapter 4/Gazebo Code/test_results"
+// makeCsvDictOfArrays in csv_dictionary.py loads a fresh cache instead of
+// parsing the csv. Files are converted in parallel, one per thread.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "csv_table.hh"
+#include "parallel.hh"
+
+namespace fs = std::filesystem;
+
+static void Usage()
+{
+  std::cerr << "Usage: csv_cache <csv file or directory>... [options]\n"
+            << "  --force               rewrite caches that are up to date\n"
+            << "  --jobs N              threads\n";
+}
+
+// A csv file to convert.
+struct Source
+{
+  std::string path;
+  std::uint64_t size = 0;
+  std::int64_t modified = 0;
+};
+
+int main(int argc, char **argv)
+{
+  std::vector<std::string> inputs;
+  bool force = false;
+  int jobs = analysis::DefaultJobs();
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string argument = argv[i];
+    if (argument == "--force")
+      force = true;
+    else if (argument == "--jobs" && i + 1 < argc)
+      jobs = std::max(1, std::atoi(argv[++i]));
+    else if (argument[0] == '-')
+    {
+      Usage();
+      return 1;
+    }
+    else
+      inputs.push_back(argument);
+  }
+  if (inputs.empty())
+  {
+    Usage();
+    return 1;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<Source> sources;
+  try
+  {
+    for (const auto &input : inputs)
+    {
+      if (!fs::is_directory(input))
+      {
+        sources.push_back(Source{input});
+        continue;
+      }
+      for (const auto &entry : fs::recursive_directory_iterator(input))
+      {
+        if (entry.is_regular_file() && entry.path().extension() == ".csv")
+          sources.push_back(Source{entry.path().string()});
+      }
+    }
+  }
+  catch (const fs::filesystem_error &_e)
+  {
+    std::cerr << _e.what() << std::endl;
+    return 1;
+  }
+
+  // Only the stale ones, largest first
+  std::vector<Source> stale;
+  for (auto &source : sources)
+  {
+    if (!analysis::SourceStamp(source.path, source.size, source.modified))
+    {
+      std::cerr << "could not open " << source.path << std::endl;
+      continue;
+    }
+    std::uint64_t size;
+    std::int64_t modified;
+    if (!force &&
+        analysis::ColumnCacheStamp(analysis::ColumnCachePath(source.path),
+                                   size, modified) &&
+        size == source.size && modified == source.modified)
+    {
+      continue;
+    }
+    stale.push_back(source);
+  }
+  std::sort(stale.begin(), stale.end(),
+            [](const Source &_a, const Source &_b)
+  {
+    return _a.size > _b.size;
+  });
+
+  std::vector<std::string> errors(stale.size());
+  analysis::ParallelFor(stale.size(), jobs, [&](size_t _i)
+  {
+    analysis::Table table;
+    if (!analysis::ReadCsvTable(stale[_i].path, table, errors[_i]))
+      return;
+    analysis::WriteColumnCache(analysis::ColumnCachePath(stale[_i].path),
+        table, stale[_i].size, stale[_i].modified, errors[_i]);
+  });
+
+  std::uint64_t bytes = 0;
+  size_t failed = 0;
+  for (size_t i = 0; i < stale.size(); ++i)
+  {
+    bytes += stale[i].size;
+    if (!errors[i].empty())
+    {
+      std::cerr << errors[i] << std::endl;
+      ++failed;
+    }
+  }
+  const double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  std::cout << stale.size() - failed << " of " << sources.size()
+            << " csv files cached (" << bytes / 1e6 << " MB) in " << seconds
+            << " s, " << sources.size() - stale.size() << " up to date"
+            << std::endl;
+  return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,538 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#include "csv_table.hh"
+
+#include <sys/stat.h>
+
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ANALYSIS_SSE2 1
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace analysis
+{
+  // Identifies a column cache, followed by the format version.
+  static const char cacheMagic[4] = {'R', 'V', 'C', 'C'};
+  static const std::uint32_t cacheVersion = 1;
+
+  // Column types of a cache.
+  static const std::uint32_t cacheNumeric = 0;
+  static const std::uint32_t cacheString = 1;
+
+  // Index of the lowest set bit.
+  static inline unsigned LowestBit(unsigned _mask)
+  {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, _mask);
+    return index;
+#else
+    return __builtin_ctz(_mask);
+#endif
+  }
+
+  // Positions of every comma and line feed of a buffer that has no
+  // quotes. SSE2 compares 16 bytes at once and the bits of the matches
+  // are walked, there are few delimiters per block of digits.
+  static void FindDelimiters(const char *_data, std::size_t _size
+                           , std::vector<std::size_t> &_positions)
+  {
+    std::size_t i = 0;
+#ifdef ANALYSIS_SSE2
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i lineFeed = _mm_set1_epi8('\n');
+    for (; i + 16 <= _size; i += 16)
+    {
+      const __m128i chunk =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(_data + i));
+      unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+          _mm_or_si128(_mm_cmpeq_epi8(chunk, comma),
+                       _mm_cmpeq_epi8(chunk, lineFeed))));
+      while (mask)
+      {
+        _positions.push_back(i + LowestBit(mask));
+        mask &= mask - 1;
+      }
+    }
+#endif
+    for (; i < _size; ++i)
+    {
+      if (_data[i] == ',' || _data[i] == '\n')
+        _positions.push_back(i);
+    }
+  }
+
+  // The same for a buffer with quotes, skipping the delimiters between
+  // them. Only the few files written by hand need this.
+  static void FindQuotedDelimiters(const char *_data, std::size_t _size
+                                 , std::vector<std::size_t> &_positions)
+  {
+    bool quoted = false;
+    for (std::size_t i = 0; i < _size; ++i)
+    {
+      if (_data[i] == '"')
+        quoted = !quoted;
+      else if (!quoted && (_data[i] == ',' || _data[i] == '\n'))
+        _positions.push_back(i);
+    }
+  }
+
+  // A field without surrounding spaces, carriage return and quotes.
+  static void TrimField(const char *&_begin, const char *&_end)
+  {
+    while (_begin < _end && (*_begin == ' ' || *_begin == '\t'))
+      ++_begin;
+    while (_end > _begin &&
+           (_end[-1] == ' ' || _end[-1] == '\t' || _end[-1] == '\r'))
+    {
+      --_end;
+    }
+    if (_end - _begin >= 2 && *_begin == '"' && _end[-1] == '"')
+    {
+      ++_begin;
+      --_end;
+    }
+  }
+
+  // Parse a trimmed field as a number. Empty fields are NaN.
+  // Returns false if the field is not a number.
+  static bool ParseNumber(const char *_begin, const char *_end
+                        , double &_value)
+  {
+    if (_begin == _end)
+    {
+      _value = std::numeric_limits<double>::quiet_NaN();
+      return true;
+    }
+    if (*_begin == '+')
+      ++_begin;
+    const auto result = std::from_chars(_begin, _end, _value);
+    return result.ec == std::errc() && result.ptr == _end;
+  }
+
+  static std::string FieldString(const char *_begin, const char *_end)
+  {
+    std::string s(_begin, _end);
+    // Doubled quotes inside a quoted field
+    for (std::size_t i = s.find("\"\""); i != std::string::npos;
+         i = s.find("\"\"", i + 1))
+    {
+      s.erase(i, 1);
+    }
+    return s;
+  }
+
+  bool ParseCsvTable(const std::string &_text, Table &_table
+                   , std::string &_error)
+  {
+    _table = Table();
+    const char *data = _text.data();
+    const std::size_t size = _text.size();
+
+    std::vector<std::size_t> delimiters;
+    delimiters.reserve(size / 8);
+    if (std::memchr(data, '"', size))
+      FindQuotedDelimiters(data, size, delimiters);
+    else
+      FindDelimiters(data, size, delimiters);
+    // A last line without a line feed ends at the end of the text
+    if (delimiters.empty() || delimiters.back() != size - 1 ||
+        data[size - 1] != '\n')
+    {
+      delimiters.push_back(size);
+    }
+
+    // Field bounds of every row: begin of the row, then the delimiter
+    // after each field.
+    std::size_t d = 0;
+    std::size_t rowBegin = 0;
+    std::vector<std::size_t> ends;
+    auto nextRow = [&]() -> bool
+    {
+      ends.clear();
+      while (d < delimiters.size())
+      {
+        const std::size_t position = delimiters[d++];
+        ends.push_back(position);
+        if (position == size || data[position] == '\n')
+          return true;
+      }
+      return false;
+    };
+    auto field = [&](std::size_t _i, const char *&_begin, const char *&_end)
+    {
+      _begin = data + (_i == 0 ? rowBegin : ends[_i - 1] + 1);
+      _end = data + ends[_i];
+      TrimField(_begin, _end);
+    };
+
+    if (!nextRow())
+    {
+      _error = "no header";
+      return false;
+    }
+    for (std::size_t i = 0; i < ends.size(); ++i)
+    {
+      const char *begin, *end;
+      field(i, begin, end);
+      TableColumn column;
+      column.name.assign(begin, end);
+      _table.columns.push_back(column);
+    }
+    while (!_table.columns.empty() && _table.columns.back().name.empty())
+      _table.columns.pop_back();
+    if (_table.columns.empty())
+    {
+      _error = "no header";
+      return false;
+    }
+
+    // Numbers are parsed as they come, a column turns into strings at its
+    // first field that is not a number and is read again as strings.
+    const std::size_t columnCount = _table.columns.size();
+    const std::size_t dataBegin = ends.back() + 1;
+    std::vector<bool> toStrings(columnCount, false);
+    rowBegin = dataBegin;
+    while (rowBegin < size && nextRow())
+    {
+      // Blank lines
+      const char *begin, *end;
+      field(0, begin, end);
+      if (ends.size() == 1 && begin == end)
+      {
+        rowBegin = ends.back() + 1;
+        continue;
+      }
+      for (std::size_t c = 0; c < columnCount; ++c)
+      {
+        double value = std::numeric_limits<double>::quiet_NaN();
+        if (c < ends.size())
+        {
+          field(c, begin, end);
+          if (!toStrings[c] && !ParseNumber(begin, end, value))
+            toStrings[c] = true;
+        }
+        _table.columns[c].values.push_back(value);
+      }
+      ++_table.rows;
+      rowBegin = ends.back() + 1;
+    }
+
+    bool anyStrings = false;
+    for (std::size_t c = 0; c < columnCount; ++c)
+    {
+      if (!toStrings[c])
+        continue;
+      anyStrings = true;
+      _table.columns[c].numeric = false;
+      _table.columns[c].values.clear();
+      _table.columns[c].values.shrink_to_fit();
+      _table.columns[c].strings.reserve(_table.rows);
+    }
+    if (!anyStrings)
+      return true;
+
+    d = 0;
+    nextRow();
+    rowBegin = dataBegin;
+    while (rowBegin < size && nextRow())
+    {
+      const char *begin, *end;
+      field(0, begin, end);
+      if (ends.size() == 1 && begin == end)
+      {
+        rowBegin = ends.back() + 1;
+        continue;
+      }
+      for (std::size_t c = 0; c < columnCount; ++c)
+      {
+        if (!toStrings[c])
+          continue;
+        if (c < ends.size())
+        {
+          field(c, begin, end);
+          _table.columns[c].strings.push_back(FieldString(begin, end));
+        }
+        else
+          _table.columns[c].strings.push_back("");
+      }
+      rowBegin = ends.back() + 1;
+    }
+    return true;
+  }
+
+  bool ReadCsvTable(const std::string &_path, Table &_table
+                  , std::string &_error)
+  {
+    std::ifstream file(_path.c_str(), std::ios::binary);
+    if (!file)
+    {
+      _error = "could not open " + _path;
+      return false;
+    }
+    const std::string text((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+    if (!ParseCsvTable(text, _table, _error))
+    {
+      _error = _path + ": " + _error;
+      return false;
+    }
+    return true;
+  }
+
+  bool SourceStamp(const std::string &_path, std::uint64_t &_size
+                 , std::int64_t &_modified)
+  {
+    struct stat info;
+    if (stat(_path.c_str(), &info) != 0)
+      return false;
+    _size = static_cast<std::uint64_t>(info.st_size);
+    _modified = static_cast<std::int64_t>(info.st_mtime);
+    return true;
+  }
+
+  std::string ColumnCachePath(const std::string &_csvPath)
+  {
+    return _csvPath + ".col";
+  }
+
+  // Fixed part of the cache header.
+  struct CacheHeader
+  {
+    char magic[4];
+    std::uint32_t version;
+    std::uint64_t sourceSize;
+    std::int64_t sourceModified;
+    std::uint64_t rows;
+    std::uint32_t columns;
+    std::uint32_t reserved;
+  };
+
+  // Header of one column, followed by its name.
+  struct CacheColumn
+  {
+    std::uint32_t type;
+    std::uint32_t nameLength;
+    std::uint64_t offset;
+    std::uint64_t length;
+  };
+
+  static std::uint64_t Align8(std::uint64_t _offset)
+  {
+    return (_offset + 7) & ~std::uint64_t(7);
+  }
+
+  bool WriteColumnCache(const std::string &_path, const Table &_table
+                      , std::uint64_t _sourceSize
+                      , std::int64_t _sourceModified
+                      , std::string &_error)
+  {
+    CacheHeader header;
+    std::memcpy(header.magic, cacheMagic, sizeof(header.magic));
+    header.version = cacheVersion;
+    header.sourceSize = _sourceSize;
+    header.sourceModified = _sourceModified;
+    header.rows = _table.rows;
+    header.columns = static_cast<std::uint32_t>(_table.columns.size());
+    header.reserved = 0;
+
+    // Data follows the headers, every column 8 byte aligned so that
+    // numpy maps the doubles without a copy.
+    std::vector<CacheColumn> columns(_table.columns.size());
+    std::uint64_t offset = sizeof(header);
+    for (const auto &column : _table.columns)
+      offset += sizeof(CacheColumn) + column.name.size();
+    for (std::size_t c = 0; c < _table.columns.size(); ++c)
+    {
+      const TableColumn &column = _table.columns[c];
+      offset = Align8(offset);
+      columns[c].type = column.numeric ? cacheNumeric : cacheString;
+      columns[c].nameLength = static_cast<std::uint32_t>(column.name.size());
+      columns[c].offset = offset;
+      if (column.numeric)
+        columns[c].length = _table.rows * sizeof(double);
+      else
+      {
+        std::uint64_t text = 0;
+        for (const auto &s : column.strings)
+          text += s.size();
+        columns[c].length = (_table.rows + 1) * sizeof(std::uint64_t) + text;
+      }
+      offset += columns[c].length;
+    }
+
+    // Written next to the cache and renamed over it, so that a reader
+    // never sees half a cache.
+    const std::string temporary = _path + ".tmp";
+    {
+      std::ofstream file(temporary.c_str(), std::ios::binary);
+      file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+      for (std::size_t c = 0; c < columns.size(); ++c)
+      {
+        file.write(reinterpret_cast<const char *>(&columns[c]),
+                   sizeof(CacheColumn));
+        file.write(_table.columns[c].name.data(),
+                   _table.columns[c].name.size());
+      }
+      const char zeros[8] = {0};
+      for (std::size_t c = 0; c < columns.size(); ++c)
+      {
+        const TableColumn &column = _table.columns[c];
+        file.write(zeros, columns[c].offset - file.tellp());
+        if (column.numeric)
+        {
+          file.write(reinterpret_cast<const char *>(column.values.data()),
+                     columns[c].length);
+          continue;
+        }
+        std::vector<std::uint64_t> starts(_table.rows + 1, 0);
+        for (std::size_t r = 0; r < _table.rows; ++r)
+          starts[r + 1] = starts[r] + column.strings[r].size();
+        file.write(reinterpret_cast<const char *>(starts.data()),
+                   starts.size() * sizeof(std::uint64_t));
+        for (const auto &s : column.strings)
+          file.write(s.data(), s.size());
+      }
+      if (!file)
+      {
+        _error = "could not write " + temporary;
+        return false;
+      }
+    }
+    std::remove(_path.c_str());
+    if (std::rename(temporary.c_str(), _path.c_str()) != 0)
+    {
+      _error = "could not replace " + _path;
+      return false;
+    }
+    return true;
+  }
+
+  bool ColumnCacheStamp(const std::string &_path
+                      , std::uint64_t &_sourceSize
+                      , std::int64_t &_sourceModified)
+  {
+    std::ifstream file(_path.c_str(), std::ios::binary);
+    CacheHeader header;
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, cacheMagic, sizeof(header.magic)) != 0 ||
+        header.version != cacheVersion)
+    {
+      return false;
+    }
+    _sourceSize = header.sourceSize;
+    _sourceModified = header.sourceModified;
+    return true;
+  }
+
+  bool ReadColumnCache(const std::string &_path, Table &_table
+                     , std::uint64_t &_sourceSize
+                     , std::int64_t &_sourceModified
+                     , std::string &_error)
+  {
+    std::ifstream file(_path.c_str(), std::ios::binary);
+    if (!file)
+    {
+      _error = "could not open " + _path;
+      return false;
+    }
+    const std::string data((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+    CacheHeader header;
+    if (data.size() < sizeof(header))
+    {
+      _error = _path + " is not a column cache";
+      return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, cacheMagic, sizeof(header.magic)) != 0 ||
+        header.version != cacheVersion)
+    {
+      _error = _path + " is not a column cache of this version";
+      return false;
+    }
+    _sourceSize = header.sourceSize;
+    _sourceModified = header.sourceModified;
+
+    _table = Table();
+    _table.rows = header.rows;
+    std::size_t position = sizeof(header);
+    for (std::uint32_t c = 0; c < header.columns; ++c)
+    {
+      CacheColumn column;
+      if (position + sizeof(column) > data.size())
+        break;
+      std::memcpy(&column, data.data() + position, sizeof(column));
+      position += sizeof(column);
+      const std::uint64_t stringsLength =
+          (header.rows + 1) * sizeof(std::uint64_t);
+      if (position + column.nameLength > data.size() ||
+          column.offset + column.length > data.size() ||
+          (column.type == cacheNumeric &&
+           column.length != header.rows * sizeof(double)) ||
+          (column.type == cacheString && column.length < stringsLength))
+      {
+        break;
+      }
+
+      TableColumn tableColumn;
+      tableColumn.name = data.substr(position, column.nameLength);
+      position += column.nameLength;
+      tableColumn.numeric = column.type == cacheNumeric;
+      if (tableColumn.numeric)
+      {
+        tableColumn.values.resize(header.rows);
+        std::memcpy(tableColumn.values.data(), data.data() + column.offset,
+                    column.length);
+      }
+      else
+      {
+        std::vector<std::uint64_t> starts(header.rows + 1);
+        std::memcpy(starts.data(), data.data() + column.offset,
+                    stringsLength);
+        const std::size_t text = column.offset + stringsLength;
+        bool increasing = starts.front() == 0;
+        for (std::size_t r = 0; r < header.rows; ++r)
+          increasing = increasing && starts[r] <= starts[r + 1];
+        if (!increasing || starts.back() != column.length - stringsLength)
+          break;
+        for (std::size_t r = 0; r < header.rows; ++r)
+        {
+          tableColumn.strings.push_back(
+              data.substr(text + starts[r], starts[r + 1] - starts[r]));
+        }
+      }
+      _table.columns.push_back(tableColumn);
+    }
+    if (_table.columns.size() != header.columns)
+    {
+      _error = _path + " is truncated";
+      return false;
+    }
+    return true;
+  }
+}
@@ -0,0 +1,91 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#ifndef ANALYSIS_CSV_TABLE_HH_
+#define ANALYSIS_CSV_TABLE_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace analysis
+{
+  // One column of a csv file. A column is numeric when every field of it
+  // is a number or empty, empty fields being NaN, and holds strings
+  // otherwise, as the engine and status columns of the boxes results.
+  struct TableColumn
+  {
+    std::string name;
+    bool numeric = true;
+    std::vector<double> values;
+    std::vector<std::string> strings;
+  };
+
+  // A csv file as typed columns.
+  struct Table
+  {
+    std::size_t rows = 0;
+    std::vector<TableColumn> columns;
+  };
+
+  // Read a csv file with a header line. Names are trimmed of spaces and
+  // quotes, the empty column of a trailing comma is dropped, and missing
+  // fields of a short row are empty. Quoted fields may hold commas.
+  // Returns false and sets _error if the file could not be read.
+  bool ReadCsvTable(const std::string &_path, Table &_table
+                  , std::string &_error);
+
+  // Parse the csv text of a whole file, as ReadCsvTable.
+  bool ParseCsvTable(const std::string &_text, Table &_table
+                   , std::string &_error);
+
+  // Size and modification time of a file, in seconds since 1970 as
+  // os.stat reports it in Python.
+  // Returns false if the file does not exist.
+  bool SourceStamp(const std::string &_path, std::uint64_t &_size
+                 , std::int64_t &_modified);
+
+  // Path of the column cache of a csv file, next to it.
+  std::string ColumnCachePath(const std::string &_csvPath);
+
+  // Write a table as a column cache: a header of the column names, types
+  // and data offsets, then every numeric column as contiguous little
+  // endian doubles and every string column as row offsets and text.
+  // column_cache.py in Chapter 4 reads it into numpy arrays directly.
+  // The size and time of the source csv are stored so that a stale cache
+  // is recognized.
+  // Returns false and sets _error if it could not be written.
+  bool WriteColumnCache(const std::string &_path, const Table &_table
+                      , std::uint64_t _sourceSize
+                      , std::int64_t _sourceModified
+                      , std::string &_error);
+
+  // Size and modification time of the csv file a column cache was
+  // written from, read from the cache header alone.
+  // Returns false if there is no column cache at the path.
+  bool ColumnCacheStamp(const std::string &_path
+                      , std::uint64_t &_sourceSize
+                      , std::int64_t &_sourceModified);
+
+  // Read a column cache written by WriteColumnCache.
+  // Returns false and sets _error if it could not be read.
+  bool ReadColumnCache(const std::string &_path, Table &_table
+                     , std::uint64_t &_sourceSize
+                     , std::int64_t &_sourceModified
+                     , std::string &_error);
+}
+#endif
@@ -0,0 +1,120 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "csv_table.hh"
+#include "gtest/gtest.h"
+
+using namespace analysis;
+
+// Path of a file in the temporary directory.
+static std::string TempPath(const std::string &_name)
+{
+  return (std::filesystem::temp_directory_path() / _name).string();
+}
+
+TEST(CsvTable, Parse)
+{
+  // Typed columns as in the boxes results, with the padding and the
+  // trailing comma of the Gazebo exports, a short row, a quoted field
+  // holding a comma and no newline at the end.
+  Table table;
+  std::string error;
+  ASSERT_TRUE(ParseCsvTable(
+      " sim_time, \"engine\" ,status,\r\n"
+      "0.5,ode,run,\r\n"
+      "1,\"bullet, 2\",\n"
+      "+2.25,simbody,fail", table, error)) << error;
+  EXPECT_EQ(table.rows, 3u);
+  ASSERT_EQ(table.columns.size(), 3u);
+  EXPECT_EQ(table.columns[0].name, "sim_time");
+  EXPECT_EQ(table.columns[1].name, "engine");
+  EXPECT_TRUE(table.columns[0].numeric);
+  ASSERT_EQ(table.columns[0].values.size(), 3u);
+  EXPECT_DOUBLE_EQ(table.columns[0].values[0], 0.5);
+  EXPECT_DOUBLE_EQ(table.columns[0].values[2], 2.25);
+  EXPECT_FALSE(table.columns[1].numeric);
+  ASSERT_EQ(table.columns[1].strings.size(), 3u);
+  EXPECT_EQ(table.columns[1].strings[1], "bullet, 2");
+  EXPECT_EQ(table.columns[2].strings[1], "");
+  EXPECT_EQ(table.columns[2].strings[2], "fail");
+}
+
+TEST(CsvTable, LongRows)
+{
+  // More than one block of the delimiter scan per field and per row, and
+  // empty fields, which are NaN in a numeric column.
+  std::string text = "a,b\n";
+  const std::string longNumber = "1.00000000000000000000000000000000000";
+  for (int i = 0; i < 100; ++i)
+    text += longNumber + "," + (i % 10 == 0 ? "" : std::to_string(i)) + "\n";
+  Table table;
+  std::string error;
+  ASSERT_TRUE(ParseCsvTable(text, table, error)) << error;
+  EXPECT_EQ(table.rows, 100u);
+  ASSERT_EQ(table.columns.size(), 2u);
+  EXPECT_TRUE(table.columns[1].numeric);
+  EXPECT_DOUBLE_EQ(table.columns[0].values[99], 1.0);
+  EXPECT_TRUE(std::isnan(table.columns[1].values[0]));
+  EXPECT_DOUBLE_EQ(table.columns[1].values[99], 99.0);
+}
+
+TEST(CsvTable, Missing)
+{
+  Table table;
+  std::string error;
+  EXPECT_FALSE(ReadCsvTable("/nonexistent/missing.csv", table, error));
+  EXPECT_FALSE(error.empty());
+}
+
+TEST(CsvTable, ColumnCache)
+{
+  Table table;
+  std::string error;
+  ASSERT_TRUE(ParseCsvTable("t,engine,x\n0,ode,1.5\n0.1,,\n", table, error));
+
+  const std::string path = TempPath("csv_table_cache.col");
+  ASSERT_TRUE(WriteColumnCache(path, table, 1234, 1600000000, error))
+      << error;
+  std::uint64_t size = 0;
+  std::int64_t modified = 0;
+  ASSERT_TRUE(ColumnCacheStamp(path, size, modified));
+  EXPECT_EQ(size, 1234u);
+  EXPECT_EQ(modified, 1600000000);
+
+  Table read;
+  ASSERT_TRUE(ReadColumnCache(path, read, size, modified, error)) << error;
+  EXPECT_EQ(read.rows, 2u);
+  ASSERT_EQ(read.columns.size(), 3u);
+  EXPECT_EQ(read.columns[1].name, "engine");
+  EXPECT_FALSE(read.columns[1].numeric);
+  EXPECT_EQ(read.columns[1].strings[0], "ode");
+  EXPECT_EQ(read.columns[1].strings[1], "");
+  EXPECT_TRUE(read.columns[2].numeric);
+  EXPECT_DOUBLE_EQ(read.columns[2].values[0], 1.5);
+  EXPECT_TRUE(std::isnan(read.columns[2].values[1]));
+
+  // A truncated cache is rejected
+  std::filesystem::resize_file(path, 60);
+  EXPECT_FALSE(ReadColumnCache(path, read, size, modified, error));
+  std::remove(path.c_str());
+  EXPECT_FALSE(ColumnCacheStamp(path, size, modified));
+}
@@ -0,0 +1,54 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#ifndef ANALYSIS_PARALLEL_HH_
+#define ANALYSIS_PARALLEL_HH_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace analysis
+{
+  // Run _f(i) for every i below _count on _jobs threads. Indices are
+  // handed out in order, so put the longest work first.
+  template <typename F>
+  void ParallelFor(std::size_t _count, int _jobs, F _f)
+  {
+    std::atomic<std::size_t> next(0);
+    std::vector<std::thread> threads;
+    const std::size_t threadCount = std::min<std::size_t>(_jobs, _count);
+    for (std::size_t j = 0; j < threadCount; ++j)
+    {
+      threads.emplace_back([&]()
+      {
+        for (std::size_t i = next++; i < _count; i = next++)
+          _f(i);
+      });
+    }
+    for (auto &thread : threads)
+      thread.join();
+  }
+
+  // Threads to use when not told otherwise, one per core.
+  inline int DefaultJobs()
+  {
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+}
+#endif
@@ -0,0 +1,279 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#include "reference.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace analysis
+{
+  static const double infinity = std::numeric_limits<double>::infinity();
+
+  // Smallest root above _after of _a2 t^2 + _a1 t + _a0, infinity if
+  // there is none.
+  static double FirstRoot(double _a2, double _a1, double _a0
+                        , double _after = 0.0)
+  {
+    double roots[2] = {infinity, infinity};
+    if (_a2 == 0.0)
+    {
+      if (_a1 != 0.0)
+        roots[0] = -_a0 / _a1;
+    }
+    else
+    {
+      const double discriminant = _a1 * _a1 - 4.0 * _a2 * _a0;
+      if (discriminant < 0.0)
+        return infinity;
+      // Without the cancellation of the textbook formula
+      const double q = -0.5 * (_a1 + std::copysign(std::sqrt(discriminant),
+                                                   _a1));
+      roots[0] = q / _a2;
+      if (q != 0.0)
+        roots[1] = _a0 / q;
+    }
+    double first = infinity;
+    for (double root : roots)
+    {
+      if (root > _after && root < first)
+        first = root;
+    }
+    return first;
+  }
+
+  // State of a piece some time after its start.
+  static void Advance(const MotionPiece &_piece, double _dt
+                    , double &_position, double &_velocity)
+  {
+    _position = _piece.position + _dt * (_piece.velocity +
+        _dt * (_piece.acceleration / 2.0 + _dt * _piece.jerk / 6.0));
+    _velocity = _piece.velocity +
+        _dt * (_piece.acceleration + _dt * _piece.jerk / 2.0);
+  }
+
+  Motion::Motion(const std::vector<MotionPiece> &_pieces)
+    : pieces(_pieces)
+  {
+  }
+
+  void Motion::Evaluate(const std::vector<double> &_times
+                      , std::vector<double> &_positions
+                      , std::vector<double> &_velocities) const
+  {
+    _positions.resize(_times.size());
+    _velocities.resize(_times.size());
+    if (this->pieces.empty())
+    {
+      std::fill(_positions.begin(), _positions.end(), 0.0);
+      std::fill(_velocities.begin(), _velocities.end(), 0.0);
+      return;
+    }
+
+    auto later = [](double _time, const MotionPiece &_piece)
+    {
+      return _time < _piece.start;
+    };
+    size_t i = 0;
+    for (size_t k = 0; k < _times.size(); ++k)
+    {
+      const double t = _times[k];
+      if (t < this->pieces[i].start && i > 0)
+      {
+        const auto next = std::upper_bound(this->pieces.begin(),
+            this->pieces.end(), t, later);
+        i = next == this->pieces.begin() ? 0 : next - this->pieces.begin() - 1;
+      }
+      while (i + 1 < this->pieces.size() && this->pieces[i + 1].start <= t)
+        ++i;
+      Advance(this->pieces[i], t - this->pieces[i].start,
+              _positions[k], _velocities[k]);
+    }
+  }
+
+  const std::vector<MotionPiece> &Motion::Pieces() const
+  {
+    return this->pieces;
+  }
+
+  Motion FallMotion(const FreeFall &_fall)
+  {
+    std::vector<MotionPiece> pieces(1);
+    pieces[0].position = _fall.height;
+    pieces[0].velocity = _fall.velocity;
+    pieces[0].acceleration = -_fall.gravity;
+    if (!_fall.ground || _fall.height <= _fall.restHeight)
+      return Motion(pieces);
+
+    const double impact = FirstRoot(-_fall.gravity / 2.0, _fall.velocity,
+                                    _fall.height - _fall.restHeight);
+    if (impact < infinity)
+    {
+      MotionPiece rest;
+      rest.start = impact;
+      rest.position = _fall.restHeight;
+      pieces.push_back(rest);
+    }
+    return Motion(pieces);
+  }
+
+  std::vector<ForceKnot> ConstantForce(double _force, double _duration)
+  {
+    return {{0.0, _force}, {_duration, _force}, {_duration, 0.0}};
+  }
+
+  std::vector<ForceKnot> ForcePattern(int _pattern)
+  {
+    std::vector<ForceKnot> knots;
+    switch (_pattern)
+    {
+      case 1:
+        knots = {{0.0, 0.0}, {2.0, 10.0}, {3.0, 10.0}, {5.0, 0.0}};
+        break;
+      case 2:
+        knots = {{0.0, 0.0}, {0.1, 10.0}, {4.9, 10.0}, {5.0, 0.0}};
+        break;
+      case 3:
+        // The same ramp, hold and ramp down three times over
+        for (int i = 0; i < 3; ++i)
+        {
+          const double start = 0.5 * i;
+          knots.push_back({start, 0.2});
+          knots.push_back({start + 0.1, 20.2});
+          knots.push_back({start + 0.1, 20.0});
+          knots.push_back({start + 0.4, 20.0});
+          knots.push_back({start + 0.5, 0.0});
+        }
+        break;
+      case 4:
+        for (int i = 0; i <= 5000; ++i)
+        {
+          const double t = i * 1e-3;
+          knots.push_back({t, 20.0 * std::fabs(std::sin(M_PI * t))});
+        }
+        break;
+      default:
+        break;
+    }
+    return knots;
+  }
+
+  Motion SlideMotion(const SlidingBlock &_block)
+  {
+    // Largest static friction force and the deceleration of sliding
+    const double stick = _block.friction * _block.mass * _block.gravity;
+    const double drag = _block.friction * _block.gravity;
+    const double tolerance = 1e-12 * std::max(1.0, stick);
+
+    // Segments of a linear force, the last one without an end
+    struct Segment
+    {
+      double start;
+      double end;
+      double force;
+      double slope;
+    };
+    std::vector<Segment> segments;
+    double t = 0.0;
+    for (size_t i = 0; i < _block.force.size(); ++i)
+    {
+      const ForceKnot &knot = _block.force[i];
+      if (knot.time > t)
+      {
+        if (i == 0)
+          segments.push_back({t, knot.time, 0.0, 0.0});
+        else
+        {
+          const ForceKnot &previous = _block.force[i - 1];
+          const double slope =
+              (knot.force - previous.force) / (knot.time - previous.time);
+          segments.push_back({t, knot.time,
+                              previous.force + slope * (t - previous.time),
+                              slope});
+        }
+        t = knot.time;
+      }
+    }
+    segments.push_back({t, infinity, 0.0, 0.0});
+
+    std::vector<MotionPiece> pieces;
+    double x = _block.position;
+    double v = _block.velocity;
+    for (const Segment &segment : segments)
+    {
+      double now = segment.start;
+      while (now < segment.end)
+      {
+        const double force = segment.force + segment.slope *
+            (now - segment.start);
+        MotionPiece piece;
+        piece.start = now;
+        piece.position = x;
+
+        // Sliding direction, zero while the block sticks
+        double direction = v > 0.0 ? 1.0 : (v < 0.0 ? -1.0 : 0.0);
+        if (direction == 0.0)
+        {
+          if (force > stick + tolerance ||
+              (force > stick - tolerance && segment.slope > 0.0))
+          {
+            direction = 1.0;
+          }
+          else if (force < -stick - tolerance ||
+                   (force < -stick + tolerance && segment.slope < 0.0))
+          {
+            direction = -1.0;
+          }
+        }
+
+        if (direction == 0.0)
+        {
+          // Stuck until the force overcomes the static friction
+          double slip = infinity;
+          if (segment.slope > 0.0)
+            slip = now + (stick - force) / segment.slope;
+          else if (segment.slope < 0.0)
+            slip = now + (-stick - force) / segment.slope;
+          if (pieces.empty() || pieces.back().velocity != 0.0 ||
+              pieces.back().acceleration != 0.0 || pieces.back().jerk != 0.0)
+          {
+            pieces.push_back(piece);
+          }
+          now = std::min(slip, segment.end);
+          continue;
+        }
+
+        piece.velocity = v;
+        piece.acceleration = force / _block.mass - direction * drag;
+        piece.jerk = segment.slope / _block.mass;
+        pieces.push_back(piece);
+
+        // Until the velocity comes back to zero or the segment ends
+        const double stop = now + FirstRoot(piece.jerk / 2.0,
+            piece.acceleration, v, 1e-12);
+        const double end = std::min(stop, segment.end);
+        if (end == infinity)
+          break;
+        Advance(piece, end - now, x, v);
+        if (stop <= segment.end)
+          v = 0.0;
+        now = end;
+      }
+    }
+    return Motion(pieces);
+  }
+}
@@ -0,0 +1,118 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#ifndef ANALYSIS_REFERENCE_HH_
+#define ANALYSIS_REFERENCE_HH_
+
+#include <vector>
+
+namespace analysis
+{
+  // One piece of a motion along an axis: from its start time on, the
+  // position is a cubic polynomial of the time since the start.
+  struct MotionPiece
+  {
+    double start = 0.0;
+    double position = 0.0;
+    double velocity = 0.0;
+    double acceleration = 0.0;
+    double jerk = 0.0;
+  };
+
+  // Exact motion along one axis, as pieces ordered by their start times.
+  // The first piece also holds before its start.
+  class Motion
+  {
+    public: explicit Motion(const std::vector<MotionPiece> &_pieces);
+
+    // Positions and velocities at any number of times. Increasing times
+    // are evaluated in one walk over the pieces, others search for their
+    // piece.
+    public: void Evaluate(const std::vector<double> &_times
+                        , std::vector<double> &_positions
+                        , std::vector<double> &_velocities) const;
+
+    public: const std::vector<MotionPiece> &Pieces() const;
+
+    private: std::vector<MotionPiece> pieces;
+  };
+
+  // A cube dropped from rest, Experiment 1 of Chapter 3. With a ground it
+  // stops dead when its center reaches the rest height, as the
+  // theoretical results assume.
+  struct FreeFall
+  {
+    // Height of the center at time 0, meters.
+    double height = 10.0;
+
+    // Vertical velocity at time 0, upwards positive.
+    double velocity = 0.0;
+
+    double gravity = 9.81;
+
+    bool ground = true;
+
+    // Height of the center of the 1 m cube resting on the ground.
+    double restHeight = 0.5;
+  };
+
+  // Vertical motion of a free fall from time 0.
+  Motion FallMotion(const FreeFall &_fall);
+
+  // A knot of a force applied over time. The force is a straight line
+  // between knots and zero before the first and after the last one, two
+  // knots at the same time make a step.
+  struct ForceKnot
+  {
+    double time;
+    double force;
+  };
+
+  // A constant force applied from time 0 for a duration, Experiment 3.
+  std::vector<ForceKnot> ConstantForce(double _force, double _duration);
+
+  // Force patterns 1 to 4 of Experiment 4, as force_pattern.cc applies
+  // them by time. Pattern 4, 20 |sin(pi t)|, is approximated by straight
+  // lines every millisecond, which is within 3e-5 N of it.
+  // Returns no knots for another pattern number.
+  std::vector<ForceKnot> ForcePattern(int _pattern);
+
+  // A block on the floor pushed along it, Experiments 2 to 4 of Chapter
+  // 3. It sticks while the force is within the static friction and
+  // slides against Coulomb friction otherwise.
+  struct SlidingBlock
+  {
+    double mass = 1.0;
+
+    // Friction coefficient, the same for sticking and sliding.
+    double friction = 1.0;
+
+    double gravity = 9.81;
+
+    // Position and velocity at time 0, as left by an impulse.
+    double position = 0.0;
+    double velocity = 0.0;
+
+    // Force along the floor, knots in increasing time.
+    std::vector<ForceKnot> force;
+  };
+
+  // Motion of a sliding block from time 0. Between knots the velocity is
+  // a quadratic polynomial of time, so the pieces start at the knots and
+  // at the exact times the block stops or starts to slide.
+  Motion SlideMotion(const SlidingBlock &_block);
+}
+#endif
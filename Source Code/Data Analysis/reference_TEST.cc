@@ -0,0 +1,124 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "reference.hh"
+
+using namespace analysis;
+
+TEST(Reference, GravityDrop)
+{
+  // 10 m drop of Experiment 1: lands after sqrt(2 9.5 / 9.81) s
+  FreeFall fall;
+  const Motion motion = FallMotion(fall);
+  std::vector<double> z, v;
+  motion.Evaluate({0.0, 0.001, 1.0, 1.5, 1.999}, z, v);
+  EXPECT_DOUBLE_EQ(z[0], 10.0);
+  EXPECT_NEAR(z[1], 9.999995095, 1e-12);
+  EXPECT_NEAR(v[1], -0.00981, 1e-12);
+  EXPECT_NEAR(z[2], 10.0 - 9.81 / 2.0, 1e-12);
+  EXPECT_DOUBLE_EQ(z[3], 0.5);
+  EXPECT_DOUBLE_EQ(v[3], 0.0);
+  ASSERT_EQ(motion.Pieces().size(), 2u);
+  EXPECT_NEAR(motion.Pieces()[1].start, std::sqrt(2.0 * 9.5 / 9.81), 1e-14);
+
+  // Times in any order give the same values
+  std::vector<double> z2, v2;
+  motion.Evaluate({1.999, 1.0, 0.001, 1.5, 0.0}, z2, v2);
+  EXPECT_DOUBLE_EQ(z2[0], z[4]);
+  EXPECT_DOUBLE_EQ(z2[1], z[2]);
+  EXPECT_DOUBLE_EQ(z2[4], z[0]);
+
+  fall.ground = false;
+  FallMotion(fall).Evaluate({3.0}, z, v);
+  EXPECT_NEAR(z[0], 10.0 - 9.81 * 4.5, 1e-12);
+}
+
+TEST(Reference, Impulse)
+{
+  // 1000 N for 1 ms on the 1 kg cube of Experiment 2
+  SlidingBlock block;
+  block.velocity = 1.0;
+  std::vector<double> y, v;
+  SlideMotion(block).Evaluate({0.002, 1.0, 4.0}, y, v);
+  EXPECT_NEAR(v[0], 1.0 - 9.81 * 0.002, 1e-14);
+  EXPECT_DOUBLE_EQ(v[1], 0.0);
+  EXPECT_NEAR(y[2], 1.0 / (2.0 * 9.81), 1e-14);
+
+  block.friction = 0.0;
+  SlideMotion(block).Evaluate({4.0}, y, v);
+  EXPECT_DOUBLE_EQ(y[0], 4.0);
+  EXPECT_DOUBLE_EQ(v[0], 1.0);
+}
+
+TEST(Reference, ConstantForce)
+{
+  // 10 N for 5 s of Experiment 3, against 9.81 N of friction
+  SlidingBlock block;
+  block.force = ConstantForce(10.0, 5.0);
+  std::vector<double> y, v;
+  SlideMotion(block).Evaluate({5.0, 5.001, 10.0}, y, v);
+  EXPECT_NEAR(v[0], 0.19 * 5.0, 1e-12);
+  EXPECT_NEAR(y[0], 0.19 * 25.0 / 2.0, 1e-12);
+  EXPECT_NEAR(v[1], 0.95 - 0.00981, 1e-12);
+  EXPECT_DOUBLE_EQ(v[2], 0.0);
+  EXPECT_NEAR(y[2], 2.375 + 0.95 * 0.95 / (2.0 * 9.81), 1e-12);
+
+  // Below the static friction the block never moves
+  block.force = ConstantForce(9.0, 5.0);
+  const Motion stuck = SlideMotion(block);
+  stuck.Evaluate({1.0, 10.0}, y, v);
+  EXPECT_DOUBLE_EQ(y[1], 0.0);
+  EXPECT_EQ(stuck.Pieces().size(), 1u);
+}
+
+TEST(Reference, ForcePattern)
+{
+  // Pattern 1 only overcomes the friction above 9.81 N, from
+  // t = 9.81 / 5 until the force drops below it at 3 + 0.19 / 5; the
+  // block then slides until it stops
+  SlidingBlock block;
+  block.force = ForcePattern(1);
+  const Motion motion = SlideMotion(block);
+  std::vector<double> y, v;
+  motion.Evaluate({1.9, 2.5, 7.0}, y, v);
+  EXPECT_DOUBLE_EQ(y[0], 0.0);
+  EXPECT_GT(v[1], 0.0);
+  EXPECT_DOUBLE_EQ(v[2], 0.0);
+  ASSERT_GE(motion.Pieces().size(), 2u);
+  EXPECT_NEAR(motion.Pieces()[1].start, 9.81 / 5.0, 1e-12);
+
+  // The velocity is continuous and never below zero with friction
+  std::vector<double> times;
+  for (int i = 0; i <= 7000; ++i)
+    times.push_back(i * 1e-3);
+  for (int pattern = 1; pattern <= 4; ++pattern)
+  {
+    block.force = ForcePattern(pattern);
+    SlideMotion(block).Evaluate(times, y, v);
+    for (size_t i = 1; i < times.size(); ++i)
+    {
+      EXPECT_GE(v[i], 0.0);
+      EXPECT_LT(std::fabs(v[i] - v[i - 1]), 0.03);
+      EXPECT_GE(y[i], y[i - 1]);
+    }
+    EXPECT_DOUBLE_EQ(v.back(), 0.0);
+  }
+  EXPECT_TRUE(ForcePattern(5).empty());
+}
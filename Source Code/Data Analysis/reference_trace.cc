@@ -0,0 +1,227 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+// Writes the analytic reference of an experiment at any step size, in the
+// columns of the theoretical results, so that trace_compare can take it
+// as the reference of the engine results, for example the 50 m drop at
+// 0.1 ms:
+//   reference_trace drop drop.csv --height 50 --duration 4 --step 0.0001
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "reference.hh"
+#include "torque_free.hh"
+
+static void Usage()
+{
+  std::cerr << "Usage: reference_trace <experiment> <output csv> [options]\n"
+            << "Experiments:\n"
+            << "  drop                  cube dropped on the ground\n"
+            << "  impulse               cube pushed by a short force\n"
+            << "  force                 cube pushed by a constant force\n"
+            << "  pattern               cube pushed by a force pattern\n"
+            << "  tumble                box rotating without torques\n"
+            << "Options:\n"
+            << "  --step S              time between samples, 0.001\n"
+            << "  --duration S          time of the last sample, 10\n"
+            << "  --height M            drop height, 10\n"
+            << "  --mass KG             1\n"
+            << "  --friction MU         1, 0 to neglect friction\n"
+            << "  --gravity G           9.81\n"
+            << "  --force N             1000 for impulse, 10 for force\n"
+            << "  --force-duration S    0.001 for impulse, 5 for force\n"
+            << "  --pattern N           force pattern 1 to 4\n"
+            << "  --inertia X,Y,Z       principal moments of the box\n"
+            << "  --angular-velocity X,Y,Z\n"
+            << "                        at time 0, of the complex box\n";
+}
+
+// Parse three comma separated numbers.
+static bool ParseVector(const std::string &_text, analysis::Vector3 &_v)
+{
+  std::istringstream stream(_text);
+  char comma1 = 0, comma2 = 0;
+  stream >> _v[0] >> comma1 >> _v[1] >> comma2 >> _v[2];
+  return stream && comma1 == ',' && comma2 == ',';
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 3 || argv[1][0] == '-' || argv[2][0] == '-')
+  {
+    Usage();
+    return 1;
+  }
+
+  const std::string experiment = argv[1];
+  const std::string path = argv[2];
+  double step = 0.001;
+  double duration = 10.0;
+  analysis::FreeFall fall;
+  analysis::SlidingBlock block;
+  double force = std::nan("");
+  double forceDuration = std::nan("");
+  int pattern = 1;
+  analysis::Vector3 inertia = {0.80833333, 0.68333333, 0.14166667};
+  analysis::Vector3 angularVelocity = {0.1, 5.0, 0.1};
+  for (int i = 3; i < argc; ++i)
+  {
+    const std::string option = argv[i];
+    if (i + 1 >= argc)
+    {
+      Usage();
+      return 1;
+    }
+    const char *value = argv[++i];
+    bool valid = true;
+    if (option == "--step")
+      step = std::atof(value);
+    else if (option == "--duration")
+      duration = std::atof(value);
+    else if (option == "--height")
+      fall.height = std::atof(value);
+    else if (option == "--mass")
+      block.mass = std::atof(value);
+    else if (option == "--friction")
+      block.friction = std::atof(value);
+    else if (option == "--gravity")
+      fall.gravity = block.gravity = std::atof(value);
+    else if (option == "--force")
+      force = std::atof(value);
+    else if (option == "--force-duration")
+      forceDuration = std::atof(value);
+    else if (option == "--pattern")
+      pattern = std::atoi(value);
+    else if (option == "--inertia")
+      valid = ParseVector(value, inertia);
+    else if (option == "--angular-velocity")
+      valid = ParseVector(value, angularVelocity);
+    else
+      valid = false;
+    if (!valid)
+    {
+      std::cerr << "Invalid option " << option << " " << value << std::endl;
+      Usage();
+      return 1;
+    }
+  }
+  if (!(step > 0.0) || !(duration >= 0.0))
+  {
+    Usage();
+    return 1;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<double> times;
+  const long count = std::lround(duration / step);
+  for (long i = 0; i <= count; ++i)
+    times.push_back(i * step);
+
+  // Every column after the time
+  std::vector<std::string> names;
+  std::vector<std::vector<double>> columns;
+  if (experiment == "drop")
+  {
+    names = {"Z Velocity", "Z Position"};
+    columns.resize(2);
+    analysis::FallMotion(fall).Evaluate(times, columns[1], columns[0]);
+  }
+  else if (experiment == "impulse" || experiment == "force" ||
+           experiment == "pattern")
+  {
+    if (experiment == "impulse")
+    {
+      // Short enough to count as an instant change of velocity
+      block.velocity = (std::isnan(force) ? 1000.0 : force) *
+          (std::isnan(forceDuration) ? 0.001 : forceDuration) / block.mass;
+    }
+    else if (experiment == "force")
+    {
+      block.force = analysis::ConstantForce(
+          std::isnan(force) ? 10.0 : force,
+          std::isnan(forceDuration) ? 5.0 : forceDuration);
+    }
+    else
+    {
+      block.force = analysis::ForcePattern(pattern);
+      if (block.force.empty())
+      {
+        std::cerr << "No force pattern " << pattern << std::endl;
+        return 1;
+      }
+    }
+    names = {"Y Velocity", "Y Position"};
+    columns.resize(2);
+    analysis::SlideMotion(block).Evaluate(times, columns[1], columns[0]);
+  }
+  else if (experiment == "tumble")
+  {
+    const analysis::TorqueFreeBody body(inertia, angularVelocity);
+    std::vector<analysis::Quaternion> orientations;
+    std::vector<analysis::Vector3> velocities;
+    body.Evaluate(times, orientations, velocities);
+    names = {"X Angular Velocity", "Y Angular Velocity",
+             "Z Angular Velocity", "Orientation W", "Orientation X",
+             "Orientation Y", "Orientation Z"};
+    columns.assign(names.size(), std::vector<double>(times.size()));
+    for (size_t i = 0; i < times.size(); ++i)
+    {
+      for (int j = 0; j < 3; ++j)
+        columns[j][i] = velocities[i][j];
+      columns[3][i] = orientations[i].w;
+      columns[4][i] = orientations[i].x;
+      columns[5][i] = orientations[i].y;
+      columns[6][i] = orientations[i].z;
+    }
+  }
+  else
+  {
+    std::cerr << "Unknown experiment " << experiment << std::endl;
+    Usage();
+    return 1;
+  }
+
+  std::ofstream file(path.c_str());
+  file.precision(12);
+  file << "Time";
+  for (const auto &name : names)
+    file << "," << name;
+  file << "\n";
+  for (size_t i = 0; i < times.size(); ++i)
+  {
+    file << times[i];
+    for (const auto &column : columns)
+      file << "," << column[i];
+    file << "\n";
+  }
+  if (!file)
+  {
+    std::cerr << "could not write " << path << std::endl;
+    return 1;
+  }
+  const double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  std::cerr << times.size() << " samples in " << seconds << " s"
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,189 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+// Keeps a catalog of the results files and queries it. The catalog is
+// brought up to date with the results directory first, which reads only
+// the files that changed since the last run, unless --no-update is given.
+// Then the files matching the query options are listed, for example all
+// ODE runs of the complex scenario with a step below 0.03 s:
+//   results_catalog "Results/Raw Data" catalog.txt
+//       --experiment "Complex Scenario" --physics ode --dt-max 0.03
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "catalog.hh"
+#include "parallel.hh"
+
+static void Usage()
+{
+  std::cerr << "Usage: results_catalog <results directory> <catalog file>"
+            << " [options]\n"
+            << "  --no-update           query the catalog as it is\n"
+            << "  --jobs N              threads reading changed files\n"
+            << "  --stats               print the column statistics\n"
+            << "Query options, names ignore case:\n"
+            << "  --chapter NAME        as \"Chapter 4\"\n"
+            << "  --experiment NAME     as \"Complex Scenario\"\n"
+            << "  --variant NAME        as \"Including Friction/1000N\"\n"
+            << "  --engine NAME         Gazebo, Unreal or Theoretical\n"
+            << "  --physics NAME        ode, bullet or simbody\n"
+            << "  --quantity NAME       column the file must have\n"
+            << "  --dt-min S            step size range\n"
+            << "  --dt-max S\n"
+            << "  --force-min N         applied force range\n"
+            << "  --force-max N\n";
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 3 || argv[1][0] == '-' || argv[2][0] == '-')
+  {
+    Usage();
+    return 1;
+  }
+
+  const std::string root = argv[1];
+  const std::string path = argv[2];
+  bool update = true;
+  bool stats = false;
+  int jobs = analysis::DefaultJobs();
+  analysis::CatalogQuery query;
+  bool list = false;
+  for (int i = 3; i < argc; ++i)
+  {
+    const std::string option = argv[i];
+    if (option == "--no-update")
+    {
+      update = false;
+      continue;
+    }
+    if (option == "--stats")
+    {
+      stats = true;
+      continue;
+    }
+    if (i + 1 >= argc)
+    {
+      Usage();
+      return 1;
+    }
+    const char *value = argv[++i];
+    list = list || option != "--jobs";
+    if (option == "--jobs")
+      jobs = std::max(1, std::atoi(value));
+    else if (option == "--chapter")
+      query.chapter = value;
+    else if (option == "--experiment")
+      query.experiment = value;
+    else if (option == "--variant")
+      query.variant = value;
+    else if (option == "--engine")
+      query.engine = value;
+    else if (option == "--physics")
+      query.physics = value;
+    else if (option == "--quantity")
+      query.quantity = value;
+    else if (option == "--dt-min")
+      query.minDt = std::atof(value);
+    else if (option == "--dt-max")
+      query.maxDt = std::atof(value);
+    else if (option == "--force-min")
+      query.minForce = std::atof(value);
+    else if (option == "--force-max")
+      query.maxForce = std::atof(value);
+    else
+    {
+      std::cerr << "Unknown option " << option << std::endl;
+      Usage();
+      return 1;
+    }
+  }
+
+  // A missing catalog is built from scratch
+  analysis::Catalog catalog;
+  std::string error;
+  if (!catalog.Load(path, error) && (!update || std::ifstream(path.c_str())))
+  {
+    std::cerr << error << std::endl;
+    return 1;
+  }
+
+  if (update)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    size_t read = 0;
+    try
+    {
+      read = catalog.Update(root, jobs);
+    }
+    catch (const std::exception &_e)
+    {
+      std::cerr << _e.what() << std::endl;
+      return 1;
+    }
+    if (read > 0 && !catalog.Save(path, error))
+    {
+      std::cerr << error << std::endl;
+      return 1;
+    }
+    const double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    std::cerr << catalog.Entries().size() << " files, " << read
+              << " read in " << seconds << " s" << std::endl;
+  }
+
+  if (!list && !stats)
+    return 0;
+
+  const auto start = std::chrono::steady_clock::now();
+  const auto found = catalog.Find(query);
+  const double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  for (const auto *entry : found)
+  {
+    const analysis::RunParameters &p = entry->parameters;
+    std::cout << entry->path << "\n    " << p.engine;
+    if (!p.physics.empty())
+      std::cout << " " << p.physics;
+    if (std::isfinite(p.dt))
+      std::cout << ", dt " << p.dt;
+    if (std::isfinite(p.force))
+      std::cout << ", force " << p.force;
+    std::cout << ", " << entry->rows << " rows, " << entry->start << " to "
+              << entry->end << " s\n";
+    if (!stats)
+      continue;
+    for (const auto &column : entry->columns)
+    {
+      std::cout << "    " << column.name << ": " << column.min << " to "
+                << column.max << ", mean " << column.mean;
+      if (column.count != entry->rows)
+        std::cout << ", " << entry->rows - column.count << " missing";
+      std::cout << "\n";
+    }
+  }
+  std::cerr << found.size() << " of " << catalog.Entries().size()
+            << " files match, found in " << seconds * 1e6 << " us"
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,556 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#include "torque_free.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace analysis
+{
+  static Quaternion Multiply(const Quaternion &_a, const Quaternion &_b)
+  {
+    Quaternion q;
+    q.w = _a.w * _b.w - _a.x * _b.x - _a.y * _b.y - _a.z * _b.z;
+    q.x = _a.w * _b.x + _a.x * _b.w + _a.y * _b.z - _a.z * _b.y;
+    q.y = _a.w * _b.y - _a.x * _b.z + _a.y * _b.w + _a.z * _b.x;
+    q.z = _a.w * _b.z + _a.x * _b.y - _a.y * _b.x + _a.z * _b.w;
+    return q;
+  }
+
+  static Quaternion Conjugate(const Quaternion &_q)
+  {
+    Quaternion q;
+    q.w = _q.w;
+    q.x = -_q.x;
+    q.y = -_q.y;
+    q.z = -_q.z;
+    return q;
+  }
+
+  static Quaternion Normalized(const Quaternion &_q)
+  {
+    const double length =
+        std::sqrt(_q.w * _q.w + _q.x * _q.x + _q.y * _q.y + _q.z * _q.z);
+    Quaternion q;
+    q.w = _q.w / length;
+    q.x = _q.x / length;
+    q.y = _q.y / length;
+    q.z = _q.z / length;
+    return q;
+  }
+
+  // _v rotated by _q.
+  static Vector3 Rotate(const Quaternion &_q, const Vector3 &_v)
+  {
+    Quaternion v;
+    v.w = 0.0;
+    v.x = _v[0];
+    v.y = _v[1];
+    v.z = _v[2];
+    const Quaternion r = Multiply(Multiply(_q, v), Conjugate(_q));
+    return {r.x, r.y, r.z};
+  }
+
+  // Rotation by _angle about a vector, which need not be a unit one.
+  static Quaternion AxisAngle(const Vector3 &_axis, double _angle)
+  {
+    const double length = std::sqrt(_axis[0] * _axis[0] +
+        _axis[1] * _axis[1] + _axis[2] * _axis[2]);
+    Quaternion q;
+    if (length == 0.0)
+      return q;
+    const double s = std::sin(_angle / 2.0) / length;
+    q.w = std::cos(_angle / 2.0);
+    q.x = _axis[0] * s;
+    q.y = _axis[1] * s;
+    q.z = _axis[2] * s;
+    return q;
+  }
+
+  // Rotation of a proper rotation matrix.
+  static Quaternion FromMatrix(const double _m[3][3])
+  {
+    Quaternion q;
+    const double trace = _m[0][0] + _m[1][1] + _m[2][2];
+    if (trace > 0.0)
+    {
+      const double s = 2.0 * std::sqrt(1.0 + trace);
+      q.w = s / 4.0;
+      q.x = (_m[2][1] - _m[1][2]) / s;
+      q.y = (_m[0][2] - _m[2][0]) / s;
+      q.z = (_m[1][0] - _m[0][1]) / s;
+      return q;
+    }
+    // Largest diagonal element first, for precision
+    int i = 0;
+    if (_m[1][1] > _m[0][0])
+      i = 1;
+    if (_m[2][2] > _m[i][i])
+      i = 2;
+    const int j = (i + 1) % 3;
+    const int k = (i + 2) % 3;
+    const double s = 2.0 * std::sqrt(1.0 + _m[i][i] - _m[j][j] - _m[k][k]);
+    double v[3];
+    v[i] = s / 4.0;
+    v[j] = (_m[j][i] + _m[i][j]) / s;
+    v[k] = (_m[k][i] + _m[i][k]) / s;
+    q.w = (_m[k][j] - _m[j][k]) / s;
+    q.x = v[0];
+    q.y = v[1];
+    q.z = v[2];
+    return q;
+  }
+
+  void JacobiElliptic(double _u, double _m
+                    , double &_sn, double &_cn, double &_dn)
+  {
+    if (_m < 1e-30)
+    {
+      _sn = std::sin(_u);
+      _cn = std::cos(_u);
+      _dn = 1.0;
+      return;
+    }
+    if (_m >= 1.0)
+    {
+      _sn = std::tanh(_u);
+      _cn = 1.0 / std::cosh(_u);
+      _dn = _cn;
+      return;
+    }
+
+    // Abramowitz and Stegun 16.4: descend by the arithmetic-geometric
+    // mean, then ascend the amplitudes back
+    const int maxSteps = 20;
+    double a[maxSteps + 1], c[maxSteps + 1];
+    a[0] = 1.0;
+    c[0] = std::sqrt(_m);
+    double b = std::sqrt(1.0 - _m);
+    int n = 0;
+    while (n < maxSteps && std::fabs(c[n]) > 1e-16)
+    {
+      a[n + 1] = (a[n] + b) / 2.0;
+      c[n + 1] = (a[n] - b) / 2.0;
+      b = std::sqrt(a[n] * b);
+      ++n;
+    }
+    double phi = std::ldexp(a[n] * _u, n);
+    double previous = phi;
+    for (int j = n; j > 0; --j)
+    {
+      previous = phi;
+      phi = (phi + std::asin(c[j] / a[j] * std::sin(phi))) / 2.0;
+    }
+    _sn = std::sin(phi);
+    _cn = std::cos(phi);
+    _dn = _cn / std::cos(previous - phi);
+  }
+
+  // Carlson's symmetric integral R_F by duplication.
+  static double CarlsonRF(double _x, double _y, double _z)
+  {
+    for (int i = 0; i < 100; ++i)
+    {
+      const double mean = (_x + _y + _z) / 3.0;
+      const double dx = 1.0 - _x / mean;
+      const double dy = 1.0 - _y / mean;
+      const double dz = 1.0 - _z / mean;
+      if (std::max({std::fabs(dx), std::fabs(dy), std::fabs(dz)}) < 1e-3)
+      {
+        const double e2 = dx * dy - dz * dz;
+        const double e3 = dx * dy * dz;
+        return (1.0 - e2 / 10.0 + e3 / 14.0 + e2 * e2 / 24.0 -
+                3.0 * e2 * e3 / 44.0) / std::sqrt(mean);
+      }
+      const double sx = std::sqrt(_x);
+      const double sy = std::sqrt(_y);
+      const double sz = std::sqrt(_z);
+      const double lambda = sx * (sy + sz) + sy * sz;
+      _x = (_x + lambda) / 4.0;
+      _y = (_y + lambda) / 4.0;
+      _z = (_z + lambda) / 4.0;
+    }
+    return std::nan("");
+  }
+
+  double EllipticF(double _phi, double _m)
+  {
+    // F(phi + n pi) = F(phi) + 2 n K
+    const double turns = std::nearbyint(_phi / M_PI);
+    const double phi = _phi - turns * M_PI;
+    const double s = std::sin(phi);
+    const double c = std::cos(phi);
+    double f = s * CarlsonRF(c * c, 1.0 - _m * s * s, 1.0);
+    if (turns != 0.0)
+      f += 2.0 * turns * CarlsonRF(0.0, 1.0 - _m, 1.0);
+    return f;
+  }
+
+  TorqueFreeBody::TorqueFreeBody(const Vector3 &_inertia
+                               , const Vector3 &_angularVelocity
+                               , const Quaternion &_orientation)
+    : orientation(Normalized(_orientation))
+  {
+    const Vector3 w = Rotate(Conjugate(this->orientation), _angularVelocity);
+    this->spin = w;
+    const Vector3 h = {_inertia[0] * w[0], _inertia[1] * w[1],
+                       _inertia[2] * w[2]};
+    const Vector3 cross = {h[1] * w[2] - h[2] * w[1],
+                           h[2] * w[0] - h[0] * w[2],
+                           h[0] * w[1] - h[1] * w[0]};
+    const double momentumSquared = h[0] * h[0] + h[1] * h[1] + h[2] * h[2];
+    const double energy2 = h[0] * w[0] + h[1] * w[1] + h[2] * w[2];
+    const double speed = std::sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+    this->momentum = std::sqrt(momentumSquared);
+    this->quadratureStep = speed > 0.0 ? 0.05 / speed : 1.0;
+
+    // The angular velocity stays put when the momentum is along it
+    const double crossLength = std::sqrt(cross[0] * cross[0] +
+        cross[1] * cross[1] + cross[2] * cross[2]);
+    if (crossLength <= 1e-12 * this->momentum * speed)
+    {
+      this->steady = true;
+      return;
+    }
+
+    // Axes of the solution: the dn axis has the largest moment when the
+    // momentum is above that of the middle axis for the energy, else the
+    // smallest, and the cn axis the opposite one
+    int order[3] = {0, 1, 2};
+    std::sort(order, order + 3, [&](int _a, int _b)
+    {
+      return _inertia[_a] < _inertia[_b];
+    });
+    if (momentumSquared < energy2 * _inertia[order[1]])
+      std::swap(order[0], order[2]);
+    double matrix[3][3] = {{0.0}};
+    for (int r = 0; r < 3; ++r)
+      matrix[r][order[r]] = 1.0;
+    const bool even = (order[0] + 1) % 3 == order[1];
+    if (!even)
+      matrix[1][order[1]] = -1.0;
+    this->axes = FromMatrix(matrix);
+    for (int r = 0; r < 3; ++r)
+      this->inertia[r] = _inertia[order[r]];
+
+    const double i1 = this->inertia[0];
+    const double i2 = this->inertia[1];
+    const double i3 = this->inertia[2];
+    if (i3 == i2 || i3 == i1)
+    {
+      this->steady = true;
+      return;
+    }
+    const Vector3 omega = Rotate(this->axes, w);
+    const double d3 = energy2 * i3 - momentumSquared;
+    const double d1 = momentumSquared - energy2 * i1;
+    const double a1 = std::sqrt(std::max(0.0, d3 / (i1 * (i3 - i1))));
+    const double a2 = std::sqrt(std::max(0.0, d3 / (i2 * (i3 - i2))));
+    const double a3 = std::sqrt(std::max(0.0, d1 / (i3 * (i3 - i1))));
+    this->parameter = std::min(1.0, std::max(0.0,
+        (i2 - i1) * d3 / ((i3 - i2) * d1)));
+    if (this->parameter > 1.0 - 1e-12)
+      this->parameter = 1.0;
+
+    // cn stays positive on the separatrix, so the cn axis needs a sign
+    // there, and dn always
+    const double s1 = this->parameter == 1.0 && omega[0] < 0.0 ? -1.0 : 1.0;
+    const double s3 = omega[2] < 0.0 ? -1.0 : 1.0;
+    this->amplitude = {s1 * a1, a2, s3 * a3};
+    this->rate = s1 * s3 * (i3 > i1 ? 1.0 : -1.0) *
+        std::sqrt(std::max(0.0, (i3 - i2) * d1 / (i1 * i2 * i3)));
+    this->phase = EllipticF(std::atan2(omega[1] * a1, s1 * omega[0] * a2),
+                            this->parameter);
+    this->quadratureStep = 0.05 / std::max(speed, std::fabs(this->rate));
+
+    // Precession counted from time 0
+    const Quaternion start = this->Orientation(0.0, 0.0);
+    this->invariable = Multiply(this->orientation, Conjugate(start));
+  }
+
+  Vector3 TorqueFreeBody::SolutionAngularVelocity(double _time) const
+  {
+    double sn, cn, dn;
+    JacobiElliptic(this->rate * _time + this->phase, this->parameter,
+                   sn, cn, dn);
+    return {this->amplitude[0] * cn, this->amplitude[1] * sn,
+            this->amplitude[2] * dn};
+  }
+
+  Vector3 TorqueFreeBody::BodyAngularVelocity(double _time) const
+  {
+    if (this->steady)
+      return this->spin;
+    return Rotate(Conjugate(this->axes),
+                  this->SolutionAngularVelocity(_time));
+  }
+
+  double TorqueFreeBody::PrecessionRate(double _time) const
+  {
+    const Vector3 w = this->SolutionAngularVelocity(_time);
+    const double h1 = this->inertia[0] * w[0];
+    const double h2 = this->inertia[1] * w[1];
+    return this->momentum * (h1 * w[0] + h2 * w[1]) / (h1 * h1 + h2 * h2);
+  }
+
+  double TorqueFreeBody::Precession(double _from, double _to) const
+  {
+    // Five point Gauss-Legendre on sub-intervals short against the
+    // period of the rate
+    static const double nodes[5] = {0.0, 0.5384693101056831,
+        -0.5384693101056831, 0.9061798459386640, -0.9061798459386640};
+    static const double weights[5] = {0.5688888888888889,
+        0.4786286704993665, 0.4786286704993665, 0.2369268850561891,
+        0.2369268850561891};
+    const double length = _to - _from;
+    const int count = std::max(1,
+        static_cast<int>(std::ceil(std::fabs(length) / this->quadratureStep)));
+    const double half = length / count / 2.0;
+    double sum = 0.0;
+    for (int i = 0; i < count; ++i)
+    {
+      const double center = _from + (2 * i + 1) * half;
+      for (int j = 0; j < 5; ++j)
+        sum += weights[j] * this->PrecessionRate(center + nodes[j] * half);
+    }
+    return sum * half;
+  }
+
+  Quaternion TorqueFreeBody::Orientation(double _time
+                                       , double _precession) const
+  {
+    // Euler angles of the solution axes against the angular momentum,
+    // rotations about z, x and z
+    const Vector3 w = this->SolutionAngularVelocity(_time);
+    const double n1 = this->inertia[0] * w[0] / this->momentum;
+    const double n2 = this->inertia[1] * w[1] / this->momentum;
+    const double n3 = this->inertia[2] * w[2] / this->momentum;
+    const double nutation = std::atan2(std::sqrt(n1 * n1 + n2 * n2), n3);
+    const double spinAngle = std::atan2(n1, n2);
+    const Quaternion euler = Multiply(Multiply(
+        AxisAngle({0.0, 0.0, 1.0}, _precession),
+        AxisAngle({1.0, 0.0, 0.0}, nutation)),
+        AxisAngle({0.0, 0.0, 1.0}, spinAngle));
+    return Multiply(Multiply(this->invariable, euler), this->axes);
+  }
+
+  Quaternion TorqueFreeBody::Orientation(double _time) const
+  {
+    if (this->steady)
+    {
+      return Multiply(this->orientation, AxisAngle(this->spin,
+          std::sqrt(this->spin[0] * this->spin[0] +
+                    this->spin[1] * this->spin[1] +
+                    this->spin[2] * this->spin[2]) * _time));
+    }
+    return this->Orientation(_time, this->Precession(0.0, _time));
+  }
+
+  double TorqueFreeBody::Period() const
+  {
+    if (this->steady || this->parameter == 1.0 || this->rate == 0.0)
+      return std::numeric_limits<double>::infinity();
+
+    // sn, cn and dn repeat after four quarter periods K(m)
+    return 4.0 * EllipticF(M_PI / 2.0, this->parameter) /
+        std::fabs(this->rate);
+  }
+
+  void TorqueFreeBody::Evaluate(const std::vector<double> &_times
+                              , std::vector<Quaternion> &_orientations
+                              , std::vector<Vector3> &_angularVelocities)
+                              const
+  {
+    _orientations.resize(_times.size());
+    _angularVelocities.resize(_times.size());
+    double previous = 0.0;
+    double precession = 0.0;
+    for (size_t k = 0; k < _times.size(); ++k)
+    {
+      const double t = _times[k];
+      if (this->steady)
+        _orientations[k] = this->Orientation(t);
+      else
+      {
+        precession += this->Precession(previous, t);
+        previous = t;
+        _orientations[k] = this->Orientation(t, precession);
+      }
+      _angularVelocities[k] =
+          Rotate(_orientations[k], this->BodyAngularVelocity(t));
+    }
+  }
+
+  // State of the integration: body angular velocity and orientation.
+  typedef std::array<double, 7> RigidState;
+
+  static RigidState Derivative(const RigidState &_y, const Matrix3 &_inertia
+                             , const Matrix3 &_inverse)
+  {
+    const Vector3 w = {_y[0], _y[1], _y[2]};
+    Vector3 h;
+    for (int i = 0; i < 3; ++i)
+    {
+      h[i] = _inertia[i][0] * w[0] + _inertia[i][1] * w[1] +
+          _inertia[i][2] * w[2];
+    }
+    // I w' = (I w) x w
+    const Vector3 torque = {h[1] * w[2] - h[2] * w[1],
+                            h[2] * w[0] - h[0] * w[2],
+                            h[0] * w[1] - h[1] * w[0]};
+    RigidState d;
+    for (int i = 0; i < 3; ++i)
+    {
+      d[i] = _inverse[i][0] * torque[0] + _inverse[i][1] * torque[1] +
+          _inverse[i][2] * torque[2];
+    }
+    // q' = q (0, w) / 2
+    Quaternion q;
+    q.w = _y[3];
+    q.x = _y[4];
+    q.y = _y[5];
+    q.z = _y[6];
+    Quaternion v;
+    v.w = 0.0;
+    v.x = w[0];
+    v.y = w[1];
+    v.z = w[2];
+    const Quaternion dq = Multiply(q, v);
+    d[3] = dq.w / 2.0;
+    d[4] = dq.x / 2.0;
+    d[5] = dq.y / 2.0;
+    d[6] = dq.z / 2.0;
+    return d;
+  }
+
+  void IntegrateTorqueFree(const Matrix3 &_inertia
+                         , const Vector3 &_angularVelocity
+                         , const Quaternion &_orientation
+                         , const std::vector<double> &_times
+                         , std::vector<Quaternion> &_orientations
+                         , std::vector<Vector3> &_angularVelocities
+                         , double _tolerance)
+  {
+    // Inverse by cofactors
+    const Matrix3 &m = _inertia;
+    Matrix3 inverse;
+    for (int i = 0; i < 3; ++i)
+    {
+      for (int j = 0; j < 3; ++j)
+      {
+        const int i1 = (j + 1) % 3, i2 = (j + 2) % 3;
+        const int j1 = (i + 1) % 3, j2 = (i + 2) % 3;
+        inverse[i][j] = m[i1][j1] * m[i2][j2] - m[i1][j2] * m[i2][j1];
+      }
+    }
+    const double determinant = m[0][0] * inverse[0][0] +
+        m[0][1] * inverse[1][0] + m[0][2] * inverse[2][0];
+    for (auto &row : inverse)
+    {
+      for (double &value : row)
+        value /= determinant;
+    }
+
+    // Dormand-Prince 5(4) tableau, without the nodes as the equations do
+    // not depend on time
+    static const double a[7][6] = {
+        {0.0},
+        {1.0 / 5.0},
+        {3.0 / 40.0, 9.0 / 40.0},
+        {44.0 / 45.0, -56.0 / 15.0, 32.0 / 9.0},
+        {19372.0 / 6561.0, -25360.0 / 2187.0, 64448.0 / 6561.0,
+         -212.0 / 729.0},
+        {9017.0 / 3168.0, -355.0 / 33.0, 46732.0 / 5247.0, 49.0 / 176.0,
+         -5103.0 / 18656.0},
+        {35.0 / 384.0, 0.0, 500.0 / 1113.0, 125.0 / 192.0,
+         -2187.0 / 6784.0, 11.0 / 84.0}};
+    // Difference of the fifth and fourth order weights
+    static const double e[7] = {71.0 / 57600.0, 0.0, -71.0 / 16695.0,
+                                71.0 / 1920.0, -17253.0 / 339200.0,
+                                22.0 / 525.0, -1.0 / 40.0};
+
+    const Quaternion q0 = Normalized(_orientation);
+    const Vector3 w0 = Rotate(Conjugate(q0), _angularVelocity);
+    RigidState y = {w0[0], w0[1], w0[2], q0.w, q0.x, q0.y, q0.z};
+    const double speed = std::sqrt(w0[0] * w0[0] + w0[1] * w0[1] +
+                                   w0[2] * w0[2]);
+    double step = speed > 0.0 ? 0.01 / speed : 1.0;
+    double t = 0.0;
+
+    _orientations.resize(_times.size());
+    _angularVelocities.resize(_times.size());
+    RigidState k[7];
+    k[0] = Derivative(y, _inertia, inverse);
+    for (size_t n = 0; n < _times.size(); ++n)
+    {
+      while (t < _times[n])
+      {
+        const double h = std::min(step, _times[n] - t);
+        RigidState next;
+        for (int s = 1; s < 7; ++s)
+        {
+          RigidState stage = y;
+          for (int j = 0; j < s; ++j)
+          {
+            for (int i = 0; i < 7; ++i)
+              stage[i] += h * a[s][j] * k[j][i];
+          }
+          k[s] = Derivative(stage, _inertia, inverse);
+          if (s == 6)
+            next = stage;
+        }
+
+        double error = 0.0;
+        for (int i = 0; i < 7; ++i)
+        {
+          double local = 0.0;
+          for (int j = 0; j < 7; ++j)
+            local += e[j] * k[j][i];
+          const double scale = _tolerance * (1.0 +
+              std::max(std::fabs(y[i]), std::fabs(next[i])));
+          error = std::max(error, std::fabs(h * local) / scale);
+        }
+        const double factor = error > 0.0 ?
+            0.9 * std::pow(error, -0.2) : 5.0;
+        if (error <= 1.0)
+        {
+          // Back on the unit sphere, so the last stage is not reused
+          t = h == _times[n] - t ? _times[n] : t + h;
+          const double length = std::sqrt(next[3] * next[3] +
+              next[4] * next[4] + next[5] * next[5] + next[6] * next[6]);
+          for (int i = 3; i < 7; ++i)
+            next[i] /= length;
+          y = next;
+          k[0] = Derivative(y, _inertia, inverse);
+          // A step cut short to land on a sample does not shrink the next
+          if (h == step)
+            step = h * std::min(5.0, std::max(0.2, factor));
+        }
+        else
+          step = h * std::max(0.2, factor);
+      }
+      Quaternion q;
+      q.w = y[3];
+      q.x = y[4];
+      q.y = y[5];
+      q.z = y[6];
+      _orientations[n] = q;
+      _angularVelocities[n] = Rotate(q, {y[0], y[1], y[2]});
+    }
+  }
+}
@@ -0,0 +1,145 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#ifndef ANALYSIS_TORQUE_FREE_HH_
+#define ANALYSIS_TORQUE_FREE_HH_
+
+#include <array>
+#include <vector>
+
+namespace analysis
+{
+  typedef std::array<double, 3> Vector3;
+
+  // 3x3 matrix by rows.
+  typedef std::array<Vector3, 3> Matrix3;
+
+  // Rotation as a unit quaternion, w the scalar part.
+  struct Quaternion
+  {
+    double w = 1.0;
+    double x = 0.0;
+    double y = 0.0;
+    double z = 0.0;
+  };
+
+  // Jacobi elliptic functions sn, cn and dn of _u for the parameter
+  // _m = k^2 between 0 and 1, by the arithmetic-geometric mean.
+  void JacobiElliptic(double _u, double _m
+                    , double &_sn, double &_cn, double &_dn);
+
+  // Incomplete elliptic integral of the first kind F(_phi | _m) for any
+  // amplitude, the inverse of the amplitude of the elliptic functions.
+  double EllipticF(double _phi, double _m);
+
+  // Exact rotation of a rigid body without torques, as the boxes of the
+  // Chapter 4 benchmark in zero gravity. The body angular velocity is
+  // the Jacobi elliptic solution of Euler's equations, see Landau and
+  // Lifshitz, Mechanics, section 37, and the orientation follows from the
+  // fixed angular momentum, all but the angle about it in closed form.
+  // That one angle is the integral of a smooth periodic rate, taken by
+  // Gauss-Legendre quadrature to rounding accuracy.
+  class TorqueFreeBody
+  {
+    // _inertia holds the principal moments of inertia along the body
+    // axes, _angularVelocity the world angular velocity and _orientation
+    // the rotation from the body to the world at time 0.
+    public: TorqueFreeBody(const Vector3 &_inertia
+                         , const Vector3 &_angularVelocity
+                         , const Quaternion &_orientation = Quaternion());
+
+    // Angular velocity in the body frame at a time.
+    public: Vector3 BodyAngularVelocity(double _time) const;
+
+    // Orientations and world angular velocities at any number of times.
+    // The quadrature runs from one time to the next, so increasing times
+    // cost one short integral each.
+    public: void Evaluate(const std::vector<double> &_times
+                        , std::vector<Quaternion> &_orientations
+                        , std::vector<Vector3> &_angularVelocities) const;
+
+    // Orientation at a single time.
+    public: Quaternion Orientation(double _time) const;
+
+    // Period of the body angular velocity, twice the time between flips
+    // of a body spinning near its middle axis. Infinite for a steady
+    // rotation and on the separatrix.
+    public: double Period() const;
+
+    // Rate of the angle about the angular momentum of the frame of the
+    // elliptic solution.
+    private: double PrecessionRate(double _time) const;
+
+    // Integral of the precession rate between two times.
+    private: double Precession(double _from, double _to) const;
+
+    // Orientation given the precession angle at that time.
+    private: Quaternion Orientation(double _time, double _precession) const;
+
+    // Body angular velocity in the axes of the elliptic solution.
+    private: Vector3 SolutionAngularVelocity(double _time) const;
+
+    // Rotation at time 0, from the body to the world.
+    private: Quaternion orientation;
+
+    // Body angular velocity at time 0, for a steady rotation.
+    private: Vector3 spin;
+
+    // Whether the angular velocity stays along a principal axis.
+    private: bool steady = false;
+
+    // Rotation from the body axes to the axes of the elliptic solution,
+    // which are ordered by their moments of inertia.
+    private: Quaternion axes;
+
+    // Moments of inertia in the axes of the solution.
+    private: Vector3 inertia;
+
+    // Amplitudes of the angular velocity along the cn, sn and dn axes,
+    // with their signs.
+    private: Vector3 amplitude;
+
+    // Parameter, rate and phase of the elliptic functions.
+    private: double parameter = 0.0;
+    private: double rate = 0.0;
+    private: double phase = 0.0;
+
+    // Magnitude of the angular momentum.
+    private: double momentum = 0.0;
+
+    // Largest sub-interval of the quadrature.
+    private: double quadratureStep = 0.0;
+
+    // Rotation from the frame of the angular momentum to the world.
+    private: Quaternion invariable;
+  };
+
+  // Orientations and world angular velocities of a rigid body without
+  // torques at increasing times, by adaptive Dormand-Prince 5(4)
+  // integration of Euler's equations and the quaternion kinematics. This
+  // covers inertias with products of inertia, which TorqueFreeBody does
+  // not, and checks it otherwise. _inertia is in the body frame, the
+  // angular velocity in the world frame, and _tolerance bounds the
+  // relative error of every step.
+  void IntegrateTorqueFree(const Matrix3 &_inertia
+                         , const Vector3 &_angularVelocity
+                         , const Quaternion &_orientation
+                         , const std::vector<double> &_times
+                         , std::vector<Quaternion> &_orientations
+                         , std::vector<Vector3> &_angularVelocities
+                         , double _tolerance = 1e-12);
+}
+#endif
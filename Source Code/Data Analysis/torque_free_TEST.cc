@@ -0,0 +1,302 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "torque_free.hh"
+
+using namespace analysis;
+
+// Angle of the rotation between two orientations.
+static double AngleBetween(const Quaternion &_a, const Quaternion &_b)
+{
+  // Vector part of the conjugate of _a times _b
+  const double x = _a.w * _b.x - _a.x * _b.w - _a.y * _b.z + _a.z * _b.y;
+  const double y = _a.w * _b.y + _a.x * _b.z - _a.y * _b.w - _a.z * _b.x;
+  const double z = _a.w * _b.z - _a.x * _b.y + _a.y * _b.x - _a.z * _b.w;
+  return 2.0 * std::asin(std::min(1.0, std::sqrt(x * x + y * y + z * z)));
+}
+
+// _v rotated by _q.
+static Vector3 Rotate(const Quaternion &_q, const Vector3 &_v)
+{
+  // v + 2 u x (u x v + w v), u the vector part
+  const Vector3 u = {_q.x, _q.y, _q.z};
+  const Vector3 t = {u[1] * _v[2] - u[2] * _v[1] + _q.w * _v[0],
+                     u[2] * _v[0] - u[0] * _v[2] + _q.w * _v[1],
+                     u[0] * _v[1] - u[1] * _v[0] + _q.w * _v[2]};
+  return {_v[0] + 2.0 * (u[1] * t[2] - u[2] * t[1]),
+          _v[1] + 2.0 * (u[2] * t[0] - u[0] * t[2]),
+          _v[2] + 2.0 * (u[0] * t[1] - u[1] * t[0])};
+}
+
+// Euler's equations and the quaternion kinematics integrated with RK4.
+struct State
+{
+  Vector3 w;
+  Quaternion q;
+};
+
+static State Derivative(const State &_s, const Vector3 &_inertia)
+{
+  const Vector3 &w = _s.w;
+  const Vector3 &i = _inertia;
+  State d;
+  d.w = {(i[1] - i[2]) * w[1] * w[2] / i[0],
+         (i[2] - i[0]) * w[2] * w[0] / i[1],
+         (i[0] - i[1]) * w[0] * w[1] / i[2]};
+  const Quaternion &q = _s.q;
+  d.q.w = 0.5 * (-q.x * w[0] - q.y * w[1] - q.z * w[2]);
+  d.q.x = 0.5 * (q.w * w[0] + q.y * w[2] - q.z * w[1]);
+  d.q.y = 0.5 * (q.w * w[1] - q.x * w[2] + q.z * w[0]);
+  d.q.z = 0.5 * (q.w * w[2] + q.x * w[1] - q.y * w[0]);
+  return d;
+}
+
+static State Add(const State &_s, const State &_d, double _h)
+{
+  State r;
+  for (int j = 0; j < 3; ++j)
+    r.w[j] = _s.w[j] + _h * _d.w[j];
+  r.q.w = _s.q.w + _h * _d.q.w;
+  r.q.x = _s.q.x + _h * _d.q.x;
+  r.q.y = _s.q.y + _h * _d.q.y;
+  r.q.z = _s.q.z + _h * _d.q.z;
+  return r;
+}
+
+// Compare the exact solution with a fine RK4 integration over 10 s.
+static void ExpectMatchesIntegration(const Vector3 &_inertia
+                                   , const Vector3 &_bodyVelocity
+                                   , const Quaternion &_orientation)
+{
+  State s;
+  s.w = _bodyVelocity;
+  s.q = _orientation;
+  const TorqueFreeBody body(_inertia, Rotate(_orientation, _bodyVelocity),
+                            _orientation);
+
+  const double h = 1e-4;
+  std::vector<double> times;
+  std::vector<State> expected;
+  for (int i = 1; i <= 100000; ++i)
+  {
+    const State k1 = Derivative(s, _inertia);
+    const State k2 = Derivative(Add(s, k1, h / 2.0), _inertia);
+    const State k3 = Derivative(Add(s, k2, h / 2.0), _inertia);
+    const State k4 = Derivative(Add(s, k3, h), _inertia);
+    s = Add(s, k1, h / 6.0);
+    s = Add(s, k2, h / 3.0);
+    s = Add(s, k3, h / 3.0);
+    s = Add(s, k4, h / 6.0);
+    if (i % 100 == 0)
+    {
+      times.push_back(i * h);
+      expected.push_back(s);
+    }
+  }
+
+  std::vector<Quaternion> orientations;
+  std::vector<Vector3> velocities;
+  body.Evaluate(times, orientations, velocities);
+  double maxAngle = 0.0, maxRate = 0.0;
+  for (size_t k = 0; k < times.size(); ++k)
+  {
+    maxAngle = std::max(maxAngle,
+        AngleBetween(orientations[k], expected[k].q));
+    const Vector3 w = body.BodyAngularVelocity(times[k]);
+    for (int j = 0; j < 3; ++j)
+      maxRate = std::max(maxRate, std::fabs(w[j] - expected[k].w[j]));
+  }
+  EXPECT_LT(maxAngle, 1e-8);
+  EXPECT_LT(maxRate, 1e-8);
+
+  // A single time agrees with the batch
+  EXPECT_LT(AngleBetween(body.Orientation(times.back()),
+                         orientations.back()), 1e-10);
+}
+
+TEST(TorqueFree, JacobiElliptic)
+{
+  for (double m : {0.0, 0.3, 0.9, 0.999999, 1.0})
+  {
+    for (double u : {-3.0, -0.4, 0.0, 0.7, 2.5, 11.0})
+    {
+      double sn, cn, dn;
+      JacobiElliptic(u, m, sn, cn, dn);
+      EXPECT_NEAR(sn * sn + cn * cn, 1.0, 1e-14);
+      EXPECT_NEAR(dn * dn + m * sn * sn, 1.0, 1e-14);
+
+      // d sn / du = cn dn
+      const double e = 1e-5;
+      double snPlus, snMinus, unused1, unused2;
+      JacobiElliptic(u + e, m, snPlus, unused1, unused2);
+      JacobiElliptic(u - e, m, snMinus, unused1, unused2);
+      EXPECT_NEAR((snPlus - snMinus) / (2.0 * e), cn * dn, 1e-8);
+    }
+  }
+
+  // F inverts the amplitude, past a quarter period too
+  for (double m : {0.0, 0.5, 0.95})
+  {
+    for (double phi : {-2.5, -0.3, 0.0, 1.2, 2.0, 3.1, 7.0})
+    {
+      double sn, cn, dn;
+      JacobiElliptic(EllipticF(phi, m), m, sn, cn, dn);
+      EXPECT_NEAR(sn, std::sin(phi), 1e-13);
+      EXPECT_NEAR(cn, std::cos(phi), 1e-13);
+    }
+  }
+  // Complete integral K(0.5)
+  EXPECT_NEAR(EllipticF(M_PI / 2.0, 0.5), 1.854074677301372, 1e-14);
+}
+
+TEST(TorqueFree, Tumbling)
+{
+  // Complex box of the Chapter 4 benchmark, spinning about its middle
+  // axis
+  ExpectMatchesIntegration({0.80833333, 0.68333333, 0.14166667},
+                           {0.1, 5.0, 0.1}, Quaternion());
+}
+
+TEST(TorqueFree, NearLargestAxis)
+{
+  ExpectMatchesIntegration({0.80833333, 0.68333333, 0.14166667},
+                           {3.0, 0.5, 0.2}, Quaternion());
+}
+
+TEST(TorqueFree, UnorderedAxes)
+{
+  // Moments in no particular order and a rotated start
+  const double c = std::cos(0.3), s = std::sin(0.3);
+  ExpectMatchesIntegration({0.2, 0.9, 0.5}, {1.0, -0.4, 2.0},
+                           Quaternion{c, s * 0.6, 0.0, s * 0.8});
+  ExpectMatchesIntegration({0.5, 0.2, 0.9}, {-0.3, 2.0, 0.2},
+                           Quaternion());
+}
+
+TEST(TorqueFree, Separatrix)
+{
+  // Momentum of exactly the middle axis for the energy, k = 1
+  ExpectMatchesIntegration({1.0, 2.0, 3.0}, {std::sqrt(3.0), 0.0, 1.0},
+                           Quaternion());
+}
+
+TEST(TorqueFree, Symmetric)
+{
+  ExpectMatchesIntegration({1.0, 1.0, 2.0}, {0.3, 0.4, 1.0},
+                           Quaternion());
+}
+
+TEST(TorqueFree, Steady)
+{
+  // Simple box of the benchmark: a spin about a principal axis
+  ExpectMatchesIntegration({0.80833333, 0.68333333, 0.14166667},
+                           {0.5, 0.0, 0.0}, Quaternion());
+  const TorqueFreeBody body({0.80833333, 0.68333333, 0.14166667},
+                            {0.5, 0.0, 0.0});
+  const Quaternion q = body.Orientation(2.0);
+  EXPECT_NEAR(q.w, std::cos(0.5), 1e-15);
+  EXPECT_NEAR(q.x, std::sin(0.5), 1e-15);
+}
+
+TEST(TorqueFree, Period)
+{
+  // Near the middle axis the middle component flips every half period
+  const TorqueFreeBody body({1.0, 2.0, 3.0}, {0.1, 5.0, 0.1});
+  const double period = body.Period();
+  ASSERT_TRUE(std::isfinite(period));
+  for (double t = 0.0; t < 3.0; t += 0.7)
+  {
+    const Vector3 w = body.BodyAngularVelocity(t);
+    const Vector3 full = body.BodyAngularVelocity(t + period);
+    const Vector3 half = body.BodyAngularVelocity(t + period / 2.0);
+    for (int i = 0; i < 3; ++i)
+      EXPECT_NEAR(full[i], w[i], 1e-9);
+    EXPECT_NEAR(half[1], -w[1], 1e-9);
+  }
+
+  EXPECT_TRUE(std::isinf(
+      TorqueFreeBody({1.0, 2.0, 3.0}, {std::sqrt(3.0), 0.0, 1.0}).Period()));
+  EXPECT_TRUE(std::isinf(
+      TorqueFreeBody({1.0, 2.0, 3.0}, {0.5, 0.0, 0.0}).Period()));
+}
+
+TEST(TorqueFree, Integration)
+{
+  const Vector3 inertia = {0.80833333, 0.68333333, 0.14166667};
+  const Vector3 w0 = {0.1, 5.0, 0.1};
+  std::vector<double> times;
+  for (int i = 1; i <= 1000; ++i)
+    times.push_back(i * 0.01);
+  std::vector<Quaternion> exact, integrated;
+  std::vector<Vector3> exactRates, integratedRates;
+  TorqueFreeBody(inertia, w0).Evaluate(times, exact, exactRates);
+
+  // Principal axes along the body axes
+  const Matrix3 diagonal = {Vector3{inertia[0], 0.0, 0.0},
+                            Vector3{0.0, inertia[1], 0.0},
+                            Vector3{0.0, 0.0, inertia[2]}};
+  IntegrateTorqueFree(diagonal, w0, Quaternion(), times, integrated,
+                      integratedRates);
+  double maxAngle = 0.0;
+  for (size_t k = 0; k < times.size(); ++k)
+    maxAngle = std::max(maxAngle, AngleBetween(exact[k], integrated[k]));
+  EXPECT_LT(maxAngle, 1e-8);
+
+  // The same body with its principal axes rotated by r in the body frame:
+  // inertia r I r^T, orientation q r^T
+  const double c = std::cos(0.4), s = std::sin(0.4);
+  const Quaternion r = {c, s * 0.48, s * 0.6, s * 0.64};
+  const Vector3 axes[3] = {Rotate(r, {1.0, 0.0, 0.0}),
+                           Rotate(r, {0.0, 1.0, 0.0}),
+                           Rotate(r, {0.0, 0.0, 1.0})};
+  Matrix3 rotated;
+  for (int i = 0; i < 3; ++i)
+  {
+    for (int j = 0; j < 3; ++j)
+    {
+      rotated[i][j] = 0.0;
+      for (int p = 0; p < 3; ++p)
+        rotated[i][j] += axes[p][i] * inertia[p] * axes[p][j];
+    }
+  }
+  const Quaternion start = {r.w, -r.x, -r.y, -r.z};
+  IntegrateTorqueFree(rotated, w0, start, times, integrated,
+                      integratedRates);
+  maxAngle = 0.0;
+  double maxRate = 0.0;
+  for (size_t k = 0; k < times.size(); ++k)
+  {
+    // Back to the principal axes: q r
+    const Quaternion &q = integrated[k];
+    const Quaternion principal = {
+        q.w * r.w - q.x * r.x - q.y * r.y - q.z * r.z,
+        q.w * r.x + q.x * r.w + q.y * r.z - q.z * r.y,
+        q.w * r.y - q.x * r.z + q.y * r.w + q.z * r.x,
+        q.w * r.z + q.x * r.y - q.y * r.x + q.z * r.w};
+    maxAngle = std::max(maxAngle, AngleBetween(exact[k], principal));
+    for (int j = 0; j < 3; ++j)
+    {
+      maxRate = std::max(maxRate,
+          std::fabs(exactRates[k][j] - integratedRates[k][j]));
+    }
+  }
+  EXPECT_LT(maxAngle, 1e-8);
+  EXPECT_LT(maxRate, 1e-8);
+}
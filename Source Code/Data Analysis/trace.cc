@@ -0,0 +1,368 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#include "trace.hh"
+
+#include "csv_table.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+#include <limits>
+
+namespace analysis
+{
+  static const double nan = std::numeric_limits<double>::quiet_NaN();
+
+  int Trace::Column(const std::string &_name) const
+  {
+    for (size_t i = 0; i < this->names.size(); ++i)
+    {
+      if (this->names[i] == _name)
+        return static_cast<int>(i);
+    }
+    return -1;
+  }
+
+  bool ReadTrace(const std::string &_path, Trace &_trace
+               , std::string &_error)
+  {
+    Table table;
+    if (!ReadCsvTable(_path, table, _error))
+      return false;
+
+    _trace = Trace();
+    size_t timeIndex = 0;
+    for (size_t c = 0; c < table.columns.size(); ++c)
+    {
+      if (table.columns[c].name == "Time")
+        timeIndex = c;
+    }
+
+    // Values of every column, the fields of a string column that are
+    // numbers all the same included.
+    std::vector<const std::vector<double> *> values(table.columns.size());
+    std::vector<std::vector<double>> parsed(table.columns.size());
+    for (size_t c = 0; c < table.columns.size(); ++c)
+    {
+      const TableColumn &column = table.columns[c];
+      values[c] = &column.values;
+      if (column.numeric)
+        continue;
+      for (const auto &s : column.strings)
+      {
+        char *end = nullptr;
+        const double value = std::strtod(s.c_str(), &end);
+        parsed[c].push_back(s.empty() || *end != '\0' ? nan : value);
+      }
+      values[c] = &parsed[c];
+    }
+
+    for (size_t c = 0; c < table.columns.size(); ++c)
+    {
+      if (c != timeIndex)
+        _trace.names.push_back(table.columns[c].name);
+    }
+    _trace.columns.resize(_trace.names.size());
+    for (size_t r = 0; r < table.rows; ++r)
+    {
+      const double t = (*values[timeIndex])[r];
+      if (!std::isfinite(t) ||
+          (!_trace.time.empty() && t <= _trace.time.back()))
+      {
+        continue;
+      }
+      _trace.time.push_back(t);
+      for (size_t c = 0, i = 0; c < table.columns.size(); ++c)
+      {
+        if (c != timeIndex)
+          _trace.columns[i++].push_back((*values[c])[r]);
+      }
+    }
+    return true;
+  }
+
+  void ScaleLinearColumns(Trace &_trace, double _factor)
+  {
+    for (size_t i = 0; i < _trace.names.size(); ++i)
+    {
+      const std::string &name = _trace.names[i];
+      if (name.find("Angular") != std::string::npos)
+        continue;
+      if (name.find("Position") == std::string::npos &&
+          name.find("Velocity") == std::string::npos &&
+          name.find("Acceleration") == std::string::npos)
+      {
+        continue;
+      }
+      for (double &value : _trace.columns[i])
+        value *= _factor;
+    }
+  }
+
+  bool ParseInterpolation(const std::string &_name, Interpolation &_mode)
+  {
+    if (_name == "linear")
+      _mode = INTERPOLATE_LINEAR;
+    else if (_name == "nearest")
+      _mode = INTERPOLATE_NEAREST;
+    else if (_name == "previous")
+      _mode = INTERPOLATE_PREVIOUS;
+    else
+      return false;
+    return true;
+  }
+
+  void Resample(const std::vector<double> &_time
+              , const std::vector<double> &_values
+              , const std::vector<double> &_at
+              , Interpolation _mode
+              , std::vector<double> &_out)
+  {
+    _out.resize(_at.size());
+    const size_t count = _time.size();
+    if (count == 0)
+    {
+      std::fill(_out.begin(), _out.end(), nan);
+      return;
+    }
+
+    // Both are increasing, so one walk over the samples finds every
+    // interval: i is the last sample at or before the current time.
+    size_t i = 0;
+    for (size_t k = 0; k < _at.size(); ++k)
+    {
+      const double t = _at[k];
+      while (i + 1 < count && _time[i + 1] <= t)
+        ++i;
+      if (t <= _time[0])
+      {
+        _out[k] = _values[0];
+        continue;
+      }
+      if (i + 1 >= count)
+      {
+        _out[k] = _values[count - 1];
+        continue;
+      }
+
+      const double t0 = _time[i];
+      const double t1 = _time[i + 1];
+      switch (_mode)
+      {
+        case INTERPOLATE_LINEAR:
+          _out[k] = _values[i] +
+              (_values[i + 1] - _values[i]) * (t - t0) / (t1 - t0);
+          break;
+        case INTERPOLATE_NEAREST:
+          _out[k] = t - t0 <= t1 - t ? _values[i] : _values[i + 1];
+          break;
+        case INTERPOLATE_PREVIOUS:
+          _out[k] = _values[i];
+          break;
+      }
+    }
+  }
+
+  // In place radix-2 FFT, the size must be a power of two. _inverse
+  // leaves out the division by the size.
+  static void Fft(std::vector<std::complex<double>> &_data, bool _inverse)
+  {
+    const size_t n = _data.size();
+    for (size_t i = 1, j = 0; i < n; ++i)
+    {
+      size_t bit = n >> 1;
+      for (; j & bit; bit >>= 1)
+        j ^= bit;
+      j ^= bit;
+      if (i < j)
+        std::swap(_data[i], _data[j]);
+    }
+    for (size_t length = 2; length <= n; length <<= 1)
+    {
+      const double angle = (_inverse ? 2.0 : -2.0) * M_PI / length;
+      const std::complex<double> unit(std::cos(angle), std::sin(angle));
+      for (size_t i = 0; i < n; i += length)
+      {
+        std::complex<double> w(1.0, 0.0);
+        for (size_t j = 0; j < length / 2; ++j)
+        {
+          const std::complex<double> u = _data[i + j];
+          const std::complex<double> v = _data[i + j + length / 2] * w;
+          _data[i + j] = u + v;
+          _data[i + j + length / 2] = u - v;
+          w *= unit;
+        }
+      }
+    }
+  }
+
+  double PhaseLag(const std::vector<double> &_reference
+                , const std::vector<double> &_candidate
+                , double _step, double _maxLag)
+  {
+    const size_t count = std::min(_reference.size(), _candidate.size());
+    if (count < 3 || _step <= 0.0)
+      return nan;
+
+    double referenceMean = 0.0, candidateMean = 0.0;
+    for (size_t i = 0; i < count; ++i)
+    {
+      referenceMean += _reference[i];
+      candidateMean += _candidate[i];
+    }
+    referenceMean /= count;
+    candidateMean /= count;
+
+    // Zero padded to twice the length, so that the circular correlation
+    // of the FFT equals the linear one.
+    size_t size = 1;
+    while (size < 2 * count)
+      size <<= 1;
+    std::vector<std::complex<double>> a(size), b(size);
+    double referenceEnergy = 0.0, candidateEnergy = 0.0;
+    for (size_t i = 0; i < count; ++i)
+    {
+      a[i] = _reference[i] - referenceMean;
+      b[i] = _candidate[i] - candidateMean;
+      referenceEnergy += std::norm(a[i]);
+      candidateEnergy += std::norm(b[i]);
+    }
+    const double tiny = 1e-24 * count;
+    if (!(referenceEnergy > tiny) || !(candidateEnergy > tiny))
+      return nan;
+
+    // r[k] = sum a[n] b[n + k], negative k wrap around to the end
+    Fft(a, false);
+    Fft(b, false);
+    for (size_t i = 0; i < size; ++i)
+      a[i] = std::conj(a[i]) * b[i];
+    Fft(a, true);
+
+    const long maxShift = std::min(static_cast<long>(count) - 1,
+        static_cast<long>(std::floor(_maxLag / _step)));
+    auto r = [&](long _k)
+    {
+      return a[_k >= 0 ? _k : static_cast<long>(size) + _k].real();
+    };
+    long best = 0;
+    for (long k = -maxShift; k <= maxShift; ++k)
+    {
+      if (r(k) > r(best))
+        best = k;
+    }
+
+    // Parabola through the peak and its neighbors, for lags below a step
+    double offset = 0.0;
+    if (best > -maxShift && best < maxShift)
+    {
+      const double left = r(best - 1);
+      const double center = r(best);
+      const double right = r(best + 1);
+      const double curvature = left - 2.0 * center + right;
+      if (curvature < 0.0)
+        offset = 0.5 * (left - right) / curvature;
+    }
+    return (best + offset) * _step;
+  }
+
+  std::vector<ColumnError> Compare(const Trace &_reference
+                                 , const Trace &_candidate
+                                 , const CompareOptions &_options)
+  {
+    std::vector<ColumnError> errors;
+    if (_reference.time.size() < 2 || _candidate.time.size() < 2)
+      return errors;
+
+    const double begin =
+        std::max(_reference.time.front(), _candidate.time.front());
+    const double end = std::min(_reference.time.back(), _candidate.time.back());
+    if (!(end > begin))
+      return errors;
+
+    // Reference samples in the common range
+    const auto first = std::lower_bound(_reference.time.begin(),
+                                        _reference.time.end(), begin);
+    const auto last = std::upper_bound(first, _reference.time.end(), end);
+    const size_t offset = first - _reference.time.begin();
+    const std::vector<double> at(first, last);
+    if (at.size() < 2)
+      return errors;
+
+    // Uniform grid of the phase lag, at the median reference step
+    std::vector<double> steps(at.size() - 1);
+    for (size_t i = 0; i + 1 < at.size(); ++i)
+      steps[i] = at[i + 1] - at[i];
+    std::nth_element(steps.begin(), steps.begin() + steps.size() / 2,
+                     steps.end());
+    const double step = steps[steps.size() / 2];
+    const size_t uniformCount = std::min<size_t>(1 << 20,
+        static_cast<size_t>((end - begin) / step) + 1);
+    std::vector<double> uniform(uniformCount);
+    for (size_t i = 0; i < uniformCount; ++i)
+      uniform[i] = begin + i * step;
+
+    std::vector<double> candidate, referenceUniform, candidateUniform;
+    for (size_t c = 0; c < _reference.names.size(); ++c)
+    {
+      const int match = _candidate.Column(_reference.names[c]);
+      if (match < 0)
+        continue;
+      const std::vector<double> &referenceValues = _reference.columns[c];
+      const std::vector<double> &candidateValues = _candidate.columns[match];
+      Resample(_candidate.time, candidateValues, at,
+               _options.interpolation, candidate);
+
+      double referenceOrigin = 0.0, candidateOrigin = 0.0;
+      if (_options.relative)
+      {
+        referenceOrigin = referenceValues[offset];
+        candidateOrigin = candidate[0];
+      }
+
+      ColumnError error;
+      error.column = _reference.names[c];
+      double sum = 0.0;
+      for (size_t i = 0; i < at.size(); ++i)
+      {
+        const double difference = (candidate[i] - candidateOrigin) -
+            (referenceValues[offset + i] - referenceOrigin);
+        if (!std::isfinite(difference))
+          continue;
+        ++error.samples;
+        sum += difference * difference;
+        if (std::fabs(difference) > error.maxError)
+        {
+          error.maxError = std::fabs(difference);
+          error.maxErrorTime = at[i];
+        }
+      }
+      if (error.samples == 0)
+        continue;
+      error.rmse = std::sqrt(sum / error.samples);
+
+      Resample(_reference.time, referenceValues, uniform,
+               _options.interpolation, referenceUniform);
+      Resample(_candidate.time, candidateValues, uniform,
+               _options.interpolation, candidateUniform);
+      error.phaseLag = PhaseLag(referenceUniform, candidateUniform, step,
+                                _options.maxLag);
+      errors.push_back(error);
+    }
+    return errors;
+  }
+}
@@ -0,0 +1,130 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#ifndef ANALYSIS_TRACE_HH_
+#define ANALYSIS_TRACE_HH_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace analysis
+{
+  // A csv file of the results: one row per sample, a Time column and any
+  // number of named value columns.
+  struct Trace
+  {
+    // Index of a value column, -1 if there is none of that name.
+    int Column(const std::string &_name) const;
+
+    // Sample times in seconds, strictly increasing.
+    std::vector<double> time;
+
+    // Names of the value columns, without the Time column.
+    std::vector<std::string> names;
+
+    // Values of every column, one entry per sample. Fields that are not
+    // numbers are NaN.
+    std::vector<std::vector<double>> columns;
+  };
+
+  // Read a results csv. The time column is the one named Time, or the
+  // first column if none is. Names are trimmed, so that "Y Velocity " and
+  // "Y Velocity" match, and the empty column of a trailing comma is
+  // dropped. Rows whose time does not increase are skipped, Unreal writes
+  // one when two frames share a time stamp.
+  // Returns false and sets _error if the file could not be read.
+  bool ReadTrace(const std::string &_path, Trace &_trace
+               , std::string &_error);
+
+  // Multiply the position, velocity and acceleration columns of a trace,
+  // the angular ones excluded. Unreal writes lengths in centimeters.
+  void ScaleLinearColumns(Trace &_trace, double _factor);
+
+  // How a trace is evaluated between its samples.
+  enum Interpolation
+  {
+    // Straight line between the two neighboring samples.
+    INTERPOLATE_LINEAR,
+
+    // Value of the closest sample.
+    INTERPOLATE_NEAREST,
+
+    // Value of the last sample at or before the time, as a frame-driven
+    // engine holds its state until the next tick.
+    INTERPOLATE_PREVIOUS
+  };
+
+  // Parse an interpolation name: linear, nearest or previous.
+  // Returns false if the name is none of them.
+  bool ParseInterpolation(const std::string &_name, Interpolation &_mode);
+
+  // Evaluate samples _values at times _time at increasing times _at.
+  // Times outside of the samples take the first or last value.
+  void Resample(const std::vector<double> &_time
+              , const std::vector<double> &_values
+              , const std::vector<double> &_at
+              , Interpolation _mode
+              , std::vector<double> &_out);
+
+  // Lag of _candidate behind _reference, both sampled every _step
+  // seconds, from the peak of their cross-correlation within _maxLag
+  // seconds either way. Positive when the candidate is late. NaN when
+  // either signal is constant.
+  double PhaseLag(const std::vector<double> &_reference
+                , const std::vector<double> &_candidate
+                , double _step, double _maxLag);
+
+  // Options of a trace comparison.
+  struct CompareOptions
+  {
+    Interpolation interpolation = INTERPOLATE_LINEAR;
+
+    // Subtract the value at the start of the common time range from
+    // both traces, for results with different origins.
+    bool relative = false;
+
+    // Largest phase lag searched for, seconds.
+    double maxLag = 0.5;
+  };
+
+  // Difference of one column of two traces.
+  struct ColumnError
+  {
+    std::string column;
+
+    // Reference samples inside the time range of both traces.
+    std::size_t samples = 0;
+
+    double rmse = 0.0;
+    double maxError = 0.0;
+
+    // Time of the largest difference.
+    double maxErrorTime = 0.0;
+
+    // Lag of the candidate behind the reference, seconds.
+    double phaseLag = 0.0;
+  };
+
+  // Compare every column that two traces share. The candidate is
+  // evaluated at the reference samples inside the time range of both,
+  // a fixed step reference against a frame-driven candidate compares at
+  // the fixed steps. Columns are in the order of the reference.
+  std::vector<ColumnError> Compare(const Trace &_reference
+                                 , const Trace &_candidate
+                                 , const CompareOptions &_options);
+}
+#endif
@@ -0,0 +1,150 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "trace.hh"
+
+using namespace analysis;
+
+// Write a csv file to a temporary path and return the path.
+static std::string WriteCsv(const std::string &_name
+                          , const std::string &_contents)
+{
+  const std::string path =
+      (std::filesystem::temp_directory_path() / _name).string();
+  std::ofstream file(path.c_str());
+  file << _contents;
+  return path;
+}
+
+// A trace with one column sampled every _step seconds.
+static Trace Sampled(double _step, double _duration
+                   , double (*_f)(double))
+{
+  Trace trace;
+  trace.names.push_back("Value");
+  trace.columns.resize(1);
+  for (int i = 0; i * _step <= _duration; ++i)
+  {
+    trace.time.push_back(i * _step);
+    trace.columns[0].push_back(_f(i * _step));
+  }
+  return trace;
+}
+
+TEST(Trace, Read)
+{
+  // Header with a padded name and the trailing comma of the Unreal files,
+  // a repeated time stamp and a field that is not a number.
+  const std::string path = WriteCsv("trace_read.csv",
+      "Time,X Position,Y Velocity ,\n"
+      "0.0,1.0,2.0,\n"
+      "0.5,1.5,x,\n"
+      "0.5,9.0,9.0,\n"
+      "1.0,2.0\n");
+  Trace trace;
+  std::string error;
+  ASSERT_TRUE(ReadTrace(path, trace, error)) << error;
+  std::remove(path.c_str());
+
+  ASSERT_EQ(trace.names.size(), 2u);
+  EXPECT_EQ(trace.Column("X Position"), 0);
+  EXPECT_EQ(trace.Column("Y Velocity"), 1);
+  EXPECT_EQ(trace.Column("Time"), -1);
+  ASSERT_EQ(trace.time.size(), 3u);
+  EXPECT_DOUBLE_EQ(trace.time[2], 1.0);
+  EXPECT_DOUBLE_EQ(trace.columns[0][1], 1.5);
+  EXPECT_TRUE(std::isnan(trace.columns[1][1]));
+  EXPECT_TRUE(std::isnan(trace.columns[1][2]));
+
+  ScaleLinearColumns(trace, 0.01);
+  EXPECT_DOUBLE_EQ(trace.columns[0][0], 0.01);
+
+  EXPECT_FALSE(ReadTrace("/nonexistent/missing.csv", trace, error));
+}
+
+TEST(Trace, Resample)
+{
+  const std::vector<double> time{0.0, 1.0, 2.0};
+  const std::vector<double> values{0.0, 10.0, 20.0};
+  const std::vector<double> at{-1.0, 0.25, 0.75, 1.0, 3.0};
+  std::vector<double> out;
+
+  Resample(time, values, at, INTERPOLATE_LINEAR, out);
+  EXPECT_DOUBLE_EQ(out[0], 0.0);
+  EXPECT_DOUBLE_EQ(out[1], 2.5);
+  EXPECT_DOUBLE_EQ(out[2], 7.5);
+  EXPECT_DOUBLE_EQ(out[3], 10.0);
+  EXPECT_DOUBLE_EQ(out[4], 20.0);
+
+  Resample(time, values, at, INTERPOLATE_NEAREST, out);
+  EXPECT_DOUBLE_EQ(out[1], 0.0);
+  EXPECT_DOUBLE_EQ(out[2], 10.0);
+
+  Resample(time, values, at, INTERPOLATE_PREVIOUS, out);
+  EXPECT_DOUBLE_EQ(out[1], 0.0);
+  EXPECT_DOUBLE_EQ(out[2], 0.0);
+  EXPECT_DOUBLE_EQ(out[3], 10.0);
+}
+
+static double Sine(double _t)
+{
+  return std::sin(2.0 * M_PI * _t);
+}
+
+static double LateSine(double _t)
+{
+  return std::sin(2.0 * M_PI * (_t - 0.0375)) + 0.1;
+}
+
+TEST(Trace, Compare)
+{
+  // Fixed step reference against a candidate on a coarser frame time
+  // that is 37.5 ms late and offset by 0.1.
+  const Trace reference = Sampled(0.001, 4.0, Sine);
+  const Trace candidate = Sampled(0.0125, 4.0, LateSine);
+  CompareOptions options;
+  std::vector<ColumnError> errors = Compare(reference, candidate, options);
+  ASSERT_EQ(errors.size(), 1u);
+  EXPECT_EQ(errors[0].column, "Value");
+  EXPECT_EQ(errors[0].samples, 4001u);
+  EXPECT_NEAR(errors[0].phaseLag, 0.0375, 0.001);
+
+  const double chord = 2.0 * std::sin(M_PI * 0.0375);
+  EXPECT_NEAR(errors[0].maxError, chord + 0.1, 0.01);
+  EXPECT_NEAR(errors[0].rmse, std::sqrt(0.5 * chord * chord + 0.01), 0.01);
+
+  // The same traces compare equal to themselves
+  errors = Compare(reference, reference, options);
+  ASSERT_EQ(errors.size(), 1u);
+  EXPECT_DOUBLE_EQ(errors[0].rmse, 0.0);
+  EXPECT_NEAR(errors[0].phaseLag, 0.0, 1e-9);
+}
+
+TEST(Trace, PhaseLagOfConstant)
+{
+  const std::vector<double> constant(100, 1.0);
+  const std::vector<double> ramp{0.0, 1.0, 2.0, 3.0};
+  EXPECT_TRUE(std::isnan(PhaseLag(constant, constant, 0.01, 0.5)));
+  EXPECT_TRUE(std::isnan(PhaseLag(ramp, constant, 0.01, 0.5)));
+}
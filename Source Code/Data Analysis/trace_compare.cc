@@ -0,0 +1,400 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+// Compares the traces of every experiment under a results directory and
+// writes one summary table. An experiment is a directory holding two or
+// more "<Engine> Results" directories, as in Results/Raw Data:
+//   Experiment  1 - Gravity Drop Test/10 Meters/{Gazebo,Unreal,...} Results
+//   Complex Scenario/{Gazebo,Unreal} Results/<dt>/
+// Every pair of engines is compared, the first of Theoretical, Gazebo and
+// Unreal being the reference. Files of the same name in the same sub
+// directory are paired, the remaining files of a sub directory are
+// paired with each other, --skip leaves out the ones that should not be.
+// For Chapter 4 that is the cubes besides the benchmarked one:
+//   trace_compare "Results/Raw Data" summary.csv
+//       --skip "*_Complex_ExperimentalCube*"
+//       --skip "*_Simple_ExperimentalCube*"
+// All traces are read, then all pairs compared, on every core.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "parallel.hh"
+#include "trace.hh"
+
+namespace fs = std::filesystem;
+
+static void Usage()
+{
+  std::cerr << "Usage: trace_compare <results directory> <summary csv>"
+            << " [options]\n"
+            << "  --interpolation MODE  linear, nearest or previous\n"
+            << "  --relative            compare changes from the start\n"
+            << "  --max-lag S           largest phase lag searched for\n"
+            << "  --scale PATTERN=F     multiply lengths of matching traces\n"
+            << "  --skip PATTERN        leave out matching file names\n"
+            << "  --jobs N              threads\n"
+            << "Patterns may use * and ?. --scale patterns match the path"
+            << " from the results\ndirectory, for example"
+            << " \"Chapter 3/*/Unreal Results/*=0.01\".\n";
+}
+
+// Options of a comparison.
+struct Options
+{
+  std::string root;
+  std::string output;
+  analysis::CompareOptions compare;
+  std::vector<std::pair<std::string, double>> scales;
+  std::vector<std::string> skips;
+  int jobs = 1;
+};
+
+// Two traces of one experiment to compare.
+struct Pair
+{
+  std::string experiment;
+  size_t reference;
+  size_t candidate;
+};
+
+// Match a name against a pattern with * and ? wildcards.
+static bool Match(const char *_pattern, const char *_name)
+{
+  if (*_pattern == '\0')
+    return *_name == '\0';
+  if (*_pattern == '*')
+  {
+    for (const char *p = _name; ; ++p)
+    {
+      if (Match(_pattern + 1, p))
+        return true;
+      if (*p == '\0')
+        return false;
+    }
+  }
+  if (*_name == '\0')
+    return false;
+  return (*_pattern == '?' || *_pattern == *_name) &&
+      Match(_pattern + 1, _name + 1);
+}
+
+// Order of the engines as references, the others follow by name.
+static int EngineRank(const std::string &_engine)
+{
+  if (_engine == "Theoretical")
+    return 0;
+  if (_engine == "Gazebo")
+    return 1;
+  if (_engine == "Unreal")
+    return 2;
+  return 3;
+}
+
+// Quote a csv field if it needs it.
+static std::string CsvField(const std::string &_s)
+{
+  if (_s.find_first_of(",\"\n") == std::string::npos)
+    return _s;
+  std::string quoted = "\"";
+  for (char c : _s)
+  {
+    if (c == '"')
+      quoted += '"';
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+// Find the experiments under the root, their traces and the pairs to
+// compare. _files are relative to the root.
+static void FindPairs(const Options &_options
+                    , std::vector<std::string> &_files
+                    , std::vector<Pair> &_pairs)
+{
+  const fs::path root(_options.root);
+  std::vector<fs::path> directories{root};
+  for (const auto &entry : fs::recursive_directory_iterator(root))
+  {
+    if (entry.is_directory())
+      directories.push_back(entry.path());
+  }
+  std::sort(directories.begin(), directories.end());
+
+  const std::string suffix = " Results";
+  for (const auto &directory : directories)
+  {
+    std::vector<std::pair<int, std::string>> engines;
+    for (const auto &entry : fs::directory_iterator(directory))
+    {
+      const std::string name = entry.path().filename().string();
+      if (entry.is_directory() && name.size() > suffix.size() &&
+          name.compare(name.size() - suffix.size(), suffix.size(),
+                       suffix) == 0)
+      {
+        const std::string engine = name.substr(0, name.size() - suffix.size());
+        engines.push_back(std::make_pair(EngineRank(engine), name));
+      }
+    }
+    if (engines.size() < 2)
+      continue;
+    std::sort(engines.begin(), engines.end());
+    const std::string experiment =
+        fs::relative(directory, root).generic_string();
+
+    // Sub directory -> csv files of every engine, by index of _files
+    std::vector<std::map<std::string, std::vector<size_t>>>
+        files(engines.size());
+    for (size_t e = 0; e < engines.size(); ++e)
+    {
+      const fs::path engineDirectory = directory / engines[e].second;
+      std::vector<fs::path> paths;
+      for (const auto &entry :
+           fs::recursive_directory_iterator(engineDirectory))
+      {
+        if (entry.is_regular_file() && entry.path().extension() == ".csv")
+          paths.push_back(entry.path());
+      }
+      std::sort(paths.begin(), paths.end());
+      for (const auto &path : paths)
+      {
+        const std::string name = path.filename().string();
+        bool skip = false;
+        for (const auto &pattern : _options.skips)
+          skip = skip || Match(pattern.c_str(), name.c_str());
+        if (skip)
+          continue;
+        const std::string sub = fs::relative(path.parent_path(),
+            engineDirectory).generic_string();
+        files[e][sub].push_back(_files.size());
+        _files.push_back(fs::relative(path, root).generic_string());
+      }
+    }
+
+    for (size_t r = 0; r < engines.size(); ++r)
+    {
+      for (size_t c = r + 1; c < engines.size(); ++c)
+      {
+        for (const auto &sub : files[r])
+        {
+          const auto other = files[c].find(sub.first);
+          if (other == files[c].end())
+            continue;
+
+          // Files of the same name, then all the others with each other
+          auto name = [&](size_t _file)
+          {
+            return fs::path(_files[_file]).filename().string();
+          };
+          std::map<std::string, size_t> referenceNames, candidateNames;
+          for (size_t reference : sub.second)
+            referenceNames[name(reference)] = reference;
+          for (size_t candidate : other->second)
+            candidateNames[name(candidate)] = candidate;
+          std::vector<size_t> references, candidates;
+          for (const auto &reference : referenceNames)
+          {
+            const auto same = candidateNames.find(reference.first);
+            if (same != candidateNames.end())
+            {
+              _pairs.push_back(
+                  Pair{experiment, reference.second, same->second});
+            }
+            else
+              references.push_back(reference.second);
+          }
+          for (const auto &candidate : candidateNames)
+          {
+            if (!referenceNames.count(candidate.first))
+              candidates.push_back(candidate.second);
+          }
+          for (size_t reference : references)
+          {
+            for (size_t candidate : candidates)
+              _pairs.push_back(Pair{experiment, reference, candidate});
+          }
+        }
+      }
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 3 || argv[1][0] == '-' || argv[2][0] == '-')
+  {
+    Usage();
+    return 1;
+  }
+
+  Options options;
+  options.root = argv[1];
+  options.output = argv[2];
+  options.jobs = analysis::DefaultJobs();
+  for (int i = 3; i < argc; ++i)
+  {
+    const std::string option = argv[i];
+    if (option == "--relative")
+    {
+      options.compare.relative = true;
+      continue;
+    }
+    if (i + 1 >= argc)
+    {
+      Usage();
+      return 1;
+    }
+    const std::string value = argv[++i];
+    if (option == "--interpolation")
+    {
+      if (!analysis::ParseInterpolation(value, options.compare.interpolation))
+      {
+        std::cerr << "Unknown interpolation " << value << std::endl;
+        return 1;
+      }
+    }
+    else if (option == "--max-lag")
+      options.compare.maxLag = std::atof(value.c_str());
+    else if (option == "--scale")
+    {
+      const size_t equals = value.rfind('=');
+      if (equals == std::string::npos)
+      {
+        Usage();
+        return 1;
+      }
+      options.scales.push_back(std::make_pair(value.substr(0, equals),
+          std::atof(value.c_str() + equals + 1)));
+    }
+    else if (option == "--skip")
+      options.skips.push_back(value);
+    else if (option == "--jobs")
+      options.jobs = std::max(1, std::atoi(value.c_str()));
+    else
+    {
+      std::cerr << "Unknown option " << option << std::endl;
+      Usage();
+      return 1;
+    }
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::string> files;
+  std::vector<Pair> pairs;
+  try
+  {
+    FindPairs(options, files, pairs);
+  }
+  catch (const fs::filesystem_error &_e)
+  {
+    std::cerr << _e.what() << std::endl;
+    return 1;
+  }
+
+  // Read every paired trace once, largest first so that no thread is
+  // left with a big file at the end.
+  std::vector<bool> paired(files.size(), false);
+  for (const auto &pair : pairs)
+    paired[pair.reference] = paired[pair.candidate] = true;
+  std::vector<size_t> order;
+  std::vector<uintmax_t> sizes(files.size());
+  uintmax_t bytes = 0;
+  for (size_t i = 0; i < files.size(); ++i)
+  {
+    if (!paired[i])
+      continue;
+    order.push_back(i);
+    sizes[i] = fs::file_size(fs::path(options.root) / files[i]);
+    bytes += sizes[i];
+  }
+  std::sort(order.begin(), order.end(), [&](size_t _a, size_t _b)
+  {
+    return sizes[_a] > sizes[_b];
+  });
+  std::vector<analysis::Trace> traces(files.size());
+  std::vector<std::string> errors(files.size());
+  analysis::ParallelFor(order.size(), options.jobs, [&](size_t _i)
+  {
+    const size_t file = order[_i];
+    const std::string path = (fs::path(options.root) / files[file]).string();
+    if (!analysis::ReadTrace(path, traces[file], errors[file]))
+      return;
+    for (const auto &scale : options.scales)
+    {
+      if (Match(scale.first.c_str(), files[file].c_str()))
+        analysis::ScaleLinearColumns(traces[file], scale.second);
+    }
+  });
+  for (const auto &error : errors)
+  {
+    if (!error.empty())
+      std::cerr << error << std::endl;
+  }
+
+  std::vector<std::vector<analysis::ColumnError>> results(pairs.size());
+  analysis::ParallelFor(pairs.size(), options.jobs, [&](size_t _i)
+  {
+    results[_i] = analysis::Compare(traces[pairs[_i].reference],
+        traces[pairs[_i].candidate], options.compare);
+  });
+
+  std::ofstream summary(options.output.c_str());
+  if (!summary)
+  {
+    std::cerr << "Could not write " << options.output << std::endl;
+    return 1;
+  }
+  summary << "Experiment,Reference,Candidate,Column,Samples,RMSE,Max Error,"
+          << "Max Error Time,Phase Lag\n";
+  summary.precision(9);
+  size_t rows = 0;
+  for (size_t i = 0; i < pairs.size(); ++i)
+  {
+    const Pair &pair = pairs[i];
+    const size_t prefix = pair.experiment == "." ?
+        0 : pair.experiment.size() + 1;
+    for (const auto &column : results[i])
+    {
+      summary << CsvField(pair.experiment) << ','
+              << CsvField(files[pair.reference].substr(prefix)) << ','
+              << CsvField(files[pair.candidate].substr(prefix)) << ','
+              << CsvField(column.column) << ',' << column.samples << ','
+              << column.rmse << ',' << column.maxError << ','
+              << column.maxErrorTime << ',';
+      if (std::isfinite(column.phaseLag))
+        summary << column.phaseLag;
+      summary << '\n';
+      ++rows;
+    }
+  }
+
+  const double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  std::cout << "Compared " << pairs.size() << " pairs of " << order.size()
+            << " traces (" << bytes / 1000000.0 << " MB), " << rows
+            << " columns in " << seconds << " s on " << options.jobs
+            << " threads" << std::endl;
+  return 0;
+}
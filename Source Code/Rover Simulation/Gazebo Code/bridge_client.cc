@@ -0,0 +1,115 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+// Example controller for the rover bridge. It holds the forward speed of
+// the rover with a PI controller on the wheel torques, answering every
+// state as soon as it arrives, and prints how long states took to reach
+// it:
+//   bridge_client <bridge name> [speed m/s] [steps]
+// Start the simulation with the bridge configured first, see
+// rover_movement.cc.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rover_bridge.hh"
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s <bridge name> [speed] [steps]\n", argv[0]);
+    return 1;
+  }
+  const std::string name = argv[1];
+  const double speed = argc > 2 ? atof(argv[2]) : 1.0;
+  const long steps = argc > 3 ? atol(argv[3]) : 10000;
+
+  rover::RoverBridge bridge;
+  while (!bridge.Open(name))
+  {
+    fprintf(stderr, "waiting for bridge %s\n", name.c_str());
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+  }
+
+  const double kp = 20.0;
+  const double ki = 10.0;
+  const double maxTorque = 5.0;
+  double integral = 0.0;
+  double lastTime = -1.0;
+  std::vector<double> latencies;
+  latencies.reserve(steps);
+
+  rover::BridgeState state;
+  int64_t lastReceived = rover::RoverBridge::Now();
+  while (static_cast<long>(latencies.size()) < steps)
+  {
+    // Spin, a sleep would cost more than the whole transfer. Yielding
+    // keeps the simulator running when both share a core.
+    if (!bridge.ReceiveState(state))
+    {
+      if (rover::RoverBridge::Now() - lastReceived > 5000000000LL)
+      {
+        fprintf(stderr, "no state for 5 s, stopping\n");
+        break;
+      }
+      std::this_thread::yield();
+      continue;
+    }
+    lastReceived = rover::RoverBridge::Now();
+    latencies.push_back((lastReceived - state.stamp) * 1e-3);
+
+    // Forward speed along the heading of the chassis
+    const double w = state.orientation[0];
+    const double x = state.orientation[1];
+    const double y = state.orientation[2];
+    const double z = state.orientation[3];
+    const double headingX = 1.0 - 2.0 * (y * y + z * z);
+    const double headingY = 2.0 * (x * y + w * z);
+    const double forward = state.linearVelocity[0] * headingX
+                         + state.linearVelocity[1] * headingY;
+
+    const double dt = lastTime < 0.0 ? 0.0 : state.time - lastTime;
+    lastTime = state.time;
+    const double error = speed - forward;
+    integral = std::min(std::max(integral + error * dt, -maxTorque / ki),
+                        maxTorque / ki);
+    const double torque =
+        std::min(std::max(kp * error + ki * integral, -maxTorque), maxTorque);
+
+    rover::BridgeCommand command;
+    command.step = state.step;
+    command.mode = rover::BRIDGE_TORQUE;
+    command.reserved = 0;
+    for (int i = 0; i < rover::bridgeWheelCount; ++i)
+      command.wheels[i] = torque;
+    bridge.SendCommand(command);
+  }
+
+  if (latencies.empty())
+    return 1;
+  std::sort(latencies.begin(), latencies.end());
+  const size_t n = latencies.size();
+  printf("states %zu, dropped %llu\n", n,
+         static_cast<unsigned long long>(bridge.DroppedStates()));
+  printf("state latency us: median %.2f, p99 %.2f, max %.2f\n",
+         latencies[n / 2], latencies[n * 99 / 100], latencies[n - 1]);
+  return 0;
+}
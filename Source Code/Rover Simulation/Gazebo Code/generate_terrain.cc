@@ -0,0 +1,129 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+// Generates a procedural terrain for the rover:
+//   generate_terrain <output directory> [--option value ...]
+// The directory gets heightmap tiles for Gazebo (.png) and Unreal (.r16)
+// at every LOD, terrain.manifest and terrain.world.
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "terrain_generator.hh"
+
+static void Usage()
+{
+  std::cerr << "Usage: generate_terrain <output directory> [options]\n"
+            << "  --seed N              random seed\n"
+            << "  --size M              terrain side in meters\n"
+            << "  --tile-size M         collision tile side in meters\n"
+            << "  --tile-resolution N   samples per tile side, 2^n + 1\n"
+            << "  --lod-levels N        number of LOD levels\n"
+            << "  --lod-distance M      distance per LOD step in meters\n"
+            << "  --amplitude M         noise amplitude in meters\n"
+            << "  --crater-density N    craters per square kilometer\n"
+            << "  --rock-fraction F     fraction of 2m cells with a rock\n"
+            << "  --streaming 0|1       stream tiles with terrain_streamer\n";
+}
+
+// Returns true if _n is 2^k + 1 for some k >= 1.
+static bool IsPowerOfTwoPlusOne(int _n)
+{
+  const int m = _n - 1;
+  return m > 0 && (m & (m - 1)) == 0;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2 || argv[1][0] == '-')
+  {
+    Usage();
+    return 1;
+  }
+
+  rover::TerrainParams params;
+  bool streaming = false;
+  for (int i = 2; i < argc; i += 2)
+  {
+    if (i + 1 >= argc)
+    {
+      Usage();
+      return 1;
+    }
+    const std::string option = argv[i];
+    const char *value = argv[i + 1];
+    if (option == "--seed")
+      params.seed = std::strtoull(value, nullptr, 10);
+    else if (option == "--size")
+      params.size = std::atof(value);
+    else if (option == "--tile-size")
+      params.tileSize = std::atof(value);
+    else if (option == "--tile-resolution")
+      params.tileResolution = std::atoi(value);
+    else if (option == "--lod-levels")
+      params.lodLevels = std::atoi(value);
+    else if (option == "--lod-distance")
+      params.lodDistance = std::atof(value);
+    else if (option == "--amplitude")
+      params.amplitude = std::atof(value);
+    else if (option == "--crater-density")
+      params.craterDensity = std::atof(value);
+    else if (option == "--rock-fraction")
+      params.rockFraction = std::atof(value);
+    else if (option == "--streaming")
+      streaming = std::atoi(value) != 0;
+    else
+    {
+      std::cerr << "Unknown option " << option << std::endl;
+      Usage();
+      return 1;
+    }
+  }
+
+  if (params.lodLevels < 1)
+  {
+    std::cerr << "There must be at least one LOD level" << std::endl;
+    return 1;
+  }
+  // Shifts by the bit width of int or more are undefined
+  if (!IsPowerOfTwoPlusOne(params.tileResolution) || params.lodLevels > 30 ||
+      ((params.tileResolution - 1) >> (params.lodLevels - 1)) < 2)
+  {
+    std::cerr << "Tile resolution must be 2^n + 1 with at least 3 samples "
+              << "left at the coarsest LOD" << std::endl;
+    return 1;
+  }
+
+  rover::TerrainGenerator generator(params);
+  const int tiles = generator.TilesPerSide();
+  if (tiles < 1)
+  {
+    std::cerr << "Terrain size must be at least one tile" << std::endl;
+    return 1;
+  }
+  std::cout << "Generating " << tiles << " x " << tiles << " tiles, "
+            << params.lodLevels << " LOD levels" << std::endl;
+
+  if (!generator.Write(argv[1], streaming))
+  {
+    std::cerr << "Failed to write terrain to " << argv[1] << std::endl;
+    return 1;
+  }
+  std::cout << "Wrote " << argv[1] << "/terrain.world" << std::endl;
+  return 0;
+}
@@ -0,0 +1,230 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#ifndef ROVER_REPLAY_LOG_HH_
+#define ROVER_REPLAY_LOG_HH_
+
+// Header only, so that the Unreal project and the replay tools can use it
+// as well.
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace rover
+{
+  // Kinds of actuation a replay log holds. Values are in the units of the
+  // simulator that wrote the log.
+  enum ReplayActuationKind : uint32_t
+  {
+    // Force on a body, set for one step
+    REPLAY_FORCE = 0,
+    // Torque on a body, set for one step
+    REPLAY_TORQUE = 1,
+    // Linear velocity of a body, set once
+    REPLAY_LINEAR_VELOCITY = 2,
+    // Angular velocity of a body, set once
+    REPLAY_ANGULAR_VELOCITY = 3,
+    // Effort of a joint, in value[0]
+    REPLAY_JOINT_FORCE = 4,
+    // Velocity of a joint, in value[0]
+    REPLAY_JOINT_VELOCITY = 5
+  };
+
+  // One actuation applied before a step.
+  struct ReplayActuation
+  {
+    // Index into the target names of the log.
+    uint32_t target;
+    uint32_t kind;
+    double value[3];
+  };
+
+  // Everything needed to run one step again: its schedule, the hash of
+  // the state it started from and the actuations applied before it.
+  struct ReplayStep
+  {
+    uint64_t step = 0;
+    // Step size, s.
+    double dt = 0.0;
+    // Simulation time at the start of the step, s.
+    double time = 0.0;
+    // Wall clock time since the previous step started, s. This is what
+    // the previous step cost, used to find slow segments.
+    double wallTime = 0.0;
+    uint64_t stateHash = 0;
+    std::vector<ReplayActuation> actuations;
+  };
+
+  // FNV-1a hash of the exact bits of a state. Any difference in any value,
+  // however small, changes the hash, so equal hashes on replay mean the
+  // run is bit for bit the same.
+  class StateHash
+  {
+    public: void Add(const void *_data, std::size_t _size)
+    {
+      const unsigned char *bytes = static_cast<const unsigned char *>(_data);
+      for (std::size_t i = 0; i < _size; ++i)
+      {
+        this->hash ^= bytes[i];
+        this->hash *= 1099511628211ULL;
+      }
+    }
+
+    public: void Add(double _value)
+    {
+      // -0 and 0 are the same state
+      if (_value == 0.0)
+        _value = 0.0;
+      this->Add(&_value, sizeof(_value));
+    }
+
+    public: uint64_t Value() const
+    {
+      return this->hash;
+    }
+
+    private: uint64_t hash = 14695981039346656037ULL;
+  };
+
+  // Log file layout, little endian as written by the host:
+  //   "RVRP", version, target count, then length and bytes of every name
+  //   per step: step, dt, time, wall time, hash, actuation count, actuations
+  const uint32_t replayMagic = 0x50525652;
+  const uint32_t replayVersion = 1;
+
+  // Writes a replay log, one step at a time.
+  class ReplayWriter
+  {
+    // Create the log.
+    // _path File to write, replaced if it exists.
+    // _targets Names of the bodies and joints actuations refer to.
+    // Returns false if the file could not be created.
+    public: bool Open(const std::string &_path
+                    , const std::vector<std::string> &_targets)
+    {
+      this->out.open(_path.c_str(), std::ios::binary | std::ios::trunc);
+      if (!this->out)
+        return false;
+      this->Put(replayMagic);
+      this->Put(replayVersion);
+      this->Put(static_cast<uint32_t>(_targets.size()));
+      for (const std::string &target : _targets)
+      {
+        this->Put(static_cast<uint32_t>(target.size()));
+        this->out.write(target.data(), target.size());
+      }
+      return static_cast<bool>(this->out);
+    }
+
+    public: bool IsOpen() const
+    {
+      return this->out.is_open();
+    }
+
+    // Append a step. Returns false once writing failed.
+    public: bool Write(const ReplayStep &_step)
+    {
+      this->Put(_step.step);
+      this->Put(_step.dt);
+      this->Put(_step.time);
+      this->Put(_step.wallTime);
+      this->Put(_step.stateHash);
+      this->Put(static_cast<uint32_t>(_step.actuations.size()));
+      for (const ReplayActuation &actuation : _step.actuations)
+        this->Put(actuation);
+      return static_cast<bool>(this->out);
+    }
+
+    public: void Close()
+    {
+      this->out.close();
+    }
+
+    private: template <typename T> void Put(const T &_value)
+    {
+      this->out.write(reinterpret_cast<const char *>(&_value), sizeof(T));
+    }
+
+    private: std::ofstream out;
+  };
+
+  // Reads a replay log written by ReplayWriter.
+  class ReplayReader
+  {
+    // Open a log and read its target names.
+    // Returns false if the file is missing or not a replay log.
+    public: bool Open(const std::string &_path)
+    {
+      this->in.open(_path.c_str(), std::ios::binary);
+      uint32_t magic = 0, version = 0, count = 0;
+      if (!this->Get(magic) || magic != replayMagic ||
+          !this->Get(version) || version != replayVersion ||
+          !this->Get(count))
+      {
+        this->in.close();
+        return false;
+      }
+      this->targets.clear();
+      for (uint32_t i = 0; i < count; ++i)
+      {
+        uint32_t length = 0;
+        if (!this->Get(length))
+          return false;
+        std::string target(length, '\0');
+        this->in.read(&target[0], length);
+        this->targets.push_back(target);
+      }
+      return static_cast<bool>(this->in);
+    }
+
+    // Names of the bodies and joints actuations refer to.
+    public: const std::vector<std::string> &Targets() const
+    {
+      return this->targets;
+    }
+
+    // Read the next step. Returns false at the end of the log.
+    public: bool Read(ReplayStep &_step)
+    {
+      uint32_t count = 0;
+      if (!this->Get(_step.step) || !this->Get(_step.dt) ||
+          !this->Get(_step.time) || !this->Get(_step.wallTime) ||
+          !this->Get(_step.stateHash) || !this->Get(count))
+      {
+        return false;
+      }
+      _step.actuations.resize(count);
+      for (ReplayActuation &actuation : _step.actuations)
+      {
+        if (!this->Get(actuation))
+          return false;
+      }
+      return true;
+    }
+
+    private: template <typename T> bool Get(T &_value)
+    {
+      this->in.read(reinterpret_cast<char *>(&_value), sizeof(T));
+      return static_cast<bool>(this->in);
+    }
+
+    private: std::ifstream in;
+    private: std::vector<std::string> targets;
+  };
+}
+#endif
@@ -0,0 +1,116 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+// Finds the slow parts of a replay log written by rover_movement or
+// ABasic_Rover:
+//   replay_summary <log> [window steps]
+// Prints the slowest steps and the slowest window of consecutive steps,
+// with the replay parameters that pause the world around that window.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+#include "replay_log.hh"
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s <log> [window steps]\n", argv[0]);
+    return 1;
+  }
+  const size_t window = argc > 2 ? std::max(atol(argv[2]), 1L) : 100;
+
+  rover::ReplayReader reader;
+  if (!reader.Open(argv[1]))
+  {
+    fprintf(stderr, "%s is not a replay log\n", argv[1]);
+    return 1;
+  }
+
+  // The wall time logged with a step is what the step before it cost
+  std::vector<std::pair<uint64_t, double>> costs;
+  rover::ReplayStep step;
+  size_t actuations = 0;
+  double endTime = 0.0;
+  while (reader.Read(step))
+  {
+    if (step.step > 1)
+      costs.push_back(std::make_pair(step.step - 1, step.wallTime));
+    actuations += step.actuations.size();
+    endTime = step.time + step.dt;
+  }
+  if (costs.empty())
+  {
+    fprintf(stderr, "%s holds less than two steps\n", argv[1]);
+    return 1;
+  }
+
+  double total = 0.0;
+  for (const auto &cost : costs)
+    total += cost.second;
+  printf("targets:");
+  for (const auto &target : reader.Targets())
+    printf(" %s", target.c_str());
+  printf("\nsteps %zu, actuations %zu, simulated %.3f s, wall %.3f s, "
+         "mean step %.3f ms\n", costs.size() + 1, actuations, endTime,
+         total, 1e3 * total / costs.size());
+
+  // Slowest window of consecutive steps, by a running sum
+  const size_t length = std::min(window, costs.size());
+  double sum = 0.0;
+  for (size_t i = 0; i < length; ++i)
+    sum += costs[i].second;
+  double slowest = sum;
+  size_t slowestStart = 0;
+  for (size_t i = length; i < costs.size(); ++i)
+  {
+    sum += costs[i].second - costs[i - length].second;
+    if (sum > slowest)
+    {
+      slowest = sum;
+      slowestStart = i - length + 1;
+    }
+  }
+  const uint64_t first = costs[slowestStart].first;
+  const uint64_t last = costs[slowestStart + length - 1].first;
+  printf("slowest %zu steps: %llu to %llu, %.3f ms, mean step %.3f ms\n",
+         length, static_cast<unsigned long long>(first),
+         static_cast<unsigned long long>(last), 1e3 * slowest,
+         1e3 * slowest / length);
+  printf("replay with <replay_pause_at>%llu</replay_pause_at> "
+         "<replay_pause_after>%llu</replay_pause_after>\n",
+         static_cast<unsigned long long>(first),
+         static_cast<unsigned long long>(last));
+
+  std::sort(costs.begin(), costs.end(),
+            [](const std::pair<uint64_t, double> &_a,
+               const std::pair<uint64_t, double> &_b)
+            {
+              return _a.second > _b.second;
+            });
+  printf("slowest steps:\n");
+  for (size_t i = 0; i < std::min<size_t>(10, costs.size()); ++i)
+  {
+    printf("  step %llu: %.3f ms\n",
+           static_cast<unsigned long long>(costs[i].first),
+           1e3 * costs[i].second);
+  }
+  return 0;
+}
@@ -0,0 +1,389 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#ifndef ROVER_ROVER_BRIDGE_HH_
+#define ROVER_ROVER_BRIDGE_HH_
+
+// Header only, so that the Unreal project and controller processes can use
+// it without linking against gazebo.
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace rover
+{
+  // Wheel order of every wheel array: left front, right front, left back,
+  // right back, as in model.sdf.
+  const int bridgeWheelCount = 4;
+
+  // How the wheel values of a command are applied.
+  enum BridgeCommandMode : uint32_t
+  {
+    // Torque about the wheel axis, N m
+    BRIDGE_TORQUE = 0,
+    // Spin rate about the wheel axis, rad/s
+    BRIDGE_VELOCITY = 1
+  };
+
+  // Wheel command written by a controller. Positive values drive forward.
+  struct BridgeCommand
+  {
+    // Step of the state this command answers, 0 if it answers none.
+    uint64_t step;
+    uint32_t mode;
+    uint32_t reserved;
+    double wheels[bridgeWheelCount];
+  };
+
+  // Rover state written by the simulator before every step, in SI units
+  // and the world frame of the simulator (z up).
+  struct BridgeState
+  {
+    // Number of the step that is about to run, starts at 1.
+    uint64_t step;
+    // Steady clock of the writer in nanoseconds, see RoverBridge::Now.
+    int64_t stamp;
+    // Simulation time, s.
+    double time;
+    double position[3];
+    // Quaternion w, x, y, z.
+    double orientation[4];
+    double linearVelocity[3];
+    double angularVelocity[3];
+    double wheelAngle[bridgeWheelCount];
+    double wheelRate[bridgeWheelCount];
+  };
+
+  // Single producer, single consumer ring of trivially copyable values. It
+  // only uses two atomic counters, so it works between processes when it
+  // lives in shared memory. Each counter sits in its own cache line so the
+  // two sides do not invalidate each other's line on every access.
+  template <typename T, uint32_t N>
+  class BridgeRing
+  {
+    static_assert((N & (N - 1)) == 0, "ring size must be a power of two");
+    static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+                  "the ring needs lock free 64 bit atomics");
+
+    // Producer: append a value, false if the ring is full.
+    public: bool Push(const T &_value)
+    {
+      const uint64_t head = this->head.load(std::memory_order_relaxed);
+      if (head - this->tail.load(std::memory_order_acquire) == N)
+        return false;
+      this->slots[head & (N - 1)] = _value;
+      this->head.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    // Consumer: take the oldest value, false if the ring is empty.
+    public: bool Pop(T &_value)
+    {
+      const uint64_t tail = this->tail.load(std::memory_order_relaxed);
+      if (tail == this->head.load(std::memory_order_acquire))
+        return false;
+      _value = this->slots[tail & (N - 1)];
+      this->tail.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    // Consumer: take the newest value and drop the older ones, false if
+    // the ring is empty.
+    public: bool PopLatest(T &_value)
+    {
+      const uint64_t tail = this->tail.load(std::memory_order_relaxed);
+      const uint64_t head = this->head.load(std::memory_order_acquire);
+      if (tail == head)
+        return false;
+      _value = this->slots[(head - 1) & (N - 1)];
+      this->tail.store(head, std::memory_order_release);
+      return true;
+    }
+
+    private: alignas(64) std::atomic<uint64_t> head{0};
+    private: alignas(64) std::atomic<uint64_t> tail{0};
+    private: alignas(64) T slots[N];
+  };
+
+  // Single writer slot holding the newest trivially copyable value behind
+  // a sequence counter, which is odd while a write is in progress. The
+  // writer never waits. A reader copies the value and retries if the
+  // counter moved meanwhile, so it always gets the newest complete value
+  // however late it comes. The value is kept as relaxed atomic words so
+  // that the racing copies are well defined, also between processes.
+  template <typename T>
+  class BridgeLatest
+  {
+    static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+                  "the slot needs lock free 64 bit atomics");
+
+    // Writer: replace the value.
+    public: void Store(const T &_value)
+    {
+      uint64_t words[wordCount] = {};
+      memcpy(words, &_value, sizeof(T));
+      const uint64_t sequence =
+          this->sequence.load(std::memory_order_relaxed);
+      this->sequence.store(sequence + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      for (size_t i = 0; i < wordCount; ++i)
+        this->words[i].store(words[i], std::memory_order_relaxed);
+      this->sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    // Reader: copy the value if it was written since _sequence, the
+    // sequence of the last value this reader took, and update _sequence.
+    // False if there is nothing newer.
+    public: bool LoadNewer(T &_value, uint64_t &_sequence) const
+    {
+      uint64_t words[wordCount];
+      for (;;)
+      {
+        const uint64_t before =
+            this->sequence.load(std::memory_order_acquire);
+        if (before == _sequence)
+          return false;
+        if (before & 1)
+          continue;
+        for (size_t i = 0; i < wordCount; ++i)
+          words[i] = this->words[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (this->sequence.load(std::memory_order_relaxed) == before)
+        {
+          memcpy(&_value, words, sizeof(T));
+          _sequence = before;
+          return true;
+        }
+      }
+    }
+
+    private: static const size_t wordCount =
+        (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    private: alignas(64) std::atomic<uint64_t> sequence{0};
+    private: std::atomic<uint64_t> words[wordCount] = {};
+  };
+
+  // Control and telemetry link between a simulated rover and a controller
+  // process on the same host, through a named shared memory segment. The
+  // simulator creates the bridge and publishes a state before every step,
+  // the controller opens it, reads states and sends commands. Neither side
+  // blocks, locks or makes a system call once the segment is mapped, a
+  // controller that spins on ReceiveState sees a state within a few
+  // microseconds of its publication.
+  class RoverBridge
+  {
+    public: RoverBridge() = default;
+    public: RoverBridge(const RoverBridge &) = delete;
+    public: RoverBridge &operator=(const RoverBridge &) = delete;
+
+    public: ~RoverBridge()
+    {
+      this->Close();
+    }
+
+    // Simulator: create the segment, or reset it if it exists already.
+    // _name Name of the bridge, shared with the controller.
+    // Returns false if the segment could not be created.
+    public: bool Create(const std::string &_name)
+    {
+      if (!this->Map(_name, true))
+        return false;
+      new (this->segment) Segment();
+      this->segment->magic.store(magicValue, std::memory_order_release);
+      return true;
+    }
+
+    // Controller: open a segment created by the simulator.
+    // Returns false if there is no such bridge yet.
+    public: bool Open(const std::string &_name)
+    {
+      if (!this->Map(_name, false))
+        return false;
+      if (this->segment->magic.load(std::memory_order_acquire) != magicValue)
+      {
+        this->Close();
+        return false;
+      }
+      this->stateSequence = 0;
+      this->lastStep = 0;
+      this->droppedStates = 0;
+      return true;
+    }
+
+    // Unmap the segment. The simulator side also removes its name.
+    public: void Close()
+    {
+      if (!this->segment)
+        return;
+#ifdef _WIN32
+      UnmapViewOfFile(this->segment);
+      CloseHandle(this->mapping);
+      this->mapping = nullptr;
+#else
+      munmap(this->segment, sizeof(Segment));
+      if (this->owner)
+        shm_unlink(this->path.c_str());
+#endif
+      this->segment = nullptr;
+      this->owner = false;
+    }
+
+    // Whether a segment is mapped.
+    public: bool IsOpen() const
+    {
+      return this->segment != nullptr;
+    }
+
+    // Simulator: publish a state, replacing the previous one whether or
+    // not the controller has read it. A controller that attaches late or
+    // falls behind always gets the current state, never a stale one.
+    public: void PublishState(const BridgeState &_state)
+    {
+      this->segment->state.Store(_state);
+    }
+
+    // Simulator: newest command sent since the last call, false if none.
+    public: bool ReceiveCommand(BridgeCommand &_command)
+    {
+      return this->segment->commands.PopLatest(_command);
+    }
+
+    // Controller: send a command, false if the simulator has not taken the
+    // previous ones yet.
+    public: bool SendCommand(const BridgeCommand &_command)
+    {
+      return this->segment->commands.Push(_command);
+    }
+
+    // Controller: newest state published since the last call, false if
+    // none. Older states are skipped, a controller only acts on the newest.
+    public: bool ReceiveState(BridgeState &_state)
+    {
+      if (!this->segment->state.LoadNewer(_state, this->stateSequence))
+        return false;
+      if (this->lastStep > 0 && _state.step > this->lastStep + 1)
+        this->droppedStates += _state.step - this->lastStep - 1;
+      this->lastStep = _state.step;
+      return true;
+    }
+
+    // Controller: states that were replaced by a newer one before this
+    // controller read them.
+    public: uint64_t DroppedStates() const
+    {
+      return this->droppedStates;
+    }
+
+    // Steady clock in nanoseconds, the same clock in every process.
+    public: static int64_t Now()
+    {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Layout of the shared memory. Both sides must be built from the same
+    // header, magicValue changes with the layout.
+    private: struct Segment
+    {
+      std::atomic<uint32_t> magic{0};
+      BridgeRing<BridgeCommand, 64> commands;
+      BridgeLatest<BridgeState> state;
+    };
+
+    private: static const uint32_t magicValue = 0x524F5602;
+
+    private: bool Map(const std::string &_name, bool _create)
+    {
+      this->Close();
+#ifdef _WIN32
+      const std::string mappingName = "Local\\rover_bridge_" + _name;
+      if (_create)
+      {
+        this->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr,
+            PAGE_READWRITE, 0, sizeof(Segment), mappingName.c_str());
+      }
+      else
+      {
+        this->mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE,
+                                         mappingName.c_str());
+      }
+      if (!this->mapping)
+        return false;
+      void *address = MapViewOfFile(this->mapping, FILE_MAP_ALL_ACCESS, 0, 0,
+                                    sizeof(Segment));
+      if (!address)
+      {
+        CloseHandle(this->mapping);
+        this->mapping = nullptr;
+        return false;
+      }
+#else
+      this->path = "/rover_bridge_" + _name;
+      const int fd = shm_open(this->path.c_str(),
+                              _create ? O_CREAT | O_RDWR : O_RDWR, 0600);
+      if (fd < 0)
+        return false;
+      // A segment that is still being created is too small to map.
+      struct stat status;
+      if ((_create && ftruncate(fd, sizeof(Segment)) != 0) ||
+          fstat(fd, &status) != 0 ||
+          status.st_size < static_cast<off_t>(sizeof(Segment)))
+      {
+        close(fd);
+        return false;
+      }
+      void *address = mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE,
+                           MAP_SHARED, fd, 0);
+      close(fd);
+      if (address == MAP_FAILED)
+        return false;
+#endif
+      this->segment = static_cast<Segment *>(address);
+      this->owner = _create;
+      return true;
+    }
+
+    private: Segment *segment = nullptr;
+    private: bool owner = false;
+
+    // Controller: sequence of the last state read, see BridgeLatest.
+    private: uint64_t stateSequence = 0;
+
+    // Controller: step of the last state read and the steps it missed.
+    private: uint64_t lastStep = 0;
+    private: uint64_t droppedStates = 0;
+#ifdef _WIN32
+    private: HANDLE mapping = nullptr;
+#else
+    private: std::string path;
+#endif
+  };
+}
+#endif
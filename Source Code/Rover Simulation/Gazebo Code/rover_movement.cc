@@ -14,20 +14,139 @@
     limitations under the License.
  */
 
+// Model plugin that drives the basic rover. Without parameters it pushes
+// the chassis forward with a constant force. With a bridge it publishes
+// the rover state before every step and applies the wheel commands of an
+// external controller instead, see rover_bridge.hh and bridge_client.cc:
+//   <plugin name="rover_movement" filename="librover_movement.so">
+//     <force>10 0 0</force>               constant chassis force, N
+//     <initial_velocity>0 0 0</initial_velocity>  chassis, m/s
+//     <chassis_mass>10</chassis_mass>     kg, inertia scales along
+//     <wheel_friction>1</wheel_friction>  friction coefficient
+//     <summary>/abs/summary.csv</summary> outcome of the traverse
+//     <summary_time>15</summary_time>     written at this time, s
+//     <bridge>rover</bridge>              name of the shared memory bridge
+//     <lock_step_timeout>0.001</lock_step_timeout>
+//     <record>/abs/run.replay</record>    log every step, or
+//     <replay>/abs/run.replay</replay>    run a logged run again
+//     <replay_pause_at>0</replay_pause_at>
+//     <replay_pause_after>0</replay_pause_after>
+//   </plugin>
+// With a lock step timeout, in seconds, every step waits up to that long
+// for the command answering its state, so a fast enough controller closes
+// its loop at the physics rate. Without one the newest command is applied
+// and the step never waits.
+//
+// A recorded log holds the step schedule, a hash of the rover state before
+// every step, the wall time of every step and every actuation, see
+// replay_log.hh. A replay applies the logged actuations instead of
+// computing them and reports every step whose state hash differs, which
+// means the run is not deterministic. replay_summary finds the slow
+// segments of a log. Replays pause the world before step replay_pause_at
+// and after step replay_pause_after, so a profiler can be attached to
+// exactly that segment.
+//
+// The summary is one CSV line: distance travelled, final position, largest
+// tilt of the chassis in degrees, mean speed and whether the rover ended
+// upside down. traverse_runner uses it for Monte Carlo batches.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
 #include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 #include <gazebo/gazebo.hh>
 #include <gazebo/physics/physics.hh>
 #include <gazebo/common/common.hh>
 #include <ignition/math/Vector3.hh>
 
+#include "replay_log.hh"
+#include "rover_bridge.hh"
+
 namespace gazebo
 {
   class RoverMovement : public ModelPlugin
   {
-    public: void Load(physics::ModelPtr _parent, sdf::ElementPtr /*_sdf*/)
+    public: ~RoverMovement()
+    {
+      if (this->replay)
+      {
+        gzmsg << "Replayed " << this->replayedSteps << " steps, "
+              << this->mismatches << " state hash mismatches" << std::endl;
+      }
+    }
+
+    public: void Load(physics::ModelPtr _parent, sdf::ElementPtr _sdf)
     {
       // Store the pointer to the model
       this->model = _parent;
+      this->chassis = this->model->GetLink("chassis");
+
+      // Everything an actuation can target, the chassis and then the wheel
+      // hinges in the order of the bridge
+      const char *hinges[rover::bridgeWheelCount] = {
+          "left_front_wheel_hinge", "right_front_wheel_hinge",
+          "left_back_wheel_hinge", "right_back_wheel_hinge"};
+      this->targets.push_back("chassis");
+      for (int i = 0; i < rover::bridgeWheelCount; ++i)
+      {
+        this->wheels[i] = this->model->GetJoint(hinges[i]);
+        this->targets.push_back(hinges[i]);
+      }
+
+      this->force = _sdf->Get<ignition::math::Vector3d>("force",
+          ignition::math::Vector3d(10, 0, 0)).first;
+      this->initialVelocity = _sdf->Get<ignition::math::Vector3d>(
+          "initial_velocity", ignition::math::Vector3d::Zero).first;
+      if (_sdf->HasElement("chassis_mass"))
+        this->SetChassisMass(_sdf->Get<double>("chassis_mass"));
+      if (_sdf->HasElement("wheel_friction"))
+        this->SetWheelFriction(_sdf->Get<double>("wheel_friction"));
+      if (_sdf->HasElement("summary"))
+      {
+        this->summaryPath = _sdf->Get<std::string>("summary");
+        this->summaryTime = _sdf->Get<double>("summary_time", 15.0).first;
+      }
+
+      if (_sdf->HasElement("replay"))
+      {
+        const std::string path = _sdf->Get<std::string>("replay");
+        this->replay.reset(new rover::ReplayReader());
+        if (!this->replay->Open(path) ||
+            this->replay->Targets() != this->targets)
+        {
+          gzerr << "Could not replay " << path << std::endl;
+          this->replay.reset();
+        }
+        this->pauseAt = _sdf->Get<uint64_t>("replay_pause_at", 0).first;
+        this->pauseAfter = _sdf->Get<uint64_t>("replay_pause_after", 0).first;
+      }
+      else if (_sdf->HasElement("record"))
+      {
+        const std::string path = _sdf->Get<std::string>("record");
+        if (!this->recorder.Open(path, this->targets))
+          gzerr << "Could not record to " << path << std::endl;
+      }
+
+      if (_sdf->HasElement("bridge") && !this->replay)
+      {
+        const std::string name = _sdf->Get<std::string>("bridge");
+        this->lockStepTimeout =
+            _sdf->Get<double>("lock_step_timeout", 0.0).first;
+
+        if (this->bridge.Create(name))
+        {
+          gzmsg << "Rover bridge " << name << " created" << std::endl;
+        }
+        else
+        {
+          gzerr << "Could not create rover bridge " << name << std::endl;
+        }
+      }
 
       // Listen to the update event. This event is broadcast every
       // simulation iteration.
@@ -38,23 +157,344 @@ namespace gazebo
     // Called by the world update start event
     public: void OnUpdate()
     {
+      const auto now = std::chrono::steady_clock::now();
+      this->current.step = ++this->step;
+      this->current.dt =
+          this->model->GetWorld()->Physics()->GetMaxStepSize();
+      this->current.time = this->model->GetWorld()->SimTime().Double();
+      this->current.wallTime = this->step == 1 ? 0.0 :
+          std::chrono::duration<double>(now - this->lastUpdate).count();
+      this->current.stateHash = this->StateHash();
+      this->current.actuations.clear();
+      this->lastUpdate = now;
+
+      if (!this->summaryPath.empty())
+        this->UpdateSummary();
+
+      if (this->replay)
+      {
+        this->Replay();
+        return;
+      }
+
+      if (this->step == 1 &&
+          this->initialVelocity != ignition::math::Vector3d::Zero)
+      {
+        this->Actuate(0, rover::REPLAY_LINEAR_VELOCITY,
+                      this->initialVelocity);
+      }
 
-        this->model->GetLink("chassis")->SetForce(ignition::math::Vector3d(10,0,0));
+      if (this->bridge.IsOpen())
+      {
+        this->UpdateBridge();
+      }
+      else if (this->force != ignition::math::Vector3d::Zero)
+      {
+        this->Actuate(0, rover::REPLAY_FORCE, this->force);
         /*
         this->model->GetJoint("left_front_wheel_hinge")->SetForce(0,1.0);
         this->model->GetJoint("right_front_wheel_hinge")->SetForce(0,1.0);
         this->model->GetJoint("left_back_wheel_hinge")->SetForce(0,1.0);
         this->model->GetJoint("right_back_wheel_hinge")->SetForce(0,1.0);
         */
+      }
+
+      if (this->recorder.IsOpen() && !this->recorder.Write(this->current))
+      {
+        gzerr << "Could not write the replay log, recording stopped"
+              << std::endl;
+        this->recorder.Close();
+      }
+    }
+
+    // Publish the rover state to the bridge and apply the command of the
+    // controller.
+    private: void UpdateBridge()
+    {
+      // The wheel axes point either way along the chassis y axis, signs
+      // turn joint values into spin that is positive when rolling forward.
+      const ignition::math::Pose3d pose = this->chassis->WorldPose();
+      const ignition::math::Vector3d lateral =
+          pose.Rot().RotateVector(ignition::math::Vector3d::UnitY);
+      double signs[rover::bridgeWheelCount];
+      for (int i = 0; i < rover::bridgeWheelCount; ++i)
+        signs[i] = this->wheels[i]->GlobalAxis(0).Dot(lateral) < 0 ? -1 : 1;
+
+      rover::BridgeState state;
+      state.step = this->step;
+      state.time = this->current.time;
+      const ignition::math::Vector3d v = this->chassis->WorldLinearVel();
+      const ignition::math::Vector3d w = this->chassis->WorldAngularVel();
+      for (int k = 0; k < 3; ++k)
+      {
+        state.position[k] = pose.Pos()[k];
+        state.linearVelocity[k] = v[k];
+        state.angularVelocity[k] = w[k];
+      }
+      state.orientation[0] = pose.Rot().W();
+      state.orientation[1] = pose.Rot().X();
+      state.orientation[2] = pose.Rot().Y();
+      state.orientation[3] = pose.Rot().Z();
+      for (int i = 0; i < rover::bridgeWheelCount; ++i)
+      {
+        state.wheelAngle[i] = signs[i] * this->wheels[i]->Position(0);
+        state.wheelRate[i] = signs[i] * this->wheels[i]->GetVelocity(0);
+      }
+      state.stamp = rover::RoverBridge::Now();
+      this->bridge.PublishState(state);
+
+      // Wait for the answer to this state, or take whatever arrived
+      rover::BridgeCommand command;
+      bool received = this->bridge.ReceiveCommand(command);
+      if (this->lockStepTimeout > 0.0)
+      {
+        const int64_t deadline =
+            state.stamp + static_cast<int64_t>(this->lockStepTimeout * 1e9);
+        while ((!received || command.step < state.step) &&
+               rover::RoverBridge::Now() < deadline)
+        {
+          received = this->bridge.ReceiveCommand(command) || received;
+          std::this_thread::yield();
+        }
+      }
+      if (received)
+      {
+        this->command = command;
+        this->haveCommand = true;
+      }
+      if (!this->haveCommand)
+        return;
+
+      // Applied again every step, gazebo clears joint forces after each.
+      for (int i = 0; i < rover::bridgeWheelCount; ++i)
+      {
+        const double value = signs[i] * this->command.wheels[i];
+        this->Actuate(i + 1, this->command.mode == rover::BRIDGE_VELOCITY ?
+            rover::REPLAY_JOINT_VELOCITY : rover::REPLAY_JOINT_FORCE,
+            ignition::math::Vector3d(value, 0, 0));
+      }
+    }
+
+    // Apply the logged actuations of the next step and check that it
+    // starts from the logged state.
+    private: void Replay()
+    {
+      rover::ReplayStep logged;
+      if (!this->replay->Read(logged))
+      {
+        gzmsg << "Replay finished after step " << this->replayedSteps
+              << std::endl;
+        this->model->GetWorld()->SetPaused(true);
+        this->replay.reset();
+        return;
+      }
+      if (logged.step != this->step ||
+          fabs(logged.dt - this->current.dt) > 1e-12)
+      {
+        gzerr << "Replay step " << this->step << " does not match the "
+              << "schedule of the log, step " << logged.step << " of "
+              << logged.dt << " s" << std::endl;
+      }
+      if (logged.stateHash != this->current.stateHash)
+      {
+        if (this->mismatches == 0)
+        {
+          gzerr << "Replay diverged at step " << this->step << ", time "
+                << logged.time << std::endl;
+        }
+        ++this->mismatches;
+      }
+      for (const rover::ReplayActuation &actuation : logged.actuations)
+      {
+        this->Actuate(actuation.target, actuation.kind,
+            ignition::math::Vector3d(actuation.value[0], actuation.value[1],
+                                     actuation.value[2]));
+      }
+      ++this->replayedSteps;
+
+      if (this->step + 1 == this->pauseAt || this->step == this->pauseAfter)
+      {
+        gzmsg << "Replay paused after step " << this->step << std::endl;
+        this->model->GetWorld()->SetPaused(true);
+      }
+    }
+
+    // Apply an actuation to one of the targets and log it.
+    private: void Actuate(uint32_t _target, uint32_t _kind
+                        , const ignition::math::Vector3d &_value)
+    {
+      if (_target >= this->targets.size())
+        return;
+      const physics::JointPtr joint =
+          _target == 0 ? nullptr : this->wheels[_target - 1];
+      switch (_kind)
+      {
+        case rover::REPLAY_FORCE:
+          this->chassis->SetForce(_value);
+          break;
+        case rover::REPLAY_TORQUE:
+          this->chassis->SetTorque(_value);
+          break;
+        case rover::REPLAY_LINEAR_VELOCITY:
+          this->chassis->SetLinearVel(_value);
+          break;
+        case rover::REPLAY_ANGULAR_VELOCITY:
+          this->chassis->SetAngularVel(_value);
+          break;
+        case rover::REPLAY_JOINT_FORCE:
+          if (joint)
+            joint->SetForce(0, _value.X());
+          break;
+        case rover::REPLAY_JOINT_VELOCITY:
+          if (joint)
+            joint->SetVelocity(0, _value.X());
+          break;
+      }
+
+      rover::ReplayActuation actuation;
+      actuation.target = _target;
+      actuation.kind = _kind;
+      actuation.value[0] = _value.X();
+      actuation.value[1] = _value.Y();
+      actuation.value[2] = _value.Z();
+      this->current.actuations.push_back(actuation);
+    }
+
+    // Follow the traverse and write its summary once it is over.
+    private: void UpdateSummary()
+    {
+      const ignition::math::Pose3d pose = this->chassis->WorldPose();
+      if (this->step > 1)
+        this->distance += pose.Pos().Distance(this->lastPosition);
+      this->lastPosition = pose.Pos();
+
+      // Angle between the chassis z axis and the vertical
+      const ignition::math::Vector3d up =
+          pose.Rot().RotateVector(ignition::math::Vector3d::UnitZ);
+      const double tilt =
+          std::acos(std::max(-1.0, std::min(1.0, up.Z())));
+      this->maxTilt = std::max(this->maxTilt, tilt);
+
+      if (this->summaryWritten || this->current.time < this->summaryTime)
+        return;
+      std::ofstream out(this->summaryPath.c_str());
+      out << "Distance,Final X,Final Y,Final Z,Max Tilt,Mean Speed,Flipped\n"
+          << this->distance << "," << pose.Pos().X() << ","
+          << pose.Pos().Y() << "," << pose.Pos().Z() << ","
+          << IGN_RTOD(this->maxTilt) << ","
+          << this->distance / std::max(this->current.time, 1e-9) << ","
+          << (up.Z() < 0.0 ? 1 : 0) << "\n";
+      this->summaryWritten = true;
+      if (!out)
+        gzerr << "Could not write " << this->summaryPath << std::endl;
+    }
+
+    // Set the chassis mass, scaling its inertia with it.
+    private: void SetChassisMass(double _mass)
+    {
+      const physics::InertialPtr inertial = this->chassis->GetInertial();
+      const double scale = _mass / inertial->Mass();
+      inertial->SetMass(_mass);
+      inertial->SetInertiaMatrix(
+          inertial->IXX() * scale, inertial->IYY() * scale,
+          inertial->IZZ() * scale, inertial->IXY() * scale,
+          inertial->IXZ() * scale, inertial->IYZ() * scale);
+      this->chassis->UpdateMass();
+    }
+
+    // Set the friction coefficient of every wheel collision.
+    private: void SetWheelFriction(double _mu)
+    {
+      for (const physics::JointPtr &wheel : this->wheels)
+      {
+        if (!wheel)
+          continue;
+        for (const auto &collision : wheel->GetChild()->GetCollisions())
+        {
+          const physics::FrictionPyramidPtr friction =
+              collision->GetSurface()->FrictionPyramid();
+          if (!friction)
+            continue;
+          friction->SetMuPrimary(_mu);
+          friction->SetMuSecondary(_mu);
+        }
+      }
+    }
+
+    // Hash of the pose and velocity of every link of the rover.
+    private: uint64_t StateHash() const
+    {
+      rover::StateHash hash;
+      for (const physics::LinkPtr &link : this->model->GetLinks())
+      {
+        const ignition::math::Pose3d pose = link->WorldPose();
+        const ignition::math::Vector3d v = link->WorldLinearVel();
+        const ignition::math::Vector3d w = link->WorldAngularVel();
+        for (int k = 0; k < 3; ++k)
+        {
+          hash.Add(pose.Pos()[k]);
+          hash.Add(v[k]);
+          hash.Add(w[k]);
+        }
+        hash.Add(pose.Rot().W());
+        hash.Add(pose.Rot().X());
+        hash.Add(pose.Rot().Y());
+        hash.Add(pose.Rot().Z());
+      }
+      return hash.Value();
     }
 
     // Pointer to the model
     private: physics::ModelPtr model;
 
+    // Link the constant force is applied to and whose state is published
+    private: physics::LinkPtr chassis;
+
+    // Wheel hinges in the order of the bridge
+    private: physics::JointPtr wheels[rover::bridgeWheelCount];
+
+    // Names of the chassis and the wheel hinges, as stored in replay logs
+    private: std::vector<std::string> targets;
+
+    // Link to an external controller, closed if not configured
+    private: rover::RoverBridge bridge;
+    private: double lockStepTimeout = 0.0;
+
+    // Last command received, applied until the next one arrives
+    private: rover::BridgeCommand command;
+    private: bool haveCommand = false;
+
+    // Open loop driving
+    private: ignition::math::Vector3d force;
+    private: ignition::math::Vector3d initialVelocity;
+
+    // Traverse summary, not written if the path is empty
+    private: std::string summaryPath;
+    private: double summaryTime = 15.0;
+    private: bool summaryWritten = false;
+    private: ignition::math::Vector3d lastPosition;
+    private: double distance = 0.0;
+    private: double maxTilt = 0.0;
+
+    // Steps since the plugin was loaded, the first one is 1
+    private: uint64_t step = 0;
+    private: std::chrono::steady_clock::time_point lastUpdate;
+
+    // The step being run, written to the log when recording
+    private: rover::ReplayStep current;
+    private: rover::ReplayWriter recorder;
+
+    // Log being replayed, null when not replaying or once it has ended
+    private: std::unique_ptr<rover::ReplayReader> replay;
+    private: uint64_t replayedSteps = 0;
+    private: uint64_t mismatches = 0;
+    private: uint64_t pauseAt = 0;
+    private: uint64_t pauseAfter = 0;
+
     // Pointer to the update event connection
     private: event::ConnectionPtr updateConnection;
   };
 
   // Register this plugin with the simulator
   GZ_REGISTER_MODEL_PLUGIN(RoverMovement)
-}
\ No newline at end of file
+}
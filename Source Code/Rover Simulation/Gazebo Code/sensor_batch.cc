@@ -0,0 +1,295 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+// World plugin that simulates an IMU on the chassis and an encoder on
+// every wheel of every rover:
+//   <plugin name="sensor_batch" filename="libsensor_batch.so">
+//     <chassis>chassis</chassis>     link the IMU is mounted on
+//     <wheel>wheel</wheel>           joints whose child link contains this
+//     <rate>1000</rate>              samples per second, at most the
+//                                    physics rate
+//     <seed>1</seed>
+//     <accel_noise>0.02</accel_noise>
+//     <accel_bias_walk>0.0005</accel_bias_walk>
+//     <gyro_noise>0.002</gyro_noise>
+//     <gyro_bias_walk>0.00005</gyro_bias_walk>
+//     <encoder_ticks>2048</encoder_ticks>
+//     <capacity>1000</capacity>      frames held by the ring
+//     <output>/abs/sensors.csv</output>  optional
+//   </plugin>
+// All rovers are sampled together in one SensorBatch, see sensor_batch.hh,
+// and every sample goes into a preallocated SensorRing. With an output
+// file the ring is written out whenever it fills up, otherwise it keeps
+// the newest frames. Nothing is allocated per sample and no gazebo sensor
+// is created per rover. Rovers keep their noise state, by model name, when
+// other rovers are inserted or removed.
+
+#include <fstream>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <gazebo/gazebo.hh>
+#include <gazebo/physics/physics.hh>
+#include <gazebo/common/common.hh>
+#include <ignition/math/Vector3.hh>
+
+#include "sensor_batch.hh"
+
+namespace gazebo
+{
+  class SensorBatchPlugin : public WorldPlugin
+  {
+    public: ~SensorBatchPlugin()
+    {
+      if (this->output.is_open())
+      {
+        this->Drain();
+        gzmsg << "Sensor batch wrote " << this->written << " frames, "
+              << this->ring.Overwritten() << " overwritten" << std::endl;
+      }
+    }
+
+    public: void Load(physics::WorldPtr _world, sdf::ElementPtr _sdf)
+    {
+      this->world = _world;
+
+      this->chassisName =
+          _sdf->Get<std::string>("chassis", std::string("chassis")).first;
+      this->wheelPattern =
+          _sdf->Get<std::string>("wheel", std::string("wheel")).first;
+      this->period = 1.0 / _sdf->Get<double>("rate", 1000.0).first;
+      this->seed = _sdf->Get<uint64_t>("seed", 1).first;
+      this->capacity = _sdf->Get<unsigned int>("capacity", 1000).first;
+
+      this->params.accelNoise =
+          _sdf->Get<double>("accel_noise", this->params.accelNoise).first;
+      this->params.accelBiasWalk = _sdf->Get<double>(
+          "accel_bias_walk", this->params.accelBiasWalk).first;
+      this->params.gyroNoise =
+          _sdf->Get<double>("gyro_noise", this->params.gyroNoise).first;
+      this->params.gyroBiasWalk = _sdf->Get<double>(
+          "gyro_bias_walk", this->params.gyroBiasWalk).first;
+      this->params.encoderTicks =
+          _sdf->Get<int>("encoder_ticks", this->params.encoderTicks).first;
+
+      if (_sdf->HasElement("output"))
+      {
+        const std::string path = _sdf->Get<std::string>("output");
+        this->output.open(path.c_str());
+        if (this->output)
+        {
+          this->output << "Time,Rover,X Acceleration,Y Acceleration,"
+                       << "Z Acceleration,X Angular Velocity,"
+                       << "Y Angular Velocity,Z Angular Velocity";
+          for (int k = 0; k < rover::sensorWheelCount; ++k)
+            this->output << ",Wheel " << k << " Ticks";
+          this->output << "\n";
+        }
+        else
+        {
+          gzerr << "Could not open " << path << std::endl;
+        }
+      }
+
+      this->batch.Resize(0, this->seed);
+      this->ring.Reset(0, this->capacity);
+
+      this->updateConnection = event::Events::ConnectWorldUpdateBegin(
+          std::bind(&SensorBatchPlugin::OnUpdate, this));
+    }
+
+    // Called by the world update start event
+    public: void OnUpdate()
+    {
+      if (this->world->ModelCount() != this->modelCount)
+        this->FindRovers();
+
+      const double time = this->world->SimTime().Double();
+      if (this->sampled && time - this->lastSample < this->period - 1e-9)
+        return;
+      const float dt = this->sampled ? time - this->lastSample : 0.0;
+      this->lastSample = time;
+      this->sampled = true;
+
+      // One pass over all rovers
+      const size_t count = this->rovers.size();
+      for (size_t i = 0; i < count; ++i)
+      {
+        const Rover &entry = this->rovers[i];
+        const ignition::math::Quaterniond q = entry.chassis->WorldPose().Rot();
+        // Wheels on the two sides have opposite axes, as in the bridge of
+        // rover_movement the angles count positive when rolling forward
+        const ignition::math::Vector3d lateral =
+            q.RotateVector(ignition::math::Vector3d::UnitY);
+        const ignition::math::Vector3d v = entry.chassis->WorldLinearVel();
+        const ignition::math::Vector3d w = entry.chassis->WorldAngularVel();
+        this->batch.vx[i] = v.X();
+        this->batch.vy[i] = v.Y();
+        this->batch.vz[i] = v.Z();
+        this->batch.qw[i] = q.W();
+        this->batch.qx[i] = q.X();
+        this->batch.qy[i] = q.Y();
+        this->batch.qz[i] = q.Z();
+        this->batch.wx[i] = w.X();
+        this->batch.wy[i] = w.Y();
+        this->batch.wz[i] = w.Z();
+        for (int k = 0; k < rover::sensorWheelCount; ++k)
+        {
+          const physics::JointPtr &wheel = entry.wheels[k];
+          double angle = 0.0;
+          if (wheel)
+          {
+            angle = wheel->GlobalAxis(0).Dot(lateral) < 0 ?
+                -wheel->Position(0) : wheel->Position(0);
+          }
+          this->batch.wheelAngle[i * rover::sensorWheelCount + k] = angle;
+        }
+      }
+
+      const ignition::math::Vector3d g = this->world->Gravity();
+      const float gravity[3] = {static_cast<float>(g.X())
+                              , static_cast<float>(g.Y())
+                              , static_cast<float>(g.Z())};
+      this->batch.Evaluate(dt, this->params, gravity);
+      this->ring.Push(time, this->batch);
+
+      if (this->output.is_open() && this->ring.Full())
+        this->Drain();
+    }
+
+    // The IMU link and the wheel joints of a rover.
+    private: struct Rover
+    {
+      std::string name;
+      physics::LinkPtr chassis;
+      physics::JointPtr wheels[rover::sensorWheelCount];
+    };
+
+    // Collect every model that has a chassis link, and its first wheels.
+    // The batch and the ring only change when the set of rovers does, and
+    // then keep the state of the rovers that stay.
+    private: void FindRovers()
+    {
+      this->modelCount = this->world->ModelCount();
+
+      std::vector<Rover> found;
+      for (const auto &model : this->world->Models())
+      {
+        Rover entry;
+        entry.name = model->GetName();
+        entry.chassis = model->GetLink(this->chassisName);
+        if (!entry.chassis)
+          continue;
+        int wheel = 0;
+        for (const auto &joint : model->GetJoints())
+        {
+          const physics::LinkPtr child = joint->GetChild();
+          if (wheel < rover::sensorWheelCount && child &&
+              child->GetName().find(this->wheelPattern) != std::string::npos)
+          {
+            entry.wheels[wheel++] = joint;
+          }
+        }
+        found.push_back(entry);
+      }
+
+      std::map<std::string, int> previous;
+      for (size_t i = 0; i < this->rovers.size(); ++i)
+        previous[this->rovers[i].name] = i;
+      bool changed = found.size() != this->rovers.size();
+      std::vector<int> from(found.size(), -1);
+      for (size_t i = 0; i < found.size(); ++i)
+      {
+        auto it = previous.find(found[i].name);
+        if (it != previous.end())
+          from[i] = it->second;
+        changed = changed || from[i] != static_cast<int>(i);
+      }
+
+      // Pointers of the same rovers are refreshed all the same
+      if (!changed)
+      {
+        this->rovers.swap(found);
+        return;
+      }
+
+      if (this->output.is_open())
+        this->Drain();
+      this->rovers.swap(found);
+      this->batch.Remap(from, this->seed, this->streams);
+      this->ring.Remap(from);
+      for (const int f : from)
+        this->streams += f < 0 ? 1 : 0;
+      gzmsg << "Sensor batch on " << this->rovers.size() << " rovers"
+            << std::endl;
+    }
+
+    // Write every frame of the ring to the output file and empty it.
+    private: void Drain()
+    {
+      const size_t count = this->rovers.size();
+      for (size_t f = 0; f < this->ring.Size(); ++f)
+      {
+        const float *imu = this->ring.Imu(f);
+        const int32_t *ticks = this->ring.Encoders(f);
+        for (size_t i = 0; i < count; ++i)
+        {
+          this->output << this->ring.Time(f) << "," << this->rovers[i].name;
+          for (int c = 0; c < 6; ++c)
+            this->output << "," << imu[c * count + i];
+          for (int k = 0; k < rover::sensorWheelCount; ++k)
+            this->output << "," << ticks[i * rover::sensorWheelCount + k];
+          this->output << "\n";
+        }
+      }
+      this->written += this->ring.Size();
+      this->ring.Clear();
+    }
+
+    // Pointer to the world
+    private: physics::WorldPtr world;
+
+    // Plugin parameters
+    private: std::string chassisName;
+    private: std::string wheelPattern;
+    private: double period = 0.001;
+    private: uint64_t seed = 1;
+    private: unsigned int capacity = 1000;
+    private: rover::SensorParams params;
+
+    // Rovers and their sensors
+    private: std::vector<Rover> rovers;
+    private: rover::SensorBatch batch;
+    private: rover::SensorRing ring;
+    private: unsigned int modelCount = 0;
+    // Noise generators given to rovers so far
+    private: std::size_t streams = 0;
+    private: double lastSample = 0.0;
+    private: bool sampled = false;
+
+    // Output file, closed if the frames are not written
+    private: std::ofstream output;
+    private: uint64_t written = 0;
+
+    // Pointer to the update event connection
+    private: event::ConnectionPtr updateConnection;
+  };
+
+  // Register this plugin with the simulator
+  GZ_REGISTER_WORLD_PLUGIN(SensorBatchPlugin)
+}
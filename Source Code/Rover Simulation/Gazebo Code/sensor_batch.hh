@@ -0,0 +1,440 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#ifndef ROVER_SENSOR_BATCH_HH_
+#define ROVER_SENSOR_BATCH_HH_
+
+// Header only, so that the Unreal project can use it as well.
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "terramechanics.hh"
+
+namespace rover
+{
+  // Noise of the simulated sensors. Noise values are standard deviations
+  // of a single sample, bias walks grow with the square root of time.
+  struct SensorParams
+  {
+    // Accelerometer white noise, m/s^2, and bias random walk, m/s^2/sqrt(s).
+    float accelNoise = 0.02f;
+    float accelBiasWalk = 0.0005f;
+
+    // Gyroscope white noise, rad/s, and bias random walk, rad/s/sqrt(s).
+    float gyroNoise = 0.002f;
+    float gyroBiasWalk = 0.00005f;
+
+    // Wheel encoder ticks per revolution.
+    int encoderTicks = 2048;
+  };
+
+  // Number of wheels with an encoder on every rover.
+  const int sensorWheelCount = 4;
+
+  // IMU and wheel encoder readings of many rovers, stored as one array per
+  // quantity so that Evaluate runs over all rovers in SIMD lanes. Every
+  // rover has its own xorshift generator in the same lanes, so the noise is
+  // vectorized with the rest and does not depend on the evaluation order.
+  // Fill the inputs of every rover, call Evaluate and read the outputs.
+  class SensorBatch
+  {
+    // Set the number of rovers, resizing every array, and seed the
+    // generators. The same seed gives the same noise.
+    public: void Resize(std::size_t _count, uint64_t _seed = 1)
+    {
+      std::vector<float> *arrays[] = {&this->vx, &this->vy, &this->vz
+          , &this->qw, &this->qx, &this->qy, &this->qz, &this->wx, &this->wy
+          , &this->wz, &this->ax, &this->ay, &this->az, &this->gx, &this->gy
+          , &this->gz, &this->lastVx, &this->lastVy, &this->lastVz
+          , &this->accelBiasX, &this->accelBiasY, &this->accelBiasZ
+          , &this->gyroBiasX, &this->gyroBiasY, &this->gyroBiasZ};
+      for (auto array : arrays)
+        array->assign(_count, 0.0f);
+      this->qw.assign(_count, 1.0f);
+      this->hasLast.assign(_count, 0.0f);
+      this->wheelAngle.assign(_count * sensorWheelCount, 0.0f);
+      this->ticks.assign(_count * sensorWheelCount, 0);
+
+      this->random.resize(_count);
+      for (std::size_t i = 0; i < _count; ++i)
+        this->random[i] = Seed(_seed, i);
+    }
+
+    // Change the set of rovers, keeping the biases, generators and last
+    // velocities of the rovers that stay.
+    // _from Index in the current set of every rover of the new set, or -1
+    // for a rover that was not in it.
+    // _stream Generator of the first new rover, the next ones follow. The
+    // generators of Resize are streams 0 to count - 1.
+    public: void Remap(const std::vector<int> &_from, uint64_t _seed
+                     , std::size_t _stream)
+    {
+      const std::size_t count = _from.size();
+      std::vector<float> *arrays[] = {&this->vx, &this->vy, &this->vz
+          , &this->qw, &this->qx, &this->qy, &this->qz, &this->wx, &this->wy
+          , &this->wz, &this->ax, &this->ay, &this->az, &this->gx, &this->gy
+          , &this->gz, &this->lastVx, &this->lastVy, &this->lastVz
+          , &this->accelBiasX, &this->accelBiasY, &this->accelBiasZ
+          , &this->gyroBiasX, &this->gyroBiasY, &this->gyroBiasZ
+          , &this->hasLast};
+      for (auto array : arrays)
+      {
+        std::vector<float> remapped(count, 0.0f);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+          if (_from[i] >= 0)
+            remapped[i] = (*array)[_from[i]];
+        }
+        array->swap(remapped);
+      }
+
+      std::vector<float> angles(count * sensorWheelCount, 0.0f);
+      std::vector<int32_t> counts(count * sensorWheelCount, 0);
+      std::vector<uint64_t> states(count);
+      for (std::size_t i = 0; i < count; ++i)
+      {
+        if (_from[i] < 0)
+        {
+          this->qw[i] = 1.0f;
+          states[i] = Seed(_seed, _stream++);
+          continue;
+        }
+        for (int k = 0; k < sensorWheelCount; ++k)
+        {
+          angles[i * sensorWheelCount + k] =
+              this->wheelAngle[_from[i] * sensorWheelCount + k];
+          counts[i * sensorWheelCount + k] =
+              this->ticks[_from[i] * sensorWheelCount + k];
+        }
+        states[i] = this->random[_from[i]];
+      }
+      this->wheelAngle.swap(angles);
+      this->ticks.swap(counts);
+      this->random.swap(states);
+    }
+
+    // Number of rovers.
+    public: std::size_t Size() const
+    {
+      return this->vx.size();
+    }
+
+    // Evaluate the readings of every rover.
+    // _dt Time since the previous evaluation, s.
+    // _gravity Gravity in the world frame, m/s^2.
+    public: void Evaluate(float _dt, const SensorParams &_params
+                        , const float _gravity[3])
+    {
+      const int count = static_cast<int>(this->Size());
+      // Copies, so that the loop does not reload them after every store
+      const float gX = _gravity[0];
+      const float gY = _gravity[1];
+      const float gZ = _gravity[2];
+      const float rate = _dt > 0.0f ? 1.0f / _dt : 0.0f;
+      const float accelNoise = _params.accelNoise;
+      const float gyroNoise = _params.gyroNoise;
+      const float accelWalk = _params.accelBiasWalk * std::sqrt(_dt);
+      const float gyroWalk = _params.gyroBiasWalk * std::sqrt(_dt);
+      const float ticksPerRadian =
+          _params.encoderTicks / (2.0f * 3.14159265f);
+
+      const float *vX = this->vx.data();
+      const float *vY = this->vy.data();
+      const float *vZ = this->vz.data();
+      const float *qW = this->qw.data();
+      const float *qX = this->qx.data();
+      const float *qY = this->qy.data();
+      const float *qZ = this->qz.data();
+      const float *wX = this->wx.data();
+      const float *wY = this->wy.data();
+      const float *wZ = this->wz.data();
+      float *aX = this->ax.data();
+      float *aY = this->ay.data();
+      float *aZ = this->az.data();
+      float *rX = this->gx.data();
+      float *rY = this->gy.data();
+      float *rZ = this->gz.data();
+      float *lastX = this->lastVx.data();
+      float *lastY = this->lastVy.data();
+      float *lastZ = this->lastVz.data();
+      float *abX = this->accelBiasX.data();
+      float *abY = this->accelBiasY.data();
+      float *abZ = this->accelBiasZ.data();
+      float *gbX = this->gyroBiasX.data();
+      float *gbY = this->gyroBiasY.data();
+      float *gbZ = this->gyroBiasZ.data();
+      float *seen = this->hasLast.data();
+      uint64_t *state = this->random.data();
+
+      ROVER_VECTORIZE
+      for (int i = 0; i < count; ++i)
+      {
+        uint64_t s = state[i];
+
+        // Specific force, the acceleration minus gravity, in the world
+        // frame and then rotated into the body frame. A rover without a
+        // previous velocity reads no acceleration.
+        const float r = rate * seen[i];
+        const float fX = (vX[i] - lastX[i]) * r - gX;
+        const float fY = (vY[i] - lastY[i]) * r - gY;
+        const float fZ = (vZ[i] - lastZ[i]) * r - gZ;
+        lastX[i] = vX[i];
+        lastY[i] = vY[i];
+        lastZ[i] = vZ[i];
+        seen[i] = 1.0f;
+        float bX, bY, bZ;
+        ToBody(qW[i], qX[i], qY[i], qZ[i], fX, fY, fZ, bX, bY, bZ);
+
+        abX[i] += accelWalk * Gaussian(s);
+        abY[i] += accelWalk * Gaussian(s);
+        abZ[i] += accelWalk * Gaussian(s);
+        aX[i] = bX + abX[i] + accelNoise * Gaussian(s);
+        aY[i] = bY + abY[i] + accelNoise * Gaussian(s);
+        aZ[i] = bZ + abZ[i] + accelNoise * Gaussian(s);
+
+        ToBody(qW[i], qX[i], qY[i], qZ[i], wX[i], wY[i], wZ[i], bX, bY, bZ);
+        gbX[i] += gyroWalk * Gaussian(s);
+        gbY[i] += gyroWalk * Gaussian(s);
+        gbZ[i] += gyroWalk * Gaussian(s);
+        rX[i] = bX + gbX[i] + gyroNoise * Gaussian(s);
+        rY[i] = bY + gbY[i] + gyroNoise * Gaussian(s);
+        rZ[i] = bZ + gbZ[i] + gyroNoise * Gaussian(s);
+
+        state[i] = s;
+      }
+
+      // Encoders count whole ticks of the wheel angle. The floor is the
+      // truncation, less one where that rounded a negative count up:
+      // std::floor only vectorizes from SSE4.1 on.
+      const int wheels = count * sensorWheelCount;
+      const float *angle = this->wheelAngle.data();
+      int32_t *tick = this->ticks.data();
+      ROVER_VECTORIZE
+      for (int i = 0; i < wheels; ++i)
+      {
+        const float exact = angle[i] * ticksPerRadian;
+        const int32_t truncated = static_cast<int32_t>(exact);
+        tick[i] = truncated - (exact < static_cast<float>(truncated) ? 1 : 0);
+      }
+    }
+
+    // Rotate a world vector into the body frame of orientation q.
+    private: static void ToBody(float _w, float _x, float _y, float _z
+                              , float _vx, float _vy, float _vz
+                              , float &_bx, float &_by, float &_bz)
+    {
+      // v + 2 w (u x v) + 2 u x (u x v) with u = -(x, y, z), the inverse
+      const float tx = 2.0f * (-_y * _vz + _z * _vy);
+      const float ty = 2.0f * (-_z * _vx + _x * _vz);
+      const float tz = 2.0f * (-_x * _vy + _y * _vx);
+      _bx = _vx + _w * tx + (-_y * tz + _z * ty);
+      _by = _vy + _w * ty + (-_z * tx + _x * tz);
+      _bz = _vz + _w * tz + (-_x * ty + _y * tx);
+    }
+
+    // State of generator _stream of a seed. splitmix64 spreads
+    // consecutive streams over the state space.
+    private: static uint64_t Seed(uint64_t _seed, std::size_t _stream)
+    {
+      uint64_t z = _seed + (_stream + 1) * 0x9E3779B97F4A7C15ULL;
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      return (z ^ (z >> 31)) | 1;
+    }
+
+    // Approximately normal sample from one xorshift64 step: the sum of four
+    // 16 bit uniforms, scaled to unit variance. Its tails end at 3.46
+    // standard deviations, which sensor noise does not miss.
+    private: static float Gaussian(uint64_t &_state)
+    {
+      _state ^= _state << 13;
+      _state ^= _state >> 7;
+      _state ^= _state << 17;
+      // Summed as integers, converting 64 bit integers to float does not
+      // vectorize before AVX-512
+      const int32_t sum = static_cast<int32_t>((_state & 0xFFFF)
+          + ((_state >> 16) & 0xFFFF) + ((_state >> 32) & 0xFFFF)
+          + (_state >> 48));
+      // Mean 2 * 65535, standard deviation 65536 / sqrt(3)
+      return static_cast<float>(sum - 131070) * 2.64301019e-5f;
+    }
+
+    // Inputs, one entry per rover, in the world frame and SI units.
+    public: std::vector<float> vx, vy, vz;
+    // Orientation quaternion.
+    public: std::vector<float> qw, qx, qy, qz;
+    public: std::vector<float> wx, wy, wz;
+    // Wheel angles, rad, rover major: wheel k of rover i at 4 i + k.
+    public: std::vector<float> wheelAngle;
+
+    // Outputs, in the body frame: accelerometer and gyroscope.
+    public: std::vector<float> ax, ay, az;
+    public: std::vector<float> gx, gy, gz;
+    // Encoder counts, in the order of wheelAngle.
+    public: std::vector<int32_t> ticks;
+
+    // Velocities of the previous evaluation, one where a rover has them,
+    // sensor biases and generators.
+    private: std::vector<float> lastVx, lastVy, lastVz;
+    private: std::vector<float> hasLast;
+    private: std::vector<float> accelBiasX, accelBiasY, accelBiasZ;
+    private: std::vector<float> gyroBiasX, gyroBiasY, gyroBiasZ;
+    private: std::vector<uint64_t> random;
+  };
+
+  // Preallocated ring of sensor frames, each holding the readings of all
+  // rovers at one time. Nothing is allocated after Reset. When the ring is
+  // full the oldest frame is overwritten, and counted.
+  class SensorRing
+  {
+    // Allocate room for a number of frames of a number of rovers.
+    public: void Reset(std::size_t _rovers, std::size_t _capacity)
+    {
+      this->rovers = _rovers;
+      this->capacity = _capacity;
+      this->times.assign(_capacity, 0.0);
+      this->imu.assign(_capacity * _rovers * 6, 0.0f);
+      this->encoders.assign(_capacity * _rovers * sensorWheelCount, 0);
+      this->first = 0;
+      this->count = 0;
+      this->overwritten = 0;
+    }
+
+    // Change the set of rovers as SensorBatch::Remap, keeping the frames.
+    // Rovers that are new read zero in the frames already held.
+    public: void Remap(const std::vector<int> &_from)
+    {
+      const std::size_t rovers = _from.size();
+      std::vector<float> remappedImu(this->capacity * rovers * 6, 0.0f);
+      std::vector<int32_t> remappedEncoders(
+          this->capacity * rovers * sensorWheelCount, 0);
+      for (std::size_t slot = 0; slot < this->capacity; ++slot)
+      {
+        for (std::size_t i = 0; i < rovers; ++i)
+        {
+          if (_from[i] < 0)
+            continue;
+          for (int c = 0; c < 6; ++c)
+          {
+            remappedImu[(slot * 6 + c) * rovers + i] =
+                this->imu[(slot * 6 + c) * this->rovers + _from[i]];
+          }
+          for (int k = 0; k < sensorWheelCount; ++k)
+          {
+            remappedEncoders[(slot * rovers + i) * sensorWheelCount + k] =
+                this->encoders[(slot * this->rovers + _from[i]) *
+                               sensorWheelCount + k];
+          }
+        }
+      }
+      this->imu.swap(remappedImu);
+      this->encoders.swap(remappedEncoders);
+      this->rovers = rovers;
+    }
+
+    // Copy the outputs of a batch as the newest frame.
+    public: void Push(double _time, const SensorBatch &_batch)
+    {
+      if (this->capacity == 0)
+        return;
+      std::size_t slot;
+      if (this->count == this->capacity)
+      {
+        slot = this->first;
+        this->first = (this->first + 1) % this->capacity;
+        ++this->overwritten;
+      }
+      else
+      {
+        slot = (this->first + this->count) % this->capacity;
+        ++this->count;
+      }
+      this->times[slot] = _time;
+      const std::vector<float> *channels[] = {&_batch.ax, &_batch.ay
+          , &_batch.az, &_batch.gx, &_batch.gy, &_batch.gz};
+      float *out = &this->imu[slot * this->rovers * 6];
+      for (const std::vector<float> *channel : channels)
+      {
+        std::copy(channel->begin(), channel->begin() + this->rovers, out);
+        out += this->rovers;
+      }
+      std::copy(_batch.ticks.begin(),
+                _batch.ticks.begin() + this->rovers * sensorWheelCount,
+                &this->encoders[slot * this->rovers * sensorWheelCount]);
+    }
+
+    // Frames held, index 0 is the oldest.
+    public: std::size_t Size() const
+    {
+      return this->count;
+    }
+
+    public: bool Full() const
+    {
+      return this->count == this->capacity;
+    }
+
+    public: double Time(std::size_t _frame) const
+    {
+      return this->times[this->Slot(_frame)];
+    }
+
+    // IMU readings of a frame, channel major: ax of every rover, then ay,
+    // az, gx, gy and gz.
+    public: const float *Imu(std::size_t _frame) const
+    {
+      return &this->imu[this->Slot(_frame) * this->rovers * 6];
+    }
+
+    // Encoder counts of a frame, as SensorBatch::ticks.
+    public: const int32_t *Encoders(std::size_t _frame) const
+    {
+      return &this->encoders[this->Slot(_frame) * this->rovers *
+                             sensorWheelCount];
+    }
+
+    // Drop every frame, after they have been read.
+    public: void Clear()
+    {
+      this->first = 0;
+      this->count = 0;
+    }
+
+    // Frames lost because the ring was full.
+    public: uint64_t Overwritten() const
+    {
+      return this->overwritten;
+    }
+
+    private: std::size_t Slot(std::size_t _frame) const
+    {
+      return (this->first + _frame) % this->capacity;
+    }
+
+    private: std::size_t rovers = 0;
+    private: std::size_t capacity = 0;
+    private: std::vector<double> times;
+    private: std::vector<float> imu;
+    private: std::vector<int32_t> encoders;
+    private: std::size_t first = 0;
+    private: std::size_t count = 0;
+    private: uint64_t overwritten = 0;
+  };
+}
+#endif
@@ -0,0 +1,149 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "sensor_batch.hh"
+
+using namespace rover;
+
+static const float g_gravity[3] = {0.0f, 0.0f, -9.81f};
+
+// Velocity along x of rover _i, and the angle of its first wheel.
+static void SetInputs(SensorBatch &_batch, int _i, float _speed)
+{
+  _batch.vx[_i] = _speed;
+  _batch.wheelAngle[_i * sensorWheelCount] = _speed;
+}
+
+/////////////////////////////////////////////////
+// Remapping an empty batch gives the same generators as Resize
+TEST(SensorBatch, RemapMatchesResize)
+{
+  SensorParams params;
+  SensorBatch resized;
+  resized.Resize(3, 7);
+  SensorBatch remapped;
+  remapped.Resize(0, 7);
+  remapped.Remap(std::vector<int>(3, -1), 7, 0);
+
+  for (int step = 0; step < 5; ++step)
+  {
+    resized.Evaluate(0.01f, params, g_gravity);
+    remapped.Evaluate(0.01f, params, g_gravity);
+  }
+  for (int i = 0; i < 3; ++i)
+  {
+    EXPECT_EQ(resized.ax[i], remapped.ax[i]);
+    EXPECT_EQ(resized.gz[i], remapped.gz[i]);
+  }
+}
+
+/////////////////////////////////////////////////
+// Rovers that stay keep their noise when another one is inserted, and the
+// new one reads no acceleration on its first sample
+TEST(SensorBatch, RemapKeepsState)
+{
+  SensorParams params;
+  SensorBatch reference;
+  reference.Resize(2, 3);
+  SensorBatch batch;
+  batch.Resize(2, 3);
+
+  for (int step = 0; step < 10; ++step)
+  {
+    for (int i = 0; i < 2; ++i)
+    {
+      SetInputs(reference, i, i + 0.1f * step);
+      SetInputs(batch, i, i + 0.1f * step);
+    }
+    reference.Evaluate(0.01f, params, g_gravity);
+    batch.Evaluate(0.01f, params, g_gravity);
+  }
+
+  // Rover 1 first, then a new rover, then rover 0
+  batch.Remap({1, -1, 0}, 3, 2);
+  ASSERT_EQ(batch.Size(), 3u);
+
+  for (int step = 10; step < 20; ++step)
+  {
+    for (int i = 0; i < 2; ++i)
+      SetInputs(reference, i, i + 0.1f * step);
+    SetInputs(batch, 0, 1 + 0.1f * step);
+    SetInputs(batch, 1, 50.0f);
+    SetInputs(batch, 2, 0.1f * step);
+    reference.Evaluate(0.01f, params, g_gravity);
+    batch.Evaluate(0.01f, params, g_gravity);
+
+    EXPECT_EQ(batch.ax[0], reference.ax[1]);
+    EXPECT_EQ(batch.az[0], reference.az[1]);
+    EXPECT_EQ(batch.ax[2], reference.ax[0]);
+    EXPECT_EQ(batch.gy[2], reference.gy[0]);
+    EXPECT_EQ(batch.ticks[0], reference.ticks[sensorWheelCount]);
+    EXPECT_EQ(batch.ticks[2 * sensorWheelCount], reference.ticks[0]);
+    if (step == 10)
+    {
+      EXPECT_NEAR(batch.ax[1], 0.0f, 0.2f);
+    }
+  }
+}
+
+/////////////////////////////////////////////////
+// The frames held by the ring follow their rovers
+TEST(SensorRing, RemapKeepsFrames)
+{
+  SensorParams params;
+  SensorBatch batch;
+  batch.Resize(2, 1);
+  SensorRing ring;
+  ring.Reset(2, 4);
+  for (int frame = 0; frame < 3; ++frame)
+  {
+    SetInputs(batch, 0, 1.0f);
+    SetInputs(batch, 1, 2.0f);
+    batch.Evaluate(0.01f, params, g_gravity);
+    ring.Push(frame, batch);
+  }
+  std::vector<float> imu(ring.Imu(2), ring.Imu(2) + 2 * 6);
+  std::vector<int32_t> encoders(ring.Encoders(2),
+                                ring.Encoders(2) + 2 * sensorWheelCount);
+
+  ring.Remap({-1, 1, 0});
+  ASSERT_EQ(ring.Size(), 3u);
+  EXPECT_DOUBLE_EQ(ring.Time(2), 2.0);
+  for (int c = 0; c < 6; ++c)
+  {
+    EXPECT_EQ(ring.Imu(2)[c * 3], 0.0f);
+    EXPECT_EQ(ring.Imu(2)[c * 3 + 1], imu[c * 2 + 1]);
+    EXPECT_EQ(ring.Imu(2)[c * 3 + 2], imu[c * 2]);
+  }
+  for (int k = 0; k < sensorWheelCount; ++k)
+  {
+    EXPECT_EQ(ring.Encoders(2)[k], 0);
+    EXPECT_EQ(ring.Encoders(2)[sensorWheelCount + k],
+              encoders[sensorWheelCount + k]);
+    EXPECT_EQ(ring.Encoders(2)[2 * sensorWheelCount + k], encoders[k]);
+  }
+
+  // Frames of the new layout go after the remapped ones
+  batch.Remap({-1, 1, 0}, 1, 2);
+  batch.Evaluate(0.01f, params, g_gravity);
+  ring.Push(3, batch);
+  EXPECT_TRUE(ring.Full());
+  EXPECT_EQ(ring.Imu(3)[2], batch.ax[2]);
+}
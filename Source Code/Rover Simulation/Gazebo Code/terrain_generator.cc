@@ -0,0 +1,656 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+#include <sys/stat.h>
+
+#include "terrain_generator.hh"
+
+using namespace rover;
+
+namespace
+{
+  // Independent random streams of the terrain features.
+  enum Channel {NOISE = 1, CRATER = 2, ROCK = 3};
+
+  // splitmix64 finalizer
+  uint64_t Mix(uint64_t _h)
+  {
+    _h += 0x9e3779b97f4a7c15ULL;
+    _h = (_h ^ (_h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    _h = (_h ^ (_h >> 27)) * 0x94d049bb133111ebULL;
+    return _h ^ (_h >> 31);
+  }
+
+  // Hash of a seed, an integer lattice point, a feature and a sub index.
+  uint64_t Hash(uint64_t _seed, int64_t _x, int64_t _y, uint64_t _channel
+              , uint64_t _index = 0)
+  {
+    uint64_t h = Mix(_seed ^ (_channel << 56) ^ _index);
+    h = Mix(h ^ static_cast<uint64_t>(_x));
+    return Mix(h ^ static_cast<uint64_t>(_y));
+  }
+
+  // Uniform number in [0, 1) from a hash.
+  double Unit(uint64_t _h)
+  {
+    return (_h >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+  double Fade(double _t)
+  {
+    return _t * _t * _t * (_t * (_t * 6.0 - 15.0) + 10.0);
+  }
+
+  // Gradient noise with one random unit gradient per lattice point,
+  // roughly in [-0.7, 0.7].
+  double Gradient(uint64_t _seed, uint64_t _octave, double _x, double _y)
+  {
+    const double fx = floor(_x);
+    const double fy = floor(_y);
+    const int64_t ix = static_cast<int64_t>(fx);
+    const int64_t iy = static_cast<int64_t>(fy);
+    const double dx = _x - fx;
+    const double dy = _y - fy;
+
+    double corner[4];
+    for (int c = 0; c < 4; ++c)
+    {
+      const int cx = c & 1;
+      const int cy = c >> 1;
+      const double angle =
+          2.0 * M_PI * Unit(Hash(_seed, ix + cx, iy + cy, NOISE, _octave));
+      corner[c] = cos(angle) * (dx - cx) + sin(angle) * (dy - cy);
+    }
+    const double u = Fade(dx);
+    const double v = Fade(dy);
+    const double bottom = corner[0] + u * (corner[1] - corner[0]);
+    const double top = corner[2] + u * (corner[3] - corner[2]);
+    return bottom + v * (top - bottom);
+  }
+
+  // Number of events of a Poisson distribution with a mean, by inversion.
+  int Poisson(double _mean, double _u)
+  {
+    double p = exp(-_mean);
+    double cumulative = p;
+    int k = 0;
+    while (_u > cumulative && k < 16)
+    {
+      ++k;
+      p *= _mean / k;
+      cumulative += p;
+    }
+    return k;
+  }
+
+  uint32_t Crc32(const unsigned char *_data, size_t _size, uint32_t _crc)
+  {
+    static uint32_t table[256];
+    static bool initialized = false;
+    if (!initialized)
+    {
+      for (uint32_t n = 0; n < 256; ++n)
+      {
+        uint32_t c = n;
+        for (int k = 0; k < 8; ++k)
+          c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        table[n] = c;
+      }
+      initialized = true;
+    }
+    _crc = ~_crc;
+    for (size_t i = 0; i < _size; ++i)
+      _crc = table[(_crc ^ _data[i]) & 0xff] ^ (_crc >> 8);
+    return ~_crc;
+  }
+
+  void PutBigEndian32(std::string &_out, uint32_t _value)
+  {
+    _out.push_back(static_cast<char>(_value >> 24));
+    _out.push_back(static_cast<char>(_value >> 16));
+    _out.push_back(static_cast<char>(_value >> 8));
+    _out.push_back(static_cast<char>(_value));
+  }
+
+  void WriteChunk(std::ofstream &_out, const char *_type
+                , const std::string &_data)
+  {
+    std::string chunk;
+    PutBigEndian32(chunk, static_cast<uint32_t>(_data.size()));
+    chunk.append(_type, 4);
+    chunk.append(_data);
+    const uint32_t crc = Crc32(
+        reinterpret_cast<const unsigned char *>(chunk.data()) + 4,
+        chunk.size() - 4, 0);
+    PutBigEndian32(chunk, crc);
+    _out.write(chunk.data(), chunk.size());
+  }
+
+  bool MakeDirectory(const std::string &_path)
+  {
+    struct stat info;
+    if (stat(_path.c_str(), &info) == 0)
+      return S_ISDIR(info.st_mode);
+    return mkdir(_path.c_str(), 0755) == 0;
+  }
+
+  std::string TileName(int _i, int _j, int _lod)
+  {
+    std::ostringstream name;
+    name << "tile_" << _i << "_" << _j << "_lod" << _lod;
+    return name.str();
+  }
+
+  std::vector<uint16_t> Quantize(const std::vector<double> &_heights
+                               , double _min, double _max)
+  {
+    const double scale = (_max > _min) ? 65535.0 / (_max - _min) : 0.0;
+    std::vector<uint16_t> samples(_heights.size());
+    for (size_t i = 0; i < _heights.size(); ++i)
+    {
+      const double q = std::round((_heights[i] - _min) * scale);
+      samples[i] =
+          static_cast<uint16_t>(std::min(65535.0, std::max(0.0, q)));
+    }
+    return samples;
+  }
+}
+
+/////////////////////////////////////////////////
+TerrainGenerator::TerrainGenerator(const TerrainParams &_params)
+  : params(_params)
+{
+}
+
+/////////////////////////////////////////////////
+double TerrainGenerator::Height(double _x, double _y) const
+{
+  return this->Noise(_x, _y) + this->Craters(_x, _y) + this->Rocks(_x, _y);
+}
+
+/////////////////////////////////////////////////
+double TerrainGenerator::Noise(double _x, double _y) const
+{
+  double height = 0.0;
+  double amplitude = this->params.amplitude;
+  double frequency = 1.0 / this->params.wavelength;
+  for (int o = 0; o < this->params.octaves; ++o)
+  {
+    height += amplitude *
+        Gradient(this->params.seed, o, _x * frequency, _y * frequency);
+    amplitude *= this->params.gain;
+    frequency *= 2.0;
+  }
+  return height;
+}
+
+/////////////////////////////////////////////////
+double TerrainGenerator::Craters(double _x, double _y) const
+{
+  // Craters reach out to twice their radius, so with cells of that size
+  // only the neighboring cells can affect a point.
+  const double cell = 2.0 * this->params.craterMaxRadius;
+  const double meanPerCell =
+      this->params.craterDensity * cell * cell * 1e-6;
+  const double ratio =
+      this->params.craterMinRadius / this->params.craterMaxRadius;
+  const int64_t cx = static_cast<int64_t>(floor(_x / cell));
+  const int64_t cy = static_cast<int64_t>(floor(_y / cell));
+
+  double height = 0.0;
+  for (int64_t ny = cy - 1; ny <= cy + 1; ++ny)
+  {
+    for (int64_t nx = cx - 1; nx <= cx + 1; ++nx)
+    {
+      const uint64_t seed = this->params.seed;
+      const int count =
+          Poisson(meanPerCell, Unit(Hash(seed, nx, ny, CRATER)));
+      for (int k = 0; k < count; ++k)
+      {
+        const double px =
+            (nx + Unit(Hash(seed, nx, ny, CRATER, 3*k+1))) * cell;
+        const double py =
+            (ny + Unit(Hash(seed, nx, ny, CRATER, 3*k+2))) * cell;
+        // inverse of the truncated power law N(>R) ~ R^-2
+        const double u = Unit(Hash(seed, nx, ny, CRATER, 3*k+3));
+        const double radius = this->params.craterMinRadius /
+            sqrt(1.0 - u * (1.0 - ratio * ratio));
+
+        const double r = hypot(_x - px, _y - py) / radius;
+        if (r >= 2.0)
+          continue;
+        // bowl of depth 0.2R inside, rim of height 0.04R falling off to
+        // zero at twice the radius
+        const double depth = 0.2 * radius;
+        const double rim = 0.04 * radius;
+        if (r < 1.0)
+          height += -depth + (depth + rim) * r * r;
+        else
+          height += rim * (2.0 - r) * (2.0 - r);
+      }
+    }
+  }
+  return height;
+}
+
+/////////////////////////////////////////////////
+double TerrainGenerator::Rocks(double _x, double _y) const
+{
+  // Each rock lies inside its 2m cell, so only one cell is checked.
+  const double cell = 2.0;
+  const int64_t cx = static_cast<int64_t>(floor(_x / cell));
+  const int64_t cy = static_cast<int64_t>(floor(_y / cell));
+  const uint64_t seed = this->params.seed;
+  if (Unit(Hash(seed, cx, cy, ROCK)) >= this->params.rockFraction)
+    return 0.0;
+
+  const double radius = this->params.rockMinRadius +
+      Unit(Hash(seed, cx, cy, ROCK, 1)) *
+      (this->params.rockMaxRadius - this->params.rockMinRadius);
+  const double free = cell - 2.0 * radius;
+  const double px =
+      cx * cell + radius + Unit(Hash(seed, cx, cy, ROCK, 2)) * free;
+  const double py =
+      cy * cell + radius + Unit(Hash(seed, cx, cy, ROCK, 3)) * free;
+  const double d2 = (_x - px) * (_x - px) + (_y - py) * (_y - py);
+  if (d2 >= radius * radius)
+    return 0.0;
+  // sphere buried to 30% of its radius
+  return std::max(0.0, sqrt(radius * radius - d2) - 0.3 * radius);
+}
+
+/////////////////////////////////////////////////
+int TerrainGenerator::TilesPerSide() const
+{
+  return static_cast<int>(std::round(this->params.size /
+                                     this->params.tileSize));
+}
+
+/////////////////////////////////////////////////
+int TerrainGenerator::TileSamples(int _lod) const
+{
+  return ((this->params.tileResolution - 1) >> _lod) + 1;
+}
+
+/////////////////////////////////////////////////
+std::vector<double> TerrainGenerator::Grid(double _minX, double _maxY
+                                         , double _side, int _samples) const
+{
+  const double spacing = _side / (_samples - 1);
+  std::vector<double> heights(_samples * _samples);
+  for (int row = 0; row < _samples; ++row)
+  {
+    const double y = _maxY - row * spacing;
+    for (int col = 0; col < _samples; ++col)
+      heights[row * _samples + col] = this->Height(_minX + col * spacing, y);
+  }
+  return heights;
+}
+
+/////////////////////////////////////////////////
+std::vector<double> TerrainGenerator::Tile(int _i, int _j, int _lod) const
+{
+  const double half = 0.5 * this->params.size;
+  return this->Grid(-half + _i * this->params.tileSize,
+                    -half + (_j + 1) * this->params.tileSize,
+                    this->params.tileSize, this->TileSamples(_lod));
+}
+
+/////////////////////////////////////////////////
+std::vector<double> TerrainGenerator::Overview() const
+{
+  const double half = 0.5 * this->params.size;
+  return this->Grid(-half, half, this->params.size,
+                    this->params.overviewResolution);
+}
+
+/////////////////////////////////////////////////
+void TerrainGenerator::TileCenter(int _i, int _j, double &_x, double &_y) const
+{
+  const double half = 0.5 * this->params.size;
+  _x = -half + (_i + 0.5) * this->params.tileSize;
+  _y = -half + (_j + 0.5) * this->params.tileSize;
+}
+
+/////////////////////////////////////////////////
+double TerrainGenerator::TileDistance(int _i, int _j
+                                    , double _x, double _y) const
+{
+  double cx, cy;
+  this->TileCenter(_i, _j, cx, cy);
+  const double halfTile = 0.5 * this->params.tileSize;
+  const double dx = std::max(0.0, fabs(_x - cx) - halfTile);
+  const double dy = std::max(0.0, fabs(_y - cy) - halfTile);
+  return hypot(dx, dy);
+}
+
+/////////////////////////////////////////////////
+int TerrainGenerator::TileLod(int _i, int _j, double _x, double _y
+                            , int _current, double _hysteresis) const
+{
+  const double distance = this->TileDistance(_i, _j, _x, _y);
+  const int lod = std::min(
+      static_cast<int>(distance / this->params.lodDistance),
+      this->params.lodLevels - 1);
+  if (_current < 0 || lod == _current)
+    return lod;
+
+  // The boundary of the current LOD on the side of the new one
+  const double boundary = this->params.lodDistance *
+      (lod > _current ? _current + 1 : _current);
+  return fabs(distance - boundary) < _hysteresis ? _current : lod;
+}
+
+/////////////////////////////////////////////////
+bool TerrainGenerator::Write(const std::string &_directory
+                           , bool _streaming) const
+{
+  const std::string tileDirectory = _directory + "/tiles";
+  if (!MakeDirectory(_directory) || !MakeDirectory(tileDirectory))
+    return false;
+
+  char resolved[PATH_MAX];
+  if (!realpath(_directory.c_str(), resolved))
+    return false;
+  const std::string absolute(resolved);
+
+  const int tiles = this->TilesPerSide();
+
+  // Every coarser LOD sample is also a sample of the finest LOD, so its
+  // range is the range of the whole terrain. All tiles are quantized to
+  // it so they line up in height.
+  double minHeight = std::numeric_limits<double>::max();
+  double maxHeight = -std::numeric_limits<double>::max();
+  for (int j = 0; j < tiles; ++j)
+  {
+    for (int i = 0; i < tiles; ++i)
+    {
+      for (double h : this->Tile(i, j, 0))
+      {
+        minHeight = std::min(minHeight, h);
+        maxHeight = std::max(maxHeight, h);
+      }
+    }
+  }
+
+  const int overviewSamples = this->params.overviewResolution;
+  const std::vector<uint16_t> overview =
+      Quantize(this->Overview(), minHeight, maxHeight);
+  if (!WritePng16(_directory + "/overview.png", overviewSamples,
+                  overviewSamples, overview))
+  {
+    return false;
+  }
+
+  for (int j = 0; j < tiles; ++j)
+  {
+    for (int i = 0; i < tiles; ++i)
+    {
+      for (int lod = 0; lod < this->params.lodLevels; ++lod)
+      {
+        const int samples = this->TileSamples(lod);
+        const std::vector<uint16_t> tile =
+            Quantize(this->Tile(i, j, lod), minHeight, maxHeight);
+        const std::string base = tileDirectory + "/" + TileName(i, j, lod);
+        if (!WritePng16(base + ".png", samples, samples, tile) ||
+            !WriteRaw16(base + ".r16", tile))
+        {
+          return false;
+        }
+      }
+    }
+  }
+
+  // Heights at full precision: the tiles are quantized with the exact
+  // range, and the streamer and world place them with what is read back
+  const int digits = std::numeric_limits<double>::max_digits10;
+  std::ofstream manifest((_directory + "/terrain.manifest").c_str());
+  manifest << std::setprecision(digits);
+  manifest << "seed " << this->params.seed << "\n"
+           << "size " << this->params.size << "\n"
+           << "tile_size " << this->params.tileSize << "\n"
+           << "tiles_per_side " << tiles << "\n"
+           << "tile_resolution " << this->params.tileResolution << "\n"
+           << "lod_levels " << this->params.lodLevels << "\n"
+           << "lod_distance " << this->params.lodDistance << "\n"
+           << "min_height " << minHeight << "\n"
+           << "max_height " << maxHeight << "\n";
+  if (!manifest)
+    return false;
+
+  // Gazebo world: one static heightmap collision per tile at the LOD of
+  // its distance from the rover start, or the streamer plugin that keeps
+  // the tiles around the rover loaded, plus the overview as the only
+  // visual since Gazebo renders a single heightmap per scene.
+  const double range = std::max(maxHeight - minHeight, 1e-3);
+  std::ofstream world((_directory + "/terrain.world").c_str());
+  world << std::setprecision(digits);
+  world << "<?xml version=\"1.0\"?>\n"
+        << "<sdf version=\"1.6\">\n"
+        << "  <world name=\"default\">\n"
+        << "    <include>\n"
+        << "      <uri>model://sun</uri>\n"
+        << "    </include>\n"
+        << "    <model name=\"terrain_overview\">\n"
+        << "      <static>true</static>\n"
+        << "      <link name=\"link\">\n"
+        << "        <visual name=\"visual\">\n"
+        << "          <geometry>\n"
+        << "            <heightmap>\n"
+        << "              <uri>file://" << absolute << "/overview.png</uri>\n"
+        << "              <size>" << this->params.size << " "
+        << this->params.size << " " << range << "</size>\n"
+        << "              <pos>0 0 " << minHeight << "</pos>\n"
+        << "            </heightmap>\n"
+        << "          </geometry>\n"
+        << "        </visual>\n"
+        << "      </link>\n"
+        << "    </model>\n";
+  if (_streaming)
+  {
+    // Tiles are inserted and removed around the rover by the streamer
+    world << "    <plugin name=\"terrain_streamer\""
+          << " filename=\"libterrain_streamer.so\">\n"
+          << "      <terrain_directory>" << absolute
+          << "</terrain_directory>\n"
+          << "    </plugin>\n";
+  }
+  else
+  {
+    for (int j = 0; j < tiles; ++j)
+    {
+      for (int i = 0; i < tiles; ++i)
+      {
+        world << this->TileModel(i, j, this->TileLod(i, j, 0.0, 0.0),
+                                 absolute, minHeight, maxHeight);
+      }
+    }
+  }
+  world << "    <include>\n"
+        << "      <uri>model://basic_rover</uri>\n"
+        << "      <pose>0 0 " << this->Height(0.0, 0.0) << " 0 0 0</pose>\n"
+        << "      <plugin name=\"rover_movement\""
+        << " filename=\"librover_movement.so\"/>\n"
+        << "    </include>\n"
+        << "  </world>\n"
+        << "</sdf>\n";
+  return static_cast<bool>(world);
+}
+
+/////////////////////////////////////////////////
+std::string TerrainGenerator::TileModelName(int _i, int _j, int _lod)
+{
+  std::ostringstream name;
+  name << "terrain_" << _i << "_" << _j << "_lod" << _lod;
+  return name.str();
+}
+
+/////////////////////////////////////////////////
+std::string TerrainGenerator::TileModel(int _i, int _j, int _lod
+                                      , const std::string &_directory
+                                      , double _minHeight
+                                      , double _maxHeight) const
+{
+  double cx, cy;
+  this->TileCenter(_i, _j, cx, cy);
+  const double range = std::max(_maxHeight - _minHeight, 1e-3);
+
+  std::ostringstream model;
+  model << std::setprecision(std::numeric_limits<double>::max_digits10);
+  model << "    <model name=\"" << TileModelName(_i, _j, _lod) << "\">\n"
+        << "      <static>true</static>\n"
+        << "      <link name=\"link\">\n"
+        << "        <collision name=\"collision\">\n"
+        << "          <geometry>\n"
+        << "            <heightmap>\n"
+        << "              <uri>file://" << _directory << "/tiles/"
+        << TileName(_i, _j, _lod) << ".png</uri>\n"
+        << "              <size>" << this->params.tileSize << " "
+        << this->params.tileSize << " " << range << "</size>\n"
+        << "              <pos>" << cx << " " << cy << " " << _minHeight
+        << "</pos>\n"
+        << "            </heightmap>\n"
+        << "          </geometry>\n"
+        << "        </collision>\n"
+        << "      </link>\n"
+        << "    </model>\n";
+  return model.str();
+}
+
+/////////////////////////////////////////////////
+bool rover::ReadTerrainManifest(const std::string &_directory
+                              , TerrainParams &_params
+                              , double &_minHeight
+                              , double &_maxHeight)
+{
+  std::ifstream manifest((_directory + "/terrain.manifest").c_str());
+  if (!manifest)
+    return false;
+
+  int tiles = 0;
+  int found = 0;
+  std::string key;
+  while (manifest >> key)
+  {
+    ++found;
+    if (key == "seed")
+      manifest >> _params.seed;
+    else if (key == "size")
+      manifest >> _params.size;
+    else if (key == "tile_size")
+      manifest >> _params.tileSize;
+    else if (key == "tiles_per_side")
+      manifest >> tiles;
+    else if (key == "tile_resolution")
+      manifest >> _params.tileResolution;
+    else if (key == "lod_levels")
+      manifest >> _params.lodLevels;
+    else if (key == "lod_distance")
+      manifest >> _params.lodDistance;
+    else if (key == "min_height")
+      manifest >> _minHeight;
+    else if (key == "max_height")
+      manifest >> _maxHeight;
+    else
+    {
+      --found;
+      std::getline(manifest, key);
+    }
+  }
+  return found == 9 && tiles > 0 && _params.lodLevels > 0;
+}
+
+/////////////////////////////////////////////////
+bool rover::WritePng16(const std::string &_path, int _width, int _height
+                     , const std::vector<uint16_t> &_samples)
+{
+  std::ofstream out(_path.c_str(), std::ios::binary);
+  if (!out)
+    return false;
+  out.write("\x89PNG\r\n\x1a\n", 8);
+
+  // 16 bit grayscale, no interlacing
+  std::string header;
+  PutBigEndian32(header, _width);
+  PutBigEndian32(header, _height);
+  header += std::string("\x10\x00\x00\x00\x00", 5);
+  WriteChunk(out, "IHDR", header);
+
+  // Scanlines with filter type 0 and big endian samples
+  std::string raw;
+  raw.reserve(_height * (1 + 2 * _width));
+  for (int row = 0; row < _height; ++row)
+  {
+    raw.push_back(0);
+    for (int col = 0; col < _width; ++col)
+    {
+      const uint16_t v = _samples[row * _width + col];
+      raw.push_back(static_cast<char>(v >> 8));
+      raw.push_back(static_cast<char>(v & 0xff));
+    }
+  }
+
+  // zlib stream of stored deflate blocks, the heightmaps are small enough
+  // that compressing them is not worth a zlib dependency
+  std::string zlib("\x78\x01", 2);
+  size_t offset = 0;
+  do
+  {
+    const size_t length = std::min<size_t>(65535, raw.size() - offset);
+    const bool last = (offset + length == raw.size());
+    zlib.push_back(last ? 1 : 0);
+    zlib.push_back(static_cast<char>(length & 0xff));
+    zlib.push_back(static_cast<char>(length >> 8));
+    zlib.push_back(static_cast<char>(~length & 0xff));
+    zlib.push_back(static_cast<char>((~length >> 8) & 0xff));
+    zlib.append(raw, offset, length);
+    offset += length;
+  } while (offset < raw.size());
+
+  uint32_t a = 1, b = 0;
+  for (unsigned char c : raw)
+  {
+    a = (a + c) % 65521;
+    b = (b + a) % 65521;
+  }
+  PutBigEndian32(zlib, (b << 16) | a);
+  WriteChunk(out, "IDAT", zlib);
+  WriteChunk(out, "IEND", std::string());
+  return static_cast<bool>(out);
+}
+
+/////////////////////////////////////////////////
+bool rover::WriteRaw16(const std::string &_path
+                     , const std::vector<uint16_t> &_samples)
+{
+  std::ofstream out(_path.c_str(), std::ios::binary);
+  for (uint16_t v : _samples)
+  {
+    const char bytes[2] = {static_cast<char>(v & 0xff),
+                           static_cast<char>(v >> 8)};
+    out.write(bytes, 2);
+  }
+  return static_cast<bool>(out);
+}
@@ -0,0 +1,164 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#ifndef ROVER_TERRAIN_GENERATOR_HH_
+#define ROVER_TERRAIN_GENERATOR_HH_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace rover
+{
+  // Parameters of a generated terrain. Lengths are in meters.
+  struct TerrainParams
+  {
+    // Seed of every random feature, the same seed gives the same terrain.
+    uint64_t seed = 1;
+
+    // Side of the square terrain, centered on the origin.
+    double size = 1024.0;
+
+    // Side of one square collision tile, size should be a multiple of it.
+    double tileSize = 64.0;
+
+    // Samples along each side of a tile at the finest LOD, 2^n + 1.
+    int tileResolution = 129;
+
+    // Number of LOD levels, each halves the samples along a tile side.
+    int lodLevels = 4;
+
+    // Distance from the rover after which the next coarser LOD is used.
+    double lodDistance = 96.0;
+
+    // Samples along each side of the visual overview heightmap, 2^n + 1.
+    int overviewResolution = 257;
+
+    // Fractal noise: amplitude and wavelength of the first octave.
+    double amplitude = 6.0;
+    double wavelength = 256.0;
+    int octaves = 9;
+    double gain = 0.5;
+
+    // Craters per square kilometer and their radius range. Radii follow
+    // a power law with cumulative exponent 2, so small craters dominate.
+    double craterDensity = 60.0;
+    double craterMinRadius = 2.0;
+    double craterMaxRadius = 40.0;
+
+    // Fraction of 2m x 2m cells holding a rock and the rock radius range.
+    double rockFraction = 0.05;
+    double rockMinRadius = 0.1;
+    double rockMaxRadius = 0.5;
+  };
+
+  // Procedural planetary terrain: fractal noise, craters and rocks.
+  // The height is a pure function of the position and the seed, so any
+  // tile can be generated at any LOD on its own, neighboring tiles match
+  // along their shared border, and memory use does not grow with the
+  // terrain size.
+  class TerrainGenerator
+  {
+    // Constructor.
+    // _params Terrain parameters.
+    public: explicit TerrainGenerator(const TerrainParams &_params);
+
+    // Height of the terrain at a point.
+    public: double Height(double _x, double _y) const;
+
+    // Number of tiles along each side of the terrain.
+    public: int TilesPerSide() const;
+
+    // Samples along each side of a tile at a LOD.
+    public: int TileSamples(int _lod) const;
+
+    // Sample heights of a tile, row major. Row 0 is the +y edge and column
+    // 0 the -x edge, the image convention of heightmaps.
+    // _i Tile column, along x.
+    // _j Tile row, along y.
+    // _lod LOD level, 0 is the finest.
+    public: std::vector<double> Tile(int _i, int _j, int _lod) const;
+
+    // Sample heights of the whole terrain at the overview resolution.
+    public: std::vector<double> Overview() const;
+
+    // Center of a tile.
+    public: void TileCenter(int _i, int _j, double &_x, double &_y) const;
+
+    // Distance from a position to the closest point of a tile.
+    public: double TileDistance(int _i, int _j, double _x, double _y) const;
+
+    // LOD of a tile for a rover at a position.
+    // _current LOD the tile is loaded at, -1 if it is not loaded.
+    // _hysteresis The current LOD is kept until the rover is this far past
+    // the boundary to another LOD, in meters, so that a rover driving
+    // along a boundary does not swap the tile back and forth.
+    public: int TileLod(int _i, int _j, double _x, double _y
+                      , int _current = -1, double _hysteresis = 0.0) const;
+
+    // Name of the Gazebo model of a tile at a LOD.
+    public: static std::string TileModelName(int _i, int _j, int _lod);
+
+    // SDF <model> element of a static tile with heightmap collision.
+    // _directory Absolute directory the terrain was written to.
+    // _minHeight Height of the lowest sample, from the manifest.
+    // _maxHeight Height of the highest sample, from the manifest.
+    public: std::string TileModel(int _i, int _j, int _lod
+                                , const std::string &_directory
+                                , double _minHeight
+                                , double _maxHeight) const;
+
+    // Write all tiles at all LODs, the overview, a manifest and a Gazebo
+    // world with the rover at the origin to a directory.
+    // _streaming Use the terrain streamer plugin in the world instead of
+    // loading every tile up front.
+    // Returns false if a file could not be written.
+    public: bool Write(const std::string &_directory
+                     , bool _streaming = false) const;
+
+    // Samples a square grid of _samples x _samples over a region.
+    private: std::vector<double> Grid(double _minX, double _maxY
+                                    , double _side, int _samples) const;
+
+    // Fractal gradient noise.
+    private: double Noise(double _x, double _y) const;
+
+    // Sum of all crater profiles at a point.
+    private: double Craters(double _x, double _y) const;
+
+    // Sum of all rock bumps at a point.
+    private: double Rocks(double _x, double _y) const;
+
+    // Terrain parameters.
+    private: TerrainParams params;
+  };
+
+  // Read the parameters and height range of a terrain written by
+  // TerrainGenerator::Write. Returns false if a value is missing.
+  bool ReadTerrainManifest(const std::string &_directory
+                         , TerrainParams &_params
+                         , double &_minHeight
+                         , double &_maxHeight);
+
+  // Write 16 bit grayscale samples as a PNG, values are stored unchanged.
+  bool WritePng16(const std::string &_path, int _width, int _height
+                , const std::vector<uint16_t> &_samples);
+
+  // Write 16 bit samples as little endian raw data, as read by Unreal.
+  bool WriteRaw16(const std::string &_path
+                , const std::vector<uint16_t> &_samples);
+}
+#endif
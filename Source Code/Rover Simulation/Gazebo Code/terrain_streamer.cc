@@ -0,0 +1,427 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+// World plugin that keeps the terrain tiles written by generate_terrain
+// loaded around the rover:
+//   <plugin name="terrain_streamer" filename="libterrain_streamer.so">
+//     <terrain_directory>/abs/path</terrain_directory>
+//     <model>basic_rover</model>        rover model to follow
+//     <link>chassis</link>              link whose pose is followed
+//     <radius>100</radius>              load radius in meters
+//     <prefetch_time>5</prefetch_time>  look ahead along the velocity, s
+//     <max_tiles>64</max_tiles>         bound on loaded tiles
+//     <lod_hysteresis>8</lod_hysteresis>  meters past a LOD boundary
+//   </plugin>
+// Load inserts the tiles around the start position of the rover and
+// physics stays disabled until all of them are in the world, so the
+// rover never steps without ground under it. From then on a background
+// thread decides which tiles to load at which LOD, reads
+// their heightmaps into the page cache and queues the model insertions
+// and removals. Only this file I/O leaves the world thread: gazebo
+// decodes the heightmap and builds its collision on the world thread
+// when it inserts the model, so a tile load still shows in the step time.
+// The world thread applies at most one operation per update, which bounds
+// that spike to a single tile. When a tile changes LOD, the old model is
+// only removed once its replacement is in the world.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gazebo/gazebo.hh>
+#include <gazebo/physics/physics.hh>
+#include <gazebo/common/common.hh>
+#include <gazebo/transport/transport.hh>
+#include <ignition/math/Vector3.hh>
+
+#include "terrain_generator.hh"
+
+namespace gazebo
+{
+  class TerrainStreamer : public WorldPlugin
+  {
+    public: ~TerrainStreamer()
+    {
+      {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stop = true;
+      }
+      this->wake.notify_all();
+      if (this->thread.joinable())
+        this->thread.join();
+    }
+
+    public: void Load(physics::WorldPtr _world, sdf::ElementPtr _sdf)
+    {
+      this->world = _world;
+
+      this->directory = _sdf->Get<std::string>("terrain_directory");
+      this->modelName =
+          _sdf->Get<std::string>("model", std::string("basic_rover")).first;
+      this->linkName =
+          _sdf->Get<std::string>("link", std::string("chassis")).first;
+      this->radius = _sdf->Get<double>("radius", 100.0).first;
+      this->prefetchTime = _sdf->Get<double>("prefetch_time", 5.0).first;
+      this->maxTiles = _sdf->Get<int>("max_tiles", 64).first;
+      this->lodHysteresis = _sdf->Get<double>("lod_hysteresis", 8.0).first;
+
+      rover::TerrainParams params;
+      if (!rover::ReadTerrainManifest(this->directory, params,
+                                      this->minHeight, this->maxHeight))
+      {
+        gzerr << "Could not read terrain manifest in " << this->directory
+              << std::endl;
+        return;
+      }
+      this->generator.reset(new rover::TerrainGenerator(params));
+
+      this->node = transport::NodePtr(new transport::Node());
+      this->node->Init(this->world->Name());
+
+      // Models are loaded before world plugins, so the rover is found
+      // here unless it is inserted later
+      ignition::math::Vector3d start;
+      physics::ModelPtr model = this->world->ModelByName(this->modelName);
+      if (model && model->GetLink(this->linkName))
+        start = model->GetLink(this->linkName)->WorldPose().Pos();
+      else
+        gzwarn << "No " << this->modelName << " yet, loading the terrain "
+               << "around the origin" << std::endl;
+
+      // All at once, the world is not stepping yet
+      const auto now = std::chrono::steady_clock::now();
+      for (const auto &w : this->WantedTiles(start, start, start))
+      {
+        const int i = w.second.first;
+        const int j = w.second.second;
+        const int lod = this->generator->TileLod(i, j, start.X(), start.Y());
+        const Operation insert = this->InsertOperation(i, j, lod);
+        this->world->InsertModelString(insert.sdf);
+        this->startTiles.push_back(insert.name);
+        this->loaded[w.second] = LoadedTile{lod, now};
+      }
+      if (!this->startTiles.empty())
+      {
+        this->physicsEnabled = this->world->PhysicsEnabled();
+        this->world->SetPhysicsEnabled(false);
+      }
+
+      this->thread = std::thread(&TerrainStreamer::Run, this);
+
+      this->updateConnection = event::Events::ConnectWorldUpdateBegin(
+          std::bind(&TerrainStreamer::OnUpdate, this));
+    }
+
+    // Called by the world update start event
+    public: void OnUpdate()
+    {
+      // Physics resumes once the tiles inserted by Load are all there
+      if (!this->startTiles.empty())
+      {
+        auto inserted = [this](const std::string &_name)
+        {
+          return static_cast<bool>(this->world->ModelByName(_name));
+        };
+        this->startTiles.erase(std::remove_if(this->startTiles.begin(),
+            this->startTiles.end(), inserted), this->startTiles.end());
+        if (this->startTiles.empty())
+          this->world->SetPhysicsEnabled(this->physicsEnabled);
+      }
+
+      if (!this->link)
+      {
+        physics::ModelPtr model = this->world->ModelByName(this->modelName);
+        if (!model)
+          return;
+        this->link = model->GetLink(this->linkName);
+        if (!this->link)
+          return;
+      }
+
+      Operation operation;
+      bool haveOperation = false;
+      {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->position = this->link->WorldPose().Pos();
+        this->velocity = this->link->WorldLinearVel();
+        this->haveState = true;
+
+        if (!this->operations.empty())
+        {
+          operation = this->operations.front();
+          this->operations.pop_front();
+          haveOperation = true;
+        }
+      }
+
+      // Removals that wait for their replacement, world thread only
+      for (auto it = this->waitingRemovals.begin();
+           it != this->waitingRemovals.end();)
+      {
+        if (this->world->ModelByName(it->after))
+        {
+          transport::RequestNoReply(this->node, "entity_delete", it->name);
+          it = this->waitingRemovals.erase(it);
+        }
+        else
+        {
+          ++it;
+        }
+      }
+
+      // Both are queued by gazebo and applied outside of this callback
+      if (haveOperation && operation.insert)
+        this->world->InsertModelString(operation.sdf);
+      else if (haveOperation && !operation.after.empty())
+        this->waitingRemovals.push_back(operation);
+      else if (haveOperation)
+      {
+        transport::RequestNoReply(this->node, "entity_delete", operation.name);
+        // A replacement that goes away before it arrived no longer holds
+        // back the removal of the tile it replaced
+        for (auto it = this->waitingRemovals.begin();
+             it != this->waitingRemovals.end();)
+        {
+          if (it->after == operation.name)
+          {
+            transport::RequestNoReply(this->node, "entity_delete", it->name);
+            it = this->waitingRemovals.erase(it);
+          }
+          else
+          {
+            ++it;
+          }
+        }
+      }
+    }
+
+    // A model insertion or removal for the world thread.
+    private: struct Operation
+    {
+      bool insert;
+      std::string name;
+      std::string sdf;
+      // Removal only: model that has to exist before this one is removed
+      std::string after;
+    };
+
+    // A tile that is loaded or queued for loading.
+    private: struct LoadedTile
+    {
+      int lod;
+      std::chrono::steady_clock::time_point lastWanted;
+    };
+
+    // Tiles within the load radius of any of three positions, with their
+    // distance from the first, closest first and never more than the
+    // bound.
+    private: std::vector<std::pair<double, std::pair<int, int>>> WantedTiles(
+        const ignition::math::Vector3d &_p
+      , const ignition::math::Vector3d &_half
+      , const ignition::math::Vector3d &_end) const
+    {
+      const int tiles = this->generator->TilesPerSide();
+      std::vector<std::pair<double, std::pair<int, int>>> wanted;
+      for (int j = 0; j < tiles; ++j)
+      {
+        for (int i = 0; i < tiles; ++i)
+        {
+          const double distance =
+              this->generator->TileDistance(i, j, _p.X(), _p.Y());
+          if (distance <= this->radius ||
+              this->generator->TileDistance(i, j, _half.X(), _half.Y()) <=
+                  this->radius ||
+              this->generator->TileDistance(i, j, _end.X(), _end.Y()) <=
+                  this->radius)
+          {
+            wanted.push_back(std::make_pair(distance, std::make_pair(i, j)));
+          }
+        }
+      }
+      std::sort(wanted.begin(), wanted.end());
+      if (static_cast<int>(wanted.size()) > this->maxTiles)
+        wanted.resize(this->maxTiles);
+      return wanted;
+    }
+
+    // Insertion of a tile at a LOD.
+    private: Operation InsertOperation(int _i, int _j, int _lod) const
+    {
+      Operation insert;
+      insert.insert = true;
+      insert.name = rover::TerrainGenerator::TileModelName(_i, _j, _lod);
+      insert.sdf = "<sdf version=\"1.6\">\n" +
+          this->generator->TileModel(_i, _j, _lod, this->directory,
+                                     this->minHeight, this->maxHeight) +
+          "</sdf>\n";
+      return insert;
+    }
+
+    // Background thread: update the wanted tiles a few times per second.
+    private: void Run()
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      while (!this->stop)
+      {
+        this->wake.wait_for(lock, std::chrono::milliseconds(250));
+        if (this->stop || !this->haveState)
+          continue;
+        const ignition::math::Vector3d p = this->position;
+        const ignition::math::Vector3d v = this->velocity;
+        lock.unlock();
+
+        // Tiles near the rover now, half way along the prefetch horizon
+        // and at its end, with the LOD of their current distance. A loaded
+        // tile keeps its LOD within the hysteresis of a boundary.
+        const auto now = std::chrono::steady_clock::now();
+        const ignition::math::Vector3d half = p + v*(0.5*this->prefetchTime);
+        const ignition::math::Vector3d end = p + v*this->prefetchTime;
+
+        std::vector<Operation> newOperations;
+        for (const auto &w : this->WantedTiles(p, half, end))
+        {
+          const int i = w.second.first;
+          const int j = w.second.second;
+          auto it = this->loaded.find(w.second);
+          const int lod = this->generator->TileLod(i, j, p.X(), p.Y(),
+              it != this->loaded.end() ? it->second.lod : -1,
+              this->lodHysteresis);
+          if (it != this->loaded.end())
+          {
+            it->second.lastWanted = now;
+            if (it->second.lod == lod)
+              continue;
+          }
+
+          // Read the heightmap once here so the world thread finds it in
+          // the page cache when it loads the model.
+          std::ifstream warm((this->directory + "/tiles/tile_" +
+              std::to_string(i) + "_" + std::to_string(j) + "_lod" +
+              std::to_string(lod) + ".png").c_str(), std::ios::binary);
+          std::vector<char> buffer(1 << 16);
+          while (warm.read(buffer.data(), buffer.size()))
+          {
+          }
+
+          const Operation insert = this->InsertOperation(i, j, lod);
+          newOperations.push_back(insert);
+
+          // The old LOD is removed after its replacement is in place
+          if (it != this->loaded.end())
+          {
+            Operation remove;
+            remove.insert = false;
+            remove.name =
+                rover::TerrainGenerator::TileModelName(i, j, it->second.lod);
+            remove.after = insert.name;
+            newOperations.push_back(remove);
+            it->second.lod = lod;
+          }
+          else
+          {
+            this->loaded[w.second] = LoadedTile{lod, now};
+          }
+        }
+
+        // Tiles that are no longer wanted, least recently wanted first
+        std::vector<std::pair<std::chrono::steady_clock::time_point,
+                              std::pair<int, int>>> unwanted;
+        for (const auto &l : this->loaded)
+        {
+          if (l.second.lastWanted != now)
+            unwanted.push_back(std::make_pair(l.second.lastWanted, l.first));
+        }
+        std::sort(unwanted.begin(), unwanted.end());
+        for (const auto &u : unwanted)
+        {
+          Operation remove;
+          remove.insert = false;
+          remove.name = rover::TerrainGenerator::TileModelName(
+              u.second.first, u.second.second, this->loaded[u.second].lod);
+          newOperations.push_back(remove);
+          this->loaded.erase(u.second);
+        }
+
+        lock.lock();
+        this->operations.insert(this->operations.end(),
+                                newOperations.begin(), newOperations.end());
+      }
+    }
+
+    // Pointer to the world
+    private: physics::WorldPtr world;
+
+    // Link whose position is followed
+    private: physics::LinkPtr link;
+
+    // Node used to request model removals
+    private: transport::NodePtr node;
+
+    // Tile layout of the terrain
+    private: std::unique_ptr<rover::TerrainGenerator> generator;
+
+    // Plugin parameters
+    private: std::string directory;
+    private: std::string modelName;
+    private: std::string linkName;
+    private: double radius = 100.0;
+    private: double prefetchTime = 5.0;
+    private: int maxTiles = 64;
+    private: double lodHysteresis = 8.0;
+
+    // Terrain layout from the manifest
+    private: double minHeight = 0.0;
+    private: double maxHeight = 0.0;
+
+    // State shared with the background thread, guarded by mutex
+    private: std::mutex mutex;
+    private: std::condition_variable wake;
+    private: bool stop = false;
+    private: bool haveState = false;
+    private: ignition::math::Vector3d position;
+    private: ignition::math::Vector3d velocity;
+    private: std::deque<Operation> operations;
+
+    // Removals waiting for their replacement tile, world thread only
+    private: std::vector<Operation> waitingRemovals;
+
+    // Tiles inserted by Load that are not in the world yet, and whether
+    // physics was enabled before Load disabled it, world thread only
+    private: std::vector<std::string> startTiles;
+    private: bool physicsEnabled = true;
+
+    // Tiles loaded or queued, filled by Load and then only used by the
+    // background thread
+    private: std::map<std::pair<int, int>, LoadedTile> loaded;
+
+    // Background thread
+    private: std::thread thread;
+
+    // Pointer to the update event connection
+    private: event::ConnectionPtr updateConnection;
+  };
+
+  // Register this plugin with the simulator
+  GZ_REGISTER_WORLD_PLUGIN(TerrainStreamer)
+}
@@ -0,0 +1,226 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+// World plugin that applies wheel-soil forces to every rover wheel:
+//   <plugin name="terramechanics" filename="libterramechanics.so">
+//     <chassis>chassis</chassis>     link that gives the rover heading
+//     <wheel>wheel</wheel>           links whose name contains this
+//     <wheel_radius>0.15</wheel_radius>
+//     <wheel_width>0.1</wheel_width>
+//     <ground_height>0</ground_height>
+//     <terrain_directory>/abs/path</terrain_directory>  optional
+//     <n>1</n> <kc>1400</kc> <kphi>820000</kphi> <cohesion>170</cohesion>
+//     <friction_angle>35</friction_angle>  degrees
+//     <shear_modulus>0.018</shear_modulus>
+//     <lateral_shear_modulus>0.018</lateral_shear_modulus>
+//     <damping>200</damping>
+//   </plugin>
+// The soil surface is the terrain written by generate_terrain when a
+// terrain directory is given, otherwise a plane at ground_height. The
+// wheels should not collide with the ground themselves, or the rigid
+// contacts carry the rover instead of the soil. All wheels of all rovers
+// are evaluated together in one WheelSoilBatch before every step.
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gazebo/gazebo.hh>
+#include <gazebo/physics/physics.hh>
+#include <gazebo/common/common.hh>
+#include <ignition/math/Vector3.hh>
+
+#include "terrain_generator.hh"
+#include "terramechanics.hh"
+
+namespace gazebo
+{
+  class Terramechanics : public WorldPlugin
+  {
+    public: void Load(physics::WorldPtr _world, sdf::ElementPtr _sdf)
+    {
+      this->world = _world;
+
+      this->chassisName =
+          _sdf->Get<std::string>("chassis", std::string("chassis")).first;
+      this->wheelPattern =
+          _sdf->Get<std::string>("wheel", std::string("wheel")).first;
+      this->wheelRadius = _sdf->Get<double>("wheel_radius", 0.15).first;
+      this->wheelWidth = _sdf->Get<double>("wheel_width", 0.1).first;
+      this->groundHeight = _sdf->Get<double>("ground_height", 0.0).first;
+
+      this->soil.n = _sdf->Get<double>("n", this->soil.n).first;
+      this->soil.kc = _sdf->Get<double>("kc", this->soil.kc).first;
+      this->soil.kphi = _sdf->Get<double>("kphi", this->soil.kphi).first;
+      this->soil.cohesion =
+          _sdf->Get<double>("cohesion", this->soil.cohesion).first;
+      this->soil.frictionAngle = IGN_DTOR(
+          _sdf->Get<double>("friction_angle", 35.0).first);
+      this->soil.shearModulus =
+          _sdf->Get<double>("shear_modulus", this->soil.shearModulus).first;
+      this->soil.lateralShearModulus = _sdf->Get<double>(
+          "lateral_shear_modulus", this->soil.lateralShearModulus).first;
+      this->soil.damping =
+          _sdf->Get<double>("damping", this->soil.damping).first;
+
+      if (_sdf->HasElement("terrain_directory"))
+      {
+        const std::string directory =
+            _sdf->Get<std::string>("terrain_directory");
+        rover::TerrainParams params;
+        double minHeight, maxHeight;
+        if (rover::ReadTerrainManifest(directory, params,
+                                       minHeight, maxHeight))
+        {
+          this->terrain.reset(new rover::TerrainGenerator(params));
+        }
+        else
+        {
+          gzerr << "Could not read terrain manifest in " << directory
+                << ", using a flat ground" << std::endl;
+        }
+      }
+
+      this->updateConnection = event::Events::ConnectWorldUpdateBegin(
+          std::bind(&Terramechanics::OnUpdate, this));
+    }
+
+    // Called by the world update start event
+    public: void OnUpdate()
+    {
+      if (this->world->ModelCount() != this->modelCount)
+        this->FindWheels();
+
+      // Inputs of every wheel, in the frame of its rover: forward along
+      // the heading of the chassis and lateral along the wheel axis.
+      const size_t count = this->wheels.size();
+      for (size_t i = 0; i < count; ++i)
+      {
+        const Wheel &wheel = this->wheels[i];
+        const ignition::math::Pose3d pose = wheel.link->WorldPose();
+        const ignition::math::Vector3d v = wheel.link->WorldLinearVel();
+        const ignition::math::Vector3d w = wheel.link->WorldAngularVel();
+        ignition::math::Vector3d &forward = this->forwards[i];
+        ignition::math::Vector3d &lateral = this->laterals[i];
+        this->Frame(wheel, forward, lateral);
+
+        const ignition::math::Vector3d &p = pose.Pos();
+        const double surface = this->terrain ?
+            this->terrain->Height(p.X(), p.Y()) : this->groundHeight;
+        this->batch.sinkage[i] = surface - (p.Z() - this->wheelRadius);
+        this->batch.sinkageRate[i] = -v.Z();
+        this->batch.forwardVelocity[i] = v.Dot(forward);
+        this->batch.lateralVelocity[i] = v.Dot(lateral);
+        this->batch.spinRate[i] = w.Dot(lateral);
+      }
+
+      this->batch.Evaluate(this->soil);
+
+      // The surface normal is taken as vertical, the terrain slopes are
+      // small over the length of a contact patch.
+      for (size_t i = 0; i < count; ++i)
+      {
+        if (this->batch.normalForce[i] <= 0.0f)
+          continue;
+        const physics::LinkPtr &link = this->wheels[i].link;
+        link->AddForce(this->forwards[i] * this->batch.drawbarPull[i]
+                     + this->laterals[i] * this->batch.lateralForce[i]
+                     + ignition::math::Vector3d::UnitZ *
+                       this->batch.normalForce[i]);
+        link->AddTorque(this->laterals[i] * this->batch.resistiveTorque[i]);
+      }
+    }
+
+    // A wheel link and the chassis of its rover.
+    private: struct Wheel
+    {
+      physics::LinkPtr link;
+      physics::LinkPtr chassis;
+    };
+
+    // Horizontal heading of the rover and the wheel axis perpendicular to
+    // it, both unit length.
+    private: void Frame(const Wheel &_wheel
+                      , ignition::math::Vector3d &_forward
+                      , ignition::math::Vector3d &_lateral) const
+    {
+      _forward = _wheel.chassis->WorldPose().Rot().RotateVector(
+          ignition::math::Vector3d::UnitX);
+      _forward.Z(0.0);
+      if (_forward.Length() < 1e-6)
+        _forward = ignition::math::Vector3d::UnitX;
+      _forward.Normalize();
+      _lateral = ignition::math::Vector3d::UnitZ.Cross(_forward);
+    }
+
+    // Collect the wheels of every model that has a chassis link.
+    private: void FindWheels()
+    {
+      this->wheels.clear();
+      for (const auto &model : this->world->Models())
+      {
+        physics::LinkPtr chassis = model->GetLink(this->chassisName);
+        if (!chassis)
+          continue;
+        for (const auto &link : model->GetLinks())
+        {
+          if (link->GetName().find(this->wheelPattern) != std::string::npos)
+            this->wheels.push_back(Wheel{link, chassis});
+        }
+      }
+      this->modelCount = this->world->ModelCount();
+
+      this->batch.Resize(this->wheels.size());
+      this->forwards.resize(this->wheels.size());
+      this->laterals.resize(this->wheels.size());
+      for (size_t i = 0; i < this->wheels.size(); ++i)
+      {
+        this->batch.radius[i] = this->wheelRadius;
+        this->batch.width[i] = this->wheelWidth;
+      }
+      gzmsg << "Terramechanics on " << this->wheels.size() << " wheels"
+            << std::endl;
+    }
+
+    // Pointer to the world
+    private: physics::WorldPtr world;
+
+    // Plugin parameters
+    private: std::string chassisName;
+    private: std::string wheelPattern;
+    private: double wheelRadius = 0.15;
+    private: double wheelWidth = 0.1;
+    private: double groundHeight = 0.0;
+    private: rover::SoilParams soil;
+
+    // Terrain heights, null for a flat ground
+    private: std::unique_ptr<rover::TerrainGenerator> terrain;
+
+    // Wheels of all rovers and their soil forces
+    private: std::vector<Wheel> wheels;
+    private: rover::WheelSoilBatch batch;
+    private: std::vector<ignition::math::Vector3d> forwards;
+    private: std::vector<ignition::math::Vector3d> laterals;
+    private: unsigned int modelCount = 0;
+
+    // Pointer to the update event connection
+    private: event::ConnectionPtr updateConnection;
+  };
+
+  // Register this plugin with the simulator
+  GZ_REGISTER_WORLD_PLUGIN(Terramechanics)
+}
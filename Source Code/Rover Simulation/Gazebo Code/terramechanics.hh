@@ -0,0 +1,242 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#ifndef ROVER_TERRAMECHANICS_HH_
+#define ROVER_TERRAMECHANICS_HH_
+
+// Header only, so that the Unreal project can use it as well.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Lets the compiler vectorize a loop without proving that the arrays
+// do not overlap. GCC also needs -fno-trapping-math before it turns the
+// selects of a loop into vector blends, clang assumes it by default.
+#if defined(__clang__)
+#define ROVER_VECTORIZE _Pragma("clang loop vectorize(enable)")
+#elif defined(__GNUC__)
+#define ROVER_VECTORIZE _Pragma("GCC ivdep")
+#else
+#define ROVER_VECTORIZE
+#endif
+
+namespace rover
+{
+  // Soil parameters of the Bekker pressure-sinkage and Janosi-Hanamoto
+  // shear models. The defaults are a lunar regolith simulant. Lengths
+  // are in meters, forces in newtons.
+  struct SoilParams
+  {
+    // Sinkage exponent.
+    float n = 1.0f;
+
+    // Cohesive modulus of deformation, N/m^(n+1).
+    float kc = 1400.0f;
+
+    // Frictional modulus of deformation, N/m^(n+2).
+    float kphi = 820000.0f;
+
+    // Cohesion, Pa.
+    float cohesion = 170.0f;
+
+    // Internal friction angle, radians.
+    float frictionAngle = 0.61f;
+
+    // Shear deformation modulus along and across the wheel.
+    float shearModulus = 0.018f;
+    float lateralShearModulus = 0.018f;
+
+    // Normal damping per sinkage rate, N s/m, keeps wheels from bouncing.
+    float damping = 200.0f;
+  };
+
+  // Fast approximations of 2^x and log2(x), about 1e-6 relative error.
+  // Unlike the library functions, sqrt included, they never set errno,
+  // so loops calling them vectorize without fast-math or a vector math
+  // library.
+  inline float FastExp2(float _x)
+  {
+    // Adding 1.5 * 2^23 rounds to the nearest integer, which then sits
+    // in the low mantissa bits. The exponent is saturated on the integer,
+    // clamping _x instead lets the compiler split the loop on the constant
+    // results at the bounds.
+    const float shifted = _x + 12582912.0f;
+    int32_t i;
+    std::memcpy(&i, &shifted, sizeof(i));
+    i = std::min(std::max(i - 0x4B400000, -126), 127);
+    const float f = _x - (shifted - 12582912.0f);
+
+    // Taylor series of 2^f for f in [-0.5, 0.5]
+    const float p = 1.0f + f * (0.693147182f + f * (0.240226507f
+        + f * (0.0555041086f + f * (0.00961812911f
+        + f * (0.00133335581f + f * 0.000154035304f)))));
+    const int32_t bits = (i + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+  }
+
+  inline float FastLog2(float _x)
+  {
+    int32_t bits;
+    std::memcpy(&bits, &_x, sizeof(bits));
+    const float e = static_cast<float>(((bits >> 23) & 255) - 127);
+    bits = (bits & 0x007FFFFF) | 0x3F800000;
+    float m;
+    std::memcpy(&m, &bits, sizeof(m));
+
+    // log2(m) = 2 atanh(y) / ln 2 with y = (m - 1) / (m + 1) <= 1/3
+    const float y = (m - 1.0f) / (m + 1.0f);
+    const float y2 = y * y;
+    const float s = y * (2.0f + y2 * (0.666666667f + y2 * (0.4f
+        + y2 * (0.285714286f + y2 * 0.222222222f))));
+    return e + s * 1.44269504f;
+  }
+
+  // Wheel-soil forces of many wheels, stored as one array per quantity
+  // so that Evaluate runs over all wheels in SIMD lanes. Fill the inputs
+  // of every wheel, call Evaluate and read the outputs. Forces are in the
+  // wheel frame: forward along the rover heading, lateral along the wheel
+  // axis and normal up.
+  class WheelSoilBatch
+  {
+    // Set the number of wheels, resizing every array.
+    public: void Resize(std::size_t _count)
+    {
+      std::vector<float> *arrays[] = {&this->radius, &this->width
+          , &this->sinkage, &this->sinkageRate, &this->forwardVelocity
+          , &this->lateralVelocity, &this->spinRate, &this->normalForce
+          , &this->drawbarPull, &this->lateralForce, &this->resistiveTorque
+          , &this->slip};
+      for (auto array : arrays)
+        array->resize(_count, 0.0f);
+    }
+
+    // Number of wheels.
+    public: std::size_t Size() const
+    {
+      return this->radius.size();
+    }
+
+    // Evaluate the soil forces of every wheel.
+    public: void Evaluate(const SoilParams &_soil)
+    {
+      const int count = static_cast<int>(this->Size());
+      // Copies, so that the loop does not reload them after every store
+      const float n = _soil.n;
+      const float kc = _soil.kc;
+      const float kphi = _soil.kphi;
+      const float cohesion = _soil.cohesion;
+      const float damping = _soil.damping;
+      const float tanPhi = std::tan(_soil.frictionAngle);
+      const float normalExponent = 0.5f * (2.0f * n + 1.0f);
+      const float normalScale = (3.0f - n) / 3.0f;
+      const float compactionScale = 1.0f / (n + 1.0f);
+      const float shearModulus = _soil.shearModulus;
+      const float lateralShearModulus = _soil.lateralShearModulus;
+      const float minSpeed = 1e-3f;
+
+      const float *r = this->radius.data();
+      const float *b = this->width.data();
+      const float *z0 = this->sinkage.data();
+      const float *dz = this->sinkageRate.data();
+      const float *vx = this->forwardVelocity.data();
+      const float *vy = this->lateralVelocity.data();
+      const float *w = this->spinRate.data();
+      float *normal = this->normalForce.data();
+      float *pull = this->drawbarPull.data();
+      float *lateral = this->lateralForce.data();
+      float *torque = this->resistiveTorque.data();
+      float *slipRatio = this->slip.data();
+
+      // Everything is computed for every wheel and masked at the end,
+      // branches would keep the loop from vectorizing.
+      ROVER_VECTORIZE
+      for (int i = 0; i < count; ++i)
+      {
+        const bool inSoil = z0[i] > 0.0f;
+        const float z = std::max(z0[i], 1e-6f);
+        const float log2z = FastLog2(z);
+        const float k = kc + b[i] * kphi;
+
+        // Bekker: normal load carried at sinkage z by a rigid wheel of
+        // diameter 2r, and the resistance of compacting the rut.
+        const float load = std::max(normalScale * k
+            * FastExp2(0.5f * FastLog2(2.0f * r[i]) + normalExponent * log2z)
+            + damping * dz[i], 0.0f);
+        const float compaction =
+            compactionScale * k * FastExp2((n + 1.0f) * log2z);
+
+        // Length of the contact patch and the largest shear force it holds.
+        const float chord = std::max(2.0f * r[i] * z - z * z, 1e-12f);
+        const float length = FastExp2(0.5f * FastLog2(chord));
+        const float maxShear = b[i] * length * cohesion + load * tanPhi;
+
+        // Slip in [-1, 1], positive when driving and negative when braking.
+        const float rw = r[i] * w[i];
+        const float maxSpeed =
+            std::max(std::max(std::fabs(rw), std::fabs(vx[i])), minSpeed);
+        const float s = (rw - vx[i]) / maxSpeed;
+
+        // Janosi-Hanamoto: shear stress builds up with the shear
+        // displacement, which is largest at the rear of the patch.
+        const float j = std::max(std::fabs(s) * length, 1e-6f);
+        const float shear = 1.0f - shearModulus / j
+            * (1.0f - FastExp2(-1.44269504f * j / shearModulus));
+        const float thrust = std::copysign(maxShear * shear, s);
+
+        // Compaction resistance opposes the direction of travel.
+        const float travel = vx[i] / (std::fabs(vx[i]) + 0.01f);
+
+        // Lateral shear from the slip angle, opposing the sideways motion.
+        const float jy = std::fabs(vy[i]) / maxSpeed * length;
+        const float side = maxShear
+            * (1.0f - FastExp2(-1.44269504f * jy / lateralShearModulus));
+
+        normal[i] = inSoil ? load : 0.0f;
+        pull[i] = inSoil ? thrust - compaction * travel : 0.0f;
+        lateral[i] = inSoil ? std::copysign(side, -vy[i]) : 0.0f;
+        torque[i] = inSoil ? -thrust * r[i] : 0.0f;
+        slipRatio[i] = inSoil ? s : 0.0f;
+      }
+    }
+
+    // Inputs, one entry per wheel.
+    public: std::vector<float> radius;
+    public: std::vector<float> width;
+    // Depth of the lowest point of the wheel below the soil surface.
+    public: std::vector<float> sinkage;
+    // Rate of sinkage, positive while the wheel goes down.
+    public: std::vector<float> sinkageRate;
+    public: std::vector<float> forwardVelocity;
+    public: std::vector<float> lateralVelocity;
+    // Spin about the wheel axis, positive when rolling forward.
+    public: std::vector<float> spinRate;
+
+    // Outputs, one entry per wheel.
+    public: std::vector<float> normalForce;
+    public: std::vector<float> drawbarPull;
+    public: std::vector<float> lateralForce;
+    // Torque of the soil about the wheel axis.
+    public: std::vector<float> resistiveTorque;
+    public: std::vector<float> slip;
+  };
+}
+#endif
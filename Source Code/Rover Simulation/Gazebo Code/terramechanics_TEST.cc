@@ -0,0 +1,114 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+#include <cmath>
+
+#include "gtest/gtest.h"
+#include "terramechanics.hh"
+
+using namespace rover;
+
+/////////////////////////////////////////////////
+TEST(Terramechanics, FastExp2)
+{
+  double maxError = 0.0;
+  for (float x = -30.0f; x <= 30.0f; x += 0.001f)
+  {
+    const double expected = std::exp2(static_cast<double>(x));
+    maxError = std::max(maxError,
+        std::fabs(FastExp2(x) - expected) / expected);
+  }
+  EXPECT_LT(maxError, 2e-6);
+
+  // The exponent saturates instead of overflowing
+  EXPECT_GT(FastExp2(200.0f), 1e38f);
+  EXPECT_LT(FastExp2(-200.0f), 1e-37f);
+}
+
+/////////////////////////////////////////////////
+TEST(Terramechanics, FastLog2)
+{
+  // Relative to the result, but absolute near x = 1 where it goes to 0
+  double maxError = 0.0;
+  for (float x = 1e-7f; x < 1e7f; x *= 1.001f)
+  {
+    const double expected = std::log2(static_cast<double>(x));
+    maxError = std::max(maxError, std::fabs(FastLog2(x) - expected)
+        / std::max(1.0, std::fabs(expected)));
+  }
+  EXPECT_LT(maxError, 2e-6);
+}
+
+/////////////////////////////////////////////////
+// The normal load of a wheel at rest against the closed form of Bekker's
+// pressure-sinkage relation for a rigid wheel
+TEST(Terramechanics, BekkerLoad)
+{
+  const float radii[] = {0.1f, 0.15f, 0.4f};
+  const float exponents[] = {0.7f, 1.0f, 1.3f};
+  const float sinkages[] = {0.001f, 0.01f, 0.05f};
+
+  WheelSoilBatch batch;
+  batch.Resize(27);
+  int i = 0;
+  for (float r : radii)
+  {
+    for (float z : sinkages)
+    {
+      for (int k = 0; k < 3; ++k)
+      {
+        batch.radius[i] = r;
+        batch.width[i] = 0.1f;
+        batch.sinkage[i] = z;
+        ++i;
+      }
+    }
+  }
+
+  for (float n : exponents)
+  {
+    SoilParams soil;
+    soil.n = n;
+    batch.Evaluate(soil);
+    for (i = 0; i < 27; ++i)
+    {
+      const double r = batch.radius[i];
+      const double z = batch.sinkage[i];
+      const double k = soil.kc + batch.width[i] * soil.kphi;
+      const double expected = (3.0 - n) / 3.0 * k * std::sqrt(2.0 * r)
+          * std::pow(z, (2.0 * n + 1.0) / 2.0);
+      EXPECT_NEAR(batch.normalForce[i], expected, 1e-4 * expected)
+          << "n " << n << ", r " << r << ", z " << z;
+    }
+  }
+}
+
+/////////////////////////////////////////////////
+TEST(Terramechanics, OutOfSoil)
+{
+  WheelSoilBatch batch;
+  batch.Resize(1);
+  batch.radius[0] = 0.15f;
+  batch.width[0] = 0.1f;
+  batch.sinkage[0] = -0.01f;
+  batch.forwardVelocity[0] = 1.0f;
+  batch.spinRate[0] = 10.0f;
+  batch.Evaluate(SoilParams());
+  EXPECT_EQ(batch.normalForce[0], 0.0f);
+  EXPECT_EQ(batch.drawbarPull[0], 0.0f);
+  EXPECT_EQ(batch.lateralForce[0], 0.0f);
+  EXPECT_EQ(batch.resistiveTorque[0], 0.0f);
+}
@@ -0,0 +1,555 @@
+/*
+    Copyright [2021] [Andrei Lazar]
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+// Runs Monte Carlo batches of rover traverses headless:
+//   traverse_runner <output directory> [--option value ...]
+// Every run draws an initial chassis velocity, a chassis mass and a wheel
+// friction coefficient from its own random stream, and runs in its own
+// simulator process: gzserver with the rover_movement plugin, or an
+// Unreal build of the project with -unreal. Up to --jobs runs at once,
+// one per core by default. Every finished run is appended to
+// traverses.csv in the output directory right away, which is also the
+// checkpoint: running the same command again skips the runs it holds as
+// ok, and retries the failed and timed out ones. batch.txt records the
+// seed and parameters of the batch, a resume with others is refused. At
+// the end summary.txt aggregates the last row of every run.
+//
+// gzserver must find librover_movement.so and the basic_rover model, set
+// GAZEBO_PLUGIN_PATH and GAZEBO_MODEL_PATH as for rover_movement.world.
+
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void Usage()
+{
+  std::cerr << "Usage: traverse_runner <output directory> [options]\n"
+            << "  --runs N              number of traverses\n"
+            << "  --jobs N              simulator processes at once\n"
+            << "  --seed N              random seed of the batch\n"
+            << "  --duration S          simulated seconds per traverse\n"
+            << "  --step S              physics step size\n"
+            << "  --speed-min V         initial speed range, m/s\n"
+            << "  --speed-max V\n"
+            << "  --mass-min KG         chassis mass range\n"
+            << "  --mass-max KG\n"
+            << "  --friction-min MU     wheel friction range\n"
+            << "  --friction-max MU\n"
+            << "  --timeout S           wall seconds before a run is killed\n"
+            << "  --unreal PATH         Unreal executable instead of gzserver\n"
+            << "  --unreal-project PATH .uproject for an editor executable\n";
+}
+
+// Options of a batch.
+struct Options
+{
+  std::string output;
+  int runs = 1000;
+  int jobs = 1;
+  uint64_t seed = 1;
+  double duration = 15.0;
+  double step = 0.001;
+  double speedMin = 0.5;
+  double speedMax = 3.0;
+  double massMin = 5.0;
+  double massMax = 20.0;
+  double frictionMin = 0.3;
+  double frictionMax = 1.2;
+  double timeout = 0.0;
+  std::string unreal;
+  std::string unrealProject;
+};
+
+// Randomized inputs of one traverse.
+struct Traverse
+{
+  int run = 0;
+  double velocityX = 0.0;
+  double velocityY = 0.0;
+  double mass = 0.0;
+  double friction = 0.0;
+};
+
+// A simulator process that is running a traverse.
+struct Job
+{
+  pid_t pid = 0;
+  Traverse traverse;
+  std::chrono::steady_clock::time_point start;
+};
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void OnInterrupt(int)
+{
+  interrupted = 1;
+}
+
+// Draw the inputs of a run. Each run has its own stream, so a run gets the
+// same inputs whichever order and process it runs in.
+static Traverse Draw(const Options &_options, int _run)
+{
+  std::seed_seq seq{static_cast<uint32_t>(_options.seed),
+                    static_cast<uint32_t>(_options.seed >> 32),
+                    static_cast<uint32_t>(_run)};
+  std::mt19937_64 rng(seq);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  auto range = [&](double _min, double _max)
+  {
+    return _min + (_max - _min) * unit(rng);
+  };
+
+  Traverse traverse;
+  traverse.run = _run;
+  // Mostly forward, up to 30 degrees to either side
+  const double speed = range(_options.speedMin, _options.speedMax);
+  const double heading = range(-0.5236, 0.5236);
+  traverse.velocityX = speed * std::cos(heading);
+  traverse.velocityY = speed * std::sin(heading);
+  traverse.mass = range(_options.massMin, _options.massMax);
+  traverse.friction = range(_options.frictionMin, _options.frictionMax);
+  return traverse;
+}
+
+static std::string RunDirectory(const Options &_options, int _run)
+{
+  return _options.output + "/runs/" + std::to_string(_run);
+}
+
+// Write the world of a Gazebo traverse: the rover on a ground plane,
+// stepped as fast as possible.
+static bool WriteWorld(const Options &_options, const Traverse &_traverse
+                     , const std::string &_path)
+{
+  std::ofstream world(_path.c_str());
+  world << "<?xml version=\"1.0\"?>\n"
+        << "<sdf version=\"1.4\">\n"
+        << "  <world name=\"default\">\n"
+        << "    <physics type=\"ode\">\n"
+        << "      <max_step_size>" << _options.step << "</max_step_size>\n"
+        << "      <real_time_update_rate>0</real_time_update_rate>\n"
+        << "    </physics>\n"
+        << "    <include>\n"
+        << "      <uri>model://ground_plane</uri>\n"
+        << "    </include>\n"
+        << "    <include>\n"
+        << "      <uri>model://basic_rover</uri>\n"
+        << "      <plugin name=\"rover_movement\" "
+        << "filename=\"librover_movement.so\">\n"
+        << "        <force>0 0 0</force>\n"
+        << "        <initial_velocity>" << _traverse.velocityX << " "
+        << _traverse.velocityY << " 0</initial_velocity>\n"
+        << "        <chassis_mass>" << _traverse.mass << "</chassis_mass>\n"
+        << "        <wheel_friction>" << _traverse.friction
+        << "</wheel_friction>\n"
+        << "        <summary>" << RunDirectory(_options, _traverse.run)
+        << "/summary.csv</summary>\n"
+        << "        <summary_time>" << _options.duration
+        << "</summary_time>\n"
+        << "      </plugin>\n"
+        << "    </include>\n"
+        << "  </world>\n"
+        << "</sdf>\n";
+  return static_cast<bool>(world);
+}
+
+// Start the simulator process of a traverse in its run directory.
+// _slot Index of the job, gives every gzserver its own master port.
+static pid_t Launch(const Options &_options, const Traverse &_traverse
+                  , int _slot)
+{
+  const std::string directory = RunDirectory(_options, _traverse.run);
+  mkdir(directory.c_str(), 0755);
+  remove((directory + "/summary.csv").c_str());
+
+  std::vector<std::string> args;
+  if (_options.unreal.empty())
+  {
+    if (!WriteWorld(_options, _traverse, directory + "/traverse.world"))
+      return -1;
+    const long iterations = std::lround(_options.duration / _options.step) + 1;
+    args = {"gzserver", "--iters", std::to_string(iterations),
+            "traverse.world"};
+  }
+  else
+  {
+    // The Unreal rover takes its inputs from the command line, in the
+    // frame of Gazebo, and quits once the summary is written. -benchmark
+    // with -fps steps at a fixed rate as fast as possible.
+    std::ostringstream velocity;
+    velocity << _traverse.velocityX << "," << _traverse.velocityY << ",0";
+    args.push_back(_options.unreal);
+    if (!_options.unrealProject.empty())
+      args.push_back(_options.unrealProject);
+    args.insert(args.end(), {"-game", "-nullrhi", "-nosound", "-unattended",
+        "-benchmark", "-fps=" + std::to_string(std::lround(1.0 /
+        _options.step)), "-RoverVelocity=" + velocity.str(),
+        "-RoverMass=" + std::to_string(_traverse.mass),
+        "-RoverFriction=" + std::to_string(_traverse.friction),
+        "-RoverDuration=" + std::to_string(_options.duration),
+        "-RoverSummary=" + directory + "/summary.csv"});
+  }
+
+  const pid_t pid = fork();
+  if (pid != 0)
+    return pid;
+
+  // Child: run in the run directory with the output in run.log
+  if (chdir(directory.c_str()) != 0)
+    _exit(127);
+  const int log = open("run.log", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (log >= 0)
+  {
+    dup2(log, STDOUT_FILENO);
+    dup2(log, STDERR_FILENO);
+    close(log);
+  }
+  const std::string master =
+      "http://127.0.0.1:" + std::to_string(11346 + _slot);
+  setenv("GAZEBO_MASTER_URI", master.c_str(), 1);
+  std::vector<char *> argv;
+  for (std::string &arg : args)
+    argv.push_back(&arg[0]);
+  argv.push_back(nullptr);
+  execvp(argv[0], argv.data());
+  _exit(127);
+}
+
+// Seed and parameters that the inputs and results of the runs depend on,
+// one per line. The number of runs, jobs and the timeout may change
+// between resumes.
+static std::string BatchParameters(const Options &_options)
+{
+  std::ostringstream parameters;
+  parameters << std::setprecision(std::numeric_limits<double>::max_digits10)
+             << "seed " << _options.seed << "\n"
+             << "duration " << _options.duration << "\n"
+             << "step " << _options.step << "\n"
+             << "speed " << _options.speedMin << " " << _options.speedMax
+             << "\n"
+             << "mass " << _options.massMin << " " << _options.massMax << "\n"
+             << "friction " << _options.frictionMin << " "
+             << _options.frictionMax << "\n"
+             << "simulator " << (_options.unreal.empty() ? "gazebo" : "unreal")
+             << "\n";
+  return parameters.str();
+}
+
+// Rows of the dataset by run number, the last row of a retried run wins.
+static std::map<int, std::vector<std::string>> ReadRuns(
+    const std::string &_path)
+{
+  std::map<int, std::vector<std::string>> runs;
+  std::ifstream in(_path.c_str());
+  std::string line;
+  std::getline(in, line);
+  while (std::getline(in, line))
+  {
+    std::vector<std::string> fields;
+    std::istringstream stream(line);
+    std::string field;
+    while (std::getline(stream, field, ','))
+      fields.push_back(field);
+    if (fields.size() < 15)
+      continue;
+    runs[std::atoi(fields[0].c_str())] = fields;
+  }
+  return runs;
+}
+
+// Run numbers that finished ok, failed and timed out ones run again.
+static std::set<int> FinishedRuns(const std::string &_path)
+{
+  std::set<int> runs;
+  for (const auto &run : ReadRuns(_path))
+  {
+    if (run.second[6] == "ok")
+      runs.insert(run.first);
+  }
+  return runs;
+}
+
+// Aggregate the dataset into summary.txt and print it.
+static void Summarize(const Options &_options)
+{
+  int ok = 0, failed = 0, flipped = 0;
+  double distance = 0.0, distanceSquares = 0.0, tilt = 0.0, wall = 0.0;
+  for (const auto &run : ReadRuns(_options.output + "/traverses.csv"))
+  {
+    const std::vector<std::string> &fields = run.second;
+    wall += std::atof(fields[7].c_str());
+    if (fields[6] != "ok")
+    {
+      ++failed;
+      continue;
+    }
+    ++ok;
+    const double d = std::atof(fields[8].c_str());
+    distance += d;
+    distanceSquares += d * d;
+    tilt += std::atof(fields[12].c_str());
+    flipped += std::atoi(fields[14].c_str());
+  }
+
+  std::ostringstream summary;
+  summary << "runs " << ok + failed << ", ok " << ok << ", failed " << failed
+          << "\n";
+  if (ok > 0)
+  {
+    const double mean = distance / ok;
+    summary << "distance mean " << mean << " m, std "
+            << std::sqrt(std::max(0.0, distanceSquares / ok - mean * mean))
+            << " m\n"
+            << "max tilt mean " << tilt / ok << " deg\n"
+            << "flipped " << flipped << " (" << 100.0 * flipped / ok
+            << "%)\n";
+  }
+  summary << "simulator wall time " << wall / 3600.0 << " h\n";
+  std::ofstream((_options.output + "/summary.txt").c_str()) << summary.str();
+  std::cout << summary.str();
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2 || argv[1][0] == '-')
+  {
+    Usage();
+    return 1;
+  }
+
+  Options options;
+  options.output = argv[1];
+  options.jobs = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 2; i < argc; i += 2)
+  {
+    if (i + 1 >= argc)
+    {
+      Usage();
+      return 1;
+    }
+    const std::string option = argv[i];
+    const char *value = argv[i + 1];
+    if (option == "--runs")
+      options.runs = std::atoi(value);
+    else if (option == "--jobs")
+      options.jobs = std::max(1, std::atoi(value));
+    else if (option == "--seed")
+      options.seed = std::strtoull(value, nullptr, 10);
+    else if (option == "--duration")
+      options.duration = std::atof(value);
+    else if (option == "--step")
+      options.step = std::atof(value);
+    else if (option == "--speed-min")
+      options.speedMin = std::atof(value);
+    else if (option == "--speed-max")
+      options.speedMax = std::atof(value);
+    else if (option == "--mass-min")
+      options.massMin = std::atof(value);
+    else if (option == "--mass-max")
+      options.massMax = std::atof(value);
+    else if (option == "--friction-min")
+      options.frictionMin = std::atof(value);
+    else if (option == "--friction-max")
+      options.frictionMax = std::atof(value);
+    else if (option == "--timeout")
+      options.timeout = std::atof(value);
+    else if (option == "--unreal")
+      options.unreal = value;
+    else if (option == "--unreal-project")
+      options.unrealProject = value;
+    else
+    {
+      std::cerr << "Unknown option " << option << std::endl;
+      Usage();
+      return 1;
+    }
+  }
+  if (options.step <= 0.0 || options.duration <= 0.0)
+  {
+    std::cerr << "Duration and step must be positive" << std::endl;
+    return 1;
+  }
+  if (options.timeout <= 0.0)
+    options.timeout = std::max(60.0, 20.0 * options.duration);
+
+  // Absolute, the simulators run in their run directories
+  mkdir(options.output.c_str(), 0755);
+  char *absolute = realpath(options.output.c_str(), nullptr);
+  if (!absolute)
+  {
+    std::cerr << "Could not create " << options.output << std::endl;
+    return 1;
+  }
+  options.output = absolute;
+  free(absolute);
+  mkdir((options.output + "/runs").c_str(), 0755);
+
+  // The runs of a dataset must all come from the same batch
+  const std::string parametersPath = options.output + "/batch.txt";
+  const std::string parameters = BatchParameters(options);
+  std::ifstream previousFile(parametersPath.c_str());
+  if (previousFile)
+  {
+    std::ostringstream previous;
+    previous << previousFile.rdbuf();
+    if (previous.str() != parameters)
+    {
+      std::cerr << options.output << " holds a batch with other parameters:\n"
+                << previous.str() << "Use another output directory"
+                << std::endl;
+      return 1;
+    }
+  }
+  else
+  {
+    std::ofstream(parametersPath.c_str()) << parameters;
+  }
+
+  const std::string datasetPath = options.output + "/traverses.csv";
+  const std::set<int> finished = FinishedRuns(datasetPath);
+  std::vector<int> pending;
+  for (int run = 0; run < options.runs; ++run)
+  {
+    if (!finished.count(run))
+      pending.push_back(run);
+  }
+  std::cout << finished.size() << " runs ok before, " << pending.size()
+            << " to run on " << options.jobs << " jobs" << std::endl;
+
+  std::ofstream dataset(datasetPath.c_str(), std::ios::app);
+  if (finished.empty() && dataset.tellp() == 0)
+  {
+    dataset << "Run,Seed,Velocity X,Velocity Y,Chassis Mass,Wheel Friction,"
+            << "Status,Wall Time,Distance,Final X,Final Y,Final Z,"
+            << "Max Tilt,Mean Speed,Flipped" << std::endl;
+  }
+
+  signal(SIGINT, OnInterrupt);
+  signal(SIGTERM, OnInterrupt);
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<Job> jobs(options.jobs);
+  size_t next = 0;
+  int done = 0;
+  int running = 0;
+  while (!interrupted && (next < pending.size() || running > 0))
+  {
+    for (int slot = 0; slot < options.jobs && next < pending.size(); ++slot)
+    {
+      if (jobs[slot].pid != 0)
+        continue;
+      Job &job = jobs[slot];
+      job.traverse = Draw(options, pending[next++]);
+      job.pid = Launch(options, job.traverse, slot);
+      job.start = std::chrono::steady_clock::now();
+      if (job.pid < 0)
+      {
+        std::cerr << "Could not start run " << job.traverse.run << std::endl;
+        job.pid = 0;
+        continue;
+      }
+      ++running;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    const auto now = std::chrono::steady_clock::now();
+    for (Job &job : jobs)
+    {
+      if (job.pid == 0)
+        continue;
+      const double wall =
+          std::chrono::duration<double>(now - job.start).count();
+      int status = 0;
+      if (waitpid(job.pid, &status, WNOHANG) == 0)
+      {
+        if (wall < options.timeout)
+          continue;
+        kill(job.pid, SIGKILL);
+        waitpid(job.pid, &status, 0);
+      }
+
+      // A run is ok if it wrote its summary, gzserver may not exit cleanly
+      const Traverse &t = job.traverse;
+      std::ifstream summary((RunDirectory(options, t.run) +
+                             "/summary.csv").c_str());
+      std::string header, values;
+      const bool ok = std::getline(summary, header) &&
+                      std::getline(summary, values) && !values.empty();
+      dataset << t.run << "," << options.seed << "," << t.velocityX << ","
+              << t.velocityY << "," << t.mass << "," << t.friction << ","
+              << (ok ? "ok" : wall >= options.timeout ? "timeout" : "failed")
+              << "," << wall << ","
+              << (ok ? values : std::string("0,0,0,0,0,0,0")) << std::endl;
+
+      job.pid = 0;
+      --running;
+      ++done;
+      const double hours = std::chrono::duration<double>(
+          now - start).count() / 3600.0;
+      std::cout << "run " << t.run << (ok ? " ok" : " failed") << ", "
+                << done << "/" << pending.size() << ", "
+                << static_cast<int>(done / hours) << " runs per hour"
+                << std::endl;
+    }
+  }
+
+  if (interrupted)
+  {
+    // Unfinished runs are not in the dataset, they run again on resume
+    for (Job &job : jobs)
+    {
+      if (job.pid != 0)
+      {
+        kill(job.pid, SIGKILL);
+        waitpid(job.pid, nullptr, 0);
+      }
+    }
+    std::cout << "Interrupted after " << done << " runs, run the same "
+              << "command again to resume" << std::endl;
+    return 1;
+  }
+
+  const double hours = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count() / 3600.0;
+  if (done > 0)
+  {
+    std::cout << done << " runs in " << hours * 60.0 << " min, "
+              << done / hours << " runs per hour" << std::endl;
+  }
+  Summarize(options);
+  return 0;
+}
@@ -22,6 +22,20 @@
 #include "Math/Quat.h"
 #include "PhysicsEngine/PhysicsConstraintComponent.h"
 #include "TextFileManager.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Paths.h"
+#include "PhysicalMaterials/PhysicalMaterial.h"
+
+#if PLATFORM_WINDOWS
+#include "Windows/AllowWindowsPlatformTypes.h"
+#endif
+#include "rover_bridge.hh"
+#if PLATFORM_WINDOWS
+#include "Windows/HideWindowsPlatformTypes.h"
+#endif
 
 ABasic_Rover::ABasic_Rover() 
 {
@@ -105,11 +119,229 @@ void ABasic_Rover::BeginPlay()
 	SetupConstraint(BackLeftWheel, BackLeftWheel_Constraint, FVector(-65, 35, 23));
 	SetupConstraint(BackRightWheel, BackRightWheel_Constraint, FVector(-65, -35, 23));
 	
+	if (!BridgeName.IsEmpty())
+	{
+		Bridge = new rover::RoverBridge();
+		if (Bridge->Create(TCHAR_TO_UTF8(*BridgeName)))
+		{
+			UE_LOG(LogTemp, Log, TEXT("Rover bridge %s created"), *BridgeName);
+		}
+		else
+		{
+			UE_LOG(LogTemp, Error, TEXT("Could not create rover bridge %s"), *BridgeName);
+			delete Bridge;
+			Bridge = nullptr;
+		}
+	}
+
+	const std::vector<std::string> Targets = { "RoverChassis", "FrontLeftWheel", "FrontRightWheel", "BackLeftWheel", "BackRightWheel" };
+	if (!ReplayPath.IsEmpty())
+	{
+		Replay = MakeUnique<rover::ReplayReader>();
+		if (!Replay->Open(TCHAR_TO_UTF8(*ReplayPath)) || Replay->Targets() != Targets)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Could not replay %s"), *ReplayPath);
+			Replay.Reset();
+		}
+	}
+	else if (!RecordPath.IsEmpty() && !Recorder.Open(TCHAR_TO_UTF8(*RecordPath), Targets))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not record to %s"), *RecordPath);
+	}
+	if (Replay || Recorder.IsOpen())
+	{
+		FApp::SetUseFixedTimeStep(true);
+		FApp::SetFixedDeltaTime(FixedDeltaTime);
+	}
+
+	ReadTraverseCommandLine();
+}
+
+void ABasic_Rover::ReadTraverseCommandLine()
+{
+	// Inputs of a traverse started by traverse_runner in the Gazebo code, in the frame of Gazebo: meters, y to the left.
+	const TCHAR* CommandLine = FCommandLine::Get();
+	FString Velocity;
+	if (FParse::Value(CommandLine, TEXT("RoverVelocity="), Velocity))
+	{
+		TArray<FString> Parts;
+		Velocity.ParseIntoArray(Parts, TEXT(","));
+		if (Parts.Num() == 3)
+		{
+			ForceToApply = FVector(FCString::Atof(*Parts[0]), -FCString::Atof(*Parts[1]), FCString::Atof(*Parts[2])) * 100.0f;
+		}
+	}
+
+	float Mass;
+	if (FParse::Value(CommandLine, TEXT("RoverMass="), Mass))
+	{
+		RoverChassis->SetMassOverrideInKg(NAME_None, Mass, true);
+	}
+
+	// Gazebo uses the smaller friction of the two surfaces, its ground plane has a very large one. The ground here needs a
+	// friction at least as large as the wheels' for the same result.
+	float Friction;
+	if (FParse::Value(CommandLine, TEXT("RoverFriction="), Friction))
+	{
+		UPhysicalMaterial* Material = NewObject<UPhysicalMaterial>(this);
+		Material->Friction = Friction;
+		Material->bOverrideFrictionCombineMode = true;
+		Material->FrictionCombineMode = EFrictionCombineMode::Min;
+		for (UStaticMeshComponent* Wheel : { FrontLeftWheel, FrontRightWheel, BackLeftWheel, BackRightWheel })
+		{
+			Wheel->SetPhysMaterialOverride(Material);
+		}
+	}
+
+	// A traverse writes its summary instead of the observation files, several of them run at once.
+	if (FParse::Value(CommandLine, TEXT("RoverSummary="), SummaryPath))
+	{
+		FParse::Value(CommandLine, TEXT("RoverDuration="), SummaryDuration);
+		bRunExperiment = true;
+		bWriteObservations = false;
+	}
+}
+
+void ABasic_Rover::UpdateSummary()
+{
+	// The traverse starts when ForceToApply is applied
+	const float Time = CurrentTime - 1.0f;
+	const FTransform Chassis = RoverChassis->GetComponentTransform();
+	if (Time > 0.0f)
+	{
+		SummaryDistance += FVector::Dist(Chassis.GetLocation(), SummaryLastLocation) / 100.0f;
+	}
+	SummaryLastLocation = Chassis.GetLocation();
+	const FVector Up = Chassis.GetUnitAxis(EAxis::Z);
+	SummaryMaxTilt = FMath::Max(SummaryMaxTilt, FMath::RadiansToDegrees(FMath::Acos(FMath::Clamp(Up.Z, -1.0f, 1.0f))));
+
+	if (bSummaryWritten || Time < SummaryDuration)
+	{
+		return;
+	}
+	const FVector Location = Chassis.GetLocation() / 100.0f;
+	TArray<FString> Summary;
+	Summary.Add(TEXT("Distance,Final X,Final Y,Final Z,Max Tilt,Mean Speed,Flipped"));
+	Summary.Add(FString::SanitizeFloat(SummaryDistance) + "," + FString::SanitizeFloat(Location.X) + "," + FString::SanitizeFloat(-Location.Y) + "," +
+		FString::SanitizeFloat(Location.Z) + "," + FString::SanitizeFloat(SummaryMaxTilt) + "," + FString::SanitizeFloat(SummaryDistance / FMath::Max(Time, 1e-6f)) + "," +
+		(Up.Z < 0.0f ? TEXT("1") : TEXT("0")));
+	if (!ATextFileManager::SaveArrayText(FPaths::GetPath(SummaryPath), FPaths::GetCleanFilename(SummaryPath), Summary, true))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not write %s"), *SummaryPath);
+	}
+	bSummaryWritten = true;
+	FGenericPlatformMisc::RequestExit(false);
+}
+
+void ABasic_Rover::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	delete Bridge;
+	Bridge = nullptr;
+
+	if (Replay)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Replayed %llu frames, %llu state hash mismatches"), (uint64)CurrentReplayStep.step, ReplayMismatches);
+		Replay.Reset();
+	}
+	Recorder.Close();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ABasic_Rover::UpdateBridge(float DeltaTime)
+{
+	// The bridge uses the frame of Gazebo: meters, x forward, y to the left and z up. Unreal's y axis points to the right,
+	// so y is mirrored, and the wheels Unreal calls left, on +y, are the right wheels of the bridge.
+	UStaticMeshComponent* BridgeWheels[rover::bridgeWheelCount] = { FrontRightWheel, FrontLeftWheel, BackRightWheel, BackLeftWheel };
+	const FTransform Chassis = RoverChassis->GetComponentTransform();
+	const FVector Axis = Chassis.GetUnitAxis(EAxis::Y);
+	const FVector ChassisAngularVelocity = RoverChassis->GetPhysicsAngularVelocityInRadians();
+
+	rover::BridgeState State;
+	State.step = ++BridgeStep;
+	State.time = GetWorld()->GetTimeSeconds();
+	const FVector Position = Chassis.GetLocation() / 100.0f;
+	const FVector Velocity = RoverChassis->GetPhysicsLinearVelocity() / 100.0f;
+	const FQuat Rotation = Chassis.GetRotation();
+	State.position[0] = Position.X;
+	State.position[1] = -Position.Y;
+	State.position[2] = Position.Z;
+	State.orientation[0] = Rotation.W;
+	State.orientation[1] = -Rotation.X;
+	State.orientation[2] = Rotation.Y;
+	State.orientation[3] = -Rotation.Z;
+	State.linearVelocity[0] = Velocity.X;
+	State.linearVelocity[1] = -Velocity.Y;
+	State.linearVelocity[2] = Velocity.Z;
+	State.angularVelocity[0] = -ChassisAngularVelocity.X;
+	State.angularVelocity[1] = ChassisAngularVelocity.Y;
+	State.angularVelocity[2] = -ChassisAngularVelocity.Z;
+	for (int32 Index = 0; Index < rover::bridgeWheelCount; Index++)
+	{
+		// Spin relative to the chassis, positive when rolling forward
+		const FVector Relative = BridgeWheels[Index]->GetPhysicsAngularVelocityInRadians() - ChassisAngularVelocity;
+		const float Rate = FVector::DotProduct(Relative, Axis);
+		BridgeWheelAngles[Index] += Rate * DeltaTime;
+		State.wheelAngle[Index] = BridgeWheelAngles[Index];
+		State.wheelRate[Index] = Rate;
+	}
+	State.stamp = rover::RoverBridge::Now();
+	Bridge->PublishState(State);
+
+	// Wait for the answer to this state, or take whatever arrived
+	rover::BridgeCommand Command;
+	bool bReceived = Bridge->ReceiveCommand(Command);
+	const int64 Deadline = State.stamp + int64(LockStepTimeout * 1e9);
+	while (LockStepTimeout > 0.0f && (!bReceived || Command.step < State.step) && rover::RoverBridge::Now() < Deadline)
+	{
+		bReceived = Bridge->ReceiveCommand(Command) || bReceived;
+		FPlatformProcess::Yield();
+	}
+	if (bReceived)
+	{
+		BridgeCommandMode = Command.mode;
+		for (int32 Index = 0; Index < rover::bridgeWheelCount; Index++)
+		{
+			BridgeCommandWheels[Index] = Command.wheels[Index];
+		}
+		bHasBridgeCommand = true;
+	}
+	if (!bHasBridgeCommand)
+	{
+		return;
+	}
+
+	for (int32 Index = 0; Index < rover::bridgeWheelCount; Index++)
+	{
+		const float Value = BridgeCommandWheels[Index];
+		const int32 Target = ReplayTargets().Find(BridgeWheels[Index]);
+		if (BridgeCommandMode == rover::BRIDGE_VELOCITY)
+		{
+			Actuate(Target, rover::REPLAY_ANGULAR_VELOCITY, ChassisAngularVelocity + Axis * Value);
+		}
+		else
+		{
+			// Newton meters to kg cm^2/s^2, the motor pushes back on the chassis
+			Actuate(Target, rover::REPLAY_TORQUE, Axis * Value * 10000.0f);
+			Actuate(0, rover::REPLAY_TORQUE, -Axis * Value * 10000.0f);
+		}
+	}
 }
 
 void ABasic_Rover::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
+	BeginReplayStep(DeltaTime);
+	if (Bridge && !Replay)
+	{
+		UpdateBridge(DeltaTime);
+	}
+	if (!bRunExperiment)
+	{
+		EndReplayStep();
+		return;
+	}
+
 	if (bHasAppliedForce && CurrentTime > 1.0f) 
 	{
 		
@@ -120,11 +352,16 @@ void ABasic_Rover::Tick(float DeltaTime)
 		BackLeftWheel->AddForce(ForceToApply);
 		BackRightWheel->AddForce(ForceToApply);
 		*/
-		RoverChassis->SetPhysicsLinearVelocity(ForceToApply);
+		Actuate(0, rover::REPLAY_LINEAR_VELOCITY, ForceToApply);
 		bHasAppliedForce = false;
 	}
 
-	if (CurrentTime > 1.0f)
+	if (!SummaryPath.IsEmpty())
+	{
+		UpdateSummary();
+	}
+
+	if (CurrentTime > 1.0f && bWriteObservations)
 	{
 		if (CurrentTime < TotalTime)
 		{
@@ -138,6 +375,128 @@ void ABasic_Rover::Tick(float DeltaTime)
 	}
 	UE_LOG(LogTemp, Warning, TEXT("Frame duration:%f"), DeltaTime);
 	CurrentTime += DeltaTime;
+	EndReplayStep();
+}
+
+TArray<UStaticMeshComponent*> ABasic_Rover::ReplayTargets() const
+{
+	return { RoverChassis, FrontLeftWheel, FrontRightWheel, BackLeftWheel, BackRightWheel };
+}
+
+uint64 ABasic_Rover::StateHash() const
+{
+	rover::StateHash Hash;
+	for (UStaticMeshComponent* Part : ReplayTargets())
+	{
+		const FTransform Transform = Part->GetComponentTransform();
+		const FVector Location = Transform.GetLocation();
+		const FQuat Rotation = Transform.GetRotation();
+		const FVector Velocity = Part->GetPhysicsLinearVelocity();
+		const FVector AngularVelocity = Part->GetPhysicsAngularVelocityInRadians();
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			Hash.Add(Location[Axis]);
+			Hash.Add(Velocity[Axis]);
+			Hash.Add(AngularVelocity[Axis]);
+		}
+		Hash.Add(Rotation.W);
+		Hash.Add(Rotation.X);
+		Hash.Add(Rotation.Y);
+		Hash.Add(Rotation.Z);
+	}
+	return Hash.Value();
+}
+
+void ABasic_Rover::BeginReplayStep(float DeltaTime)
+{
+	const double Now = FPlatformTime::Seconds();
+	CurrentReplayStep.step++;
+	CurrentReplayStep.dt = DeltaTime;
+	CurrentReplayStep.time = GetWorld()->GetTimeSeconds();
+	CurrentReplayStep.wallTime = CurrentReplayStep.step == 1 ? 0.0 : Now - LastTickSeconds;
+	CurrentReplayStep.stateHash = StateHash();
+	CurrentReplayStep.actuations.clear();
+	LastTickSeconds = Now;
+
+	if (!Replay)
+	{
+		return;
+	}
+
+	rover::ReplayStep Logged;
+	if (!Replay->Read(Logged))
+	{
+		UE_LOG(LogTemp, Log, TEXT("Replay finished after frame %llu, %llu state hash mismatches"), (uint64)CurrentReplayStep.step - 1, ReplayMismatches);
+		Replay.Reset();
+		return;
+	}
+	if (Logged.dt != CurrentReplayStep.dt)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Replay frame %llu lasts %f s, the log %f s"), (uint64)CurrentReplayStep.step, DeltaTime, Logged.dt);
+	}
+	if (Logged.stateHash != CurrentReplayStep.stateHash)
+	{
+		if (ReplayMismatches == 0)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Replay diverged at frame %llu, time %f"), (uint64)CurrentReplayStep.step, Logged.time);
+		}
+		ReplayMismatches++;
+	}
+	for (const rover::ReplayActuation& Actuation : Logged.actuations)
+	{
+		ApplyActuation(Actuation.target, Actuation.kind, FVector(Actuation.value[0], Actuation.value[1], Actuation.value[2]));
+	}
+}
+
+void ABasic_Rover::EndReplayStep()
+{
+	if (Recorder.IsOpen() && !Recorder.Write(CurrentReplayStep))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not write the replay log, recording stopped"));
+		Recorder.Close();
+	}
+}
+
+void ABasic_Rover::Actuate(int32 Target, uint32 Kind, const FVector& Value)
+{
+	if (Replay)
+	{
+		return;
+	}
+	ApplyActuation(Target, Kind, Value);
+
+	rover::ReplayActuation Actuation;
+	Actuation.target = Target;
+	Actuation.kind = Kind;
+	Actuation.value[0] = Value.X;
+	Actuation.value[1] = Value.Y;
+	Actuation.value[2] = Value.Z;
+	CurrentReplayStep.actuations.push_back(Actuation);
+}
+
+void ABasic_Rover::ApplyActuation(int32 Target, uint32 Kind, const FVector& Value)
+{
+	const TArray<UStaticMeshComponent*> Targets = ReplayTargets();
+	if (!Targets.IsValidIndex(Target))
+	{
+		return;
+	}
+	UStaticMeshComponent* Part = Targets[Target];
+	switch (Kind)
+	{
+	case rover::REPLAY_FORCE:
+		Part->AddForce(Value);
+		break;
+	case rover::REPLAY_TORQUE:
+		Part->AddTorqueInRadians(Value);
+		break;
+	case rover::REPLAY_LINEAR_VELOCITY:
+		Part->SetPhysicsLinearVelocity(Value);
+		break;
+	case rover::REPLAY_ANGULAR_VELOCITY:
+		Part->SetPhysicsAngularVelocityInRadians(Value);
+		break;
+	}
 }
 
 void ABasic_Rover::AddObservation(TArray<FString>* ObservationsArray, UStaticMeshComponent* Mesh)
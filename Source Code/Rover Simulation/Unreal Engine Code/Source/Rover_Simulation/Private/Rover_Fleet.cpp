@@ -0,0 +1,179 @@
+/*
+	Copyright [2021] [Andrei Lazar]
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+ */
+
+#include "Rover_Fleet.h"
+#include "Basic_Rover.h"
+#include "Components/SceneComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/World.h"
+#include "HAL/PlatformTime.h"
+#include "Kismet/KismetSystemLibrary.h"
+#include "TextFileManager.h"
+
+void FRoverFleetTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if (!Target || Target->IsPendingKill())
+	{
+		return;
+	}
+
+	if (TickGroup == TG_PostPhysics)
+	{
+		Target->PhysicsDone();
+	}
+	else
+	{
+		Target->RoversTicked();
+	}
+}
+
+FString FRoverFleetTickFunction::DiagnosticMessage()
+{
+	return TEXT("FRoverFleetTickFunction");
+}
+
+ARover_Fleet::ARover_Fleet()
+{
+	DummyRootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("DummyRootComponent"));
+	SetRootComponent(DummyRootComponent);
+
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+
+	RoversTickedTick.bCanEverTick = true;
+	RoversTickedTick.TickGroup = TG_PrePhysics;
+	PhysicsDoneTick.bCanEverTick = true;
+	PhysicsDoneTick.TickGroup = TG_PostPhysics;
+}
+
+void ARover_Fleet::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Floating rovers are spawned well above anything else in the level.
+	const int32 RowLength = FMath::CeilToInt(FMath::Sqrt(float(RoverCount)));
+	const FVector Origin = GetActorLocation() + (bGrounded ? FVector::ZeroVector : FVector(0, 0, 10000.0f));
+
+	for (int32 Index = 0; Index < RoverCount; Index++)
+	{
+		const FTransform Transform(FVector(Origin.X + (Index % RowLength) * Spacing, Origin.Y + (Index / RowLength) * Spacing, Origin.Z));
+		ABasic_Rover* Rover = GetWorld()->SpawnActorDeferred<ABasic_Rover>(ABasic_Rover::StaticClass(), Transform, this);
+		Rover->bRunExperiment = false;
+		Rover->FinishSpawning(Transform);
+
+		if (!bGrounded)
+		{
+			TArray<UStaticMeshComponent*> Parts = { Rover->RoverChassis, Rover->FrontLeftWheel, Rover->FrontRightWheel, Rover->BackLeftWheel, Rover->BackRightWheel };
+			for (UStaticMeshComponent* Part : Parts)
+			{
+				Part->SetEnableGravity(false);
+			}
+		}
+
+		// Rovers tick after the commands are applied and before the fleet marks the end of the actor ticks.
+		Rover->AddTickPrerequisiteActor(this);
+		RoversTickedTick.AddPrerequisite(Rover, Rover->PrimaryActorTick);
+
+		Rovers.Add(Rover);
+		FRoverFleetCommand Command;
+		Command.Stream.Initialize(Index);
+		Commands.Add(Command);
+	}
+
+	RoversTickedTick.Target = this;
+	RoversTickedTick.RegisterTickFunction(GetLevel());
+	PhysicsDoneTick.Target = this;
+	PhysicsDoneTick.RegisterTickFunction(GetLevel());
+
+	Observations.Add(TEXT("Frame,Delta Time,Command Time,Rover Tick Time,Physics Time"));
+	TimeSinceCommand = CommandPeriod;
+}
+
+void ARover_Fleet::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	RoversTickedTick.UnRegisterTickFunction();
+	PhysicsDoneTick.UnRegisterTickFunction();
+	Super::EndPlay(EndPlayReason);
+}
+
+void ARover_Fleet::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	FrameStart = FPlatformTime::Seconds();
+	ApplyCommands(DeltaTime);
+	CommandEnd = FPlatformTime::Seconds();
+}
+
+void ARover_Fleet::ApplyCommands(float DeltaTime)
+{
+	TimeSinceCommand += DeltaTime;
+	const bool bNewCommand = TimeSinceCommand >= CommandPeriod;
+	if (bNewCommand)
+	{
+		TimeSinceCommand = 0.0f;
+	}
+
+	for (int32 Index = 0; Index < Rovers.Num(); Index++)
+	{
+		FRoverFleetCommand& Command = Commands[Index];
+		if (bNewCommand)
+		{
+			const float Drive = MaxTorque * Command.Stream.FRandRange(-1.0f, 1.0f);
+			const float Turn = 0.5f * MaxTorque * Command.Stream.FRandRange(-1.0f, 1.0f);
+			Command.Left = Drive - Turn;
+			Command.Right = Drive + Turn;
+		}
+
+		// Torques are cleared after every physics step. The wheels turn about the rover's right axis, 1 Nm is 10000 kg cm^2 / s^2.
+		ABasic_Rover* Rover = Rovers[Index];
+		const FVector Axis = Rover->RoverChassis->GetRightVector() * 10000.0f;
+		Rover->FrontLeftWheel->AddTorqueInRadians(Axis * Command.Left);
+		Rover->BackLeftWheel->AddTorqueInRadians(Axis * Command.Left);
+		Rover->FrontRightWheel->AddTorqueInRadians(Axis * Command.Right);
+		Rover->BackRightWheel->AddTorqueInRadians(Axis * Command.Right);
+	}
+}
+
+void ARover_Fleet::RoversTicked()
+{
+	RoversEnd = FPlatformTime::Seconds();
+}
+
+void ARover_Fleet::PhysicsDone()
+{
+	const double PhysicsEnd = FPlatformTime::Seconds();
+	Frame++;
+	if (Frame <= WarmupFrames || Frame > WarmupFrames + MeasuredFrames)
+	{
+		return;
+	}
+
+	Observations.Add(FString::FromInt(Frame - WarmupFrames) + "," + FString::SanitizeFloat(GetWorld()->GetDeltaSeconds()) + "," +
+		FString::SanitizeFloat(CommandEnd - FrameStart) + "," + FString::SanitizeFloat(RoversEnd - CommandEnd) + "," + FString::SanitizeFloat(PhysicsEnd - RoversEnd));
+
+	if (Frame == WarmupFrames + MeasuredFrames)
+	{
+		WriteResults();
+	}
+}
+
+void ARover_Fleet::WriteResults()
+{
+	const FString FileName = FString::Printf(TEXT("Rover_Fleet_%d_%d.csv"), RoverCount, bGrounded ? 1 : 0);
+	ATextFileManager::SaveArrayText(UKismetSystemLibrary::GetProjectDirectory(), FileName, Observations, true);
+	UE_LOG(LogTemp, Warning, TEXT("Rover fleet of %d written to %s"), RoverCount, *FileName);
+}
@@ -0,0 +1,236 @@
+/*
+	Copyright [2021] [Andrei Lazar]
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+ */
+
+#include "Rover_Sensors.h"
+#include "Basic_Rover.h"
+#include "Components/SceneComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/FileManager.h"
+#include "Kismet/KismetSystemLibrary.h"
+
+ARover_Sensors::ARover_Sensors()
+{
+	DummyRootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("DummyRootComponent"));
+	SetRootComponent(DummyRootComponent);
+
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+
+	OnCalculateCustomPhysics.BindUObject(this, &ARover_Sensors::SubstepTick);
+}
+
+void ARover_Sensors::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (!OutputFile.IsEmpty())
+	{
+		const FString Path = UKismetSystemLibrary::GetProjectDirectory() / OutputFile;
+		Output.Reset(IFileManager::Get().CreateFileWriter(*Path));
+		if (Output)
+		{
+			FString Header = TEXT("Time,Rover,X Acceleration,Y Acceleration,Z Acceleration,X Angular Velocity,Y Angular Velocity,Z Angular Velocity");
+			for (int32 Wheel = 0; Wheel < rover::sensorWheelCount; Wheel++)
+			{
+				Header += FString::Printf(TEXT(",Wheel %d Ticks"), Wheel);
+			}
+			Header += LINE_TERMINATOR;
+			Output->Serialize(TCHAR_TO_ANSI(*Header), Header.Len());
+		}
+		else
+		{
+			UE_LOG(LogTemp, Error, TEXT("Could not open %s"), *Path);
+		}
+	}
+
+	Batch.Resize(0, Seed);
+	Ring.Reset(0, Capacity);
+	for (TActorIterator<ABasic_Rover> It(GetWorld()); It; ++It)
+	{
+		AddRover(*It);
+	}
+	ResizeBatch();
+
+	// Rovers spawned later, by a fleet for instance
+	ActorSpawnedHandle = GetWorld()->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &ARover_Sensors::OnActorSpawned));
+}
+
+void ARover_Sensors::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	GetWorld()->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+
+	if (Output)
+	{
+		Drain();
+		Output->Close();
+		Output.Reset();
+		UE_LOG(LogTemp, Log, TEXT("Rover sensors wrote %llu frames, %llu overwritten"), Written, (uint64)Ring.Overwritten());
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ARover_Sensors::OnActorSpawned(AActor* Actor)
+{
+	if (ABasic_Rover* Rover = Cast<ABasic_Rover>(Actor))
+	{
+		AddRover(Rover);
+	}
+}
+
+void ARover_Sensors::AddRover(ABasic_Rover* Rover)
+{
+	if (Rovers.Contains(Rover) || PendingRovers.Contains(Rover))
+	{
+		return;
+	}
+
+	// The substeps read Rovers on the physics thread, the rover joins at the next tick, once for all the rovers spawned
+	// in between
+	PendingRovers.Add(Rover);
+}
+
+void ARover_Sensors::ResizeBatch()
+{
+	if (PendingRovers.Num() == 0)
+	{
+		return;
+	}
+
+	// Rovers are only appended, so the new ones take the next noise generators
+	std::vector<int> From(Rovers.Num() + PendingRovers.Num(), -1);
+	for (int32 Index = 0; Index < Rovers.Num(); Index++)
+	{
+		From[Index] = Index;
+	}
+	Batch.Remap(From, Seed, Rovers.Num());
+	Ring.Remap(From);
+	WheelAngles.AddZeroed(PendingRovers.Num() * rover::sensorWheelCount);
+	Rovers.Append(PendingRovers);
+	PendingRovers.Reset();
+}
+
+// Called every frame
+void ARover_Sensors::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	// Physics is not running in this tick group, the ring and the rovers are the game thread's until it starts
+	if (Output)
+	{
+		Drain();
+	}
+	ResizeBatch();
+
+	// Custom physics only lasts for the next simulation, it has to be added again every frame. One body is enough,
+	// the callback samples all rovers.
+	if (Rovers.Num() > 0)
+	{
+		if (FBodyInstance* Body = Rovers[0]->RoverChassis->GetBodyInstance())
+		{
+			Body->AddCustomPhysics(OnCalculateCustomPhysics);
+		}
+	}
+}
+
+void ARover_Sensors::SubstepTick(float DeltaTime, FBodyInstance* BodyInstance)
+{
+	// Rovers spawned since the last tick wait in PendingRovers
+	const int32 Count = static_cast<int32>(Batch.Size());
+
+	// Encoders see every substep, the other readings only every sample
+	for (int32 Index = 0; Index < Count; Index++)
+	{
+		ABasic_Rover* Rover = Rovers[Index];
+		FBodyInstance* Chassis = Rover->RoverChassis->GetBodyInstance();
+		const FVector Axis = Chassis->GetUnrealWorldTransform_AssumesLocked().GetUnitAxis(EAxis::Y);
+		const FVector ChassisAngularVelocity = Chassis->GetUnrealWorldAngularVelocityInRadians_AssumesLocked();
+		UStaticMeshComponent* Wheels[rover::sensorWheelCount] = { Rover->FrontLeftWheel, Rover->FrontRightWheel, Rover->BackLeftWheel, Rover->BackRightWheel };
+		for (int32 Wheel = 0; Wheel < rover::sensorWheelCount; Wheel++)
+		{
+			const FVector Relative = Wheels[Wheel]->GetBodyInstance()->GetUnrealWorldAngularVelocityInRadians_AssumesLocked() - ChassisAngularVelocity;
+			WheelAngles[Index * rover::sensorWheelCount + Wheel] += FVector::DotProduct(Relative, Axis) * DeltaTime;
+		}
+	}
+
+	SampleTime += DeltaTime;
+	TimeSinceSample += DeltaTime;
+	if (bSampled && TimeSinceSample < 1.0f / Rate - KINDA_SMALL_NUMBER)
+	{
+		return;
+	}
+	const float SampleDeltaTime = bSampled ? TimeSinceSample : 0.0f;
+	TimeSinceSample = 0.0f;
+	bSampled = true;
+
+	// One pass over all rovers, centimeters to meters
+	for (int32 Index = 0; Index < Count; Index++)
+	{
+		FBodyInstance* Chassis = Rovers[Index]->RoverChassis->GetBodyInstance();
+		const FQuat Rotation = Chassis->GetUnrealWorldTransform_AssumesLocked().GetRotation();
+		const FVector Velocity = Chassis->GetUnrealWorldVelocity_AssumesLocked() / 100.0f;
+		const FVector AngularVelocity = Chassis->GetUnrealWorldAngularVelocityInRadians_AssumesLocked();
+		Batch.vx[Index] = Velocity.X;
+		Batch.vy[Index] = Velocity.Y;
+		Batch.vz[Index] = Velocity.Z;
+		Batch.qw[Index] = Rotation.W;
+		Batch.qx[Index] = Rotation.X;
+		Batch.qy[Index] = Rotation.Y;
+		Batch.qz[Index] = Rotation.Z;
+		Batch.wx[Index] = AngularVelocity.X;
+		Batch.wy[Index] = AngularVelocity.Y;
+		Batch.wz[Index] = AngularVelocity.Z;
+	}
+	FMemory::Memcpy(Batch.wheelAngle.data(), WheelAngles.GetData(), WheelAngles.Num() * sizeof(float));
+
+	rover::SensorParams Params;
+	Params.accelNoise = AccelNoise;
+	Params.accelBiasWalk = AccelBiasWalk;
+	Params.gyroNoise = GyroNoise;
+	Params.gyroBiasWalk = GyroBiasWalk;
+	Params.encoderTicks = EncoderTicks;
+	const float Gravity[3] = { 0.0f, 0.0f, GetWorld()->GetGravityZ() / 100.0f };
+	Batch.Evaluate(SampleDeltaTime, Params, Gravity);
+	Ring.Push(SampleTime, Batch);
+}
+
+void ARover_Sensors::Drain()
+{
+	const int32 Count = static_cast<int32>(Batch.Size());
+	for (size_t Frame = 0; Frame < Ring.Size(); Frame++)
+	{
+		const float* Imu = Ring.Imu(Frame);
+		const int32_t* Ticks = Ring.Encoders(Frame);
+		for (int32 Index = 0; Index < Count; Index++)
+		{
+			FString Line = FString::SanitizeFloat(Ring.Time(Frame)) + "," + Rovers[Index]->GetName();
+			for (int32 Channel = 0; Channel < 6; Channel++)
+			{
+				Line += "," + FString::SanitizeFloat(Imu[Channel * Count + Index]);
+			}
+			for (int32 Wheel = 0; Wheel < rover::sensorWheelCount; Wheel++)
+			{
+				Line += "," + FString::FromInt(Ticks[Index * rover::sensorWheelCount + Wheel]);
+			}
+			Line += LINE_TERMINATOR;
+			Output->Serialize(TCHAR_TO_ANSI(*Line), Line.Len());
+		}
+	}
+	Written += Ring.Size();
+	Ring.Clear();
+}
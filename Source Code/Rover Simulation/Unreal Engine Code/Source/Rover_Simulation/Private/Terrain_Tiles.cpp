@@ -0,0 +1,388 @@
+/*
+	Copyright [2021] [Andrei Lazar]
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+ */
+
+#include "Terrain_Tiles.h"
+#include "Async/Async.h"
+#include "Basic_Rover.h"
+#include "Components/SceneComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Kismet/KismetSystemLibrary.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "ProceduralMeshComponent.h"
+
+ATerrain_Tiles::ATerrain_Tiles()
+{
+	DummyRootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("DummyRootComponent"));
+	SetRootComponent(DummyRootComponent);
+
+	Rover = nullptr;
+	PrimaryActorTick.bCanEverTick = true;
+}
+
+void ATerrain_Tiles::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (FPaths::IsRelative(TerrainDirectory))
+	{
+		TerrainDirectory = FPaths::Combine(UKismetSystemLibrary::GetProjectDirectory(), TerrainDirectory);
+	}
+
+	if (!LoadManifest())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not read terrain manifest in %s"), *TerrainDirectory);
+		return;
+	}
+
+	TileMeshes.Init(nullptr, TilesPerSide * TilesPerSide);
+	TileLods.Init(-1, TilesPerSide * TilesPerSide);
+	if (bStreamTiles)
+	{
+		BuiltTiles = MakeShared<TQueue<TSharedPtr<FTerrainTileData>, EQueueMode::Mpsc>, ESPMode::ThreadSafe>();
+		PendingLods.Init(-1, TilesPerSide * TilesPerSide);
+		LastWanted.Init(0.0f, TilesPerSide * TilesPerSide);
+		UpdateStreaming();
+		return;
+	}
+
+	SetActorTickEnabled(false);
+	for (int32 J = 0; J < TilesPerSide; J++)
+	{
+		for (int32 I = 0; I < TilesPerSide; I++)
+		{
+			BuildTile(I, J, TileLod(I, J));
+		}
+	}
+}
+
+void ATerrain_Tiles::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (!BuiltTiles.IsValid())
+	{
+		return;
+	}
+
+	// Cooking collision for a tile is the expensive part, so only one tile is handed over per tick.
+	TSharedPtr<FTerrainTileData> Data;
+	while (BuiltTiles->Dequeue(Data))
+	{
+		const int32 Index = Data->J * TilesPerSide + Data->I;
+		if (PendingLods[Index] == Data->Lod)
+		{
+			PendingLods[Index] = -1;
+			ApplyTile(*Data);
+			break;
+		}
+		// Superseded by a newer request or no longer wanted.
+	}
+
+	TimeSinceUpdate += DeltaTime;
+	if (TimeSinceUpdate >= 0.25f)
+	{
+		TimeSinceUpdate = 0.0f;
+		UpdateStreaming();
+	}
+}
+
+bool ATerrain_Tiles::LoadManifest()
+{
+	TArray<FString> Lines;
+	if (!FFileHelper::LoadFileToStringArray(Lines, *FPaths::Combine(TerrainDirectory, TEXT("terrain.manifest"))))
+	{
+		return false;
+	}
+
+	TMap<FString, FString> Values;
+	for (const FString& Line : Lines)
+	{
+		FString Key, Value;
+		if (Line.Split(TEXT(" "), &Key, &Value))
+		{
+			Values.Add(Key, Value);
+		}
+	}
+
+	const TCHAR* RequiredKeys[] = { TEXT("size"), TEXT("tile_size"), TEXT("tiles_per_side"), TEXT("lod_levels"), TEXT("lod_distance"), TEXT("min_height"), TEXT("max_height") };
+	for (const TCHAR* Key : RequiredKeys)
+	{
+		if (!Values.Contains(Key))
+		{
+			return false;
+		}
+	}
+
+	Size = FCString::Atof(*Values[TEXT("size")]);
+	TileSize = FCString::Atof(*Values[TEXT("tile_size")]);
+	TilesPerSide = FCString::Atoi(*Values[TEXT("tiles_per_side")]);
+	LodLevels = FCString::Atoi(*Values[TEXT("lod_levels")]);
+	LodDistance = FCString::Atof(*Values[TEXT("lod_distance")]);
+	MinHeight = FCString::Atof(*Values[TEXT("min_height")]);
+	MaxHeight = FCString::Atof(*Values[TEXT("max_height")]);
+	return TilesPerSide > 0 && LodLevels > 0;
+}
+
+void ATerrain_Tiles::RoverState(FVector& Position, FVector& Velocity) const
+{
+	Position = FVector::ZeroVector;
+	Velocity = FVector::ZeroVector;
+	if (!Rover)
+	{
+		return;
+	}
+
+	// The root of a basic rover does not move, its chassis does.
+	const ABasic_Rover* BasicRover = Cast<ABasic_Rover>(Rover);
+	if (BasicRover && BasicRover->RoverChassis)
+	{
+		Position = (BasicRover->RoverChassis->GetComponentLocation() - GetActorLocation()) / 100.0f;
+		Velocity = BasicRover->RoverChassis->GetPhysicsLinearVelocity() / 100.0f;
+	}
+	else
+	{
+		Position = (Rover->GetActorLocation() - GetActorLocation()) / 100.0f;
+		Velocity = Rover->GetVelocity() / 100.0f;
+	}
+}
+
+float ATerrain_Tiles::TileDistance(int32 I, int32 J, const FVector& Position) const
+{
+	const float HalfSize = 0.5f * Size;
+	const float CenterX = -HalfSize + (I + 0.5f) * TileSize;
+	const float CenterY = -HalfSize + (J + 0.5f) * TileSize;
+	const float DX = FMath::Max(0.0f, FMath::Abs(Position.X - CenterX) - 0.5f * TileSize);
+	const float DY = FMath::Max(0.0f, FMath::Abs(Position.Y - CenterY) - 0.5f * TileSize);
+	return FMath::Sqrt(DX * DX + DY * DY);
+}
+
+int32 ATerrain_Tiles::TileLod(int32 I, int32 J) const
+{
+	FVector Position, Velocity;
+	RoverState(Position, Velocity);
+	const int32 Lod = FMath::FloorToInt(TileDistance(I, J, Position) / LodDistance);
+	return FMath::Min(Lod, LodLevels - 1);
+}
+
+void ATerrain_Tiles::UpdateStreaming()
+{
+	FVector Position, Velocity;
+	RoverState(Position, Velocity);
+	const float Now = GetWorld()->GetTimeSeconds();
+
+	// Tiles near the rover now, half way along the prefetch horizon and at its end.
+	TArray<TPair<float, int32>> Wanted;
+	for (int32 J = 0; J < TilesPerSide; J++)
+	{
+		for (int32 I = 0; I < TilesPerSide; I++)
+		{
+			const float Distance = TileDistance(I, J, Position);
+			if (Distance <= StreamRadius
+				|| TileDistance(I, J, Position + 0.5f * PrefetchTime * Velocity) <= StreamRadius
+				|| TileDistance(I, J, Position + PrefetchTime * Velocity) <= StreamRadius)
+			{
+				Wanted.Add(TPair<float, int32>(Distance, J * TilesPerSide + I));
+			}
+		}
+	}
+	// Closest first, and never more than the bound.
+	Wanted.Sort([](const TPair<float, int32>& A, const TPair<float, int32>& B) { return A.Key < B.Key; });
+	if (Wanted.Num() > MaxTiles)
+	{
+		Wanted.SetNum(MaxTiles);
+	}
+
+	for (const TPair<float, int32>& Tile : Wanted)
+	{
+		const int32 Index = Tile.Value;
+		const int32 I = Index % TilesPerSide;
+		const int32 J = Index / TilesPerSide;
+		const int32 Lod = FMath::Min(FMath::FloorToInt(Tile.Key / LodDistance), LodLevels - 1);
+		LastWanted[Index] = Now;
+		if (TileLods[Index] == Lod)
+		{
+			PendingLods[Index] = -1;
+			continue;
+		}
+		if (PendingLods[Index] == Lod)
+		{
+			continue;
+		}
+
+		// The old LOD stays in place until its replacement is applied.
+		PendingLods[Index] = Lod;
+		const FString Directory = TerrainDirectory;
+		const float SizeCopy = Size, TileSizeCopy = TileSize, MinHeightCopy = MinHeight, MaxHeightCopy = MaxHeight;
+		TSharedPtr<TQueue<TSharedPtr<FTerrainTileData>, EQueueMode::Mpsc>, ESPMode::ThreadSafe> Queue = BuiltTiles;
+		Async(EAsyncExecution::ThreadPool, [=]()
+		{
+			TSharedPtr<FTerrainTileData> Data = MakeShared<FTerrainTileData>();
+			Data->I = I;
+			Data->J = J;
+			Data->Lod = Lod;
+			if (LoadTileData(Directory, SizeCopy, TileSizeCopy, MinHeightCopy, MaxHeightCopy, *Data))
+			{
+				Queue->Enqueue(Data);
+			}
+		});
+	}
+
+	// Unload tiles that are no longer wanted, least recently wanted first.
+	TArray<int32> Unwanted;
+	for (int32 Index = 0; Index < TileLods.Num(); Index++)
+	{
+		if (LastWanted[Index] != Now)
+		{
+			PendingLods[Index] = -1;
+			if (TileLods[Index] >= 0)
+			{
+				Unwanted.Add(Index);
+			}
+		}
+	}
+	Unwanted.Sort([this](int32 A, int32 B) { return LastWanted[A] < LastWanted[B]; });
+	for (int32 Index : Unwanted)
+	{
+		UnloadTile(Index);
+	}
+}
+
+bool ATerrain_Tiles::LoadTileData(const FString& Directory, float InSize, float InTileSize, float InMinHeight, float InMaxHeight, FTerrainTileData& Tile)
+{
+	const int32 I = Tile.I;
+	const int32 J = Tile.J;
+	const FString FileName = FString::Printf(TEXT("tiles/tile_%d_%d_lod%d.r16"), I, J, Tile.Lod);
+	TArray<uint8> Data;
+	if (!FFileHelper::LoadFileToArray(Data, *FPaths::Combine(Directory, FileName)))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not read terrain tile %s"), *FileName);
+		return false;
+	}
+
+	const int32 Samples = FMath::RoundToInt(FMath::Sqrt(Data.Num() / 2.0f));
+	if (Samples < 2 || Samples * Samples * 2 != Data.Num())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Terrain tile %s is not square"), *FileName);
+		return false;
+	}
+
+	// Row 0 of a tile is its +y edge and column 0 its -x edge. Everything below is in centimeters.
+	const float Spacing = 100.0f * InTileSize / (Samples - 1);
+	const float MinX = 100.0f * (-0.5f * InSize + I * InTileSize);
+	const float MaxY = 100.0f * (-0.5f * InSize + (J + 1) * InTileSize);
+	const float HeightScale = 100.0f * (InMaxHeight - InMinHeight) / 65535.0f;
+
+	TArray<float> Heights;
+	Heights.SetNumUninitialized(Samples * Samples);
+	for (int32 Index = 0; Index < Samples * Samples; Index++)
+	{
+		const uint16 Value = Data[2 * Index] | (Data[2 * Index + 1] << 8);
+		Heights[Index] = 100.0f * InMinHeight + Value * HeightScale;
+	}
+
+	TArray<FVector>& Vertices = Tile.Vertices;
+	TArray<FVector>& Normals = Tile.Normals;
+	TArray<FVector2D>& UV0 = Tile.UV0;
+	Vertices.Reserve(Samples * Samples);
+	Normals.Reserve(Samples * Samples);
+	UV0.Reserve(Samples * Samples);
+	for (int32 Row = 0; Row < Samples; Row++)
+	{
+		for (int32 Col = 0; Col < Samples; Col++)
+		{
+			Vertices.Add(FVector(MinX + Col * Spacing, MaxY - Row * Spacing, Heights[Row * Samples + Col]));
+			UV0.Add(FVector2D(Col / float(Samples - 1), Row / float(Samples - 1)));
+
+			// Central differences, one sided on the tile border.
+			const int32 Left = FMath::Max(Col - 1, 0);
+			const int32 Right = FMath::Min(Col + 1, Samples - 1);
+			const int32 Up = FMath::Max(Row - 1, 0);
+			const int32 Down = FMath::Min(Row + 1, Samples - 1);
+			const float SlopeX = (Heights[Row * Samples + Right] - Heights[Row * Samples + Left]) / ((Right - Left) * Spacing);
+			const float SlopeY = (Heights[Up * Samples + Col] - Heights[Down * Samples + Col]) / ((Down - Up) * Spacing);
+			Normals.Add(FVector(-SlopeX, -SlopeY, 1.0f).GetSafeNormal());
+		}
+	}
+
+	// Two triangles per grid cell, wound so that they face +Z.
+	TArray<int32>& Triangles = Tile.Triangles;
+	Triangles.Reserve(6 * (Samples - 1) * (Samples - 1));
+	for (int32 Row = 0; Row < Samples - 1; Row++)
+	{
+		for (int32 Col = 0; Col < Samples - 1; Col++)
+		{
+			const int32 A = Row * Samples + Col;
+			const int32 B = A + 1;
+			const int32 C = A + Samples;
+			const int32 D = C + 1;
+			Triangles.Append({ A, B, C, B, D, C });
+		}
+	}
+
+	return true;
+}
+
+bool ATerrain_Tiles::BuildTile(int32 I, int32 J, int32 Lod)
+{
+	FTerrainTileData Data;
+	Data.I = I;
+	Data.J = J;
+	Data.Lod = Lod;
+	if (!LoadTileData(TerrainDirectory, Size, TileSize, MinHeight, MaxHeight, Data))
+	{
+		return false;
+	}
+	ApplyTile(Data);
+	return true;
+}
+
+void ATerrain_Tiles::ApplyTile(const FTerrainTileData& Data)
+{
+	const int32 Index = Data.J * TilesPerSide + Data.I;
+	UProceduralMeshComponent* TileMesh = TileMeshes[Index];
+	if (!TileMesh)
+	{
+		if (MeshPool.Num() > 0)
+		{
+			TileMesh = MeshPool.Pop();
+		}
+		else
+		{
+			TileMesh = NewObject<UProceduralMeshComponent>(this);
+			TileMesh->SetupAttachment(RootComponent);
+			TileMesh->bUseAsyncCooking = true;
+			TileMesh->RegisterComponent();
+		}
+		TileMeshes[Index] = TileMesh;
+	}
+
+	TileMesh->CreateMeshSection_LinearColor(0, Data.Vertices, Data.Triangles, Data.Normals, Data.UV0, TArray<FLinearColor>(), TArray<FProcMeshTangent>(), true);
+	TileLods[Index] = Data.Lod;
+}
+
+void ATerrain_Tiles::UnloadTile(int32 Index)
+{
+	UProceduralMeshComponent* TileMesh = TileMeshes[Index];
+	if (TileMesh)
+	{
+		TileMesh->ClearAllMeshSections();
+		MeshPool.Add(TileMesh);
+		TileMeshes[Index] = nullptr;
+	}
+	TileLods[Index] = -1;
+}
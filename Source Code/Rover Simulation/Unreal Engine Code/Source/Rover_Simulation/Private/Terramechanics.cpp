@@ -0,0 +1,187 @@
+/*
+	Copyright [2021] [Andrei Lazar]
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+ */
+
+#include "Terramechanics.h"
+#include "Basic_Rover.h"
+#include "Components/SceneComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+
+ATerramechanics::ATerramechanics()
+{
+	DummyRootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("DummyRootComponent"));
+	SetRootComponent(DummyRootComponent);
+
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+
+	OnCalculateCustomPhysics.BindUObject(this, &ATerramechanics::SubstepTick);
+}
+
+void ATerramechanics::BeginPlay()
+{
+	Super::BeginPlay();
+
+	for (TActorIterator<ABasic_Rover> It(GetWorld()); It; ++It)
+	{
+		AddRover(*It);
+	}
+	AddPendingRovers();
+
+	// Rovers spawned later, by a fleet for instance
+	ActorSpawnedHandle = GetWorld()->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &ATerramechanics::OnActorSpawned));
+}
+
+void ATerramechanics::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	GetWorld()->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ATerramechanics::OnActorSpawned(AActor* Actor)
+{
+	if (ABasic_Rover* Rover = Cast<ABasic_Rover>(Actor))
+	{
+		AddRover(Rover);
+	}
+}
+
+void ATerramechanics::AddRover(ABasic_Rover* Rover)
+{
+	if (Rovers.Contains(Rover) || PendingRovers.Contains(Rover))
+	{
+		return;
+	}
+
+	// Once for all the rovers spawned until the next tick
+	PendingRovers.Add(Rover);
+}
+
+void ATerramechanics::AddPendingRovers()
+{
+	if (PendingRovers.Num() == 0)
+	{
+		return;
+	}
+
+	const int32 First = Wheels.Num();
+	for (ABasic_Rover* Rover : PendingRovers)
+	{
+		Rovers.Add(Rover);
+		TArray<UStaticMeshComponent*> RoverWheels = { Rover->FrontLeftWheel, Rover->FrontRightWheel, Rover->BackLeftWheel, Rover->BackRightWheel };
+		for (UStaticMeshComponent* Wheel : RoverWheels)
+		{
+			if (bReplaceWheelContacts)
+			{
+				Wheel->SetCollisionResponseToChannel(ECC_WorldStatic, ECR_Ignore);
+			}
+
+			FTerramechanicsWheel Entry;
+			Entry.Wheel = Wheel;
+			Entry.Chassis = Rover->RoverChassis;
+			Wheels.Add(Entry);
+		}
+	}
+	PendingRovers.Reset();
+
+	// Only the new wheels need their size, the others keep theirs
+	Batch.Resize(Wheels.Num());
+	for (int32 Index = First; Index < Wheels.Num(); Index++)
+	{
+		Batch.radius[Index] = WheelRadius / 100.0f;
+		Batch.width[Index] = WheelWidth / 100.0f;
+	}
+}
+
+// Called every frame
+void ATerramechanics::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	// Physics is not running in this tick group
+	AddPendingRovers();
+
+	// Custom physics only lasts for the next simulation, it has to be added again every frame. One body is enough,
+	// the callback handles the wheels of all rovers.
+	if (Wheels.Num() > 0)
+	{
+		if (FBodyInstance* Body = Wheels[0].Chassis->GetBodyInstance())
+		{
+			Body->AddCustomPhysics(OnCalculateCustomPhysics);
+		}
+	}
+}
+
+void ATerramechanics::SubstepTick(float DeltaTime, FBodyInstance* BodyInstance)
+{
+	rover::SoilParams Soil;
+	Soil.n = SinkageExponent;
+	Soil.kc = CohesiveModulus;
+	Soil.kphi = FrictionalModulus;
+	Soil.cohesion = Cohesion;
+	Soil.frictionAngle = FMath::DegreesToRadians(FrictionAngle);
+	Soil.shearModulus = ShearModulus;
+	Soil.lateralShearModulus = LateralShearModulus;
+	Soil.damping = Damping;
+
+	// The model works in meters, Unreal in centimeters.
+	const float GroundHeight = GetActorLocation().Z;
+	TArray<FVector> Forwards;
+	TArray<FVector> Laterals;
+	Forwards.SetNum(Wheels.Num());
+	Laterals.SetNum(Wheels.Num());
+
+	for (int32 Index = 0; Index < Wheels.Num(); Index++)
+	{
+		FBodyInstance* Wheel = Wheels[Index].Wheel->GetBodyInstance();
+		FBodyInstance* Chassis = Wheels[Index].Chassis->GetBodyInstance();
+
+		// Horizontal heading of the rover and the wheel axis perpendicular to it
+		FVector Forward = Chassis->GetUnrealWorldTransform_AssumesLocked().GetUnitAxis(EAxis::X);
+		Forward.Z = 0.0f;
+		Forward = Forward.GetSafeNormal(KINDA_SMALL_NUMBER, FVector::ForwardVector);
+		const FVector Lateral = FVector::UpVector ^ Forward;
+		Forwards[Index] = Forward;
+		Laterals[Index] = Lateral;
+
+		const FVector Position = Wheel->GetUnrealWorldTransform_AssumesLocked().GetLocation();
+		const FVector Velocity = Wheel->GetUnrealWorldVelocity_AssumesLocked();
+		const FVector AngularVelocity = Wheel->GetUnrealWorldAngularVelocityInRadians_AssumesLocked();
+
+		Batch.sinkage[Index] = (GroundHeight - (Position.Z - WheelRadius)) / 100.0f;
+		Batch.sinkageRate[Index] = -Velocity.Z / 100.0f;
+		Batch.forwardVelocity[Index] = FVector::DotProduct(Velocity, Forward) / 100.0f;
+		Batch.lateralVelocity[Index] = FVector::DotProduct(Velocity, Lateral) / 100.0f;
+		Batch.spinRate[Index] = FVector::DotProduct(AngularVelocity, Lateral);
+	}
+
+	Batch.Evaluate(Soil);
+
+	// Newtons to kg cm/s^2 and newton meters to kg cm^2/s^2. The surface normal is taken as vertical.
+	for (int32 Index = 0; Index < Wheels.Num(); Index++)
+	{
+		if (Batch.normalForce[Index] <= 0.0f)
+		{
+			continue;
+		}
+		FBodyInstance* Wheel = Wheels[Index].Wheel->GetBodyInstance();
+		const FVector Force = Forwards[Index] * Batch.drawbarPull[Index] + Laterals[Index] * Batch.lateralForce[Index] + FVector::UpVector * Batch.normalForce[Index];
+		Wheel->AddForce(Force * 100.0f, false, false);
+		Wheel->AddTorqueInRadians(Laterals[Index] * Batch.resistiveTorque[Index] * 10000.0f, false, false);
+	}
+}
@@ -18,6 +18,7 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "replay_log.hh"
 #include "Basic_Rover.generated.h"
 
 class UStaticMeshComponent;
@@ -25,6 +26,11 @@ class UMaterial;
 class USceneComponent;
 class UPhysicsConstraintComponent;
 
+namespace rover
+{
+	class RoverBridge;
+}
+
 /* Thiss class is used to represent a basic rover containing one box placed on top of 4 cylinders acting as wheels.*/
 UCLASS()
 class ROVER_SIMULATION_API ABasic_Rover : public AActor
@@ -53,6 +59,69 @@ private:
 
 	bool bHasAddedLabels = false;
 
+	/* Off for traverses started from the command line, which only write their summary. */
+	bool bWriteObservations = true;
+
+	/* Summary of a traverse started by traverse_runner, see ReadTraverseCommandLine. Empty path for none. */
+	FString SummaryPath;
+	float SummaryDuration = 15.0f;
+	float SummaryDistance = 0.0f;
+	float SummaryMaxTilt = 0.0f;
+	FVector SummaryLastLocation = FVector::ZeroVector;
+	bool bSummaryWritten = false;
+
+	/* Reads the initial velocity, chassis mass, wheel friction and summary file of a headless traverse from the command line:
+	   -RoverVelocity=X,Y,Z -RoverMass=KG -RoverFriction=MU -RoverDuration=S -RoverSummary=PATH */
+	void ReadTraverseCommandLine();
+
+	/* Follows the traverse and writes its summary and quits once it is over. */
+	void UpdateSummary();
+
+	/* Shared memory link to an external controller, see rover_bridge.hh in the Gazebo code. Null without a BridgeName. */
+	rover::RoverBridge* Bridge = nullptr;
+
+	uint64 BridgeStep = 0;
+
+	/* Wheel angles integrated from their spin, in the order of the bridge. */
+	float BridgeWheelAngles[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+	/* Last command of the controller, applied every frame until the next one arrives. */
+	bool bHasBridgeCommand = false;
+	uint32 BridgeCommandMode = 0;
+	float BridgeCommandWheels[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+	/* Publishes the rover state to the bridge and applies the command of the controller. */
+	void UpdateBridge(float DeltaTime);
+
+	/* The frame being run, written to the log when recording. See replay_log.hh in the Gazebo code. */
+	rover::ReplayStep CurrentReplayStep;
+
+	rover::ReplayWriter Recorder;
+
+	/* Log being replayed, null when not replaying or once it has ended. */
+	TUniquePtr<rover::ReplayReader> Replay;
+
+	uint64 ReplayMismatches = 0;
+
+	double LastTickSeconds = 0.0;
+
+	/* Parts an actuation can target, in the order of the names stored in replay logs. */
+	TArray<UStaticMeshComponent*> ReplayTargets() const;
+
+	/* Hash of the pose and velocity of every part of the rover. */
+	uint64 StateHash() const;
+
+	/* Starts the log step of a frame and, when replaying, applies the logged actuations. */
+	void BeginReplayStep(float DeltaTime);
+
+	/* Writes the log step of a frame when recording. */
+	void EndReplayStep();
+
+	/* Applies an actuation computed by this frame and logs it. Ignored while replaying, the log drives the rover then. */
+	void Actuate(int32 Target, uint32 Kind, const FVector& Value);
+
+	void ApplyActuation(int32 Target, uint32 Kind, const FVector& Value);
+
 	TArray<FString> FrontLeftWheelObservations;
 	TArray<FString> FrontRightWheelObservations;
 	TArray<FString> BackLeftWheelObservations;
@@ -62,6 +131,8 @@ private:
 protected:
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 public:	
 	ABasic_Rover();
 
@@ -106,4 +177,32 @@ public:
 
 	UPROPERTY(EditAnywhere)
 	FVector ForceToApply;
+
+	/* Sets the chassis velocity to ForceToApply after one second and writes the observations of every part to csv files.
+	   Turned off by ARover_Fleet, which drives the wheels of its rovers itself. */
+	UPROPERTY(EditAnywhere)
+	bool bRunExperiment = true;
+
+	/* Name of the shared memory bridge an external controller process opens to read the rover state and send wheel commands
+	   every frame, as with the bridge of the Gazebo rover_movement plugin. Empty for no bridge. */
+	UPROPERTY(EditAnywhere)
+	FString BridgeName;
+
+	/* Seconds every frame waits for the command answering its state, 0 applies the newest command without waiting. */
+	UPROPERTY(EditAnywhere)
+	float LockStepTimeout = 0.0f;
+
+	/* File every frame's schedule, state hash, wall time and actuations are logged to. Empty for no recording. */
+	UPROPERTY(EditAnywhere)
+	FString RecordPath;
+
+	/* Log of an earlier run to drive the rover with instead of the experiment and the bridge. Every frame whose starting
+	   state differs from the logged one is reported. Empty for no replay. */
+	UPROPERTY(EditAnywhere)
+	FString ReplayPath;
+
+	/* Frame time while recording or replaying, the engine runs with a fixed time step so that the schedule repeats. Physics
+	   only repeats bit for bit with enhanced determinism on in the physics project settings. */
+	UPROPERTY(EditAnywhere)
+	float FixedDeltaTime = 1.0f / 60.0f;
 };
@@ -0,0 +1,142 @@
+/*
+	Copyright [2021] [Andrei Lazar]
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineBaseTypes.h"
+#include "GameFramework/Actor.h"
+#include "Rover_Fleet.generated.h"
+
+class ABasic_Rover;
+class ARover_Fleet;
+
+/* Tick function of ARover_Fleet that marks a point in the frame, used to time the phases between its ticks. */
+USTRUCT()
+struct FRoverFleetTickFunction : public FTickFunction
+{
+	GENERATED_BODY()
+
+	ARover_Fleet* Target = nullptr;
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+
+	virtual FString DiagnosticMessage() override;
+};
+
+template<>
+struct TStructOpsTypeTraits<FRoverFleetTickFunction> : public TStructOpsTypeTraitsBase2<FRoverFleetTickFunction>
+{
+	enum
+	{
+		WithCopy = false
+	};
+};
+
+/* Independent command stream of one rover: wheel torques redrawn every command period from the rover's own random stream. */
+struct FRoverFleetCommand
+{
+	FRandomStream Stream;
+	float Left = 0.0f;
+	float Right = 0.0f;
+};
+
+/* This class spawns a fleet of basic rovers, drives each one with its own stream of wheel torque commands and measures how
+   the frame time splits into actor ticks and physics as the fleet grows. Every frame is timed at three points:
+   the fleet tick at the start of the pre physics group, after all rover ticks, and at the start of the post physics group.
+   Running the same fleet with bGrounded off leaves only the wheel constraints to solve, the difference is the cost of contacts.
+   The results are written to Rover_Fleet_<RoverCount>_<Grounded>.csv in the project directory. */
+UCLASS()
+class ROVER_SIMULATION_API ARover_Fleet : public AActor
+{
+	GENERATED_BODY()
+
+private:
+
+	USceneComponent* DummyRootComponent;
+
+	UPROPERTY()
+	TArray<ABasic_Rover*> Rovers;
+
+	TArray<FRoverFleetCommand> Commands;
+
+	float TimeSinceCommand = 0.0f;
+
+	int32 Frame = 0;
+
+	/* Times of the current frame from FPlatformTime::Seconds. */
+	double FrameStart = 0.0;
+	double CommandEnd = 0.0;
+	double RoversEnd = 0.0;
+
+	/* One line per measured frame. */
+	TArray<FString> Observations;
+
+	void ApplyCommands(float DeltaTime);
+
+	void WriteResults();
+
+protected:
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
+	ARover_Fleet();
+
+	// Called every frame, at the start of the pre physics tick group
+	virtual void Tick(float DeltaTime) override;
+
+	/* Called after the ticks of all rovers. */
+	void RoversTicked();
+
+	/* Called at the start of the post physics tick group. */
+	void PhysicsDone();
+
+	/* Runs after the ticks of all rovers, still before physics. */
+	FRoverFleetTickFunction RoversTickedTick;
+
+	/* Runs once physics has finished for the frame. */
+	FRoverFleetTickFunction PhysicsDoneTick;
+
+	/* Number of rovers to spawn. */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "1", ClampMax = "1000"))
+	int32 RoverCount = 10;
+
+	/* Distance between neighboring rovers on the spawn grid, in centimeters. */
+	UPROPERTY(EditAnywhere)
+	float Spacing = 400.0f;
+
+	/* Rovers drive on the ground, otherwise they float without gravity and never touch anything. */
+	UPROPERTY(EditAnywhere)
+	bool bGrounded = true;
+
+	/* Largest wheel torque of a command, in newton meters. */
+	UPROPERTY(EditAnywhere)
+	float MaxTorque = 2.0f;
+
+	/* Seconds between new commands of every rover. */
+	UPROPERTY(EditAnywhere)
+	float CommandPeriod = 0.5f;
+
+	/* Frames that are not measured while the rovers settle. */
+	UPROPERTY(EditAnywhere)
+	int32 WarmupFrames = 200;
+
+	/* Frames that are measured. */
+	UPROPERTY(EditAnywhere)
+	int32 MeasuredFrames = 1000;
+};
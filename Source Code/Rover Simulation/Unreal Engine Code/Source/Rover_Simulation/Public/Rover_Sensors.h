@@ -0,0 +1,127 @@
+/*
+	Copyright [2021] [Andrei Lazar]
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "PhysicsEngine/BodyInstance.h"
+#include "sensor_batch.hh"
+#include "Rover_Sensors.generated.h"
+
+class ABasic_Rover;
+class FArchive;
+class UStaticMeshComponent;
+
+/* This class simulates an IMU on the chassis and an encoder on every wheel of every basic rover in the level, with the same
+   model as the Gazebo sensor_batch plugin (sensor_batch.hh in the Gazebo code). All rovers are sampled in one pass from the
+   physics bodies during the physics substeps, instead of through the component getters of every rover, and every sample
+   goes into a preallocated ring. Readings are in SI units and the axes of Unreal.
+   With an OutputFile the ring is written out every tick, otherwise it keeps the newest frames. Only the substeps write
+   the ring and only the game thread reads it or changes the set of rovers, in the tick before physics runs. */
+UCLASS()
+class ROVER_SIMULATION_API ARover_Sensors : public AActor
+{
+	GENERATED_BODY()
+
+private:
+
+	USceneComponent* DummyRootComponent;
+
+	UPROPERTY()
+	TArray<ABasic_Rover*> Rovers;
+
+	/* Rovers spawned since the last tick, added to Rovers by the next one. */
+	UPROPERTY()
+	TArray<ABasic_Rover*> PendingRovers;
+
+	rover::SensorBatch Batch;
+
+	rover::SensorRing Ring;
+
+	/* Wheel angles integrated from their spin relative to the chassis, as Batch.wheelAngle. */
+	TArray<float> WheelAngles;
+
+	float TimeSinceSample = 0.0f;
+
+	float SampleTime = 0.0f;
+
+	bool bSampled = false;
+
+	TUniquePtr<FArchive> Output;
+
+	uint64 Written = 0;
+
+	FCalculateCustomPhysics OnCalculateCustomPhysics;
+
+	FDelegateHandle ActorSpawnedHandle;
+
+	void AddRover(ABasic_Rover* Rover);
+
+	/* Moves the pending rovers to Rovers and grows the batch, the ring and the wheel angles for them. The other rovers
+	   keep their noise and their frames. */
+	void ResizeBatch();
+
+	void OnActorSpawned(AActor* Actor);
+
+	/* Samples every rover once a sample period has passed into the ring, called by physics every substep. */
+	void SubstepTick(float DeltaTime, FBodyInstance* BodyInstance);
+
+	/* Writes every frame of the ring to the output file and empties it. */
+	void Drain();
+
+protected:
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
+	ARover_Sensors();
+
+	// Called every frame
+	virtual void Tick(float DeltaTime) override;
+
+	/* Samples per second, at most one per physics substep. */
+	UPROPERTY(EditAnywhere)
+	float Rate = 1000.0f;
+
+	UPROPERTY(EditAnywhere)
+	int32 Seed = 1;
+
+	/* Frames held by the ring. */
+	UPROPERTY(EditAnywhere)
+	int32 Capacity = 1000;
+
+	/* File in the project directory the frames are written to. Empty to keep them in the ring only. */
+	UPROPERTY(EditAnywhere)
+	FString OutputFile = TEXT("Rover_Sensors.csv");
+
+	/* Sensor noise, see rover::SensorParams. */
+	UPROPERTY(EditAnywhere, Category = "Noise")
+	float AccelNoise = 0.02f;
+
+	UPROPERTY(EditAnywhere, Category = "Noise")
+	float AccelBiasWalk = 0.0005f;
+
+	UPROPERTY(EditAnywhere, Category = "Noise")
+	float GyroNoise = 0.002f;
+
+	UPROPERTY(EditAnywhere, Category = "Noise")
+	float GyroBiasWalk = 0.00005f;
+
+	UPROPERTY(EditAnywhere, Category = "Noise")
+	int32 EncoderTicks = 2048;
+};
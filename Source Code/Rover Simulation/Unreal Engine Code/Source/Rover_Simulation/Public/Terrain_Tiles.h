@@ -0,0 +1,142 @@
+/*
+	Copyright [2021] [Andrei Lazar]
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Containers/Queue.h"
+#include "Terrain_Tiles.generated.h"
+
+class UProceduralMeshComponent;
+class USceneComponent;
+
+/* Mesh data of one tile at one LOD, built off the game thread when streaming. */
+struct FTerrainTileData
+{
+	int32 I = 0;
+	int32 J = 0;
+	int32 Lod = 0;
+	TArray<FVector> Vertices;
+	TArray<int32> Triangles;
+	TArray<FVector> Normals;
+	TArray<FVector2D> UV0;
+};
+
+/* This class builds the terrain written by the Gazebo generate_terrain tool as one procedural mesh with collision per tile.
+   Tiles far from the rover use the coarser LOD levels of the generator, so collision cost does not grow with the terrain size.
+   Terrain x and y map to Unreal X and Y, like the rover wheel offsets do.
+   With bStreamTiles set only the tiles around the rover and along its predicted path are kept, their meshes are built on
+   the thread pool and at most one of them is handed to the physics scene per tick. */
+UCLASS()
+class ROVER_SIMULATION_API ATerrain_Tiles : public AActor
+{
+	GENERATED_BODY()
+
+private:
+
+	USceneComponent* DummyRootComponent;
+
+	bool LoadManifest();
+
+	/* Position and velocity of the rover in meters relative to the terrain, the chassis is followed for a basic rover. */
+	void RoverState(FVector& Position, FVector& Velocity) const;
+
+	/* Distance in meters from a point to the closest point of a tile. */
+	float TileDistance(int32 I, int32 J, const FVector& Position) const;
+
+	/* Returns the LOD of a tile for the current rover position. */
+	int32 TileLod(int32 I, int32 J) const;
+
+	/* Reads the .r16 file of a tile at the given LOD and builds its mesh data. Only reads its arguments, so it can run on any thread. */
+	static bool LoadTileData(const FString& Directory, float InSize, float InTileSize, float InMinHeight, float InMaxHeight, FTerrainTileData& Data);
+
+	/* Builds the mesh section and collision of a tile from its .r16 file at the given LOD. */
+	bool BuildTile(int32 I, int32 J, int32 Lod);
+
+	/* Creates the mesh section and collision of a tile, reusing a pooled component if there is one. */
+	void ApplyTile(const FTerrainTileData& Data);
+
+	/* Clears a tile and returns its component to the pool. */
+	void UnloadTile(int32 Index);
+
+	/* Picks the tiles to keep loaded, starts loading the missing ones and unloads the rest. */
+	void UpdateStreaming();
+
+	/* Components of unloaded tiles, kept to avoid creating new ones. */
+	UPROPERTY()
+	TArray<UProceduralMeshComponent*> MeshPool;
+
+	/* Tiles built on the thread pool and waiting to be applied, shared with the loading tasks. */
+	TSharedPtr<TQueue<TSharedPtr<FTerrainTileData>, EQueueMode::Mpsc>, ESPMode::ThreadSafe> BuiltTiles;
+
+	/* LOD being loaded for each tile, -1 if none. */
+	TArray<int32> PendingLods;
+
+	/* Last time each tile was wanted, used to unload the least recently wanted tiles first. */
+	TArray<float> LastWanted;
+
+	float TimeSinceUpdate = 0.0f;
+
+	/* Values read from terrain.manifest, lengths in meters. */
+	float Size = 0.0f;
+	float TileSize = 0.0f;
+	int32 TilesPerSide = 0;
+	int32 LodLevels = 1;
+	float LodDistance = 0.0f;
+	float MinHeight = 0.0f;
+	float MaxHeight = 0.0f;
+
+protected:
+	virtual void BeginPlay() override;
+
+public:
+	ATerrain_Tiles();
+
+	// Called every frame
+	virtual void Tick(float DeltaTime) override;
+
+	/* Directory written by generate_terrain, absolute or relative to the project directory. */
+	UPROPERTY(EditAnywhere)
+	FString TerrainDirectory;
+
+	/* Actor whose position selects the LOD of each tile, the origin is used if not set. */
+	UPROPERTY(EditAnywhere)
+	AActor* Rover;
+
+	/* Load tiles around the rover while it moves instead of building every tile at BeginPlay. */
+	UPROPERTY(EditAnywhere)
+	bool bStreamTiles = false;
+
+	/* Distance in meters from the rover, now or along its predicted path, within which tiles are loaded. */
+	UPROPERTY(EditAnywhere)
+	float StreamRadius = 100.0f;
+
+	/* How far ahead in seconds the rover position is predicted from its velocity. */
+	UPROPERTY(EditAnywhere)
+	float PrefetchTime = 5.0f;
+
+	/* Bound on the number of loaded tiles, the closest ones are kept. */
+	UPROPERTY(EditAnywhere)
+	int32 MaxTiles = 64;
+
+	/* One mesh component per tile, indexed by J * TilesPerSide + I, null for tiles that are not loaded. */
+	UPROPERTY(VisibleAnywhere)
+	TArray<UProceduralMeshComponent*> TileMeshes;
+
+	/* LOD currently built for each tile, -1 if not built. */
+	TArray<int32> TileLods;
+};
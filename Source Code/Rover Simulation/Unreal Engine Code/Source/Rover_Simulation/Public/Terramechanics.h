@@ -0,0 +1,122 @@
+/*
+	Copyright [2021] [Andrei Lazar]
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+		http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "PhysicsEngine/BodyInstance.h"
+#include "terramechanics.hh"
+#include "Terramechanics.generated.h"
+
+class ABasic_Rover;
+class UStaticMeshComponent;
+
+/* A wheel driven by the soil and the chassis that gives its rover's heading. */
+struct FTerramechanicsWheel
+{
+	UStaticMeshComponent* Wheel = nullptr;
+	UStaticMeshComponent* Chassis = nullptr;
+};
+
+/* This class applies wheel-soil forces to the wheels of every basic rover in the level, with the same Bekker and
+   Janosi-Hanamoto model as the Gazebo terramechanics plugin (terramechanics.hh in the Gazebo code). The soil surface is a
+   plane at the height of this actor. All wheels are evaluated together in one batch, once per physics substep. Rovers
+   spawned during a frame are only added by the next tick, before physics runs, since the substeps read the wheels on
+   the physics thread.
+   With bReplaceWheelContacts the wheels stop colliding with static geometry, so the rovers rest on the soil alone. */
+UCLASS()
+class ROVER_SIMULATION_API ATerramechanics : public AActor
+{
+	GENERATED_BODY()
+
+private:
+
+	USceneComponent* DummyRootComponent;
+
+	UPROPERTY()
+	TArray<ABasic_Rover*> Rovers;
+
+	/* Rovers spawned since the last tick, added by the next one. */
+	UPROPERTY()
+	TArray<ABasic_Rover*> PendingRovers;
+
+	TArray<FTerramechanicsWheel> Wheels;
+
+	rover::WheelSoilBatch Batch;
+
+	FCalculateCustomPhysics OnCalculateCustomPhysics;
+
+	FDelegateHandle ActorSpawnedHandle;
+
+	void AddRover(ABasic_Rover* Rover);
+
+	/* Adds the wheels of the pending rovers and sizes the batch for them, the other wheels keep theirs. */
+	void AddPendingRovers();
+
+	void OnActorSpawned(AActor* Actor);
+
+	/* Evaluates the batch and applies the forces, called by physics every substep. */
+	void SubstepTick(float DeltaTime, FBodyInstance* BodyInstance);
+
+protected:
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
+	ATerramechanics();
+
+	// Called every frame
+	virtual void Tick(float DeltaTime) override;
+
+	/* Wheel radius and width, in centimeters. */
+	UPROPERTY(EditAnywhere)
+	float WheelRadius = 15.0f;
+
+	UPROPERTY(EditAnywhere)
+	float WheelWidth = 10.0f;
+
+	/* Turns off the collisions of the wheels with static geometry when a rover is added. */
+	UPROPERTY(EditAnywhere)
+	bool bReplaceWheelContacts = true;
+
+	/* Soil parameters in SI units, see rover::SoilParams. */
+	UPROPERTY(EditAnywhere, Category = "Soil")
+	float SinkageExponent = 1.0f;
+
+	UPROPERTY(EditAnywhere, Category = "Soil")
+	float CohesiveModulus = 1400.0f;
+
+	UPROPERTY(EditAnywhere, Category = "Soil")
+	float FrictionalModulus = 820000.0f;
+
+	UPROPERTY(EditAnywhere, Category = "Soil")
+	float Cohesion = 170.0f;
+
+	/* Internal friction angle, in degrees. */
+	UPROPERTY(EditAnywhere, Category = "Soil")
+	float FrictionAngle = 35.0f;
+
+	UPROPERTY(EditAnywhere, Category = "Soil")
+	float ShearModulus = 0.018f;
+
+	UPROPERTY(EditAnywhere, Category = "Soil")
+	float LateralShearModulus = 0.018f;
+
+	UPROPERTY(EditAnywhere, Category = "Soil")
+	float Damping = 200.0f;
+};